@@ -1,87 +1,267 @@
 
 #include <stdbool.h>
-#include <stdalign.h>
-#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 
-#include <lua.h>
-#include <lauxlib.h>
+#include "audio.h"
 
-typedef float audio_sample_t;
+#ifndef EL_AUDIO_POISON_VIEWS
+ #ifdef NDEBUG
+  #define EL_AUDIO_POISON_VIEWS 0
+ #else
+  #define EL_AUDIO_POISON_VIEWS 1
+ #endif
+#endif
 
-typedef struct _AudioBuffer {
+struct el_audio_buffer_s {
     int nframes;
     int nchannels;
-    size_t size;
-    char* data;
     float** channels;
-    float* prealloc [32];
-    bool cleared;
-} AudioBuffer;
+    bool owner;
+    bool stale;
+};
 
 //=============================================================================
-static void audiobuffer_init (AudioBuffer* buf) {
+static void audiobuffer_setmetatable (lua_State* L);
+
+el_audio_buffer_t* el_audio_buffer_new (lua_State* L, int nchannels, int nframes) {
+    if (nchannels < 0) nchannels = 0;
+    if (nframes < 0) nframes = 0;
+
+    // the struct, the channel list and then the samples, 16 byte aligned
+    size_t list_size = sizeof (el_audio_buffer_t) + (size_t) nchannels * sizeof (float*);
+    list_size = (list_size + 15) & ~(size_t) 15;
+    size_t size = list_size + (size_t) nchannels * (size_t) nframes * sizeof (float) + 16;
+
+    el_audio_buffer_t* buf = (el_audio_buffer_t*) lua_newuserdata (L, size);
+    char* data = (char*) buf;
+    char* samples = (char*) (((uintptr_t) data + list_size + 15) & ~(uintptr_t) 15);
+
+    buf->nframes = nframes;
+    buf->nchannels = nchannels;
+    buf->channels = (float**) (data + sizeof (el_audio_buffer_t));
+    buf->owner = true;
+    buf->stale = false;
+
+    for (int c = 0; c < nchannels; ++c)
+        buf->channels[c] = (float*) samples + (size_t) c * (size_t) nframes;
+    if (nchannels > 0 && nframes > 0)
+        memset (samples, 0, (size_t) nchannels * (size_t) nframes * sizeof (float));
+
+    audiobuffer_setmetatable (L);
+    return buf;
+}
+
+el_audio_buffer_t* el_audio_buffer_new_view (lua_State* L) {
+    el_audio_buffer_t* buf = (el_audio_buffer_t*) lua_newuserdata (L, sizeof (el_audio_buffer_t));
     buf->nframes = buf->nchannels = 0;
-    buf->size = 0;
-    buf->data = NULL;
-    memset (buf->channels, 0, sizeof(float*) * 32);
-    buf->channels = (float**) buf->prealloc;
-    buf->cleared = false;
+    buf->channels = NULL;
+    buf->owner = false;
+    buf->stale = false;
+    audiobuffer_setmetatable (L);
+    return buf;
 }
 
-static int audiobuffer_new (lua_State* L) {
-    AudioBuffer* buf = lua_newuserdata (L, sizeof (AudioBuffer));
-    audiobuffer_init (buf);
-    return 1;
+void el_audio_buffer_refer_to (el_audio_buffer_t* buf, float** channels, int nchannels, int nframes) {
+    if (buf->owner)
+        return;
+    buf->channels = channels;
+    buf->nchannels = channels != NULL && nchannels > 0 ? nchannels : 0;
+    buf->nframes = nframes > 0 ? nframes : 0;
+    buf->stale = false;
 }
 
-//=============================================================================
-static void audiobuffer_allocate_data (AudioBuffer* buf) {
-    size_t list_size = (size_t)(buf->nchannels + 1) * sizeof(float*);
-    size_t required_alignment = (size_t) alignof (float);
-    size_t alignment_overflow = list_size % required_alignment;
-    if (alignment_overflow > 0)
-        list_size += alignment_overflow - required_alignment;
-
-    buf->size = (size_t)buf->nchannels * (size_t)buf->nframes * sizeof(float) + list_size + 32;
-    buf->data = malloc (buf->size);
-    buf->channels = (float**) buf->data;
-    float* chan = (float*)(buf->data + list_size);
-
-    int i;
-    for (i = 0; i < buf->nchannels; ++i) {
-        buf->channels[i] = chan;
-        chan += buf->nframes;
-    }
+void el_audio_buffer_detach (el_audio_buffer_t* buf) {
+    if (buf->owner)
+        return;
+    buf->channels = NULL;
+    buf->nchannels = buf->nframes = 0;
+    buf->stale = true;
+}
 
-    buf->channels[buf->nchannels] = NULL;
-    buf->cleared = false;
+el_audio_buffer_t* el_audio_buffer_check (lua_State* L, int idx) {
+    el_audio_buffer_t* buf = (el_audio_buffer_t*) luaL_checkudata (L, idx, EL_AUDIO_BUFFER_MT);
+   #if EL_AUDIO_POISON_VIEWS
+    if (buf->stale)
+        luaL_error (L, "audio view used after the call it was passed to");
+   #endif
+    return buf;
 }
 
-static void audiobuffer_allocate_channels (AudioBuffer* buf) {
+int el_audio_buffer_channels (const el_audio_buffer_t* buf)   { return buf->nchannels; }
+int el_audio_buffer_length (const el_audio_buffer_t* buf)     { return buf->nframes; }
+
+float* el_audio_buffer_channel (el_audio_buffer_t* buf, int channel) {
+    return channel >= 0 && channel < buf->nchannels ? buf->channels[channel] : NULL;
 }
 
 //=============================================================================
-static void audiobuffer_clear_all (AudioBuffer* buf) {
-    if (buf->cleared)
-        return;
-    for (int c = 0; c < buf->nchannels; ++c)
-        memset (buf->channels[c], 0, sizeof(float) * (size_t)buf->nframes);
-    buf->cleared = true;
+static int check_channel (lua_State* L, const el_audio_buffer_t* buf, int idx) {
+    lua_Integer c = luaL_checkinteger (L, idx);
+    luaL_argcheck (L, c >= 1 && c <= buf->nchannels, idx, "channel out of range");
+    return (int) c - 1;
 }
 
-static void audiobuffer_clear_range (AudioBuffer* buf, int start, int count) {
-    if (buf->cleared)
-        return;
-    if (start == 0 && count == buf->nframes)
-        buf->cleared = true;
-    for (int c = 0; c < buf->nchannels; ++c)
-        memset (buf->channels[c] + start, 0, sizeof(float) * (size_t)buf->nframes);
-    buf->cleared = true;
+static int check_frame (lua_State* L, const el_audio_buffer_t* buf, int idx) {
+    lua_Integer f = luaL_checkinteger (L, idx);
+    luaL_argcheck (L, f >= 1 && f <= buf->nframes, idx, "frame out of range");
+    return (int) f - 1;
+}
+
+/** Reads an optional 1 based start and count into a 0 based range */
+static void check_range (lua_State* L, const el_audio_buffer_t* buf, int idx, int* start, int* count) {
+    lua_Integer s = luaL_optinteger (L, idx, 1);
+    luaL_argcheck (L, s >= 1 && s <= (lua_Integer) buf->nframes + 1, idx, "start out of range");
+    lua_Integer n = luaL_optinteger (L, idx + 1, (lua_Integer) buf->nframes - s + 1);
+    luaL_argcheck (L, n >= 0 && s - 1 + n <= buf->nframes, idx + 1, "count out of range");
+    *start = (int) s - 1;
+    *count = (int) n;
 }
 
-static void audiobuffer_clear_channel (AudioBuffer* buf, int channel, int start, int count) {
-    if (buf->cleared)
+static void apply_ramp (float* samples, int count, float g0, float g1) {
+    if (g0 == g1) {
+        for (int i = 0; i < count; ++i)
+            samples[i] *= g0;
         return;
-    memset (buf->channels[channel] + start, 0, sizeof(float) * count);
+    }
+
+    const float inc = count > 0 ? (g1 - g0) / (float) count : 0.f;
+    for (int i = 0; i < count; ++i) {
+        samples[i] *= g0;
+        g0 += inc;
+    }
+}
+
+//=============================================================================
+static int f_new (lua_State* L) {
+    lua_Integer nchannels = luaL_optinteger (L, 1, 0);
+    lua_Integer nframes = luaL_optinteger (L, 2, 0);
+    luaL_argcheck (L, nchannels >= 0 && nchannels <= 256, 1, "invalid channel count");
+    luaL_argcheck (L, nframes >= 0 && nframes <= 1 << 24, 2, "invalid length");
+    el_audio_buffer_new (L, (int) nchannels, (int) nframes);
+    return 1;
+}
+
+static int audiobuffer_channels (lua_State* L) {
+    lua_pushinteger (L, el_audio_buffer_check (L, 1)->nchannels);
+    return 1;
+}
+
+static int audiobuffer_length (lua_State* L) {
+    lua_pushinteger (L, el_audio_buffer_check (L, 1)->nframes);
+    return 1;
+}
+
+static int audiobuffer_isview (lua_State* L) {
+    el_audio_buffer_t* buf = (el_audio_buffer_t*) luaL_checkudata (L, 1, EL_AUDIO_BUFFER_MT);
+    lua_pushboolean (L, ! buf->owner);
+    return 1;
+}
+
+static int audiobuffer_get (lua_State* L) {
+    el_audio_buffer_t* buf = el_audio_buffer_check (L, 1);
+    int c = check_channel (L, buf, 2);
+    int f = check_frame (L, buf, 3);
+    lua_pushnumber (L, (lua_Number) buf->channels[c][f]);
+    return 1;
+}
+
+static int audiobuffer_set (lua_State* L) {
+    el_audio_buffer_t* buf = el_audio_buffer_check (L, 1);
+    int c = check_channel (L, buf, 2);
+    int f = check_frame (L, buf, 3);
+    buf->channels[c][f] = (float) luaL_checknumber (L, 4);
+    return 0;
+}
+
+/** clear() clear(channel) clear(channel, start, count) */
+static int audiobuffer_clear (lua_State* L) {
+    el_audio_buffer_t* buf = el_audio_buffer_check (L, 1);
+    if (lua_isnoneornil (L, 2)) {
+        for (int c = 0; c < buf->nchannels; ++c)
+            memset (buf->channels[c], 0, sizeof (float) * (size_t) buf->nframes);
+        return 0;
+    }
+
+    int c = check_channel (L, buf, 2);
+    int start, count;
+    check_range (L, buf, 3, &start, &count);
+    memset (buf->channels[c] + start, 0, sizeof (float) * (size_t) count);
+    return 0;
+}
+
+/** gain(g) gain(channel, g) */
+static int audiobuffer_gain (lua_State* L) {
+    el_audio_buffer_t* buf = el_audio_buffer_check (L, 1);
+    if (lua_gettop (L) < 3) {
+        float g = (float) luaL_checknumber (L, 2);
+        for (int c = 0; c < buf->nchannels; ++c)
+            apply_ramp (buf->channels[c], buf->nframes, g, g);
+        return 0;
+    }
+
+    int c = check_channel (L, buf, 2);
+    float g = (float) luaL_checknumber (L, 3);
+    apply_ramp (buf->channels[c], buf->nframes, g, g);
+    return 0;
+}
+
+/** fade(g0, g1) fade(channel, start, count, g0, g1) */
+static int audiobuffer_fade (lua_State* L) {
+    el_audio_buffer_t* buf = el_audio_buffer_check (L, 1);
+    if (lua_gettop (L) < 6) {
+        float g0 = (float) luaL_checknumber (L, 2);
+        float g1 = (float) luaL_checknumber (L, 3);
+        for (int c = 0; c < buf->nchannels; ++c)
+            apply_ramp (buf->channels[c], buf->nframes, g0, g1);
+        return 0;
+    }
+
+    int c = check_channel (L, buf, 2);
+    int start, count;
+    check_range (L, buf, 3, &start, &count);
+    apply_ramp (buf->channels[c] + start, count,
+                (float) luaL_checknumber (L, 5), (float) luaL_checknumber (L, 6));
+    return 0;
+}
+
+static int audiobuffer_tostring (lua_State* L) {
+    el_audio_buffer_t* buf = (el_audio_buffer_t*) luaL_checkudata (L, 1, EL_AUDIO_BUFFER_MT);
+    lua_pushfstring (L, "el.audio.Buffer (%d x %d%s)", buf->nchannels, buf->nframes,
+                     buf->owner ? "" : buf->stale ? ", stale view" : ", view");
+    return 1;
+}
+
+static const luaL_Reg audiobuffer_m[] = {
+    { "channels",   audiobuffer_channels },
+    { "length",     audiobuffer_length },
+    { "isview",     audiobuffer_isview },
+    { "get",        audiobuffer_get },
+    { "set",        audiobuffer_set },
+    { "clear",      audiobuffer_clear },
+    { "gain",       audiobuffer_gain },
+    { "fade",       audiobuffer_fade },
+    { "__len",      audiobuffer_length },
+    { "__tostring", audiobuffer_tostring },
+    { NULL, NULL }
+};
+
+static void audiobuffer_setmetatable (lua_State* L) {
+    if (luaL_newmetatable (L, EL_AUDIO_BUFFER_MT)) {
+        luaL_setfuncs (L, audiobuffer_m, 0);
+        lua_pushvalue (L, -1);
+        lua_setfield (L, -2, "__index");
+    }
+    lua_setmetatable (L, -2);
+}
+
+static const luaL_Reg audio_f[] = {
+    { "Buffer", f_new },
+    { NULL, NULL }
+};
+
+int luaopen_el_audio (lua_State* L) {
+    luaL_newlib (L, audio_f);
+    return 1;
 }
@@ -0,0 +1,51 @@
+/** Audio buffers for Lua.
+
+    A buffer either owns its samples, which live inside the userdata, or is
+    a view that refers to samples owned by the host. The host points a view
+    at its channels for the length of a call and detaches it afterwards, so
+    no samples are copied. Every accessor is bounds checked, and a detached
+    view has no channels. With EL_AUDIO_POISON_VIEWS (on in debug builds)
+    using a detached view raises an error that says so.
+*/
+
+#ifndef EL_LUA_AUDIO_H
+#define EL_LUA_AUDIO_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <lua.h>
+#include <lauxlib.h>
+
+#define EL_AUDIO_BUFFER_MT "el.audio.Buffer"
+
+typedef struct el_audio_buffer_s el_audio_buffer_t;
+
+/** Push a new buffer that owns its samples. The samples are cleared */
+el_audio_buffer_t* el_audio_buffer_new (lua_State* L, int nchannels, int nframes);
+
+/** Push a new view. It has no channels until el_audio_buffer_refer_to */
+el_audio_buffer_t* el_audio_buffer_new_view (lua_State* L);
+
+/** Point a view at host channels. Doesn't allocate */
+void el_audio_buffer_refer_to (el_audio_buffer_t* buf, float** channels, int nchannels, int nframes);
+
+/** Detach a view from the host channels */
+void el_audio_buffer_detach (el_audio_buffer_t* buf);
+
+/** Returns the buffer at a stack index or raises an error */
+el_audio_buffer_t* el_audio_buffer_check (lua_State* L, int idx);
+
+int el_audio_buffer_channels (const el_audio_buffer_t* buf);
+int el_audio_buffer_length (const el_audio_buffer_t* buf);
+float* el_audio_buffer_channel (el_audio_buffer_t* buf, int channel);
+
+/** Opens the el.audio module */
+int luaopen_el_audio (lua_State* L);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -231,6 +231,19 @@ public:
     const bool audio, midi;
 };
 
+/** Send this to mute or bypass a node through its model */
+class SetNodeStateMessage : public Message
+{
+public:
+    enum State { mute, bypass };
+    SetNodeStateMessage (const Node& g, const uint32 n, const State s, const bool v)
+        : Message(), graph (g), nodeId (n), state (s), value (v) { }
+    const Node graph;
+    const uint32 nodeId;
+    const State state;
+    const bool value;
+};
+
 struct FinishedLaunchingMessage : public AppMessage
 {
     FinishedLaunchingMessage() { }
@@ -40,6 +40,7 @@ const char* Settings::workspaceKey              = "workspace";
 const char* Settings::midiEngineKey             = "midiEngine";
 const char* Settings::oscHostPortKey            = "oscHostPortKey";
 const char* Settings::oscHostEnabledKey         = "oscHostEnabledKey";
+const char* Settings::oscFeedbackHostsKey       = "oscFeedbackHosts";
 const char* Settings::systrayKey                = "systrayKey";
 
 //=============================================================================
@@ -365,6 +366,20 @@ void Settings::setOscHostPort (int port)
         p->setValue (oscHostPortKey, port);
 }
 
+StringArray Settings::getOscFeedbackHosts() const
+{
+    const String hosts = "127.0.0.1 localhost ::1";
+    if (auto* p = getProps())
+        return StringArray::fromTokens (p->getValue (oscFeedbackHostsKey, hosts), false);
+    return StringArray::fromTokens (hosts, false);
+}
+
+void Settings::setOscFeedbackHosts (const StringArray& hosts)
+{
+    if (auto* p = getProps())
+        p->setValue (oscFeedbackHostsKey, hosts.joinIntoString (" "));
+}
+
 //=============================================================================
 
 bool Settings::isSystrayEnabled() const
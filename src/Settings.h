@@ -49,6 +49,7 @@ public:
     static const char* midiEngineKey;
     static const char* oscHostPortKey;
     static const char* oscHostEnabledKey;
+    static const char* oscFeedbackHostsKey;
     static const char* systrayKey;
 
     std::unique_ptr<XmlElement> getLastGraph() const;
@@ -112,6 +113,10 @@ public:
     int getOscHostPort() const;
     void setOscHostPort (int);
 
+    /** Hosts OSC clients may ask the engine to send feedback to */
+    StringArray getOscFeedbackHosts() const;
+    void setOscFeedbackHosts (const StringArray&);
+
     bool isSystrayEnabled() const;
     void setSystrayEnabled (bool);
     
@@ -98,43 +98,30 @@ inline static bool isValidOscPort (int port)
     return port > 0 && port < 65536;
 }
 
-inline static std::vector<std::string> parseOscAddressPaths (const OSCMessage& message)
+/** Converts an OSC time tag to the Time::getMillisecondCounterHiRes() clock.
+    Immediate time tags return the current time.
+ */
+inline static double oscTimeTagToMillisecondCounter (const OSCTimeTag& tag)
 {
-    /** AddressPattern.oscSymbols is already parsed, but it's a private member */
-    const auto addr = message.getAddressPattern().toString().toStdString();
-
-    /** Parts: I/O Type, Device Name, Command */
-
-    std::vector<std::string> paths;
-
-    std::string delimiter = "/";
-    std::string part = "";
-    std::size_t currentPos = 0;
-    std::size_t nextPos = 0;
-
-    while (currentPos != std::string::npos)
-    {
-        currentPos = addr.find(delimiter, currentPos);
-        nextPos = addr.find(delimiter, currentPos + 1);
-        part = addr.substr(currentPos + 1, (nextPos - 1) - currentPos);
-        currentPos = nextPos;
-        if (part == "") continue;
-
-        paths.push_back(part);
-    }
-
-    for (size_t i = paths.size(); i < 3; i++)
-        paths.push_back("");
-
-    return paths;
+    const double nowMs = Time::getMillisecondCounterHiRes();
+    if (tag.isImmediately())
+        return nowMs;
+
+    // NTP time: seconds since 1900 in the high word, fraction in the low
+    const uint64 raw = tag.getRawTimeTag();
+    const double secondsSince1970 = (double) (raw >> 32) - 2208988800.0;
+    const double tagMs = 1000.0 * (secondsSince1970 + (double) (raw & 0xffffffffu) / 4294967296.0);
+    return nowMs + (tagMs - (double) Time::currentTimeMillis());
 }
 
-inline static var getOscArgumentAsPrimitiveValue (const OSCArgument& arg)
+/** Converts a time on the Time::getMillisecondCounterHiRes() clock to an OSC time tag */
+inline static OSCTimeTag millisecondCounterToOscTimeTag (double timeMs)
 {
-    if (arg.isFloat32()) return arg.getFloat32();
-    if (arg.isInt32())   return arg.getInt32();
-    if (arg.isString())  return arg.getString();
-    return 0;
+    const double wallMs = (double) Time::currentTimeMillis() + (timeMs - Time::getMillisecondCounterHiRes());
+    const double secondsSince1900 = 0.001 * wallMs + 2208988800.0;
+    const double seconds = std::floor (secondsSince1900);
+    const double fraction = jmin (4294967295.0, (secondsSince1900 - seconds) * 4294967296.0);
+    return OSCTimeTag (((uint64) seconds << 32) | (uint64) fraction);
 }
 
 inline static String getOscArgumentAsString (const OSCArgument& arg)
@@ -190,183 +177,6 @@ inline static String getOscMessageAsString (const OSCMessage& message)
     return str;
 }
 
-inline static MidiMessage processOscToMidiMessage (const OSCMessage& message)
-{
-    std::vector<std::string> paths = parseOscAddressPaths(message);
-
-    if (paths[0] != "midi")
-    {
-        return MidiMessage();
-    }
-
-    std::string deviceName;
-    std::string command;
-
-    /** /midi/{command} or /midi/{deviceName}/{command} */
-
-    if (paths[2] == "")
-    {
-        deviceName = "";
-        command = paths[1];
-    }
-    else if (paths[1] != "")
-    {
-        deviceName = paths[1];
-        command = paths[2];
-    }
-    else
-    {
-        return MidiMessage();
-    }
-
-    /** Cast the rest of values to their respective types */
-
-    const int numArgs = message.size();
-    std::unique_ptr<var[]> values;
-    values.reset (new var [numArgs]);
-    
-    int blobIndexInMessage = -1;
-
-    int i = 0;
-    for (auto& arg : message)
-    {
-        if (arg.isBlob())
-        {
-            blobIndexInMessage = i;
-            values[i] = 0;
-        }
-        else
-        {
-            values[i] = getOscArgumentAsPrimitiveValue(arg);
-        }
-        i++;
-    }
-
-    /** Commands - See https://docs.juce.com/master/classMidiMessage.html#pub-static-methods */
-
-    if (command == "raw")
-    {
-        if (blobIndexInMessage >= 0) {
-            const MemoryBlock& blob = message[blobIndexInMessage].getBlob();
-            // return String::fromUTF8 ((const char*) blob.getData(), (int) blob.getSize());
-            return MidiMessage(blob.getData(), (int) blob.getSize());
-        }
-    }
-    else if (command == "noteOn")
-    {
-        if (numArgs >= 3)
-        {
-            /** channel, noteNumber, velocity */
-            return MidiMessage::noteOn((int) values[0], (int) values[1], (float) values[2]);
-        }
-    }
-    else if (command == "noteOff")
-    {
-        if (numArgs >= 3)
-        {
-            /** channel, noteNumber, velocity */
-            return MidiMessage::noteOff((int) values[0], (int) values[1], (float) values[2]);
-        }
-    }
-    else if (command == "programChange")
-    {
-        if (numArgs >= 2)
-        {
-            /** channel, programNumber */
-            return MidiMessage::noteOff((int) values[0], (int) values[1]);
-        }
-    }
-    else if (command == "pitchBend")
-    {
-        if (numArgs >= 2)
-        {
-            /** channel, position */
-            return MidiMessage::pitchWheel((int) values[0], (int) values[1]);
-        }
-    }
-    else if (command == "afterTouch")
-    {
-        if (numArgs >= 2)
-        {
-            /** channel, noteNumber, aftertouchAmount */
-            return MidiMessage::aftertouchChange((int) values[0], (int) values[1], (int) values[2]);
-        }
-    }
-    else if (command == "channelPressure")
-    {
-        if (numArgs >= 2)
-        {
-            /** channel, pressure */
-            return MidiMessage::noteOff((int) values[0], (int) values[1]);
-        }
-    }
-    else if (command == "controlChange")
-    {
-        if (numArgs >= 3)
-        {
-            /** channel, controllerType, value */
-            return MidiMessage::controllerEvent((int) values[0], (int) values[1], (int) values[2]);
-        }
-    }
-    else if (command == "allNotesOff")
-    {
-        if (numArgs >= 1)
-        {
-            /** channel */
-            return MidiMessage::allNotesOff((int) values[0]);
-        }
-    }
-    else if (command == "allSoundOff")
-    {
-        if (numArgs >= 1)
-        {
-            /** channel */
-            return MidiMessage::allSoundOff((int) values[0]);
-        }
-    }
-    else if (command == "allControllersOff")
-    {
-        if (numArgs >= 1)
-        {
-            /** channel */
-            return MidiMessage::allControllersOff((int) values[0]);
-        }
-    }
-    else if (command == "start")
-    {
-        return MidiMessage::midiStart();
-    }
-    else if (command == "continue")
-    {
-        return MidiMessage::midiContinue();
-    }
-    else if (command == "stop")
-    {
-        return MidiMessage::midiStop();
-    }
-    else if (command == "clock")
-    {
-        return MidiMessage::midiClock();
-    }
-    else if (command == "songPositionPointer")
-    {
-        if (numArgs >= 1)
-        {
-            /** positionInMidiBeats */
-            return MidiMessage::songPositionPointer((int) values[0]);
-        }
-    }
-    else if (command == "activeSense")
-    {
-        return MidiMessage();
-    }
-
-    // Command "polyPressure" not supported?
-
-    /** Unknown command */
-    return MidiMessage();
-}
-
 inline static OSCMessage processMidiToOscMessage (const MidiMessage& m)
 {
     /** Address: /midi/{command} or /midi/{deviceName}/{command} */
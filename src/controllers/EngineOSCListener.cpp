@@ -0,0 +1,497 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "controllers/AppController.h"
+#include "controllers/EngineOSCListener.h"
+#include "engine/GraphProcessor.h"
+#include "Messages.h"
+
+namespace Element {
+
+static bool getOscNumber (const OSCMessage& message, int index, float& value)
+{
+    if (! isPositiveAndBelow (index, message.size()))
+        return false;
+    const auto& arg = message[index];
+    if (arg.isFloat32())
+        value = arg.getFloat32();
+    else if (arg.isInt32())
+        value = (float) arg.getInt32();
+    else
+        return false;
+    return true;
+}
+
+static float getRouteValue (const OSCRoute& route)
+{
+    auto* const node = route.node.get();
+    if (node == nullptr)
+        return 0.f;
+
+    switch (route.kind)
+    {
+        case OSCRoute::parameter:
+            if (auto* param = node->getParameters().getObjectPointer (route.index))
+                return param->getValue();
+            break;
+        case OSCRoute::gain:        return node->getGain();
+        case OSCRoute::inputGain:   return node->getInputGain();
+        case OSCRoute::mute:        return node->isMuted() ? 1.f : 0.f;
+        case OSCRoute::bypass:      return node->isSuspended() ? 1.f : 0.f;
+        default: break;
+    }
+
+    return 0.f;
+}
+
+//=============================================================================
+
+EngineOSCFeedback::EngineOSCFeedback() : Thread ("elosc.feedback") { }
+
+EngineOSCFeedback::~EngineOSCFeedback()
+{
+    cancelPendingUpdate();
+    stop();
+}
+
+bool EngineOSCFeedback::setTarget (const String& host, int port, float rateHz)
+{
+    {
+        ScopedLock sl (lock);
+        intervalMs = roundToInt (1000.f / jlimit (1.f, 100.f, rateHz));
+    }
+
+    {
+        ScopedLock sl (sendLock);
+        connected = sender.connect (host, port);
+    }
+
+    if (connected.load() && ! isThreadRunning())
+        startThread (4);
+    return connected.load();
+}
+
+void EngineOSCFeedback::subscribe (const String& address, const OSCRoute& route)
+{
+    if (route.node == nullptr)
+        return;
+    ScopedLock sl (lock);
+    for (auto* sub : subscriptions)
+        if (sub->address == address)
+            return;
+    subscriptions.add (new Subscription ({ address, route, -1.f }));
+}
+
+void EngineOSCFeedback::unsubscribe (const String& address)
+{
+    ScopedLock sl (lock);
+    for (int i = subscriptions.size(); --i >= 0;)
+        if (subscriptions.getUnchecked(i)->address == address)
+            subscriptions.remove (i);
+}
+
+void EngineOSCFeedback::refresh (const OSCRouteTable& table)
+{
+    ScopedLock sl (lock);
+    for (int i = subscriptions.size(); --i >= 0;)
+    {
+        auto* sub = subscriptions.getUnchecked (i);
+        if (auto* route = table.find (sub->address))
+            sub->route = *route;
+        else
+            subscriptions.remove (i);
+    }
+}
+
+void EngineOSCFeedback::probe (const String& address, const GraphNodePtr& node, int port, int decimation)
+{
+    ScopedLock sl (lock);
+    probeRequests.add ({ address, node, port, decimation });
+    touch();
+    triggerAsyncUpdate();
+}
+
+void EngineOSCFeedback::stop()
+{
+    stopThread (500);
+
+    {
+        ScopedLock sl (lock);
+        subscriptions.clear();
+        for (auto* stream : streams)
+            if (auto* graph = stream->node->getParentGraph())
+                graph->detachProbe (stream->probe.get());
+        streams.clear();
+        probeRequests.clearQuick();
+        expired = false;
+    }
+
+    ScopedLock sl (sendLock);
+    sender.disconnect();
+    connected = false;
+}
+
+void EngineOSCFeedback::run()
+{
+    while (! threadShouldExit())
+    {
+        int interval = 50;
+
+        {
+            ScopedLock sl (lock);
+            interval = intervalMs;
+            if (connected.load())
+                gatherChanges();
+
+            if (streams.size() > 0 && ! expired.load()
+                && Time::getMillisecondCounter() - lastContactMs.load() > (uint32) clientTimeoutMs)
+            {
+                expired = true;
+                triggerAsyncUpdate();
+            }
+        }
+
+        if (outgoingMessages.size() > 0 || outgoingBundles.size() > 0)
+        {
+            ScopedLock sl (sendLock);
+            for (const auto& message : outgoingMessages)
+                sender.send (message);
+            for (const auto& bundle : outgoingBundles)
+                sender.send (bundle);
+        }
+
+        outgoingMessages.clearQuick();
+        outgoingBundles.clearQuick();
+        wait (interval);
+    }
+}
+
+void EngineOSCFeedback::handleAsyncUpdate()
+{
+    Array<ProbeRequest> requests;
+    int interval = 50;
+    {
+        ScopedLock sl (lock);
+        requests.swapWith (probeRequests);
+        interval = intervalMs;
+
+        if (expired.exchange (false))
+        {
+            for (auto* stream : streams)
+                if (auto* graph = stream->node->getParentGraph())
+                    graph->detachProbe (stream->probe.get());
+            streams.clear();
+        }
+    }
+
+    for (const auto& request : requests)
+    {
+        auto* const graph = request.node->getParentGraph();
+        ScopedLock sl (lock);
+
+        for (int i = streams.size(); --i >= 0;)
+        {
+            auto* stream = streams.getUnchecked (i);
+            if (stream->address != request.address)
+                continue;
+            if (graph != nullptr)
+                graph->detachProbe (stream->probe.get());
+            streams.remove (i);
+        }
+
+        if (graph == nullptr || ! isPositiveAndBelow (request.port, (int) request.node->getNumPorts()))
+            continue;
+
+        // room for a few feedback intervals, so a late send doesn't drop samples
+        const double sampleRate = graph->getSampleRate() > 0.0 ? graph->getSampleRate() : 48000.0;
+        const int perInterval = roundToInt (std::ceil (sampleRate * interval / (1000.0 * request.decimation)));
+        const int capacity = jmax ((int) maxProbeSamples, nextPowerOfTwo (4 * perInterval));
+
+        SignalProbe::Ptr probe = new SignalProbe (request.node->getPortType ((uint32) request.port),
+                                                  capacity, request.decimation);
+        if (graph->attachProbe (request.node->nodeId, (uint32) request.port, probe.get()))
+            streams.add (new ProbeStream ({ request.address, request.node, probe }));
+    }
+}
+
+/** Audio goes out as the peak and a blob of float32 samples, MIDI as one
+    blob per message */
+void EngineOSCFeedback::gatherProbes()
+{
+    if (samples == nullptr)
+        samples.calloc ((size_t) maxProbeSamples);
+
+    for (auto* stream : streams)
+    {
+        auto& probe = *stream->probe;
+        const OSCAddressPattern address (stream->address);
+
+        if (probe.getType() == PortType::Midi)
+        {
+            MidiMessage msg;
+            OSCBundle bundle;
+            int numMessages = 0;
+            while (numMessages < 128 && probe.readMidi (msg))
+            {
+                OSCMessage oscMsg (address);
+                oscMsg.addBlob (MemoryBlock (msg.getRawData(), (size_t) msg.getRawDataSize()));
+                bundle.addElement (oscMsg);
+                ++numMessages;
+            }
+            if (numMessages > 0)
+                outgoingBundles.add (bundle);
+        }
+        else if (probe.getNumReady() > 0)
+        {
+            // sends what was ready, one packet per block
+            const float peak = probe.readPeak();
+            for (int remaining = probe.getNumReady(); remaining > 0;)
+            {
+                const int numRead = probe.readAudio (samples, jmin (remaining, (int) maxProbeSamples));
+                if (numRead <= 0)
+                    break;
+                remaining -= numRead;
+                OSCMessage oscMsg (address, peak);
+                oscMsg.addBlob (MemoryBlock (samples.getData(), sizeof (float) * (size_t) numRead));
+                outgoingMessages.add (oscMsg);
+            }
+        }
+    }
+}
+
+void EngineOSCFeedback::gatherChanges()
+{
+    if (streams.size() > 0)
+        gatherProbes();
+
+    OSCBundle bundle;
+    int numValues = 0;
+
+    for (auto* sub : subscriptions)
+    {
+        const float value = getRouteValue (sub->route);
+        if (value == sub->lastValue)
+            continue;
+
+        sub->lastValue = value;
+        bundle.addElement (OSCMessage (OSCAddressPattern (sub->address), value));
+        if (++numValues == 128)
+        {
+            outgoingBundles.add (bundle);
+            bundle = OSCBundle();
+            numValues = 0;
+        }
+    }
+
+    if (numValues > 0)
+        outgoingBundles.add (bundle);
+}
+
+//=============================================================================
+
+EngineOSCListener::EngineOSCListener (AppController& a, AudioEnginePtr e, AsyncUpdater& u, EngineOSCFeedback& f)
+    : app (a), engine (e), updater (u), feedback (f) { }
+
+EngineOSCRoutes::Ptr EngineOSCListener::setRoutes (EngineOSCRoutes::Ptr newRoutes)
+{
+    SpinLock::ScopedLockType sl (routesLock);
+    std::swap (routes, newRoutes);
+    return newRoutes;
+}
+
+EngineOSCRoutes::Ptr EngineOSCListener::getRoutes() const
+{
+    SpinLock::ScopedLockType sl (routesLock);
+    return routes;
+}
+
+void EngineOSCListener::setFeedbackHosts (const StringArray& hosts)
+{
+    SpinLock::ScopedLockType sl (hostsLock);
+    feedbackHosts = hosts;
+}
+
+bool EngineOSCListener::isFeedbackHostAllowed (const String& host) const
+{
+    SpinLock::ScopedLockType sl (hostsLock);
+    return feedbackHosts.contains (host.trim(), true);
+}
+
+void EngineOSCListener::oscMessageReceived (const OSCMessage& message)
+{
+    const auto& pattern = message.getAddressPattern();
+    const auto address = pattern.toString();
+    if (! address.startsWith (EL_OSC_ADDRESS_ENGINE))
+        return;
+
+    feedback.touch();
+    auto current = getRoutes();
+    if (current == nullptr)
+        return;
+
+    if (pattern.containsWildcards())
+    {
+        // patterns only fan out to node values, not to transport or graph actions
+        current->table.findMatches (pattern, [&] (const OSCRoute& route) {
+            if (route.node != nullptr)
+                perform (*current, route, message);
+        });
+    }
+    else if (auto* route = current->table.find (address))
+    {
+        perform (*current, *route, message);
+    }
+    else
+    {
+        // maybe the session changed, but don't let a client flood the
+        // message thread with rebuilds
+        const auto now = Time::getMillisecondCounter();
+        auto last = lastRefreshMs.load();
+        if (now - last >= refreshIntervalMs && lastRefreshMs.compare_exchange_strong (last, now))
+            updater.triggerAsyncUpdate();
+    }
+}
+
+void EngineOSCListener::oscBundleReceived (const OSCBundle& bundle)
+{
+    for (const auto& element : bundle)
+    {
+        if (element.isMessage())
+            oscMessageReceived (element.getMessage());
+        else if (element.isBundle())
+            oscBundleReceived (element.getBundle());
+    }
+}
+
+void EngineOSCListener::perform (const EngineOSCRoutes& current, const OSCRoute& route, const OSCMessage& message)
+{
+    auto* const node = route.node.get();
+    float value = 1.f;
+    const bool hasValue = getOscNumber (message, 0, value);
+
+    switch (route.kind)
+    {
+        case OSCRoute::parameter:
+            if (hasValue)
+                node->postParameterValue (route.index, jlimit (0.f, 1.f, value));
+            break;
+
+        case OSCRoute::gain:
+            if (hasValue)
+                node->setGain (jmax (0.f, value));
+            break;
+
+        case OSCRoute::inputGain:
+            if (hasValue)
+                node->setInputGain (jmax (0.f, value));
+            break;
+
+        case OSCRoute::mute:
+        case OSCRoute::bypass:
+        {
+            // the model owns these, so the session and views stay in step
+            const auto state = route.kind == OSCRoute::mute ? SetNodeStateMessage::mute
+                                                            : SetNodeStateMessage::bypass;
+            app.postMessage (new SetNodeStateMessage (current.graphs [route.graph],
+                                                      node->nodeId, state, value != 0.f));
+            break;
+        }
+
+        case OSCRoute::activateGraph:
+            if (value != 0.f)
+                engine->setActiveGraph (route.graph);
+            break;
+
+        case OSCRoute::connect:
+        case OSCRoute::disconnect:
+        {
+            float ports[4];
+            for (int i = 0; i < 4; ++i)
+                if (! getOscNumber (message, i, ports[i]))
+                    return;
+
+            // topology changes are rare, they go through the model on the message thread
+            const auto graph = current.graphs [route.graph];
+            const auto s = (uint32) ports[0], sp = (uint32) ports[1];
+            const auto d = (uint32) ports[2], dp = (uint32) ports[3];
+            if (route.kind == OSCRoute::connect)
+                app.postMessage (new AddConnectionMessage (s, sp, d, dp, graph));
+            else
+                app.postMessage (new RemoveConnectionMessage (s, sp, d, dp, graph));
+            break;
+        }
+
+        case OSCRoute::play:    engine->setPlaying (value != 0.f); break;
+        case OSCRoute::stop:    engine->setPlaying (false); break;
+        case OSCRoute::record:  engine->setRecording (value != 0.f); break;
+
+        case OSCRoute::seek:
+            if (message.size() > 0 && message[0].isInt32())
+                engine->seekToAudioFrame (jmax (0, message[0].getInt32()));
+            break;
+
+        case OSCRoute::feedback:
+        {
+            float port = 0.f, rate = 20.f;
+            getOscNumber (message, 2, rate);
+            if (message.size() >= 2 && message[0].isString() && getOscNumber (message, 1, port)
+                && isFeedbackHostAllowed (message[0].getString()))
+                feedback.setTarget (message[0].getString(), (int) port, rate);
+            break;
+        }
+
+        case OSCRoute::subscribe:
+        case OSCRoute::unsubscribe:
+        {
+            if (message.size() < 1 || ! message[0].isString())
+                break;
+            const auto address = message[0].getString();
+            if (route.kind == OSCRoute::unsubscribe)
+                feedback.unsubscribe (address);
+            else if (auto* target = current.table.find (address))
+                feedback.subscribe (address, *target);
+            break;
+        }
+
+        case OSCRoute::refresh:
+            updater.triggerAsyncUpdate();
+            break;
+
+        case OSCRoute::probe:
+        case OSCRoute::unprobe:
+        {
+            if (! hasValue)
+                break;
+            float decimation = 1.f;
+            getOscNumber (message, 1, decimation);
+            const auto port = (int) value;
+            const auto address = message.getAddressPattern().toString()
+                .upToLastOccurrenceOf ("/", false, false) + "/probe/" + String (port);
+            feedback.probe (address, route.node,
+                            route.kind == OSCRoute::probe ? port : -1,
+                            jlimit (1, 1024, (int) decimation));
+            break;
+        }
+
+        case OSCRoute::invalid:
+            break;
+    }
+}
+
+}
@@ -0,0 +1,170 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "engine/AudioEngine.h"
+#include "engine/OSCRouteTable.h"
+#include "engine/SignalProbe.h"
+#include "session/Node.h"
+
+#define EL_OSC_ADDRESS_ENGINE  "/el/"
+
+namespace Element {
+
+class AppController;
+
+/** The session's routes along with the graph models they refer to */
+struct EngineOSCRoutes : public ReferenceCountedObject
+{
+    using Ptr = ReferenceCountedObjectPtr<EngineOSCRoutes>;
+    OSCRouteTable table;
+    Array<Node> graphs;
+    int64 signature = 0;
+};
+
+//=============================================================================
+
+/** Sends subscribed values back to a client when they change, no faster
+    than the feedback rate. Probed ports are streamed at the same rate until
+    the client has been quiet for a while. */
+class EngineOSCFeedback : private Thread,
+                          private AsyncUpdater
+{
+public:
+    EngineOSCFeedback();
+    ~EngineOSCFeedback();
+
+    /** Sets where and how often to send values. Starts sending if needed */
+    bool setTarget (const String& host, int port, float rateHz);
+
+    /** Returns true if values are being sent to a client */
+    bool isSending() const noexcept { return connected.load(); }
+
+    void subscribe (const String& address, const OSCRoute& route);
+    void unsubscribe (const String& address);
+
+    /** Points subscriptions at a new route table, dropping ones which no longer exist */
+    void refresh (const OSCRouteTable& table);
+
+    /** Call when a message arrives from the client, which keeps probes streaming */
+    void touch() noexcept { lastContactMs.store (Time::getMillisecondCounter()); }
+
+    /** Attaches a probe to a node output and streams it to the address.
+        A negative port detaches it. Attaching happens on the message thread */
+    void probe (const String& address, const GraphNodePtr& node, int port, int decimation);
+
+    void stop();
+
+private:
+    struct Subscription
+    {
+        String address;
+        OSCRoute route;
+        float lastValue;
+    };
+
+    struct ProbeRequest
+    {
+        String address;
+        GraphNodePtr node;
+        int port;
+        int decimation;
+    };
+
+    struct ProbeStream
+    {
+        String address;
+        GraphNodePtr node;
+        SignalProbe::Ptr probe;
+    };
+
+    // lock guards subscriptions and probes, sendLock the sender. Values are
+    // gathered under the first and sent under the second, so the message
+    // thread never waits for the network
+    CriticalSection lock, sendLock;
+    OwnedArray<Subscription> subscriptions;
+    OwnedArray<ProbeStream> streams;
+    Array<ProbeRequest> probeRequests;
+    HeapBlock<float> samples;
+    OSCSender sender;
+    std::atomic<bool> connected { false };
+    int intervalMs = 50;
+    std::atomic<uint32> lastContactMs { 0 };
+    std::atomic<bool> expired { false };
+
+    /** Feedback thread, what to send once the lock is released */
+    Array<OSCMessage> outgoingMessages;
+    Array<OSCBundle> outgoingBundles;
+
+    // keeps a streamed block inside one UDP packet
+    enum { maxProbeSamples = 2048 };
+
+    // probes are detached when nothing arrives from the client for this long
+    enum { clientTimeoutMs = 30000 };
+
+    void run() override;
+    void handleAsyncUpdate() override;
+    void gatherProbes();
+    void gatherChanges();
+};
+
+//=============================================================================
+
+/** Handles the /el/ namespace on the receiver thread. Values are applied
+    through the engine's lock-free queues without going through the message
+    thread. Changes which belong to the session model, like mute, bypass and
+    connections, are posted to the message thread. */
+class EngineOSCListener final : public OSCReceiver::Listener<OSCReceiver::RealtimeCallback>
+{
+public:
+    EngineOSCListener (AppController& a, AudioEnginePtr e, AsyncUpdater& u, EngineOSCFeedback& f);
+
+    /** Swaps in new routes and returns the previous ones. The receiver
+        thread may still be using them, so the caller keeps them until it
+        holds the last reference. */
+    EngineOSCRoutes::Ptr setRoutes (EngineOSCRoutes::Ptr newRoutes);
+    EngineOSCRoutes::Ptr getRoutes() const;
+
+    /** Sets the hosts /el/feedback may send values to. The receiver doesn't
+        know where a message came from, so without this any client could
+        point feedback at any host. Defaults to this machine */
+    void setFeedbackHosts (const StringArray& hosts);
+
+    /** Returns true if feedback may be sent to the host */
+    bool isFeedbackHostAllowed (const String& host) const;
+
+    void oscMessageReceived (const OSCMessage& message) override;
+    void oscBundleReceived (const OSCBundle& bundle) override;
+
+private:
+    AppController& app;
+    AudioEnginePtr engine;
+    AsyncUpdater& updater;
+    EngineOSCFeedback& feedback;
+    SpinLock routesLock, hostsLock;
+    EngineOSCRoutes::Ptr routes;
+    StringArray feedbackHosts { "127.0.0.1", "localhost", "::1" };
+    std::atomic<uint32> lastRefreshMs { 0 };
+    enum { refreshIntervalMs = 1000 };
+
+    void perform (const EngineOSCRoutes& current, const OSCRoute& route, const OSCMessage& message);
+};
+
+}
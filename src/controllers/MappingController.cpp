@@ -113,7 +113,7 @@ public:
     int parameter               = -1;
 
 private:
-    class Mappable : public Parameter::Listener
+    class Mappable
     {
     public:
         Mappable (AudioProcessorParameterCapture& c, const Node& n)
@@ -129,8 +129,6 @@ private:
 
         void clear()
         {
-            for (auto* const param : object->getParameters())
-                param->removeListener (this);
             for (auto& c : connections)
                 c.disconnect();
         }
@@ -146,15 +144,17 @@ private:
                 &Mappable::onBypassChanged, this, std::placeholders::_1)));
             connections.add (object->muteChanged.connect (std::bind (
                 &Mappable::onMuteChanged, this, std::placeholders::_1)));
-                
-            for (auto* const param : object->getParameters())
-                param->addListener (this);
+            connections.add (object->parametersChanged.connect (std::bind (
+                &Mappable::onParametersChanged, this, std::placeholders::_1, std::placeholders::_2)));
         }
 
-        void controlValueChanged (int index, float) override 
+        void onParametersChanged (GraphNode*, const Array<int>& indexes)
         {
-            if (capture.capture.get() == false)
+            // batches are sorted by index, not by when each parameter moved,
+            // so only learn from a batch that names a single parameter
+            if (capture.capture.get() == false || indexes.size() != 1)
                 return;
+            const int index = indexes.getFirst();
             ScopedLock sl (capture.lock);
             capture.capture.set (false);
             capture.node      = node;
@@ -164,8 +164,6 @@ private:
             capture.triggerAsyncUpdate();
         }
 
-        void controlTouched (int, bool) override {}
-
         void onEnablementChanged (GraphNode*)
         {
             if (capture.capture.get() == false)
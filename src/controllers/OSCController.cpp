@@ -18,9 +18,16 @@
 */
 
 #include "controllers/OSCController.h"
+#include "controllers/EngineOSCListener.h"
+#include "controllers/SessionController.h"
+#include "engine/AudioEngine.h"
+#include "engine/GraphProcessor.h"
 #include "session/CommandManager.h"
+#include "session/Node.h"
+#include "session/Session.h"
 #include "Commands.h"
 #include "Globals.h"
+#include "Messages.h"
 #include "Settings.h"
 
 #define EL_OSC_ADDRESS_COMMAND "/element/command"
@@ -53,12 +60,18 @@ private:
 
 //=============================================================================
 
-class OSCController::Impl
+class OSCController::Impl : private AsyncUpdater,
+                            private ChangeListener,
+                            private Timer
 {
 public:
     Impl (OSCController& o) 
         : owner (o) {}
-    ~Impl() {}
+    ~Impl()
+    {
+        cancelPendingUpdate();
+        shutdown();
+    }
 
     bool startServer()
     {
@@ -99,6 +112,20 @@ public:
         application.reset (new CommandOSCListener (owner.getWorld()));
         receiver.addListener (application.get(), EL_OSC_ADDRESS_COMMAND);
 
+        engine.reset (new EngineOSCListener (owner.getAppController(),
+            owner.getWorld().getAudioEngine(), *this, feedback));
+        if (feedbackHosts.size() > 0)
+            engine->setFeedbackHosts (feedbackHosts);
+        rebuildRoutes (true);
+        receiver.addListener (engine.get());
+
+        // nodes and graphs come and go with the session, routes follow them
+        if (auto session = owner.getWorld().getSession())
+            session->addChangeListener (this);
+        if (auto* sessions = owner.getAppController().findChild<SessionController>())
+            sessionLoadedConnection = sessions->sessionLoaded.connect (
+                [this]() { triggerAsyncUpdate(); });
+
         listenersReady = true;
     }
 
@@ -108,12 +135,29 @@ public:
             return;
         listenersReady = false;
 
+        sessionLoadedConnection.disconnect();
+        if (auto session = owner.getWorld().getSession())
+            session->removeChangeListener (this);
+
         receiver.removeListener (application.get());
         application.reset();
+        receiver.removeListener (engine.get());
+        feedback.stop();
+        engine.reset();
+
+        stopTimer();
+        retiredRoutes.clear();
     }
 
     int getHostPort() const { return serverPort; }
 
+    void setFeedbackHosts (const StringArray& hosts)
+    {
+        feedbackHosts = hosts;
+        if (engine != nullptr)
+            engine->setFeedbackHosts (hosts);
+    }
+
 private:
     OSCController& owner;
     OSCSender sender;
@@ -122,8 +166,127 @@ private:
     bool listenersReady = false;
     bool serving { false };
     int serverPort { 9000 };
+    StringArray feedbackHosts;
 
     std::unique_ptr<CommandOSCListener> application;
+    std::unique_ptr<EngineOSCListener> engine;
+    EngineOSCFeedback feedback;
+    SignalConnection sessionLoadedConnection;
+
+    // replaced routes hold nodes, so they are only freed here once the
+    // receiver thread has let go of them
+    ReferenceCountedArray<EngineOSCRoutes> retiredRoutes;
+
+    void handleAsyncUpdate() override
+    {
+        rebuildRoutes (false);
+    }
+
+    void changeListenerCallback (ChangeBroadcaster*) override
+    {
+        triggerAsyncUpdate();
+    }
+
+    void timerCallback() override
+    {
+        for (int i = retiredRoutes.size(); --i >= 0;)
+            if (retiredRoutes.getObjectPointerUnchecked (i)->getReferenceCount() == 1)
+                retiredRoutes.remove (i);
+        if (retiredRoutes.isEmpty())
+            stopTimer();
+    }
+
+    /** Returns a value which changes when graphs, nodes or their parameters do */
+    static int64 getSignature (const SessionPtr session)
+    {
+        int64 signature = session->getNumGraphs();
+        for (int g = 0; g < session->getNumGraphs(); ++g)
+        {
+            const auto graph = session->getGraph (g);
+            for (int i = 0; i < graph.getNumNodes(); ++i)
+            {
+                const auto node = graph.getNode (i);
+                auto* object = node.getGraphNode();
+                signature = signature * 31 + (int64) node.getNodeId();
+                signature = signature * 31 + (object != nullptr ? object->getParameters().size() : -1);
+            }
+        }
+        return signature;
+    }
+
+    /** Builds the route table from the session. Call on the message thread */
+    void rebuildRoutes (bool force)
+    {
+        auto session = owner.getWorld().getSession();
+        if (engine == nullptr || session == nullptr)
+            return;
+
+        const auto signature = getSignature (session);
+        if (auto current = engine->getRoutes())
+            if (! force && current->signature == signature)
+                return;
+
+        EngineOSCRoutes::Ptr routes = new EngineOSCRoutes();
+        routes->signature = signature;
+        auto& table = routes->table;
+
+        auto addRoute = [&table] (const String& address, OSCRoute::Kind kind,
+                                  int graph = -1, GraphNode* node = nullptr, int index = -1)
+        {
+            OSCRoute route;
+            route.kind  = kind;
+            route.graph = graph;
+            route.node  = node;
+            route.index = index;
+            table.add (address, route);
+        };
+
+        addRoute ("/el/transport/play",   OSCRoute::play);
+        addRoute ("/el/transport/stop",   OSCRoute::stop);
+        addRoute ("/el/transport/record", OSCRoute::record);
+        addRoute ("/el/transport/seek",   OSCRoute::seek);
+        addRoute ("/el/feedback",         OSCRoute::feedback);
+        addRoute ("/el/subscribe",        OSCRoute::subscribe);
+        addRoute ("/el/unsubscribe",      OSCRoute::unsubscribe);
+        addRoute ("/el/refresh",          OSCRoute::refresh);
+
+        for (int g = 0; g < session->getNumGraphs(); ++g)
+        {
+            const auto graph = session->getGraph (g);
+            const String graphPath = String ("/el/graph/") + String (g);
+            routes->graphs.add (graph);
+            addRoute (graphPath + "/activate",   OSCRoute::activateGraph, g);
+            addRoute (graphPath + "/connect",    OSCRoute::connect, g);
+            addRoute (graphPath + "/disconnect", OSCRoute::disconnect, g);
+
+            for (int i = 0; i < graph.getNumNodes(); ++i)
+            {
+                const auto model = graph.getNode (i);
+                GraphNodePtr node = model.getGraphNode();
+                if (node == nullptr)
+                    continue;
+
+                const String nodePath = graphPath + "/node/" + String (model.getNodeId());
+                addRoute (nodePath + "/gain",      OSCRoute::gain, g, node);
+                addRoute (nodePath + "/inputGain", OSCRoute::inputGain, g, node);
+                addRoute (nodePath + "/mute",      OSCRoute::mute, g, node);
+                addRoute (nodePath + "/bypass",    OSCRoute::bypass, g, node);
+                addRoute (nodePath + "/probe",     OSCRoute::probe, g, node);
+                addRoute (nodePath + "/unprobe",   OSCRoute::unprobe, g, node);
+
+                for (int p = 0; p < node->getParameters().size(); ++p)
+                    addRoute (nodePath + "/param/" + String (p), OSCRoute::parameter, g, node, p);
+            }
+        }
+
+        feedback.refresh (table);
+        if (auto previous = engine->setRoutes (routes))
+        {
+            retiredRoutes.add (previous);
+            if (! isTimerRunning())
+                startTimer (250);
+        }
+    }
 };
 
 //=============================================================================
@@ -143,6 +306,7 @@ void OSCController::refreshWithSettings (bool alertOnFail)
     auto& settings = getWorld().getSettings();
     impl->stopServer();
     impl->setServerPort (settings.getOscHostPort());
+    impl->setFeedbackHosts (settings.getOscFeedbackHosts());
     
     if (settings.isOscHostEnabled())
     {
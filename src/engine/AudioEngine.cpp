@@ -18,11 +18,13 @@
 */
 
 #include "engine/AudioEngine.h"
+#include "engine/EngineCommandQueue.h"
 #include "engine/GraphProcessor.h"
 #include "engine/InternalFormat.h"
 #include "engine/MidiClock.h"
 #include "engine/MidiChannelMap.h"
 #include "engine/MidiEngine.h"
+#include "engine/MidiInputCollector.h"
 #include "engine/MidiTranspose.h"
 #include "engine/Transport.h"
 #include "Globals.h"
@@ -73,6 +75,38 @@ void RootGraph::setPlayConfigFor (const DeviceManager::AudioDeviceSetup& setup)
                           setup.sampleRate, setup.bufferSize);
 }
 
+void RootGraph::setRenderMode (const RenderMode mode)
+{
+    if (! locked && renderMode == static_cast<int> (mode))
+        return;
+
+    struct RenderModeCommand : public EngineCommand
+    {
+        RenderModeCommand (RootGraph& g, RenderMode m) : graph (g), mode (m) { }
+        void perform() override { graph.renderMode = mode; }
+        RootGraph& graph;
+        const RenderMode mode;
+    };
+
+    EngineCommandQueue::post (getCommandQueue(), new RenderModeCommand (*this, locked ? SingleGraph : mode));
+}
+
+void RootGraph::setMidiProgram (const int program)
+{
+    if (program == midiProgram)
+        return;
+
+    struct MidiProgramCommand : public EngineCommand
+    {
+        MidiProgramCommand (RootGraph& g, int p) : graph (g), program (p) { }
+        void perform() override { graph.midiProgram = program; }
+        RootGraph& graph;
+        const int program;
+    };
+
+    EngineCommandQueue::post (getCommandQueue(), new MidiProgramCommand (*this, program));
+}
+
 const String RootGraph::getName() const { return graphName; }
     
 const String RootGraph::getInputChannelName (int c) const { return audioInputNames[c]; }
@@ -147,7 +181,7 @@ struct RootGraphRender : public AsyncUpdater
         
     }
 
-    void renderGraphs (AudioSampleBuffer& buffer, MidiBuffer& midi)
+    void renderGraphs (AudioSampleBuffer& buffer, MidiBuffer& midi, double blockTimeMs)
     {
        #if defined (EL_PRO)
         if (program.wasRequested())
@@ -200,6 +234,8 @@ struct RootGraphRender : public AsyncUpdater
             
             for (auto* const graph : graphs)
             {
+                graph->setBlockTime (blockTimeMs);
+
                 // copy inputs, clear outs if more than input count
                 for (int i = 0; i < numInputChans; ++i)
                     audioTemp.copyFrom (i, 0, buffer, i, 0, numSamples);
@@ -234,16 +270,15 @@ struct RootGraphRender : public AsyncUpdater
                     midiTemp.addEvents (midi, 0, numSamples, 0);
                 }
 
+                // graphs change through the command queue, which was drained
+                // at the start of the block, so nothing is locked here
+                if (graph->isSuspended())
                 {
-                    const ScopedLock sl (graph->getCallbackLock());
-                    if (graph->isSuspended())
-                    {
-                        graph->processBlockBypassed (audioTemp, midiTemp);
-                    }
-                    else
-                    {
-                        graph->processBlock (audioTemp, midiTemp);
-                    }
+                    graph->processBlockBypassed (audioTemp, midiTemp);
+                }
+                else
+                {
+                    graph->processBlock (audioTemp, midiTemp);
                 }
                 
                 if (graphChanged && ((current->isSingle() && current != graph) ||
@@ -438,6 +473,7 @@ public:
     
     void timerCallback() override
     {
+        commands.dispatchCompleted();
         midiIOMonitor->notify();
     }
 
@@ -445,12 +481,7 @@ public:
     
     void onCurrentGraphChanged()
     {
-        int currentGraph = -1;
-        {
-            ScopedLock sl (lock);
-            currentGraph = graphs.getGraphIndex();
-        }
-
+        const int currentGraph = this->currentGraph.get();
         auto session = engine.getWorld().getSession();
         if (currentGraph >= 0 && currentGraph != session->getActiveGraphIndex())
         {
@@ -467,6 +498,8 @@ public:
                                 const int numSamples) override
     {
         jassert (sampleRate > 0 && blockSize > 0);
+        const double callbackTimeMs = Time::getMillisecondCounterHiRes();
+        engine.world.getMidiEngine().setBlockTime (callbackTimeMs);
         int totalNumChans = 0;
         ScopedNoDenormals denormals;
         if (numInputChannels > numOutputChannels)
@@ -510,11 +543,11 @@ public:
 
         const bool wasPlaying = transport.isPlaying();
         AudioSampleBuffer buffer (channels, totalNumChans, numSamples);
-        processCurrentGraph (buffer, incomingMidi);
+        processCurrentGraph (buffer, incomingMidi, callbackTimeMs);
 
         {
             ScopedLock lockMidiOut (engine.world.getMidiEngine().getMidiOutputLock());
-            if (auto* const midiOut = engine.world.getMidiEngine().getDefaultMidiOutput())
+            if (auto* const scheduler = engine.world.getMidiEngine().getDefaultMidiOutputScheduler())
             {
                #if defined (EL_PRO)
                 if (sendMidiClockToInput.get() != 1 && generateMidiClock.get() == 1)
@@ -537,24 +570,23 @@ public:
                 }
                #endif
 
-                const double delayMs = 6.0;
                 if (! incomingMidi.isEmpty())
-                {
                     midiIOMonitor->sent();
-                    midiOut->sendBlockOfMessages (incomingMidi, delayMs + Time::getMillisecondCounterHiRes(), sampleRate);
-                }
+                scheduler->send (incomingMidi, numSamples, sampleRate, callbackTimeMs);
             }
         }
         
         incomingMidi.clear();
     }
     
-    void processCurrentGraph (AudioBuffer<float>& buffer, MidiBuffer& midi)
+    void processCurrentGraph (AudioBuffer<float>& buffer, MidiBuffer& midi, double callbackTimeMs)
     {
         const int numSamples = buffer.getNumSamples();
-        messageCollector.removeNextBlockOfMessages (midi, numSamples);
+        messageCollector.removeNextBlockOfMessages (midi, numSamples, callbackTimeMs);
         
         const ScopedLock sl (lock);
+        commands.performPending();
+
         const bool shouldProcess = shouldBeLocked.get() == 0;
         const bool wasPlaying = transport.isPlaying();
         transport.preProcess (numSamples);
@@ -583,7 +615,7 @@ public:
 
             if (currentGraph.get() != graphs.getCurrentGraphIndex())
                 graphs.setCurrentGraph (currentGraph.get());
-            graphs.renderGraphs (buffer, midi);  // user requested index can be cancelled by program changed
+            graphs.renderGraphs (buffer, midi, callbackTimeMs);  // user requested index can be cancelled by program changed
             currentGraph.set (graphs.getCurrentGraphIndex());
         }
         else
@@ -641,6 +673,7 @@ public:
 
         prepareToPlay (sampleRate, blockSize);
         isPrepared = true;
+        commands.setActive (true);
     }
     
     void audioDeviceStopped() override
@@ -651,6 +684,7 @@ public:
     void audioStopped()
     {
         const ScopedLock sl (lock);
+        commands.setActive (false);
         keyboardState.removeListener (&messageCollector);
         if (isPrepared)
             releaseResources();
@@ -692,6 +726,7 @@ public:
         if (isPrepared)
             prepareGraph (graph, sampleRate, blockSize);
         ScopedLock sl (lock);
+        graph->setCommandQueue (&commands);
         if (graphs.addGraph (graph))
         {
             graph->renderingSequenceChanged.connect (
@@ -703,7 +738,10 @@ public:
     {
         {
             ScopedLock sl (lock);
+            // pending commands may reference the graph
+            commands.flush();
             graphs.removeGraph (graph);
+            graph->setCommandQueue (nullptr);
         }
         
         graph->renderingSequenceChanged.disconnect_all_slots();
@@ -786,6 +824,7 @@ private:
     Transport           transport;
     RootGraphRender     graphs;
     SessionPtr          session;
+    EngineCommandQueue  commands;
     
     Value tempoValue;
     Atomic<float> nextTempo;
@@ -800,7 +839,7 @@ private:
     HeapBlock<float*> channels;
     AudioSampleBuffer tempBuffer;
     MidiBuffer incomingMidi;
-    MidiMessageCollector messageCollector;
+    MidiInputCollector messageCollector { 16 };
     MidiKeyboardState keyboardState;
 
     AudioSampleBuffer graphBuffer;
@@ -879,6 +918,7 @@ void AudioEngine::deactivate()
 
 AudioIODeviceCallback&  AudioEngine::getAudioIODeviceCallback() { jassert (priv != nullptr); return *priv; }
 MidiInputCallback&      AudioEngine::getMidiInputCallback()     { jassert (priv != nullptr); return *priv; }
+EngineCommandQueue&     AudioEngine::getCommandQueue()          { jassert (priv != nullptr); return priv->commands; }
 
 bool AudioEngine::addGraph (RootGraph* graph)
 {
@@ -998,7 +1038,7 @@ void AudioEngine::processExternalBuffers (AudioBuffer<float>& buffer, MidiBuffer
        #if EL_RUNNING_AS_PLUGIN
         world.getMidiEngine().processMidiBuffer (midi, buffer.getNumSamples(), priv->sampleRate);
        #endif
-        priv->processCurrentGraph (buffer, midi);
+        priv->processCurrentGraph (buffer, midi, Time::getMillisecondCounterHiRes());
     }
 }
 
@@ -31,6 +31,7 @@ namespace Element {
 
 class Globals;
 class ClipFactory;
+class EngineCommandQueue;
 class EngineControl;
 class Settings;
 
@@ -48,11 +49,10 @@ public:
         Parallel        = (1 << 0)
     };
 
+    /** Only read on the message thread, commands carry what it decided */
     inline void setLocked (const var&)
     {
-        const bool isNowLocked = false;
-        ScopedLock sl (getCallbackLock());
-        locked = isNowLocked;
+        locked = false;
     }
 
     inline static bool renderModeValid (const int mode) {
@@ -78,22 +78,12 @@ public:
     inline String getRenderModeSlug() const { return getSlugForRenderMode (renderMode); }
     inline bool isSingle() const { return getRenderMode() == SingleGraph; }
     
-    inline void setRenderMode (const RenderMode mode)
-    {
-        // TODO: don't use a lock
-        if (! locked && renderMode == static_cast<int> (mode))
-            return;
-        ScopedLock sl (getCallbackLock());
-        renderMode = locked ? SingleGraph : mode;
-    }
+    /** Change the render mode. This is applied on the audio thread */
+    void setRenderMode (const RenderMode mode);
 
-    inline void setMidiProgram (const int program)
-    {
-        if (program == midiProgram)
-            return;
-        ScopedLock sl (getCallbackLock());
-        midiProgram = program;
-    }
+    /** Change the MIDI program which activates this graph. This is applied
+        on the audio thread */
+    void setMidiProgram (const int program);
     
     const String getName() const override;
     const String getInputChannelName (int channelIndex) const override;
@@ -172,6 +162,9 @@ public:
     Transport::MonitorPtr getTransportMonitor() const;
     AudioIODeviceCallback& getAudioIODeviceCallback() override;
     MidiInputCallback& getMidiInputCallback() override;
+
+    /** Returns the queue used to apply control changes on the audio thread */
+    EngineCommandQueue& getCommandQueue();
     
     /** For use by external systems only! e.g. the AU/VST version of Element and
         possibly things like rendering in the future
@@ -0,0 +1,88 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "engine/ControllerMapTable.h"
+
+namespace Element {
+
+ControllerMapTable::ControllerMapTable (const Array<ControllerMapHandler*>& handlers)
+{
+    offsets.calloc ((size_t) numKeys + 1);
+
+    auto forEachKey = [] (const ControllerMapHandler& handler, std::function<void(int)> callback)
+    {
+        const int channel = handler.getChannel();
+        for (int ch = 1; ch <= 16; ++ch)
+            if (channel == 0 || channel == ch)
+                callback (getKey (handler.messageType, ch, handler.number));
+    };
+
+    // count entries per key, then turn the counts into offsets and fill
+    for (auto* const handler : handlers)
+        forEachKey (*handler, [this] (int key) { ++offsets [key + 1]; });
+
+    for (int key = 0; key < numKeys; ++key)
+        offsets [key + 1] += offsets [key];
+
+    entries.insertMultiple (0, nullptr, offsets [numKeys]);
+    HeapBlock<int> next;
+    next.malloc ((size_t) numKeys);
+    memcpy (next.get(), offsets.get(), sizeof (int) * (size_t) numKeys);
+
+    for (auto* const handler : handlers)
+        forEachKey (*handler, [this, &next, handler] (int key) { entries.set (next [key]++, handler); });
+}
+
+ControllerMapTable::~ControllerMapTable() { }
+
+int ControllerMapTable::getKey (const MidiMessage& message) noexcept
+{
+    const int channel = message.getChannel();
+    if (channel <= 0)
+        return -1;
+
+    if (message.isController())
+        return getKey (ControllerMapHandler::Controller, channel, message.getControllerNumber());
+    if (message.isNoteOnOrOff())
+        return getKey (ControllerMapHandler::Note, channel, message.getNoteNumber());
+
+    return -1;
+}
+
+int ControllerMapTable::dispatch (const MidiMessage& message) const
+{
+    const int key = getKey (message);
+    if (key < 0)
+        return 0;
+
+    int numPerformed = 0;
+    for (int i = offsets [key]; i < offsets [key + 1]; ++i)
+    {
+        auto* const handler = entries.getUnchecked (i);
+        if (handler->wants (message))
+        {
+            handler->perform (message);
+            ++numPerformed;
+        }
+    }
+
+    return numPerformed;
+}
+
+}
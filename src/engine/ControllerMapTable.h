@@ -0,0 +1,103 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "ElementApp.h"
+
+namespace Element {
+
+/** Performs a mapping for MIDI messages of one type and number */
+class ControllerMapHandler
+{
+public:
+    enum MessageType
+    {
+        Controller = 0,
+        Note,
+        numMessageTypes
+    };
+
+    ControllerMapHandler (MessageType t, int n)
+        : messageType (t), number (n)
+    {
+        jassert (isPositiveAndBelow (number, 128));
+    }
+
+    virtual ~ControllerMapHandler() { }
+
+    virtual bool wants (const MidiMessage& message) const =0;
+    virtual void perform (const MidiMessage& message) =0;
+
+    /** Returns the MIDI channel handled, 1 to 16, or 0 for all channels */
+    virtual int getChannel() const =0;
+
+    /** The type of message this handler responds to */
+    const MessageType messageType;
+
+    /** The controller or note number this handler responds to */
+    const int number;
+
+    /** Called on the message thread when the channel has changed */
+    std::function<void()> channelChanged;
+
+private:
+    JUCE_DECLARE_NON_COPYABLE (ControllerMapHandler)
+};
+
+/** An immutable lookup table from MIDI messages to the handlers mapped to
+    them, indexed by message type, channel and number. Build a new table on
+    the message thread when mappings change and swap it in.
+ */
+class ControllerMapTable : public ReferenceCountedObject
+{
+public:
+    using Ptr = ReferenceCountedObjectPtr<ControllerMapTable>;
+
+    enum { numKeys = ControllerMapHandler::numMessageTypes * 16 * 128 };
+
+    explicit ControllerMapTable (const Array<ControllerMapHandler*>& handlers);
+    ~ControllerMapTable();
+
+    /** Returns the table index for a type, channel and number */
+    static int getKey (ControllerMapHandler::MessageType type, int channel, int number) noexcept
+    {
+        return (((int) type * 16) + (channel - 1)) * 128 + number;
+    }
+
+    /** Returns the table index for a message or -1 if it can't be mapped */
+    static int getKey (const MidiMessage& message) noexcept;
+
+    /** Calls perform() on each handler mapped to the message which wants it
+
+        @returns the number of handlers performed
+     */
+    int dispatch (const MidiMessage& message) const;
+
+    /** Returns the total number of entries. Omni handlers have one per channel */
+    int getNumEntries() const noexcept { return entries.size(); }
+
+private:
+    HeapBlock<int> offsets;
+    Array<ControllerMapHandler*> entries;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ControllerMapTable)
+};
+
+}
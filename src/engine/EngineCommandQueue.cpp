@@ -0,0 +1,220 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "engine/EngineCommandQueue.h"
+
+namespace Element {
+
+EngineCommandQueue::EngineCommandQueue (int capacity)
+    : pending (jmax (2, capacity)),
+      completed (jmax (2, capacity) * 2)
+{
+    pendingSlots.calloc ((size_t) pending.getTotalSize());
+    completedSlots.calloc ((size_t) completed.getTotalSize());
+}
+
+EngineCommandQueue::~EngineCommandQueue()
+{
+    int start1, size1, start2, size2;
+    pending.prepareToRead (pending.getNumReady(), start1, size1, start2, size2);
+    for (int i = 0; i < size1; ++i)
+        delete pendingSlots [start1 + i];
+    for (int i = 0; i < size2; ++i)
+        delete pendingSlots [start2 + i];
+    pending.finishedRead (size1 + size2);
+
+    completed.prepareToRead (completed.getNumReady(), start1, size1, start2, size2);
+    for (int i = 0; i < size1; ++i)
+        delete completedSlots [start1 + i];
+    for (int i = 0; i < size2; ++i)
+        delete completedSlots [start2 + i];
+    completed.finishedRead (size1 + size2);
+
+    for (const auto& item : deferred)
+        delete item.command;
+}
+
+bool EngineCommandQueue::post (EngineCommandQueue* queue, EngineCommand* command)
+{
+    if (queue != nullptr)
+        return queue->post (command);
+
+    std::unique_ptr<EngineCommand> deleter (command);
+    if (command != nullptr)
+    {
+        command->perform();
+        command->completed();
+    }
+
+    return true;
+}
+
+bool EngineCommandQueue::post (EngineCommand* command)
+{
+    jassert (command != nullptr);
+    if (command == nullptr)
+        return false;
+
+    bool performed = false, posted = false;
+
+    {
+        const SpinLock::ScopedLockType sl (writeLock);
+
+        if (! isActive())
+        {
+            command->perform();
+            performed = true;
+        }
+        else
+        {
+            int start1, size1, start2, size2;
+            pending.prepareToWrite (1, start1, size1, start2, size2);
+            if (size1 + size2 > 0)
+            {
+                pendingSlots [size1 > 0 ? start1 : start2] = command;
+                pending.finishedWrite (1);
+                posted = true;
+            }
+        }
+    }
+
+    // completed() runs outside the write lock, so it may post more commands
+    if (performed)
+    {
+        complete (command, true);
+        return true;
+    }
+
+    if (! posted)
+    {
+        jassertfalse; // command queue overflow
+        complete (command, false);
+        return false;
+    }
+
+    return true;
+}
+
+int EngineCommandQueue::performPending() noexcept
+{
+    const int numToPerform = jmin (pending.getNumReady(), completed.getFreeSpace());
+    if (numToPerform <= 0)
+        return 0;
+
+    int start1, size1, start2, size2;
+    pending.prepareToRead (numToPerform, start1, size1, start2, size2);
+
+    for (int i = 0; i < size1; ++i)
+    {
+        auto* const command = pendingSlots [start1 + i];
+        command->perform();
+        addCompleted (command);
+    }
+
+    for (int i = 0; i < size2; ++i)
+    {
+        auto* const command = pendingSlots [start2 + i];
+        command->perform();
+        addCompleted (command);
+    }
+
+    pending.finishedRead (size1 + size2);
+    return size1 + size2;
+}
+
+int EngineCommandQueue::flush()
+{
+    const SpinLock::ScopedLockType sl (writeLock);
+    return performPending();
+}
+
+int EngineCommandQueue::dispatchCompleted()
+{
+    jassert (MessageManager::getInstance()->isThisTheMessageThread());
+
+    int start1, size1, start2, size2;
+    completed.prepareToRead (completed.getNumReady(), start1, size1, start2, size2);
+
+    for (int i = 0; i < size1; ++i)
+    {
+        std::unique_ptr<EngineCommand> command (completedSlots [start1 + i]);
+        command->completed();
+    }
+
+    for (int i = 0; i < size2; ++i)
+    {
+        std::unique_ptr<EngineCommand> command (completedSlots [start2 + i]);
+        command->completed();
+    }
+
+    completed.finishedRead (size1 + size2);
+
+    Array<Deferred> toDispatch;
+    {
+        const ScopedLock sl (deferredLock);
+        toDispatch.swapWith (deferred);
+    }
+
+    for (const auto& item : toDispatch)
+    {
+        std::unique_ptr<EngineCommand> command (item.command);
+        if (item.performed)
+            command->completed();
+    }
+
+    return size1 + size2 + toDispatch.size();
+}
+
+void EngineCommandQueue::setActive (bool shouldBeActive)
+{
+    const SpinLock::ScopedLockType sl (writeLock);
+    if (isActive() == shouldBeActive)
+        return;
+
+    if (! shouldBeActive)
+        performPending();
+    active.set (shouldBeActive ? 1 : 0);
+}
+
+void EngineCommandQueue::complete (EngineCommand* command, bool performed)
+{
+    if (MessageManager::getInstance()->isThisTheMessageThread())
+    {
+        std::unique_ptr<EngineCommand> deleter (command);
+        if (performed)
+            command->completed();
+        return;
+    }
+
+    // commands may hold the last reference to a node, so they are only
+    // ever completed and deleted on the message thread
+    const ScopedLock sl (deferredLock);
+    deferred.add ({ command, performed });
+}
+
+void EngineCommandQueue::addCompleted (EngineCommand* command)
+{
+    int start1, size1, start2, size2;
+    completed.prepareToWrite (1, start1, size1, start2, size2);
+    jassert (size1 + size2 == 1);
+    completedSlots [size1 > 0 ? start1 : start2] = command;
+    completed.finishedWrite (1);
+}
+
+}
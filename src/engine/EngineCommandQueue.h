@@ -0,0 +1,133 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "ElementApp.h"
+
+namespace Element {
+
+/** A control change which is applied on the audio thread.
+
+    Commands are created on a control thread, posted to an EngineCommandQueue
+    and performed by the audio thread at the start of the next block. Once
+    performed, they are handed back to the message thread where completed()
+    is called and the command is deleted.
+ */
+class EngineCommand
+{
+public:
+    virtual ~EngineCommand() { }
+
+    /** Apply the change. This is called on the audio thread so it must not
+        lock, allocate or otherwise block */
+    virtual void perform() = 0;
+
+    /** Called on the message thread after perform() has been called */
+    virtual void completed() { }
+
+protected:
+    EngineCommand() { }
+
+private:
+    JUCE_DECLARE_NON_COPYABLE (EngineCommand)
+};
+
+/** A lock-free queue of EngineCommands from control threads to the audio thread.
+
+    Any number of control threads can post commands. Only the audio thread
+    should call performPending() and only the message thread should call
+    dispatchCompleted().  While the queue is not active (e.g. no audio device
+    is running), posted commands are performed on the calling thread instead.
+ */
+class EngineCommandQueue
+{
+public:
+    explicit EngineCommandQueue (int capacity = 512);
+    ~EngineCommandQueue();
+
+    /** Post a command to a queue.  If the queue is nullptr the command is
+        performed immediately.  Ownership of the command is taken in all cases
+
+        @returns false if the queue was full and the command wasn't posted
+     */
+    static bool post (EngineCommandQueue* queue, EngineCommand* command);
+
+    /** Post a command to this queue. Takes ownership of the command.
+        DO NOT call this from the audio thread.
+
+        @returns false if the queue was full and the command wasn't posted
+     */
+    bool post (EngineCommand* command);
+
+    /** Performs all pending commands. Call this from the audio thread only,
+        at the start of each block.
+
+        @returns the number of commands performed
+     */
+    int performPending() noexcept;
+
+    /** Performs all pending commands from a non-realtime thread. The caller
+        must make sure the audio thread cannot call performPending() at the
+        same time, e.g. by holding the engine's callback lock
+     */
+    int flush();
+
+    /** Calls completed() on and deletes all performed commands. Call this
+        on the message thread.
+
+        @returns the number of commands dispatched
+     */
+    int dispatchCompleted();
+
+    /** Marks whether or not the audio thread is draining this queue. When
+        deactivated, pending commands are flushed and new commands perform
+        immediately on the posting thread */
+    void setActive (bool shouldBeActive);
+
+    /** Returns true if commands are performed by the audio thread */
+    bool isActive() const noexcept      { return active.get() == 1; }
+
+    /** Returns the number of commands waiting for the audio thread */
+    int getNumPending() const noexcept  { return pending.getNumReady(); }
+
+private:
+    struct Deferred
+    {
+        EngineCommand* command;
+        bool performed;
+    };
+
+    AbstractFifo pending, completed;
+    HeapBlock<EngineCommand*> pendingSlots, completedSlots;
+    SpinLock writeLock;
+    Atomic<int> active { 0 };
+
+    // commands finished or dropped off the message thread, while the audio
+    // thread isn't draining the queue
+    CriticalSection deferredLock;
+    Array<Deferred> deferred;
+
+    void complete (EngineCommand*, bool performed);
+    void addCompleted (EngineCommand*);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (EngineCommandQueue)
+};
+
+}
@@ -0,0 +1,143 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+
+#pragma once
+
+#include "JuceHeader.h"
+
+#if JUCE_MSVC
+ #include <intrin.h>
+#endif
+
+namespace Element {
+
+/** A grid of gains from inputs to outputs, stored in one block with the
+    inputs of each output next to each other.
+
+    Each output also has a bitset of the inputs with a gain other than zero,
+    so a renderer can skip the rest. Only resizing allocates, use swapWith
+    or operator= on the audio thread.
+ */
+class GainMatrix
+{
+public:
+    explicit GainMatrix (const int ins = 4, const int outs = 4)
+    {
+        resize (ins, outs);
+    }
+
+    /** Creates a matrix with a gain of 1 for each connected cell */
+    GainMatrix (const MatrixState& matrix)
+    {
+        resize (matrix.getNumRows(), matrix.getNumColumns());
+        for (int i = 0; i < numIns; ++i)
+            for (int o = 0; o < numOuts; ++o)
+                if (matrix.connected (i, o))
+                    set (i, o, 1.f);
+    }
+
+    /** Resizes and clears the matrix. This allocates */
+    void resize (int ins, int outs)
+    {
+        jassert (ins > 0 && outs > 0);
+        numIns   = ins;
+        numOuts  = outs;
+        numWords = (ins + 63) / 64;
+        gains.calloc ((size_t) (numIns * numOuts));
+        active.calloc ((size_t) (numWords * numOuts));
+    }
+
+    inline bool sameSizeAs (const GainMatrix& other) const noexcept
+    {
+        return numIns == other.numIns && numOuts == other.numOuts;
+    }
+
+    inline void clear() noexcept
+    {
+        zeromem (gains, sizeof (float) * (size_t) (numIns * numOuts));
+        zeromem (active, sizeof (uint64) * (size_t) (numWords * numOuts));
+    }
+
+    inline float get (const int in, const int out) const noexcept
+    {
+        jassert (isPositiveAndBelow (in, numIns) && isPositiveAndBelow (out, numOuts));
+        return gains [out * numIns + in];
+    }
+
+    inline void set (const int in, const int out, const float gain) noexcept
+    {
+        jassert (isPositiveAndBelow (in, numIns) && isPositiveAndBelow (out, numOuts));
+        gains [out * numIns + in] = gain;
+        const uint64 bit = (uint64) 1 << (in & 63);
+        auto& word = active [out * numWords + (in >> 6)];
+        word = gain != 0.f ? (word | bit) : (word & ~bit);
+    }
+
+    /** Returns the gains of every input to an output */
+    inline const float* getGains (const int out) const noexcept     { return gains + out * numIns; }
+
+    /** Returns the bitset of inputs that reach an output */
+    inline const uint64* getActive (const int out) const noexcept   { return active + out * numWords; }
+
+    inline int getNumInputs() const noexcept    { return numIns; }
+    inline int getNumOutputs() const noexcept   { return numOuts; }
+    inline int getNumWords() const noexcept     { return numWords; }
+
+    /** Returns the index of the lowest bit set in a non-zero word */
+    static inline int findLowestBit (const uint64 bits) noexcept
+    {
+        jassert (bits != 0);
+       #if JUCE_MSVC
+        unsigned long index = 0;
+        _BitScanForward64 (&index, bits);
+        return (int) index;
+       #else
+        return __builtin_ctzll (bits);
+       #endif
+    }
+
+    inline void swapWith (GainMatrix& other) noexcept
+    {
+        gains.swapWith (other.gains);
+        active.swapWith (other.active);
+        std::swap (numIns, other.numIns);
+        std::swap (numOuts, other.numOuts);
+        std::swap (numWords, other.numWords);
+    }
+
+    /** Copies the gains of another matrix of the same size */
+    GainMatrix& operator= (const GainMatrix& other) noexcept
+    {
+        jassert (sameSizeAs (other));
+        if (sameSizeAs (other))
+        {
+            memcpy (gains, other.gains, sizeof (float) * (size_t) (numIns * numOuts));
+            memcpy (active, other.active, sizeof (uint64) * (size_t) (numWords * numOuts));
+        }
+        return *this;
+    }
+
+private:
+    int numIns = 0, numOuts = 0, numWords = 0;
+    HeapBlock<float> gains;
+    HeapBlock<uint64> active;
+};
+
+}
@@ -26,9 +26,11 @@
 #include "engine/nodes/SubGraphProcessor.h"
 
 #include "engine/AudioEngine.h"
+#include "engine/EngineCommandQueue.h"
 #include "engine/GraphNode.h"
 #include "engine/GraphProcessor.h"
 #include "engine/MidiPipe.h"
+#include "engine/SignalProbe.h"
 
 #include "session/Node.h"
 
@@ -47,6 +49,8 @@ GraphNode::GraphNode (const uint32 nodeId_) noexcept
     inputGain.set(1.0f); lastInputGain.set (1.0f);
     metadata.setProperty (Slugs::id, static_cast<int64> (nodeId), nullptr)
             .setProperty (Slugs::type, getTypeString(), nullptr);
+    parameterChanges.onChanged = [this] (const Array<int>& indexes) { handleParameterChanges (indexes); };
+    appliedParameters.onChanged = [this] (const Array<int>& indexes) { handleAppliedParameters (indexes); };
 }
 
 GraphNode::~GraphNode()
@@ -62,9 +66,32 @@ void GraphNode::clearParameters()
     for (const auto* param : parameters)
         jassert(param->getReferenceCount() == 1);
    #endif
+    detachParameters();
     parameters.clear();
 }
 
+void GraphNode::detachParameters()
+{
+    for (auto* const param : parameters)
+        param->changes.set (nullptr);
+}
+
+void GraphNode::handleParameterChanges (const Array<int>& indexes)
+{
+    for (const auto index : indexes)
+        if (auto* const param = parameters.getObjectPointer (index))
+            param->sendValueChangedMessageToObservers();
+    parametersChanged (this, indexes);
+}
+
+void GraphNode::handleAppliedParameters (const Array<int>& indexes)
+{
+    // the value may have moved on since, listeners get the latest
+    for (const auto index : indexes)
+        if (auto* const param = parameters.getObjectPointer (index))
+            param->sendValueChangedMessageToListeners (param->getValue());
+}
+
 bool GraphNode::isSpecialParameter (int parameter)
 {
     return parameter >= SpecialParameterBegin && parameter < SpecialParameterEnd;
@@ -207,26 +234,34 @@ bool GraphNode::isSuspended() const
     return bypassed.get() == 1;
 }
 
-void GraphNode::suspendProcessing (const bool shouldBeSuspended)
+struct GraphNode::SuspendCommand : public EngineCommand
 {
-    const bool wasSuspeneded = isSuspended();
-    const int iShouldBeSuspended = static_cast<int> (shouldBeSuspended);
+    SuspendCommand (GraphNode* n, bool suspend)
+        : node (n), shouldBeSuspended (suspend) { }
 
-    if (auto* proc = getAudioProcessor())
+    void perform() override
     {
-        if (wasSuspeneded != shouldBeSuspended)
-        {
-            proc->suspendProcessing (shouldBeSuspended);
-            bypassed.set (proc->isSuspended() ? 1 : 0);
-        }
+        wasSuspended = node->isSuspended();
+        node->bypassed.set (shouldBeSuspended ? 1 : 0);
     }
-    else if (bypassed.get() != iShouldBeSuspended)
+
+    void completed() override
     {
-        bypassed.set (iShouldBeSuspended);
+        // the processor's own suspended flag is left alone: setting it takes
+        // the plugin's callback lock and rendering only needs bypassed
+        if (wasSuspended != shouldBeSuspended)
+            node->bypassChanged (node.get());
     }
 
-    if (isSuspended() != wasSuspeneded)
-        bypassChanged (this);
+    GraphNodePtr node;
+    const bool shouldBeSuspended;
+    bool wasSuspended = false;
+};
+
+void GraphNode::suspendProcessing (const bool shouldBeSuspended)
+{
+    EngineCommandQueue::post (getCommandQueue(), 
+        new SuspendCommand (this, shouldBeSuspended));
 }
 
 bool GraphNode::isGraph() const noexcept        { return nullptr != dynamic_cast<GraphProcessor*> (getAudioProcessor()); }
@@ -309,6 +344,7 @@ void GraphNode::prepare (const double sampleRate, const int blockSize,
 
         const int osFactor = getOversamplingFactor();
         prepareToRender (sampleRate * osFactor, blockSize * osFactor);
+        parameterEvents.prepare (sampleRate);
 
         // TODO: move model code out of engine code
         // VERIFY: this portion is actually needed. This was here to ensure
@@ -317,8 +353,14 @@ void GraphNode::prepare (const double sampleRate, const int blockSize,
             resetPorts();
 
         // VERIFY: this is needed.  GraphManager should be setting this
+        // NOTE: applied directly because the node may not be owned by
+        // a graph yet, so it can't be referenced by a command
         if (metadata.getProperty (Tags::bypass, false))
-            suspendProcessing (true);
+        {
+            bypassed.set (1);
+            if (auto* proc = getAudioProcessor())
+                proc->suspendProcessing (true);
+        }
 
         inRMS.clearQuick (true);
         for (int i = 0; i < getNumAudioInputs(); ++i)
@@ -663,13 +705,21 @@ void GraphNode::resetPorts()
     metadata.addChild (portList, 1, nullptr);
     jassert (metadata.getChildWithName(Tags::ports).getNumChildren() == ports.size());
     
+    detachParameters();
     parameters.clear();
+    int numChangeBits = 0;
     for (int i = 0; i < ports.size(); ++i)
     {
         const auto port = ports.getPort (i);
         if (port.input && port.type == PortType::Control)
-            parameters.add (getOrCreateParameter (port));
+        {
+            if (auto* const param = parameters.add (getOrCreateParameter (port)))
+                numChangeBits = jmax (numChangeBits, param->getParameterIndex() + 1);
+        }
     }
+
+    parameterChanges.setNumParameters (numChangeBits);
+    appliedParameters.setNumParameters (parameters.size());
     
     struct ParamSorter
     {
@@ -685,8 +735,39 @@ void GraphNode::resetPorts()
             sub->getNode(i)->resetPorts();
 }
 
+void GraphNode::postParameterValue (int index, float value, double timeMs)
+{
+    auto* const param = parameters.getObjectPointer (index);
+    if (param == nullptr)
+        return;
+
+    auto* const queue = getCommandQueue();
+    const double now = Time::getMillisecondCounterHiRes();
+    timeMs = timeMs > 0.0 ? jmin (timeMs, now) : now;
+
+    if (isPrepared && queue != nullptr && queue->isActive() &&
+        parameterEvents.post (index, value, timeMs))
+    {
+        // listeners are notified from the message thread once it's applied
+        return;
+    }
+
+    param->setValue (value);
+    param->sendValueChangedMessageToListeners (value);
+}
+
 GraphProcessor* GraphNode::getParentGraph() const { return parent; }
 
+double GraphNode::getBlockTime() const
+{
+    return parent != nullptr ? parent->getBlockTime() : Time::getMillisecondCounterHiRes();
+}
+
+EngineCommandQueue* GraphNode::getCommandQueue() const
+{
+    return parent != nullptr ? parent->getCommandQueue() : nullptr;
+}
+
 void GraphNode::setParentGraph (GraphProcessor* const graph)
 {
     typedef GraphProcessor::AudioGraphIOProcessor IOP;
@@ -699,12 +780,31 @@ void GraphNode::setParentGraph (GraphProcessor* const graph)
     }
 }
 
+struct GraphNode::MuteCommand : public EngineCommand
+{
+    MuteCommand (GraphNode* n, bool muted)
+        : node (n), shouldBeMuted (muted) { }
+
+    void perform() override
+    {
+        wasMuted = node->isMuted();
+        node->mute.set (shouldBeMuted ? 1 : 0);
+    }
+
+    void completed() override
+    {
+        if (wasMuted != shouldBeMuted)
+            node->muteChanged (node.get());
+    }
+
+    GraphNodePtr node;
+    const bool shouldBeMuted;
+    bool wasMuted = false;
+};
+
 void GraphNode::setMuted (bool muted)
 {
-    bool wasMuted = isMuted();
-    mute.set (muted ? 1 : 0);
-    if (wasMuted != isMuted())
-        muteChanged (this);
+    EngineCommandQueue::post (getCommandQueue(), new MuteCommand (this, muted));
 }
 
 void GraphNode::initOversampling (int numChannels, int blockSize)
@@ -831,6 +931,7 @@ Parameter::Ptr GraphNode::getOrCreateParameter (const PortDescription& port)
     if (param != nullptr)
     {
         param->parameterIndex = port.channel;
+        param->changes.set (&parameterChanges);
     }
 
     jassert(param != nullptr);
@@ -21,6 +21,8 @@
 
 #include "ElementApp.h"
 #include "engine/Parameter.h"
+#include "engine/ParameterChangeSet.h"
+#include "engine/ParameterEventQueue.h"
 
 namespace Element {
 
@@ -29,8 +31,10 @@ namespace GraphRender {
 class ProcessBufferOp;
 }
 
+class EngineCommandQueue;
 class GraphProcessor;
 class MidiPipe;
+struct SignalTaps;
 
 class GraphNode : public ReferenceCountedObject
 {
@@ -91,6 +95,28 @@ public:
     //=========================================================================
     const ParameterArray& getParameters() const    { return parameters; }
 
+    /** Schedule a parameter change to be applied on the audio thread at the
+        point in the block matching when it happened. Listeners are notified
+        from the message thread once the value has been applied. If the node
+        isn't being rendered, the value is set and listeners notified now.
+
+        @param parameter    Index in getParameters()
+        @param value        The new normalized value
+        @param timeMs       When the change happened, in
+                            Time::getMillisecondCounterHiRes() units. Zero
+                            means now.
+     */
+    void postParameterValue (int parameter, float value, double timeMs = 0.0);
+
+    /** Return true if this node applies parameter events itself while
+        rendering. If false, the block is split at event boundaries and
+        values are set before each part is rendered */
+    virtual bool handlesParameterEvents() const { return false; }
+
+    /** The parameter events collected for the block being rendered. Only
+        valid on the audio thread while rendering */
+    const ParameterEventQueue& getParameterEvents() const noexcept { return parameterEvents; }
+
     //=========================================================================
     /** Returns the type of port
         
@@ -159,7 +185,8 @@ public:
     /** Returns true if the processor is suspended */
     bool isSuspended() const;
   
-    /** Suspend processing */
+    /** Suspend processing. The change is applied on the audio thread and
+        bypassChanged is triggered on the message thread afterwards */
     void suspendProcessing (const bool);
 
     /** Get latency audio samples */
@@ -199,6 +226,15 @@ public:
        this will return nullptr */
     GraphProcessor* getParentGraph() const;
 
+    /** Returns the start time of the block being rendered, in
+        Time::getMillisecondCounterHiRes() units. Use this on the audio thread
+        to place timed events, rather than the time the node renders at */
+    double getBlockTime() const;
+
+    /** Returns the queue used to apply control changes on the audio thread.
+        This will return nullptr if the node isn't in an engine's graph */
+    EngineCommandQueue* getCommandQueue() const;
+
     void setInputRMS (int chan, float val);
     float getInputRMS(int chan) const { return (chan < inRMS.size()) ? inRMS.getUnchecked(chan)->get() : 0.0f; }
     void setOutputRMS (int chan, float val);
@@ -325,6 +361,8 @@ public:
     }
 
     //=========================================================================
+    /** Mute or unmute this node. The change is applied on the audio thread
+        and muteChanged is triggered on the message thread afterwards */
     void setMuted (bool muted);
     bool isMuted() const        { return mute.get() == 1; }
     void setMuteInput (bool shouldMuteInput) { muteInput.set (shouldMuteInput ? 1 : 0); }
@@ -360,6 +398,11 @@ public:
     /** Triggered when the node changes its name */
     Signal<void()> nameChanged;
 
+    /** Triggered on the message thread with the indexes of parameters which
+        changed since the last time. Changes from any thread are coalesced
+        and delivered at a bounded rate */
+    Signal<void(GraphNode*, const Array<int>&)> parametersChanged;
+
 
 
 protected:
@@ -395,8 +438,11 @@ private:
     friend class GraphManager;
     friend class EngineController;
     friend class Node;
+    struct MuteCommand;
+    struct SuspendCommand;
     
     GraphProcessor* parent = nullptr;
+    std::unique_ptr<SignalTaps> taps;
     bool isPrepared = false;
     Atomic<int> enabled { 1 };
     Atomic<int> bypassed { 0 };
@@ -407,6 +453,14 @@ private:
     String name;
 
     ParameterArray parameters;
+    ParameterEventQueue parameterEvents;
+    ParameterChangeSet parameterChanges;
+    // parameter events the audio thread applied, reported to the parameters'
+    // listeners from the message thread
+    ParameterChangeSet appliedParameters;
+    void handleParameterChanges (const Array<int>&);
+    void handleAppliedParameters (const Array<int>&);
+    void detachParameters();
 
     Atomic<float> gain, lastGain, inputGain, lastInputGain;
     OwnedArray<AtomicValue<float> > inRMS, outRMS;
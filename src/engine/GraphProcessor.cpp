@@ -19,6 +19,7 @@
 
 #include "engine/nodes/AudioProcessorNode.h"
 #include "engine/AudioEngine.h"
+#include "engine/EngineCommandQueue.h"
 #include "engine/GraphProcessor.h"
 #include "engine/MidiPipe.h"
 #include "engine/MidiTranspose.h"
@@ -133,7 +134,11 @@ public:
 
     void perform (AudioSampleBuffer&, const OwnedArray <MidiBuffer>& sharedMidiBuffers, const int)
     {
-        *sharedMidiBuffers.getUnchecked (dstBufferNum) = *sharedMidiBuffers.getUnchecked (srcBufferNum);
+        // copies the raw event data into storage the buffer already has,
+        // MidiBuffer's assignment would allocate a new copy every block
+        auto& dst = *sharedMidiBuffers.getUnchecked (dstBufferNum);
+        dst.clear();
+        dst.data.addArray (sharedMidiBuffers.getUnchecked (srcBufferNum)->data);
     }
 
 private:
@@ -153,8 +158,16 @@ public:
 
     void perform (AudioSampleBuffer&, const OwnedArray <MidiBuffer>& sharedMidiBuffers, const int numSamples)
     {
-        sharedMidiBuffers.getUnchecked (dstBufferNum)
-            ->addEvents (*sharedMidiBuffers.getUnchecked (srcBufferNum), 0, numSamples, 0);
+        auto& dst = *sharedMidiBuffers.getUnchecked (dstBufferNum);
+        const auto& src = *sharedMidiBuffers.getUnchecked (srcBufferNum);
+        if (src.isEmpty())
+            return;
+
+        // adding to nothing is a straight copy, not an insert per event
+        if (dst.isEmpty() && src.getLastEventTime() < numSamples)
+            dst.data.addArray (src.data);
+        else
+            dst.addEvents (src, 0, numSamples, 0);
     }
 
 private:
@@ -207,6 +220,7 @@ public:
                      const Array <int> chans [PortType::Unknown])
         : node (node_),
           processor (node_->getAudioPluginInstance()),
+          subGraph (dynamic_cast<GraphProcessor*> (processor)),
           audioChannelsToUse (audioChannelsToUse_),
           midiChannelsToUse (chans[PortType::Midi]),
           totalChans (jmax (1, totalChans_)),
@@ -223,6 +237,22 @@ public:
             midiBufferToUse = chans[PortType::Midi].getFirst();
 
         lastMute = node->isMuted();
+
+        // referenced here so parameters stay valid while the node's ports
+        // are reset on the message thread
+        parameters = node->getParameters();
+
+        if (node->wantsMidiPipe())
+            midiSources = midiChannelsToUse;
+        else
+            midiSources.add (midiBufferToUse);
+
+        for (int i = 0; i < midiSources.size(); ++i)
+        {
+            splitChannels.add (i);
+            splitInput.add (new MidiBuffer())->ensureSize (2048);
+            splitOutput.add (new MidiBuffer())->ensureSize (2048);
+        }
     }
 
     void perform (AudioSampleBuffer& sharedBufferChans, const OwnedArray <MidiBuffer>& sharedMidiBuffers, const int numSamples)
@@ -322,9 +352,93 @@ public:
         // End MIDI filters
        #endif
         
+        if (subGraph != nullptr)
+            subGraph->setBlockTime (node->getBlockTime());
+
+        auto& events = node->parameterEvents;
+        const int granularity = node->getParentGraph() != nullptr
+            ? node->getParentGraph()->getParameterEventGranularity() : 1;
+
+        const int numEvents = events.collect (numSamples, granularity);
+        if (numEvents <= 0 || node->handlesParameterEvents())
+            renderBlock (buffer, sharedMidiBuffers, midiSources);
+        else
+            renderSplit (buffer, sharedMidiBuffers, events);
+
+        // posted values are only reported once they've been applied, so
+        // listeners reading getValue() don't see the previous value. They are
+        // called from the message thread, here the change is only marked
+        for (int i = 0; i < numEvents; ++i)
+            node->appliedParameters.mark (events.getEvent (i).parameter);
+        
+        if (muted && !muteInput)
+        {
+            if (lastMute != muted)
+            {
+                // just became muted
+                buffer.applyGainRamp (0, numSamples, node->getLastGain(), 0.0);
+            }
+            else
+            {
+                // normal mute processing
+                buffer.applyGain (0, numSamples, 0.0);
+            }
+        }
+        else if (!muted && !muteInput && muted != lastMute)
+        {
+            // just became unmuted
+            buffer.applyGainRamp (0, numSamples, 0.0, node->getGain());
+        }
+        else if (node->getGain() != node->getLastGain())
+        {
+            buffer.applyGainRamp (0, numSamples, node->getLastGain(), node->getGain());
+        }
+        else 
+        {
+            buffer.applyGain (0, numSamples, node->getGain());
+        }
+
+        node->updateGain();
+        lastMute = muted;
+
+        for (int i = 0; i < numAudioOuts; ++i)
+            node->setOutputRMS (i, buffer.getRMSLevel (i, 0, numSamples));
+
+        if (auto* taps = node->taps.get())
+            writeTaps (*taps, buffer, sharedMidiBuffers, numSamples);
+    }
+
+    void writeTaps (const SignalTaps& taps, const AudioSampleBuffer& buffer,
+                    const OwnedArray<MidiBuffer>& sharedMidiBuffers, const int numSamples)
+    {
+        for (const auto& tap : taps.taps)
+        {
+            if (tap.type == PortType::Audio)
+            {
+                if (isPositiveAndBelow (tap.channel, buffer.getNumChannels()))
+                    tap.probe->writeAudio (buffer.getReadPointer (tap.channel), numSamples);
+            }
+            else
+            {
+                const int index = isPositiveAndBelow (tap.channel, midiChannelsToUse.size())
+                    ? midiChannelsToUse.getUnchecked (tap.channel) : midiBufferToUse;
+                tap.probe->writeMidi (*sharedMidiBuffers.getUnchecked (index), numSamples, taps.sampleRate);
+            }
+        }
+    }
+
+    const GraphNodePtr node;
+    AudioProcessor* const processor;
+    GraphProcessor* const subGraph;
+
+private:
+    /** Renders the node with the given MIDI buffers */
+    void renderBlock (AudioSampleBuffer& buffer, const OwnedArray<MidiBuffer>& midiBuffers,
+                      const Array<int>& midiChannels)
+    {
         if (node->wantsMidiPipe())
         {
-            MidiPipe midiPipe (sharedMidiBuffers, midiChannelsToUse);
+            MidiPipe midiPipe (midiBuffers, midiChannels);
             if (! node->isSuspended())
                 node->render (buffer, midiPipe);
             else
@@ -332,18 +446,23 @@ public:
         }
         else
         {
-            auto pluginProcessBlock = [=, &sharedMidiBuffers] (AudioSampleBuffer& buffer, bool isSuspended)
+            auto& midi = *midiBuffers.getUnchecked (midiChannels.getUnchecked (0));
+            auto pluginProcessBlock = [this, &midi] (AudioSampleBuffer& buffer, bool isSuspended)
             {
                 if (! isSuspended)
                 {
-                    processor->processBlock (buffer, *sharedMidiBuffers.getUnchecked (midiBufferToUse));
+                    processor->processBlock (buffer, midi);
                 }
                 else
                 {
-                    processor->processBlockBypassed (buffer, *sharedMidiBuffers.getUnchecked (midiBufferToUse));
+                    processor->processBlockBypassed (buffer, midi);
                 }
             };
 
+            // the node's bypass state is applied on the audio thread, the processor
+            // can also be suspended directly while it's being reconfigured
+            const bool suspended = node->isSuspended() || processor->isSuspended();
+
             if (node->getOversamplingFactor() > 1)
             {
                 auto osProcessor = node->getOversamplingProcessor();
@@ -357,55 +476,62 @@ public:
                     ptrArray.get()[ch] = osBlock.getChannelPointer (ch);
 
                 AudioBuffer<float> osBuffer (ptrArray.get(), buffer.getNumChannels(), static_cast<int> (osBlock.getNumSamples()));
-                pluginProcessBlock (osBuffer, processor->isSuspended());
+                pluginProcessBlock (osBuffer, suspended);
 
                 osProcessor->processSamplesDown (block);
             }
             else
             {
-                pluginProcessBlock (buffer, processor->isSuspended());
+                pluginProcessBlock (buffer, suspended);
             }
-            
+
         }
-        
-        if (muted && !muteInput)
+    }
+
+    /** Renders the block in parts, setting parameter values at the start
+        of each part */
+    void renderSplit (AudioSampleBuffer& buffer, const OwnedArray<MidiBuffer>& sharedMidiBuffers,
+                      const ParameterEventQueue& events)
+    {
+        const int numSamples = buffer.getNumSamples();
+        const int numEvents = events.getNumEvents();
+
+        for (auto* const midi : splitOutput)
+            midi->clear();
+
+        int start = 0, index = 0;
+        while (start < numSamples)
         {
-            if (lastMute != muted)
+            for (; index < numEvents && events.getEvent (index).frame <= start; ++index)
             {
-                // just became muted
-                buffer.applyGainRamp (0, numSamples, node->getLastGain(), 0.0);
+                const auto& event = events.getEvent (index);
+                if (auto* const param = parameters.getObjectPointer (event.parameter))
+                    param->setValue (event.value);
             }
-            else
+
+            const int end = index < numEvents ? events.getEvent (index).frame : numSamples;
+            const int length = end - start;
+
+            for (int i = 0; i < midiSources.size(); ++i)
             {
-                // normal mute processing
-                buffer.applyGain (0, numSamples, 0.0);
+                auto* const midi = splitInput.getUnchecked (i);
+                midi->clear();
+                midi->addEvents (*sharedMidiBuffers.getUnchecked (midiSources.getUnchecked (i)), start, length, -start);
             }
-        }
-        else if (!muted && !muteInput && muted != lastMute)
-        {
-            // just became unmuted
-            buffer.applyGainRamp (0, numSamples, 0.0, node->getGain());
-        }
-        else if (node->getGain() != node->getLastGain())
-        {
-            buffer.applyGainRamp (0, numSamples, node->getLastGain(), node->getGain());
-        }
-        else 
-        {
-            buffer.applyGain (0, numSamples, node->getGain());
-        }
 
-        node->updateGain();
-        lastMute = muted;
+            AudioSampleBuffer part (buffer.getArrayOfWritePointers(), buffer.getNumChannels(), start, length);
+            renderBlock (part, splitInput, splitChannels);
 
-        for (int i = 0; i < numAudioOuts; ++i)
-            node->setOutputRMS (i, buffer.getRMSLevel (i, 0, numSamples));
-    }
+            for (int i = 0; i < midiSources.size(); ++i)
+                splitOutput.getUnchecked(i)->addEvents (*splitInput.getUnchecked (i), 0, length, start);
 
-    const GraphNodePtr node;
-    AudioProcessor* const processor;
+            start = end;
+        }
+
+        for (int i = 0; i < midiSources.size(); ++i)
+            sharedMidiBuffers.getUnchecked (midiSources.getUnchecked (i))->swapWith (*splitOutput.getUnchecked (i));
+    }
 
-private:
     Array <int> audioChannelsToUse;
     Array <int> midiChannelsToUse;
     HeapBlock <float*> channels;
@@ -414,6 +540,10 @@ private:
     bool lastMute = false;
     MidiTranspose transpose;
     MidiBuffer tempMidi;
+
+    ParameterArray parameters;
+    Array<int> midiSources, splitChannels;
+    OwnedArray<MidiBuffer> splitInput, splitOutput;
     JUCE_DECLARE_NON_COPYABLE (ProcessBufferOp)
 };
 
@@ -860,9 +990,60 @@ GraphProcessor::Connection::Connection (const uint32 sourceNode_, const uint32 s
        .setProperty (Tags::destPort, (int) destPort, nullptr);
 }
     
+/** The tasks a graph renders and the buffers they work on */
+struct GraphProcessor::RenderSequence
+{
+    ~RenderSequence()
+    {
+        for (int i = ops.size(); --i >= 0;)
+            delete static_cast<GraphRender::Task*> (ops.getUnchecked (i));
+    }
+
+    Array<void*> ops;
+    AudioSampleBuffer buffers { 1, 1 };
+    OwnedArray<MidiBuffer> midiBuffers;
+};
+
+/** Holds the sequence the audio thread renders. Commands keep a reference,
+    so one performed after its graph was deleted only swaps an orphan */
+struct GraphProcessor::SequenceSlot : public ReferenceCountedObject
+{
+    std::unique_ptr<RenderSequence> sequence;
+};
+
+struct GraphProcessor::SetSequenceCommand : public EngineCommand
+{
+    SetSequenceCommand (SequenceSlot* s, RenderSequence* newSequence)
+        : slot (s), sequence (newSequence) { }
+
+    void perform() override
+    {
+        // the old sequence goes back to the message thread with this command
+        std::swap (slot->sequence, sequence);
+    }
+
+    ReferenceCountedObjectPtr<SequenceSlot> slot;
+    std::unique_ptr<RenderSequence> sequence;
+};
+
+struct GraphProcessor::ResetCommand : public EngineCommand
+{
+    explicit ResetCommand (const ReferenceCountedArray<GraphNode>& n)
+        : nodes (n) { }
+
+    void perform() override
+    {
+        for (auto* const node : nodes)
+            if (auto* const proc = node->getAudioProcessor())
+                proc->reset();
+    }
+
+    ReferenceCountedArray<GraphNode> nodes;
+};
+
 GraphProcessor::GraphProcessor()
     : lastNodeId (0),
-      renderingBuffers (1, 1),
+      rendering (new SequenceSlot()),
       currentAudioInputBuffer (nullptr),
       currentAudioOutputBuffer (1, 1),
       currentMidiInputBuffer (nullptr)
@@ -874,7 +1055,6 @@ GraphProcessor::GraphProcessor()
 GraphProcessor::~GraphProcessor()
 {
     renderingSequenceChanged.disconnect_all_slots();
-    clearRenderingSequence();
     clear();
 }
 
@@ -885,6 +1065,7 @@ const String GraphProcessor::getName() const
 
 void GraphProcessor::clear()
 {
+    probes.clearQuick();
     nodes.clear();
     connections.clear();
     //triggerAsyncUpdate();
@@ -940,6 +1121,12 @@ GraphNode* GraphProcessor::addNode (AudioProcessor* const newProcessor, uint32 n
     if (auto* iop = dynamic_cast<AudioGraphIOProcessor*> (newProcessor))
         iop->setParentGraph (this);
     
+    if (auto* sub = dynamic_cast<GraphProcessor*> (newProcessor))
+    {
+        sub->setCommandQueue (commandQueue);
+        sub->setParameterEventGranularity (getParameterEventGranularity());
+    }
+
     if (GraphNode* node = createNode (nodeId, newProcessor))
     {
         node->setParentGraph (this);
@@ -993,6 +1180,12 @@ GraphNode* GraphProcessor::addNode (GraphNode* newNode, uint32 nodeId)
     // TODO: playhead in Graph Node base
     // newNode->setPlayHead (getPlayHead());
     
+    if (auto* sub = newNode->processor<GraphProcessor>())
+    {
+        sub->setCommandQueue (commandQueue);
+        sub->setParameterEventGranularity (getParameterEventGranularity());
+    }
+
     newNode->setParentGraph (this);
     newNode->resetPorts();
     newNode->prepare (getSampleRate(), getBlockSize(), this);
@@ -1009,6 +1202,10 @@ bool GraphProcessor::removeNode (const uint32 nodeId)
         GraphNodePtr n = nodes.getUnchecked (i);
         if (nodes.getUnchecked(i)->nodeId == nodeId)
         {
+            for (int j = probes.size(); --j >= 0;)
+                if (probes.getReference(j).nodeId == nodeId)
+                    probes.remove (j);
+
             nodes.remove (i);
          
             // triggerAsyncUpdate();
@@ -1201,56 +1398,140 @@ bool GraphProcessor::removeIllegalConnections()
     return doneAnything;
 }
 
-void GraphProcessor::setMidiChannel (const int channel) noexcept
+void GraphProcessor::setMidiChannel (const int channel)
 {
     jassert (isPositiveAndBelow (channel, 17));
+    kv::MidiChannels channels;
     if (channel <= 0)
-        midiChannels.setOmni (true);
+        channels.setOmni (true);
     else
-        midiChannels.setChannel (channel);
+        channels.setChannel (channel);
+    setMidiChannels (channels);
 }
 
-void GraphProcessor::setMidiChannels (const BigInteger channels) noexcept
+void GraphProcessor::setMidiChannels (const BigInteger channels)
 {
-    ScopedLock sl (getCallbackLock());
-    midiChannels.setChannels (channels);
+    kv::MidiChannels newChannels;
+    newChannels.setChannels (channels);
+    setMidiChannels (newChannels);
 }
 
-void GraphProcessor::setMidiChannels (const kv::MidiChannels channels) noexcept
+void GraphProcessor::setMidiChannels (const kv::MidiChannels channels)
 {
-    ScopedLock sl (getCallbackLock());
-    midiChannels = channels;
+    struct MidiChannelsCommand : public EngineCommand
+    {
+        MidiChannelsCommand (GraphProcessor& g, const kv::MidiChannels& c)
+            : graph (g), channels (c) { }
+        void perform() override { std::swap (graph.midiChannels, channels); }
+        GraphProcessor& graph;
+        kv::MidiChannels channels;
+    };
+
+    EngineCommandQueue::post (commandQueue, new MidiChannelsCommand (*this, channels));
 }
 
 bool GraphProcessor::acceptsMidiChannel (const int channel) const noexcept
 {
-    ScopedLock sl (getCallbackLock());
     return midiChannels.isOn (channel);
 }
 
-void GraphProcessor::setVelocityCurveMode (const VelocityCurve::Mode mode) noexcept
+void GraphProcessor::setVelocityCurveMode (const VelocityCurve::Mode mode)
 {
-    ScopedLock sl (getCallbackLock());
-    velocityCurve.setMode (mode);
+    struct VelocityCurveCommand : public EngineCommand
+    {
+        VelocityCurveCommand (GraphProcessor& g, VelocityCurve::Mode m)
+            : graph (g), mode (m) { }
+        void perform() override { graph.velocityCurve.setMode (mode); }
+        GraphProcessor& graph;
+        const VelocityCurve::Mode mode;
+    };
+
+    EngineCommandQueue::post (commandQueue, new VelocityCurveCommand (*this, mode));
 }
 
-static void deleteRenderOpArray (Array<void*>& ops)
+void GraphProcessor::setCommandQueue (EngineCommandQueue* queue)
 {
-    for (int i = ops.size(); --i >= 0;)
-        delete static_cast<GraphRender::Task*> (ops.getUnchecked (i));
-    ops.clearQuick();
+    commandQueue = queue;
+    for (auto* const node : nodes)
+        if (auto* const sub = node->processor<GraphProcessor>())
+            sub->setCommandQueue (commandQueue);
 }
 
-void GraphProcessor::clearRenderingSequence()
+void GraphProcessor::setParameterEventGranularity (int samples)
+{
+    parameterEventGranularity.set (jmax (0, samples));
+    for (auto* const node : nodes)
+        if (auto* const sub = node->processor<GraphProcessor>())
+            sub->setParameterEventGranularity (samples);
+}
+
+struct GraphProcessor::SetTapsCommand : public EngineCommand
+{
+    SetTapsCommand (GraphNode* n, SignalTaps* t)
+        : node (n), taps (t) { }
+
+    void perform() override
+    {
+        // the old taps go back to the message thread with this command
+        std::swap (node->taps, taps);
+    }
+
+    GraphNodePtr node;
+    std::unique_ptr<SignalTaps> taps;
+};
+
+bool GraphProcessor::attachProbe (uint32 nodeId, uint32 port, SignalProbe* probe)
+{
+    auto* const node = getNodeForId (nodeId);
+    if (node == nullptr || probe == nullptr || port >= node->getNumPorts())
+        return false;
+    if (! node->isPortOutput (port) || node->getPortType (port) != probe->getType())
+        return false;
+
+    detachProbe (probe);
+    probes.add ({ nodeId, port, probe });
+    updateTaps (node);
+    return true;
+}
+
+void GraphProcessor::detachProbe (SignalProbe* probe)
 {
-    Array<void*> oldOps;
+    for (int i = probes.size(); --i >= 0;)
+    {
+        const auto attachment = probes.getReference (i);
+        if (attachment.probe.get() != probe)
+            continue;
+
+        probes.remove (i);
+        if (auto* node = getNodeForId (attachment.nodeId))
+            updateTaps (node);
+    }
+}
 
+void GraphProcessor::updateTaps (GraphNode* node)
+{
+    std::unique_ptr<SignalTaps> taps (new SignalTaps());
+    taps->sampleRate = getSampleRate() > 0.0 ? getSampleRate() : 44100.0;
+
+    for (const auto& attachment : probes)
     {
-        const ScopedLock sl (getCallbackLock());
-        renderingOps.swapWith (oldOps);
+        if (attachment.nodeId != node->nodeId || attachment.port >= node->getNumPorts())
+            continue;
+        const auto type = node->getPortType (attachment.port);
+        if (! node->isPortOutput (attachment.port) || type != attachment.probe->getType())
+            continue;
+        taps->taps.add ({ type, node->getChannelPort (attachment.port), attachment.probe });
     }
 
-    deleteRenderOpArray (oldOps);
+    if (taps->taps.isEmpty())
+        taps.reset();
+
+    EngineCommandQueue::post (commandQueue, new SetTapsCommand (node, taps.release()));
+}
+
+void GraphProcessor::clearRenderingSequence()
+{
+    EngineCommandQueue::post (commandQueue, new SetSequenceCommand (rendering.get(), nullptr));
 }
 
 bool GraphProcessor::isAnInputTo (const uint32 possibleInputId,
@@ -1275,7 +1556,7 @@ bool GraphProcessor::isAnInputTo (const uint32 possibleInputId,
 
 void GraphProcessor::buildRenderingSequence()
 {
-    Array<void*> newRenderingOps;
+    std::unique_ptr<RenderSequence> newSequence (new RenderSequence());
     int numRenderingBuffersNeeded = 2;
     int numMidiBuffersNeeded = 1;
 
@@ -1302,30 +1583,30 @@ void GraphProcessor::buildRenderingSequence()
             }
         }
 
-        GraphRender::ProcessorGraphBuilder calculator (*this, orderedNodes, newRenderingOps);
+        GraphRender::ProcessorGraphBuilder calculator (*this, orderedNodes, newSequence->ops);
 
         numRenderingBuffersNeeded = calculator.buffersNeeded (PortType::Audio);
         numMidiBuffersNeeded      = calculator.buffersNeeded (PortType::Midi);
     }
 
-    {
-        // swap over to the new rendering sequence..
-        const ScopedLock sl (getCallbackLock());
-
-        renderingBuffers.setSize (numRenderingBuffersNeeded, 4096);
-        renderingBuffers.clear();
-
-        for (int i = midiBuffers.size(); --i >= 0;)
-            midiBuffers.getUnchecked(i)->clear();
+    newSequence->buffers.setSize (numRenderingBuffersNeeded, 4096);
+    newSequence->buffers.clear();
 
-        while (midiBuffers.size() < numMidiBuffersNeeded)
-            midiBuffers.add (new MidiBuffer());
+    // the buffers are new, so room for events is made here
+    while (newSequence->midiBuffers.size() < numMidiBuffersNeeded)
+        newSequence->midiBuffers.add (new MidiBuffer())->ensureSize (2048);
 
-        renderingOps.swapWith (newRenderingOps);
-    }
+    // swapped in at the start of a block, the old one is deleted here once
+    // the command comes back. A full queue tries again later
+    if (! EngineCommandQueue::post (commandQueue, new SetSequenceCommand (rendering.get(), newSequence.release())))
+        triggerAsyncUpdate();
 
-    // delete the old ones..
-    deleteRenderOpArray (newRenderingOps);
+    // ports might have moved, each probed node gets new taps once
+    Array<uint32> tapped;
+    for (const auto& attachment : probes)
+        if (tapped.addIfNotAlreadyThere (attachment.nodeId))
+            if (auto* node = getNodeForId (attachment.nodeId))
+                updateTaps (node);
 
     renderingSequenceChanged();
 }
@@ -1357,7 +1638,6 @@ void GraphProcessor::prepareToPlay (double sampleRate, int estimatedSamplesPerBl
     currentAudioOutputBuffer.setSize (jmax (1, getTotalNumOutputChannels()), estimatedSamplesPerBlock);
     currentMidiInputBuffer = nullptr;
     currentMidiOutputBuffer.clear();
-    clearRenderingSequence();
 
     if (getSampleRate() != sampleRate || getBlockSize() != estimatedSamplesPerBlock)
     {
@@ -1376,8 +1656,7 @@ void GraphProcessor::releaseResources()
     for (int i = 0; i < nodes.size(); ++i)
         nodes.getUnchecked(i)->unprepare();
 
-    renderingBuffers.setSize (1, 1);
-    midiBuffers.clear();
+    clearRenderingSequence();
 
     currentAudioInputBuffer = nullptr;
     currentAudioOutputBuffer.setSize (1, 1);
@@ -1387,10 +1666,7 @@ void GraphProcessor::releaseResources()
 
 void GraphProcessor::reset()
 {
-    const ScopedLock sl (getCallbackLock());
-    for (auto node : nodes)
-        if (auto* const proc = node->getAudioProcessor())
-            proc->reset();
+    EngineCommandQueue::post (commandQueue, new ResetCommand (nodes));
 }
 
 // MARK: Process Graph
@@ -1434,10 +1710,13 @@ void GraphProcessor::processBlock (AudioSampleBuffer& buffer, MidiBuffer& midiMe
     
     currentMidiOutputBuffer.clear();
 
-    for (int i = 0; i < renderingOps.size(); ++i)
+    if (auto* const sequence = rendering->sequence.get())
     {
-        GraphRender::Task* const op = static_cast<GraphRender::Task*> (renderingOps.getUnchecked (i));
-        op->perform (renderingBuffers, midiBuffers, numSamples);
+        for (int i = 0; i < sequence->ops.size(); ++i)
+        {
+            GraphRender::Task* const op = static_cast<GraphRender::Task*> (sequence->ops.getUnchecked (i));
+            op->perform (sequence->buffers, sequence->midiBuffers, numSamples);
+        }
     }
 
     for (int i = 0; i < buffer.getNumChannels(); ++i)
@@ -21,11 +21,14 @@
 
 #include "ElementApp.h"
 #include "engine/GraphNode.h"
+#include "engine/SignalProbe.h"
 #include "engine/VelocityCurve.h"
 #include "Signals.h"
 
 namespace Element {
 
+class EngineCommandQueue;
+
 /**
     A type of AudioProcessor which plays back a graph of other AudioProcessors.
 
@@ -172,20 +175,73 @@ public:
     */
     bool removeIllegalConnections();
 
-    /** Set the allowed MIDI channel of this Graph */
-    void setMidiChannel (const int channel) noexcept;
+    /** Set the allowed MIDI channel of this Graph. Like the other MIDI
+        settings below, it applies at the start of the next block */
+    void setMidiChannel (const int channel);
     
     /** Set the allowed MIDI channels of this Graph */
-    void setMidiChannels (const BigInteger channels) noexcept;
+    void setMidiChannels (const BigInteger channels);
 
     /** Set the allowed MIDI channels of this Graph */
-    void setMidiChannels (const kv::MidiChannels channels) noexcept;
+    void setMidiChannels (const kv::MidiChannels channels);
 
-    /** returns true if this graph is processing the given channel */
+    /** returns true if this graph is processing the given channel. Call
+        this from the audio thread */
     bool acceptsMidiChannel (const int channel) const noexcept;
 
     /** Set the MIDI curve of this graph */
-    void setVelocityCurveMode (const VelocityCurve::Mode) noexcept;
+    void setVelocityCurveMode (const VelocityCurve::Mode);
+
+    /** Set the queue used to send control changes to the audio thread. This
+        is also set on any nested graphs */
+    void setCommandQueue (EngineCommandQueue* queue);
+
+    /** Returns the command queue for this graph. Can be nullptr if the graph
+        isn't attached to an engine */
+    EngineCommandQueue* getCommandQueue() const noexcept            { return commandQueue; }
+
+    /** Set how finely blocks are split to apply parameter events. Event
+        positions are rounded down to a multiple of this many samples, 1 is
+        sample accurate and 0 applies all events at the start of the block.
+        This is also set on any nested graphs */
+    void setParameterEventGranularity (int samples);
+
+    /** Returns the parameter event granularity in samples */
+    int getParameterEventGranularity() const noexcept               { return parameterEventGranularity.get(); }
+
+    /** Sets the start time of the block about to be rendered, in
+        Time::getMillisecondCounterHiRes() units. Nested graphs are given
+        the same time by the render op that processes them */
+    void setBlockTime (double timeMs) noexcept                      { blockTimeMs.store (timeMs); }
+
+    /** Returns the start time of the block being rendered, or now if the
+        engine hasn't set one */
+    double getBlockTime() const noexcept
+    {
+        const double timeMs = blockTimeMs.load();
+        return timeMs > 0.0 ? timeMs : Time::getMillisecondCounterHiRes();
+    }
+
+    /** Attaches a probe to an audio or MIDI output port of a node. The probe
+        reads what every connection from that port carries. The rendering
+        sequence isn't rebuilt, the node's taps are swapped in on the audio
+        thread. Call this on the message thread.
+
+        @returns false if the port isn't an output of the probe's type
+     */
+    bool attachProbe (uint32 nodeId, uint32 port, SignalProbe* probe);
+
+    /** Attaches a probe to the source of a connection */
+    bool attachProbe (const Connection& connection, SignalProbe* probe)
+    {
+        return attachProbe (connection.sourceNode, connection.sourcePort, probe);
+    }
+
+    /** Detaches a probe. Call this on the message thread */
+    void detachProbe (SignalProbe* probe);
+
+    /** Returns the number of attached probes */
+    int getNumProbes() const noexcept                               { return probes.size(); }
 
     /** A special number that represents the midi channel of a node.
 
@@ -341,9 +397,14 @@ private:
     uint32 ioNodes [AudioGraphIOProcessor::numDeviceTypes];
     
     uint32 lastNodeId;
-    AudioSampleBuffer renderingBuffers;
-    OwnedArray <MidiBuffer> midiBuffers;
-    Array<void*> renderingOps;
+
+    // the rendering sequence is built on the message thread and swapped in
+    // by the audio thread through the command queue
+    struct RenderSequence;
+    struct SequenceSlot;
+    struct SetSequenceCommand;
+    struct ResetCommand;
+    ReferenceCountedObjectPtr<SequenceSlot> rendering;
 
     friend class AudioGraphIOProcessor;
     friend class GraphPort;
@@ -355,7 +416,20 @@ private:
     
     kv::MidiChannels midiChannels;
     VelocityCurve velocityCurve;
+    EngineCommandQueue* commandQueue = nullptr;
+    Atomic<int> parameterEventGranularity { 1 };
+    std::atomic<double> blockTimeMs { 0.0 };
     MidiBuffer filteredMidi;
+
+    struct ProbeAttachment
+    {
+        uint32 nodeId;
+        uint32 port;
+        SignalProbe::Ptr probe;
+    };
+    Array<ProbeAttachment> probes;
+    struct SetTapsCommand;
+    void updateTaps (GraphNode* node);
     
     void handleAsyncUpdate() override;
     void clearRenderingSequence();
@@ -25,6 +25,7 @@
 #include "engine/nodes/ChannelizeProcessor.h"
 #include "engine/nodes/CombFilterProcessor.h"
 #include "engine/nodes/CompressorProcessor.h"
+#include "engine/nodes/ConvolutionProcessor.h"
 #include "engine/nodes/EQFilterProcessor.h"
 #include "engine/nodes/FreqSplitterProcessor.h"
 #include "engine/nodes/LuaNode.h"
@@ -34,6 +35,8 @@
 #include "engine/nodes/MidiDeviceProcessor.h"
 #include "engine/nodes/MidiMonitorNode.h"
 #include "engine/nodes/MidiRouterNode.h"
+#include "engine/nodes/NetAudioReceiveNode.h"
+#include "engine/nodes/NetAudioSendNode.h"
 #include "engine/nodes/PlaceholderProcessor.h"
 #include "engine/nodes/OSCReceiverNode.h"
 #include "engine/nodes/OSCSenderNode.h"
@@ -237,6 +240,11 @@ void ElementAudioPluginFormat::findAllTypesForFile (OwnedArray <PluginDescriptio
         auto* desc = ds.add (new PluginDescription());
         ReverbProcessor().fillInPluginDescription (*desc);
     }
+    else if (fileOrId == EL_INTERNAL_ID_CONVOLUTION)
+    {
+        auto* desc = ds.add (new PluginDescription());
+        ConvolutionProcessor().fillInPluginDescription (*desc);
+    }
     else if (fileOrId == EL_INTERNAL_ID_EQ_FILTER)
     {
         auto* desc = ds.add (new PluginDescription());
@@ -357,6 +365,16 @@ void ElementAudioPluginFormat::findAllTypesForFile (OwnedArray <PluginDescriptio
         auto* const desc = ds.add (new PluginDescription());
         OSCSenderNode().fillInPluginDescription (*desc);
     }
+    else if (fileOrId == EL_INTERNAL_ID_NET_AUDIO_SEND)
+    {
+        auto* const desc = ds.add (new PluginDescription());
+        NetAudioSendNode().getPluginDescription (*desc);
+    }
+    else if (fileOrId == EL_INTERNAL_ID_NET_AUDIO_RECEIVE)
+    {
+        auto* const desc = ds.add (new PluginDescription());
+        NetAudioReceiveNode().getPluginDescription (*desc);
+    }
     else if (fileOrId == EL_INTERNAL_ID_LUA)
     {
        #if EL_USE_LUA
@@ -378,6 +396,7 @@ StringArray ElementAudioPluginFormat::searchPathsForPlugins (const FileSearchPat
     results.add ("element.volume");
     results.add (EL_INTERNAL_ID_WET_DRY);
     results.add (EL_INTERNAL_ID_REVERB);
+    results.add (EL_INTERNAL_ID_CONVOLUTION);
 
    #if defined EL_PRO
     results.add (EL_INTERNAL_ID_AUDIO_MIXER);
@@ -399,6 +418,8 @@ StringArray ElementAudioPluginFormat::searchPathsForPlugins (const FileSearchPat
     results.add (EL_INTERNAL_ID_MIDI_MONITOR);
     results.add (EL_INTERNAL_ID_OSC_RECEIVER);
     results.add (EL_INTERNAL_ID_OSC_SENDER);
+    results.add (EL_INTERNAL_ID_NET_AUDIO_SEND);
+    results.add (EL_INTERNAL_ID_NET_AUDIO_RECEIVE);
    #if EL_USE_LUA
     results.add (EL_INTERNAL_ID_LUA);
    #endif
@@ -428,6 +449,8 @@ AudioPluginInstance* ElementAudioPluginFormat::instantiatePlugin (const PluginDe
         base = new WetDryProcessor();
     else if (desc.fileOrIdentifier == EL_INTERNAL_ID_REVERB)
         base = new ReverbProcessor();
+    else if (desc.fileOrIdentifier == EL_INTERNAL_ID_CONVOLUTION)
+        base = new ConvolutionProcessor();
     else if (desc.fileOrIdentifier == EL_INTERNAL_ID_EQ_FILTER)
         base = new EQFilterProcessor();
     else if (desc.fileOrIdentifier == EL_INTERNAL_ID_FREQ_SPLITTER)
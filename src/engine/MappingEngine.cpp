@@ -17,6 +17,7 @@
     Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 */
 
+#include "engine/ControllerMapTable.h"
 #include "engine/GraphNode.h"
 #include "engine/MappingEngine.h"
 #include "engine/MidiEngine.h"
@@ -25,15 +26,12 @@
 
 namespace Element {
 
-class ControllerMapHandler
+/** Returns the time a MIDI input message was received, suitable for
+    posting parameter events. MidiInput stamps messages in seconds */
+static double getEventTimeMs (const MidiMessage& message)
 {
-public:
-    ControllerMapHandler() { }
-    virtual ~ControllerMapHandler() { }
-
-    virtual bool wants (const MidiMessage& message) const =0;
-    virtual void perform (const MidiMessage& message) =0;
-};
+    return message.getTimeStamp() > 0.0 ? message.getTimeStamp() * 1000.0 : 0.0;
+}
 
 struct MidiNoteControllerMap : public ControllerMapHandler,
                                public AsyncUpdater,
@@ -42,7 +40,8 @@ struct MidiNoteControllerMap : public ControllerMapHandler,
     MidiNoteControllerMap (const ControllerDevice::Control& ctl,
                            const MidiMessage& message, const Node& _node, 
                            const int _parameter)
-        : control (ctl),
+        : ControllerMapHandler (ControllerMapHandler::Note, message.getNoteNumber()),
+          control (ctl),
           model (_node), 
           node (_node.getGraphNode()),
           parameterIndex (_parameter),
@@ -74,7 +73,11 @@ struct MidiNoteControllerMap : public ControllerMapHandler,
     ~MidiNoteControllerMap()
     {
         channelObject.removeListener (this);
+        momentaryObject.removeListener (this);
+        inverseObject.removeListener (this);
     }
+
+    int getChannel() const override { return channel.get(); }
     
     bool checkNoteAndChannel (const MidiMessage& message) const
     {
@@ -93,11 +96,7 @@ struct MidiNoteControllerMap : public ControllerMapHandler,
     void perform (const MidiMessage& message) override
     {
         const bool isInverse = inverse.get() == 1;
-
-        {
-            SpinLock::ScopedLockType sl (eventLock);
-            lastEvent = message;
-        }
+        const bool isMomentary = momentary.get() == 1;
 
         jassert (message.isNoteOnOrOff());
        
@@ -106,26 +105,65 @@ struct MidiNoteControllerMap : public ControllerMapHandler,
             parameter->beginChangeGesture();
             if (momentary.get() == 0)
             {
-                parameter->setValueNotifyingHost (parameter->getValue() < 0.5 ? 1.f : 0.f);
+                const bool on = getToggleSource (parameter->getValue() >= 0.5f);
+                node->postParameterValue (parameterIndex, on ? 0.f : 1.f,
+                                          getEventTimeMs (message));
+                setToggleSource (parameter->getValue() >= 0.5f, ! on);
             }
             else
             {
                 const bool onOrOff = isInverse ? message.isNoteOff() : message.isNoteOn();
-                parameter->setValueNotifyingHost (onOrOff ? 1.f : 0.f);
+                node->postParameterValue (parameterIndex, onOrOff ? 1.f : 0.f,
+                                          getEventTimeMs (message));
             }
 
             parameter->endChangeGesture();
         }
-        else if (parameterIndex == GraphNode::EnabledParameter ||
-                 parameterIndex == GraphNode::BypassParameter ||
-                 parameterIndex == GraphNode::MuteParameter)
+        else if (parameterIndex == GraphNode::BypassParameter)
+        {
+            // applied on the audio thread at the next block, the model is
+            // synced afterwards on the message thread
+            const bool bypass = isMomentary ? (isInverse ? message.isNoteOn() : message.isNoteOff())
+                                            : ! getToggleSource (node->isSuspended());
+            node->suspendProcessing (bypass);
+            setToggleSource (node->isSuspended(), bypass);
+            toggleState.set (bypass ? 1 : 0);
+            triggerAsyncUpdate();
+        }
+        else if (parameterIndex == GraphNode::MuteParameter)
+        {
+            const bool muted = isMomentary ? (isInverse ? message.isNoteOff() : message.isNoteOn())
+                                           : ! getToggleSource (node->isMuted());
+            node->setMuted (muted);
+            setToggleSource (node->isMuted(), muted);
+            toggleState.set (muted ? 1 : 0);
+            triggerAsyncUpdate();
+        }
+        else if (parameterIndex == GraphNode::EnabledParameter)
         {
+            // enabling prepares the node, so it has to happen on the message thread
+            {
+                SpinLock::ScopedLockType sl (eventLock);
+                lastEvent = message;
+            }
+
             triggerAsyncUpdate();
         }
     }
 
     void handleAsyncUpdate() override
     {
+        if (parameterIndex == GraphNode::BypassParameter)
+        {
+            model.setProperty (Tags::bypass, toggleState.get() == 1);
+            return;
+        }
+        else if (parameterIndex == GraphNode::MuteParameter)
+        {
+            model.setProperty (Tags::mute, toggleState.get() == 1);
+            return;
+        }
+
         MidiMessage event;
 
         {
@@ -140,15 +178,6 @@ struct MidiNoteControllerMap : public ControllerMapHandler,
                 node->setEnabled (! node->isEnabled());
                 model.setProperty (Tags::enabled, node->isEnabled());
             }
-            else if (parameterIndex == GraphNode::BypassParameter)
-            {
-                node->suspendProcessing (! node->isSuspended());
-                model.setProperty (Tags::bypass, node->isSuspended());
-            }
-            else if (parameterIndex == GraphNode::MuteParameter)
-            {
-                model.setMuted (! model.isMuted());
-            }
         }
         else
         {
@@ -161,15 +190,6 @@ struct MidiNoteControllerMap : public ControllerMapHandler,
                 node->setEnabled (isInverse ? event.isNoteOff() : event.isNoteOn());
                 model.setProperty (Tags::enabled, node->isEnabled());
             }
-            else if (parameterIndex == GraphNode::BypassParameter)
-            {
-                node->suspendProcessing (isInverse ? event.isNoteOn() : event.isNoteOff());
-                model.setProperty (Tags::bypass, node->isSuspended());
-            }
-            else if (parameterIndex == GraphNode::MuteParameter)
-            {
-                model.setMuted (isInverse ? event.isNoteOff() : event.isNoteOn());
-            }
         }
     }
 
@@ -189,8 +209,26 @@ private:
     Value inverseObject;
     Atomic<int> inverse { 0 };
 
+    Atomic<int> toggleState { 0 };
     const int noteNumber;
 
+    // the state last posted by perform() and the applied state it was posted
+    // against. A post reaches the audio thread at the next block, so toggles
+    // in the meantime flip the posted state rather than the stale one
+    int postedState = -1;
+    bool postedOver = false;
+
+    bool getToggleSource (bool applied) const noexcept
+    {
+        return (postedState >= 0 && applied == postedOver) ? postedState == 1 : applied;
+    }
+
+    void setToggleSource (bool applied, bool posted) noexcept
+    {
+        postedOver = applied;
+        postedState = posted ? 1 : 0;
+    }
+
     SpinLock eventLock;
     MidiMessage lastEvent;
 
@@ -198,7 +236,13 @@ private:
     {
         if (channelObject.refersToSameSourceAs (value))
         {
-            channel.set (jlimit (0, 16, (int) channelObject.getValue()));
+            const int newChannel = jlimit (0, 16, (int) channelObject.getValue());
+            if (newChannel != channel.get())
+            {
+                channel.set (newChannel);
+                if (channelChanged)
+                    channelChanged();
+            }
         }
         else if (momentaryObject.refersToSameSourceAs (value))
         {
@@ -219,7 +263,8 @@ struct MidiCCControllerMapHandler : public ControllerMapHandler,
                                 const MidiMessage& message,
                                 const Node& _node,
                                 const int _parameter)
-        : control (ctl), model (_node), node (_node.getGraphNode()),
+        : ControllerMapHandler (ControllerMapHandler::Controller, message.getControllerNumber()),
+          control (ctl), model (_node), node (_node.getGraphNode()),
           parameter (nullptr),
           controllerNumber (message.getControllerNumber()),
           parameterIndex (_parameter)
@@ -262,6 +307,8 @@ struct MidiCCControllerMapHandler : public ControllerMapHandler,
         channelObject.removeListener (this);
     }
 
+    int getChannel() const override { return channel.get(); }
+
     bool wants (const MidiMessage& message) const override
     {
         return message.isController() && 
@@ -276,7 +323,8 @@ struct MidiCCControllerMapHandler : public ControllerMapHandler,
         if (nullptr != parameter)
         {
             parameter->beginChangeGesture();
-            parameter->setValueNotifyingHost (static_cast<float> (ccValue) / 127.f);
+            node->postParameterValue (parameterIndex, static_cast<float> (ccValue) / 127.f,
+                                      getEventTimeMs (message));
             parameter->endChangeGesture();
         }
         else if (parameterIndex == GraphNode::EnabledParameter ||
@@ -336,7 +384,15 @@ struct MidiCCControllerMapHandler : public ControllerMapHandler,
             }
 
             if (currentToggleState != desiredToggleState.get())
+            {
+                // bypass and mute are applied on the audio thread at the next
+                // block, enabling prepares the node so it waits for the message thread
+                if (parameterIndex == GraphNode::BypassParameter)
+                    node->suspendProcessing (! isToggledOn()); // inverted because UI displays bypass as inactive
+                else if (parameterIndex == GraphNode::MuteParameter)
+                    node->setMuted (isToggledOn());
                 triggerAsyncUpdate();
+            }
         }
 
         lastControllerValue = ccValue;
@@ -344,27 +400,20 @@ struct MidiCCControllerMapHandler : public ControllerMapHandler,
 
     void handleAsyncUpdate() override
     {
-        const auto mode = toggleMode.get();
-        const int stateToCompare = mode != ControllerDevice::Equals 
-            ? (inverseToggle.get() == 1 ? 0 : 1) // inverse on, then compare false
-            : 1;                                 // equals mode always compare true
-
         if (parameterIndex == GraphNode::EnabledParameter)
         {
-            node->setEnabled (desiredToggleState.get() == stateToCompare);
+            node->setEnabled (isToggledOn());
             if (model.isEnabled() != node->isEnabled())
                 model.setProperty (Tags::enabled, node->isEnabled());
         }
         else if (parameterIndex == GraphNode::BypassParameter)
         {
-            // inverted because UI displays bypass as inactive (or active for not bypassed)
-            node->suspendProcessing (! (desiredToggleState.get() == stateToCompare));
-            if (model.isBypassed() != node->isSuspended())
-                model.setProperty (Tags::bypass, node->isSuspended());
+            if (model.isBypassed() != ! isToggledOn())
+                model.setProperty (Tags::bypass, ! isToggledOn());
         }
         else if (parameterIndex == GraphNode::MuteParameter)
         {
-            model.setMuted (desiredToggleState.get() == stateToCompare);
+            model.setProperty (Tags::mute, isToggledOn());
         }
     }
 
@@ -392,6 +441,14 @@ private:
 
     Atomic<int> desiredToggleState { 1 };
 
+    bool isToggledOn() const
+    {
+        const int stateToCompare = toggleMode.get() != ControllerDevice::Equals
+            ? (inverseToggle.get() == 1 ? 0 : 1) // inverse on, then compare false
+            : 1;                                 // equals mode always compare true
+        return desiredToggleState.get() == stateToCompare;
+    }
+
     void valueChanged (Value& value) override
     {
         if (toggleValueObject.refersToSameSourceAs (value))
@@ -409,7 +466,13 @@ private:
         }
         else if (channelObject.refersToSameSourceAs (value))
         {
-            channel.set (jlimit (0, 16, (int) channelObject.getValue()));
+            const int newChannel = jlimit (0, 16, (int) channelObject.getValue());
+            if (newChannel != channel.get())
+            {
+                channel.set (newChannel);
+                if (channelChanged)
+                    channelChanged();
+            }
         }
     }
 };
@@ -441,9 +504,15 @@ public:
         else if (message.isController())
             mapping.captureNextEvent (*this, controls[message.getControllerNumber()], message);
 
-        for (auto* handler : handlers)
-            if (handler->wants (message))
-                handler->perform (message);
+        ControllerMapTable::Ptr current;
+
+        {
+            SpinLock::ScopedLockType sl (tableLock);
+            current = table;
+        }
+
+        if (current != nullptr)
+            current->dispatch (message);
     }
 
     bool close()
@@ -501,9 +570,9 @@ public:
 
     void addHandler (ControllerMapHandler* handler)
     {
-        stop();
+        handler->channelChanged = [this]() { rebuildTable(); };
         handlers.add (handler);
-        start();
+        rebuildTable();
     }
 
 private:
@@ -514,6 +583,22 @@ private:
     OwnedArray<ControllerMapHandler> handlers;
     BigInteger controllerNumbers, noteNumbers;
     HashMap<int, ControllerDevice::Control> controls, notes;
+
+    SpinLock tableLock;
+    ControllerMapTable::Ptr table;
+
+    void rebuildTable()
+    {
+        Array<ControllerMapHandler*> toIndex;
+        toIndex.addArray (handlers);
+        ControllerMapTable::Ptr newTable = new ControllerMapTable (toIndex);
+
+        {
+            SpinLock::ScopedLockType sl (tableLock);
+            std::swap (table, newTable);
+        }
+    }
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ControllerMapInput)
 };
 
@@ -0,0 +1,77 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+namespace Element {
+
+/** Maps audio blocks onto the Time::getMillisecondCounterHiRes() clock.
+
+    Each block starts one block length after the last, nudged slightly toward
+    the time of its device callback. Wake-up jitter is filtered out while
+    drift between the audio and system clocks is still followed. The clock
+    resets if a callback is far from where it was expected.
+ */
+class MidiBlockClock
+{
+public:
+    MidiBlockClock() = default;
+
+    void reset() noexcept
+    {
+        blockTimeMs = nextBlockTimeMs = blockLengthMs = 0.0;
+    }
+
+    /** Move to the next block. Call once per block from the audio thread
+
+        @param callbackTimeMs   Time::getMillisecondCounterHiRes() at the device callback
+        @param numSamples       Size of the block
+        @param sampleRate       Current sample rate
+     */
+    void advance (double callbackTimeMs, int numSamples, double sampleRate) noexcept
+    {
+        if (numSamples <= 0 || sampleRate <= 0.0)
+            return;
+
+        blockLengthMs = 1000.0 * numSamples / sampleRate;
+        const double errorMs = callbackTimeMs - nextBlockTimeMs;
+
+        if (nextBlockTimeMs <= 0.0 || std::abs (errorMs) > jmax (maxErrorMs, blockLengthMs))
+            blockTimeMs = callbackTimeMs;   // first block, or the device stalled
+        else
+            blockTimeMs = nextBlockTimeMs + errorMs * smoothing;
+
+        nextBlockTimeMs = blockTimeMs + blockLengthMs;
+    }
+
+    /** Returns the time the current block starts, in milliseconds */
+    double getBlockTime() const noexcept    { return blockTimeMs; }
+
+    /** Returns the length of the current block, in milliseconds */
+    double getBlockLength() const noexcept  { return blockLengthMs; }
+
+private:
+    static constexpr double smoothing = 0.05;
+    static constexpr double maxErrorMs = 5.0;
+    double blockTimeMs = 0.0, nextBlockTimeMs = 0.0, blockLengthMs = 0.0;
+};
+
+}
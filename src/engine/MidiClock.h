@@ -59,6 +59,12 @@ private:
     Array<Listener*> listeners;
 };
 
+/** Generates MIDI clock messages at the current tempo.
+
+    Clock phase is kept in double precision from the sample where tempo or
+    sample rate last changed. Each tick lands on the sample nearest its exact
+    time, so rounding never accumulates into drift against the transport.
+ */
 class MidiClockMaster
 {
 public:
@@ -70,16 +76,22 @@ public:
 
     ~MidiClockMaster() noexcept { }
 
+    /** Restart so the next tick is at the next rendered sample */
     inline void reset()
     {
-        pos = 0;
+        pos = anchorPos = 0;
+        anchorClocks = 0.0;
         updateCoefficients();
     }
 
+    /** Change tempo from the next rendered sample. To change it mid-block,
+        render up to the change, set the tempo, then render the rest.
+     */
     inline void setTempo (const double newTempo) noexcept
     {
         if (tempo == newTempo)
             return;
+        reanchor();
         tempo = newTempo;
         updateCoefficients();
     }
@@ -88,21 +100,39 @@ public:
     {
         if (sampleRate == newSampleRate)
             return;
+        reanchor();
         sampleRate = newSampleRate;
         updateCoefficients();
     }
 
+    /** Returns the exact number of samples between ticks */
+    inline double getSamplesPerClock() const noexcept { return clocksPerSample > 0.0 ? 1.0 / clocksPerSample : 0.0; }
+
     inline void render (MidiBuffer& midi, int numSamples) noexcept
     {
-        if (samplesPerClock <= 0)
+        render (midi, 0, numSamples);
+    }
+
+    /** Render ticks for part of a block
+
+        @param midi         Buffer to add clock messages to
+        @param startFrame   Offset in the buffer of the first sample rendered
+        @param numSamples   Number of samples to render
+     */
+    inline void render (MidiBuffer& midi, int startFrame, int numSamples) noexcept
+    {
+        if (clocksPerSample <= 0.0 || numSamples <= 0)
             return;
 
-        int frame = static_cast<int> (pos % samplesPerClock);
-        if (frame > 0) frame = samplesPerClock - frame;
-        while (frame < numSamples)
+        // first tick whose nearest sample is at or after pos
+        const double clocksAtStart = anchorClocks + (static_cast<double> (pos - anchorPos) - 0.5) * clocksPerSample;
+        for (double tick = std::ceil (clocksAtStart);; tick += 1.0)
         {
-            midi.addEvent (clockMessage, frame);
-            frame += samplesPerClock;
+            const double exact = static_cast<double> (anchorPos) + (tick - anchorClocks) / clocksPerSample;
+            const int64 frame = static_cast<int64> (std::floor (exact + 0.5)) - pos;
+            if (frame >= numSamples)
+                break;
+            midi.addEvent (clockMessage, startFrame + static_cast<int> (frame));
         }
 
         pos += numSamples;
@@ -110,16 +140,26 @@ public:
 
 private:
     MidiMessage clockMessage;
-    int64 pos = 0;
+    int64 pos = 0, anchorPos = 0;
+    double anchorClocks = 0.0;
     double tempo = 120.0;
     double sampleRate = 44100.0;
-    int samplesPerClock = 0;
-    double clocksPerMinute = 1.0;
+    double clocksPerSample = 0.0;
+
+    /** Move the phase reference to the current position, keeping only the
+        fractional clock so precision doesn't shrink over long runs
+     */
+    void reanchor() noexcept
+    {
+        const double clocks = anchorClocks + static_cast<double> (pos - anchorPos) * clocksPerSample;
+        anchorClocks = clocks - std::floor (clocks);
+        anchorPos = pos;
+    }
 
     void updateCoefficients()
     {
-        clocksPerMinute = 24.f * tempo;
-        samplesPerClock = roundToIntAccurate ((60.0 * sampleRate) / clocksPerMinute);
+        const double clocksPerMinute = 24.0 * tempo;
+        clocksPerSample = sampleRate > 0.0 ? clocksPerMinute / (60.0 * sampleRate) : 0.0;
     }
 };
 
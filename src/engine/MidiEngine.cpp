@@ -58,7 +58,7 @@ void MidiEngine::writeSettings (Settings& settings)
     {
         ValueTree input ("input");
         input.setProperty (Tags::name, holder->input->getName(), nullptr)
-             .setProperty (Tags::active, holder->active, nullptr);
+             .setProperty (Tags::active, holder->active.load(), nullptr);
         data.appendChild (input, nullptr);
     }
 
@@ -135,22 +135,22 @@ void MidiEngine::MidiInputHolder::handleIncomingMidiMessage (MidiInput* source,
         return;
 
     jassert (source == input.get());
-    const ScopedLock sl (engine.midiCallbackLock);
-
-    for (auto& mc : engine.midiCallbacks)
-        if ((active || mc.consumer) && (mc.deviceName.isEmpty() || mc.deviceName == input->getName()))
-            mc.callback->handleIncomingMidiMessage (input.get(), message);
+    dispatcher.dispatch (source, message, active.load());
 }
 
 //==============================================================================
 MidiEngine::MidiEngine()
 {
+    inputListReaders[0].store (0);
+    inputListReaders[1].store (0);
+    inputList.store (new InputList());
     callbackHandler.reset (new CallbackHandler (*this));
 }
 
 MidiEngine::~MidiEngine()
 {
     callbackHandler.reset (nullptr);
+    delete inputList.exchange (nullptr);
 }
 
 //==============================================================================
@@ -166,13 +166,17 @@ MidiEngine::MidiInputHolder* MidiEngine::getMidiInput (const String& deviceName,
     auto index = MidiInput::getDevices().indexOf (deviceName);
     if (index >= 0)
     {
+        midiInputIds.addIfNotAlreadyThere (deviceName);
         std::unique_ptr<MidiInputHolder> holder;
-        holder.reset (new MidiInputHolder (*this));
+        holder.reset (new MidiInputHolder (getMidiInputId (deviceName)));
         if (auto midiIn = MidiInput::openDevice (index, holder.get()))
         {
             holder->input.reset (midiIn.release());
+            updateDispatcher (*holder);
             holder->input->start();
-            return openMidiInputs.add (holder.release());
+            auto* const opened = openMidiInputs.add (holder.release());
+            publishInputs();
+            return opened;
         }
     }
 
@@ -225,49 +229,157 @@ void MidiEngine::addMidiInputCallback (const String& name, MidiInputCallback* ca
         mc.callback = callbackToAdd;
         mc.consumer = consumer;
 
-        const ScopedLock sl (midiCallbackLock);
-        midiCallbacks.add (mc);
+        {
+            const ScopedLock sl (midiCallbackLock);
+            midiCallbacks.add (mc);
+            updateDispatchers();
+        }
+
+        synchroniseDispatchers();
     }
 }
 
 void MidiEngine::removeMidiInputCallback (const String& name, MidiInputCallback* callbackToRemove)
 {
-    for (int i = midiCallbacks.size(); --i >= 0;)
+    bool changed = false;
+
     {
-        auto& mc = midiCallbacks.getReference (i);
+        const ScopedLock sl (midiCallbackLock);
 
-        if (mc.callback == callbackToRemove && mc.deviceName == name)
+        for (int i = midiCallbacks.size(); --i >= 0;)
         {
-            const ScopedLock sl (midiCallbackLock);
-            midiCallbacks.remove (i);
+            auto& mc = midiCallbacks.getReference (i);
+
+            if (mc.callback == callbackToRemove && mc.deviceName == name)
+            {
+                midiCallbacks.remove (i);
+                changed = true;
+            }
         }
+
+        if (changed)
+            updateDispatchers();
     }
+
+    if (changed)
+        synchroniseDispatchers();
 }
 
 void MidiEngine::removeMidiInputCallback (MidiInputCallback* callbackToRemove)
 {
-    for (int i = midiCallbacks.size(); --i >= 0;)
+    bool changed = false;
+
     {
-        auto& mc = midiCallbacks.getReference (i);
+        const ScopedLock sl (midiCallbackLock);
 
-        if (mc.callback == callbackToRemove)
+        for (int i = midiCallbacks.size(); --i >= 0;)
         {
-            const ScopedLock sl (midiCallbackLock);
-            midiCallbacks.remove (i);
+            auto& mc = midiCallbacks.getReference (i);
+
+            if (mc.callback == callbackToRemove)
+            {
+                midiCallbacks.remove (i);
+                changed = true;
+            }
         }
+
+        if (changed)
+            updateDispatchers();
     }
+
+    if (changed)
+        synchroniseDispatchers();
 }
 
-void MidiEngine::handleIncomingMidiMessageInt (MidiInput* source, const MidiMessage& message)
+int MidiEngine::getMidiInputId (const String& name) const
 {
-    if (! message.isActiveSense())
-    {
-        const ScopedLock sl (midiCallbackLock);
+    return midiInputIds.indexOf (name) + 1;
+}
+
+void MidiEngine::updateDispatcher (MidiInputHolder& holder)
+{
+    const ScopedLock sl (midiCallbackLock);
+    const auto deviceName = holder.input != nullptr ? holder.input->getName() : String();
+
+    // resolve device names here so the midi thread only walks its own callbacks
+    Array<MidiInputDispatcher::Entry> entries;
+    for (const auto& mc : midiCallbacks)
+        if (mc.deviceName.isEmpty() || mc.deviceName == deviceName)
+            entries.add ({ mc.callback, mc.consumer });
+
+    holder.dispatcher.setCallbacks (entries);
+}
 
-        for (auto& mc : midiCallbacks)
-            if (mc.consumer || mc.deviceName.isEmpty() || mc.deviceName == source->getName())
-                mc.callback->handleIncomingMidiMessage (source, message);
+void MidiEngine::updateDispatchers()
+{
+    const ScopedLock sl (midiCallbackLock);
+
+    for (auto* const holder : openMidiInputs)
+        updateDispatcher (*holder);
+
+    Array<MidiInputDispatcher::Entry> entries;
+    for (const auto& mc : midiCallbacks)
+        entries.add ({ mc.callback, mc.consumer });
+    allInputs.setCallbacks (entries);
+}
+
+void MidiEngine::synchroniseDispatchers()
+{
+    // outside midiCallbackLock: a callback still running may be waiting on it
+    for (auto* const holder : openMidiInputs)
+        holder->dispatcher.synchronise();
+    allInputs.synchronise();
+
+    // lists retired before the flip can't be picked up by lookups in the new
+    // epoch. Lookups don't call out, so waiting for them can't deadlock
+    const int previous = inputListEpoch.load();
+    inputListEpoch.store (1 - previous);
+    while (inputListReaders[previous].load() > 0)
+        Thread::yield();
+    retiredInputLists.clear();
+}
+
+void MidiEngine::publishInputs()
+{
+    auto* const list = new InputList (openMidiInputs.begin(), openMidiInputs.size());
+    retiredInputLists.add (inputList.exchange (list));
+}
+
+MidiEngine::MidiInputHolder* MidiEngine::findOpenInput (MidiInput* source) const noexcept
+{
+    // count this lookup in the current epoch, trying again if it flipped
+    // before the count was visible to synchroniseDispatchers()
+    int current = inputListEpoch.load();
+    for (;;)
+    {
+        inputListReaders[current].fetch_add (1);
+        const int now = inputListEpoch.load();
+        if (now == current)
+            break;
+        inputListReaders[current].fetch_sub (1);
+        current = now;
     }
+
+    // holders live as long as the engine, only the list can be replaced
+    MidiInputHolder* found = nullptr;
+    if (auto* const list = inputList.load())
+        for (auto* const holder : *list)
+            if (holder->input.get() == source)
+                { found = holder; break; }
+
+    inputListReaders[current].fetch_sub (1);
+    return found;
+}
+
+void MidiEngine::handleIncomingMidiMessageInt (MidiInput* source, const MidiMessage& message)
+{
+    if (message.isActiveSense())
+        return;
+
+    if (auto* const holder = findOpenInput (source))
+        holder->dispatcher.dispatch (source, message, true);
+    else
+        allInputs.dispatch (source, message, true);
 }
 
 void MidiEngine::processMidiBuffer (const MidiBuffer& buffer, int nframes, double sampleRate)
@@ -275,17 +387,15 @@ void MidiEngine::processMidiBuffer (const MidiBuffer& buffer, int nframes, doubl
     MidiBuffer::Iterator iter (buffer);
     MidiMessage message; int frame = 0;
     const double timeNow = 1.5 + Time::getMillisecondCounterHiRes();
-    
-    const ScopedLock sl (midiCallbackLock);
 
     while (iter.getNextEvent (message, frame))
     {
         if (frame >= nframes)
             break;
         
-        message.setTimeStamp (timeNow + (1000.0 * (static_cast<double> (frame) / sampleRate)));
-        for (auto& mc : midiCallbacks)
-            mc.callback->handleIncomingMidiMessage (nullptr, message);
+        // seconds, the same as messages from a MidiInput
+        message.setTimeStamp (0.001 * (timeNow + (1000.0 * (static_cast<double> (frame) / sampleRate))));
+        allInputs.dispatch (nullptr, message, true);
     }
 }
 
@@ -310,17 +420,19 @@ void MidiEngine::setDefaultMidiOutput (const String& deviceName)
 
         if (newMidiOut)
         {
-            newMidiOut->startBackgroundThread();
+            std::unique_ptr<MidiOutputScheduler> newScheduler;
+            newScheduler.reset (new MidiOutputScheduler (newMidiOut.get()));
+            newScheduler->start();
+
             {
                 ScopedLock sl (midiOutputLock);
                 defaultMidiOutput.swap (newMidiOut);
+                defaultMidiOutputScheduler.swap (newScheduler);
             }
 
-            if (newMidiOut) // is now the old output
-            {
-                newMidiOut->stopBackgroundThread();
-                newMidiOut.reset();
-            }
+            // these are now the old output and its scheduler
+            newScheduler.reset();
+            newMidiOut.reset();
         }
 
         defaultMidiOutputName = deviceName;
@@ -18,6 +18,8 @@
 */
 
 #include "JuceHeader.h"
+#include "engine/MidiInputDispatcher.h"
+#include "engine/MidiOutputScheduler.h"
 
 #pragma once
 
@@ -87,6 +89,11 @@ public:
 
     /** Returns the number of enabled midi inputs */
     int getNumActiveMidiInputs() const;
+
+    /** Returns the ID given to a midi input device, or 0 if it has never been opened.
+        IDs stay the same for a device while the engine exists, even if it is reopened.
+     */
+    int getMidiInputId (const String& midiInputDeviceName) const;
     
     //==============================================================================
     /** Sets a midi output device to use as the default.
@@ -114,8 +121,28 @@ public:
     */
     MidiOutput* getDefaultMidiOutput() const noexcept               { return defaultMidiOutput.get(); }
 
+    /** Returns the scheduler which sends to the default midi output, or nullptr
+        if there isn't one. Lock getMidiOutputLock() while using it.
+     */
+    MidiOutputScheduler* getDefaultMidiOutputScheduler() const noexcept { return defaultMidiOutputScheduler.get(); }
+
     void processMidiBuffer (const MidiBuffer& buffer, int nframes, double sampleRate);
 
+    /** Sets the start time of the block the engine is rendering. Called on
+        the audio thread at the start of every device callback */
+    void setBlockTime (double callbackTimeMs) noexcept              { blockTimeMs.store (callbackTimeMs); }
+
+    /** Returns the start time of the block being rendered, in
+        Time::getMillisecondCounterHiRes() units. Nodes stamping MIDI use this
+        so all of a block's events share one time base. Falls back to the
+        current time if the engine hasn't rendered yet.
+     */
+    double getBlockTime() const noexcept
+    {
+        const double timeMs = blockTimeMs.load();
+        return timeMs > 0.0 ? timeMs : Time::getMillisecondCounterHiRes();
+    }
+
     CriticalSection& getMidiOutputLock() { return midiOutputLock; }
 
 private:
@@ -134,31 +161,54 @@ private:
 
     struct MidiInputHolder : public MidiInputCallback
     {
-        MidiInputHolder (MidiEngine& e)
-            : engine (e) { }
+        MidiInputHolder (int inputId)
+            : dispatcher (inputId) { }
+
+        ~MidiInputHolder()
+        {
+            // stop the device before the dispatcher goes away
+            input.reset();
+        }
 
         std::unique_ptr<MidiInput> input;
-        bool active = false;  // if true, then will feed to audio engine
+        std::atomic<bool> active { false };  // if true, then will feed to audio engine
+        MidiInputDispatcher dispatcher;
 
         void handleIncomingMidiMessage (MidiInput* source, const MidiMessage& message) override;
-
-    private:
-        MidiEngine& engine;
     };
 
     StringArray midiInsFromXml;
+    StringArray midiInputIds;
     OwnedArray<MidiInputHolder> openMidiInputs;
+
+    // what the MIDI thread searches for an input's holder. A new list is
+    // published when an input opens, retired lists are freed by
+    // synchroniseDispatchers() once no lookup can still be using them
+    using InputList = Array<MidiInputHolder*>;
+    std::atomic<InputList*> inputList { nullptr };
+    mutable std::atomic<int> inputListReaders[2];
+    std::atomic<int> inputListEpoch { 0 };
+    OwnedArray<InputList> retiredInputLists;
+
     Array<MidiCallbackInfo> midiCallbacks;
+    MidiInputDispatcher allInputs { 0 };
 
     String defaultMidiOutputName;
     std::unique_ptr<MidiOutput> defaultMidiOutput;
+    std::unique_ptr<MidiOutputScheduler> defaultMidiOutputScheduler;
     CriticalSection audioCallbackLock, midiCallbackLock, midiOutputLock;
+    std::atomic<double> blockTimeMs { 0.0 };
 
     class CallbackHandler;
     std::unique_ptr<CallbackHandler> callbackHandler;
 
     MidiInputHolder* getMidiInput (const String& deviceName, bool openIfNotAlready);
+    MidiInputHolder* findOpenInput (MidiInput*) const noexcept;
+    void publishInputs();
     void handleIncomingMidiMessageInt (MidiInput*, const MidiMessage&);
+    void updateDispatchers();
+    void updateDispatcher (MidiInputHolder&);
+    void synchroniseDispatchers();
 };
 
 }
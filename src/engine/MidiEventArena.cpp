@@ -0,0 +1,140 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "engine/MidiEventArena.h"
+
+namespace Element {
+
+MidiEventArena::MidiEventArena (int events_, int bytes_)
+    : maxEvents (jmax (1, events_)), maxBytes (jmax (3, bytes_))
+{
+    events.calloc ((size_t) maxEvents);
+    bytes.calloc ((size_t) maxBytes);
+}
+
+MidiEventArena::~MidiEventArena() { }
+
+int MidiEventArena::add (const uint8* data, int size, int frame) noexcept
+{
+    if (size <= 0 || numEvents >= maxEvents || numBytes + size > maxBytes)
+        return -1;
+
+    memcpy (bytes + numBytes, data, (size_t) size);
+    events[numEvents] = { frame, numBytes, size };
+    numBytes += size;
+    return numEvents++;
+}
+
+//=============================================================================
+MidiEventView::MidiEventView (int capacity_)
+    : capacity (jmax (1, capacity_))
+{
+    indices.calloc ((size_t) capacity);
+    scratch.calloc ((size_t) capacity);
+}
+
+MidiEventView::~MidiEventView() { }
+
+bool MidiEventView::add (int index) noexcept
+{
+    if (index < 0 || numIndices >= capacity)
+        return false;
+    indices[numIndices++] = index;
+    return true;
+}
+
+int MidiEventView::addFromBuffer (MidiEventArena& arena, const MidiBuffer& buffer, int numSamples) noexcept
+{
+    MidiBuffer::Iterator iter (buffer);
+    const uint8* data = nullptr;
+    int size = 0, frame = 0, numAdded = 0;
+
+    while (iter.getNextEvent (data, size, frame))
+    {
+        if (frame >= numSamples)
+            break;
+        if (! add (arena.add (data, size, frame)))
+            break;
+        ++numAdded;
+    }
+
+    return numAdded;
+}
+
+void MidiEventView::merge (const MidiEventArena& arena, const MidiEventView& other) noexcept
+{
+    if (other.isEmpty())
+        return;
+
+    if (isEmpty() || arena.getFrame (indices[numIndices - 1]) <= arena.getFrame (other.indices[0]))
+    {
+        // the common case, nothing to interleave
+        const int count = jmin (other.numIndices, capacity - numIndices);
+        memcpy (indices + numIndices, other.indices, sizeof (int) * (size_t) count);
+        numIndices += count;
+        return;
+    }
+
+    int a = 0, b = 0, n = 0;
+    while (n < capacity && (a < numIndices || b < other.numIndices))
+    {
+        const bool takeOther = a >= numIndices ||
+            (b < other.numIndices && arena.getFrame (other.indices[b]) < arena.getFrame (indices[a]));
+        scratch[n++] = takeOther ? other.indices[b++] : indices[a++];
+    }
+
+    indices.swapWith (scratch);
+    numIndices = n;
+}
+
+bool MidiEventView::replace (MidiEventArena& arena, int position, const uint8* data, int size) noexcept
+{
+    jassert (isPositiveAndBelow (position, numIndices));
+    const int index = arena.add (data, size, arena.getFrame (indices[position]));
+    if (index < 0)
+        return false;
+    indices[position] = index;
+    return true;
+}
+
+void MidiEventView::writeTo (const MidiEventArena& arena, MidiBuffer& buffer) const
+{
+    buffer.clear();
+
+    // events are already in time order, so they are appended directly in
+    // MidiBuffer's layout rather than searching for each insert position
+    int totalSize = 0;
+    for (int i = 0; i < numIndices; ++i)
+        totalSize += (int) (sizeof (int32) + sizeof (uint16)) + arena.getSize (indices[i]);
+
+    buffer.data.resize (totalSize);
+    uint8* dest = buffer.data.begin();
+
+    for (int i = 0; i < numIndices; ++i)
+    {
+        const int index = indices[i];
+        const auto size = (uint16) arena.getSize (index);
+        const auto frame = (int32) arena.getFrame (index);
+        memcpy (dest, &frame, sizeof (int32));            dest += sizeof (int32);
+        memcpy (dest, &size, sizeof (uint16));            dest += sizeof (uint16);
+        memcpy (dest, arena.getData (index), size);       dest += size;
+    }
+}
+
+}
@@ -0,0 +1,152 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "ElementApp.h"
+
+namespace Element {
+
+/** Storage for one block of MIDI.
+
+    The bytes of each event are written once and events are referred to by
+    index, so routing and splitting only move indices around. Memory is
+    preallocated and clear() keeps it, so nothing allocates while rendering.
+    Events which don't fit are dropped.
+ */
+class MidiEventArena
+{
+public:
+    /** Create an arena
+
+        @param maxEvents    Maximum number of events per block
+        @param maxBytes     Maximum number of event bytes per block
+     */
+    explicit MidiEventArena (int maxEvents = 4096, int maxBytes = 32 * 1024);
+    ~MidiEventArena();
+
+    /** Discards all events. Call at the start of each block */
+    void clear() noexcept               { numEvents = numBytes = 0; }
+
+    /** Adds an event. Returns its index or -1 if the arena is full */
+    int add (const uint8* data, int size, int frame) noexcept;
+
+    /** Returns the number of events */
+    int getNumEvents() const noexcept   { return numEvents; }
+
+    /** Returns the bytes of an event */
+    const uint8* getData (int index) const noexcept
+    {
+        jassert (isPositiveAndBelow (index, numEvents));
+        return bytes + events[index].offset;
+    }
+
+    /** Returns the size of an event in bytes */
+    int getSize (int index) const noexcept
+    {
+        jassert (isPositiveAndBelow (index, numEvents));
+        return events[index].size;
+    }
+
+    /** Returns the sample offset of an event in the block */
+    int getFrame (int index) const noexcept
+    {
+        jassert (isPositiveAndBelow (index, numEvents));
+        return events[index].frame;
+    }
+
+private:
+    struct Event
+    {
+        int frame;
+        int offset;
+        int size;
+    };
+
+    HeapBlock<Event> events;
+    HeapBlock<uint8> bytes;
+    const int maxEvents, maxBytes;
+    int numEvents = 0, numBytes = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MidiEventArena)
+};
+
+/** A time ordered list of events in a MidiEventArena.
+
+    Views hold indices, not bytes. Routing one source to many destinations
+    copies indices, and a node which changes an event writes a new one to
+    the arena so other views keep seeing the original.
+ */
+class MidiEventView
+{
+public:
+    explicit MidiEventView (int capacity = 1024);
+    ~MidiEventView();
+
+    /** Removes all events from the view, the arena is unchanged */
+    void clear() noexcept                   { numIndices = 0; }
+
+    /** Returns the number of events in the view */
+    int size() const noexcept               { return numIndices; }
+
+    /** Returns true if the view has no events */
+    bool isEmpty() const noexcept           { return numIndices <= 0; }
+
+    /** Returns the arena index of an event */
+    int operator[] (int position) const noexcept
+    {
+        jassert (isPositiveAndBelow (position, numIndices));
+        return indices[position];
+    }
+
+    /** Appends an arena event. Events must be added in time order.
+        Returns false if the view is full */
+    bool add (int index) noexcept;
+
+    /** Writes the events of a buffer before numSamples to the arena and
+        appends them to this view.
+
+        @returns the number of events added
+     */
+    int addFromBuffer (MidiEventArena& arena, const MidiBuffer& buffer, int numSamples) noexcept;
+
+    /** Merges another view into this one, keeping time order. Events which
+        share a frame keep this view's first */
+    void merge (const MidiEventArena& arena, const MidiEventView& other) noexcept;
+
+    /** Copy on write: replaces the event at a position with new bytes in the
+        arena. Only this view sees the change.
+
+        @returns false if the arena is full, the original is kept
+     */
+    bool replace (MidiEventArena& arena, int position, const uint8* data, int size) noexcept;
+
+    /** Replaces the contents of a buffer with the events in this view.
+        This is the only place bytes are copied out of the arena. */
+    void writeTo (const MidiEventArena& arena, MidiBuffer& buffer) const;
+
+private:
+    HeapBlock<int> indices, scratch;
+    const int capacity;
+    int numIndices = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MidiEventView)
+};
+
+}
@@ -0,0 +1,95 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "engine/MidiEventFifo.h"
+
+namespace Element {
+
+MidiEventFifo::MidiEventFifo (int capacity, int dataCapacity)
+    : headerFifo (capacity), dataFifo (dataCapacity)
+{
+    headers.calloc ((size_t) capacity);
+    data.calloc ((size_t) dataCapacity);
+}
+
+MidiEventFifo::~MidiEventFifo() { }
+
+bool MidiEventFifo::push (double timeMs, const uint8* bytes, int size) noexcept
+{
+    if (size <= 0 || headerFifo.getFreeSpace() < 1 || dataFifo.getFreeSpace() < size)
+        return false;
+
+    int start1, size1, start2, size2;
+    dataFifo.prepareToWrite (size, start1, size1, start2, size2);
+    memcpy (data + start1, bytes, (size_t) size1);
+    if (size2 > 0)
+        memcpy (data + start2, bytes + size1, (size_t) size2);
+    dataFifo.finishedWrite (size1 + size2);
+
+    // the header is published last, so its data is always there to read
+    headerFifo.prepareToWrite (1, start1, size1, start2, size2);
+    headers[start1] = { timeMs, size };
+    headerFifo.finishedWrite (1);
+    return true;
+}
+
+bool MidiEventFifo::getNextTime (double& timeMs) const noexcept
+{
+    int start1, size1, start2, size2;
+    headerFifo.prepareToRead (1, start1, size1, start2, size2);
+    if (size1 <= 0)
+        return false;
+    timeMs = headers[start1].timeMs;
+    return true;
+}
+
+int MidiEventFifo::pop (uint8* dest, int maxSize) noexcept
+{
+    int start1, size1, start2, size2;
+    headerFifo.prepareToRead (1, start1, size1, start2, size2);
+    if (size1 <= 0)
+        return 0;
+
+    const int size = headers[start1].size;
+    dataFifo.prepareToRead (size, start1, size1, start2, size2);
+    if (size <= maxSize)
+    {
+        memcpy (dest, data + start1, (size_t) size1);
+        if (size2 > 0)
+            memcpy (dest + size1, data + start2, (size_t) size2);
+    }
+
+    dataFifo.finishedRead (size1 + size2);
+    headerFifo.finishedRead (1);
+    return size <= maxSize ? size : 0;
+}
+
+void MidiEventFifo::clear() noexcept
+{
+    // discard one at a time so a running producer stays consistent
+    for (int i = headerFifo.getNumReady(); --i >= 0;)
+    {
+        int start1, size1, start2, size2;
+        headerFifo.prepareToRead (1, start1, size1, start2, size2);
+        dataFifo.finishedRead (headers[start1].size);
+        headerFifo.finishedRead (1);
+    }
+}
+
+}
@@ -0,0 +1,79 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "ElementApp.h"
+
+namespace Element {
+
+/** A wait-free single producer, single consumer queue of timestamped MIDI.
+
+    Message bytes and headers are stored in preallocated rings, so pushing
+    and popping never lock or allocate. One thread may push and one other
+    thread may read.
+ */
+class MidiEventFifo
+{
+public:
+    /** Create a fifo
+
+        @param capacity         Maximum number of queued messages
+        @param dataCapacity     Maximum number of queued message bytes
+     */
+    MidiEventFifo (int capacity, int dataCapacity);
+    ~MidiEventFifo();
+
+    /** Add a message. Returns false if there wasn't room */
+    bool push (double timeMs, const uint8* data, int size) noexcept;
+
+    /** Gets the time of the next message. Returns false if there isn't one */
+    bool getNextTime (double& timeMs) const noexcept;
+
+    /** Removes the next message, copying it to dest.
+
+        @returns the size of the message, or 0 if there wasn't one. If the
+                 message is bigger than maxSize it is discarded and 0 is returned
+     */
+    int pop (uint8* dest, int maxSize) noexcept;
+
+    /** Discards all messages. Call from the reading thread */
+    void clear() noexcept;
+
+    /** Returns the number of messages waiting */
+    int getNumReady() const noexcept        { return headerFifo.getNumReady(); }
+
+    /** Returns the largest message which can be queued */
+    int getDataCapacity() const noexcept    { return dataFifo.getTotalSize() - 1; }
+
+private:
+    struct Header
+    {
+        double timeMs;
+        int size;
+    };
+
+    AbstractFifo headerFifo, dataFifo;
+    HeapBlock<Header> headers;
+    HeapBlock<uint8> data;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MidiEventFifo)
+};
+
+}
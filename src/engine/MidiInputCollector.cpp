@@ -0,0 +1,241 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "engine/MidiInputCollector.h"
+
+namespace Element {
+
+/** Timestamps further than this from now are treated as now */
+static const double maxTimestampErrorMs = 1000.0;
+
+MidiInputCollector::Schedule::Schedule (int c, int dc)
+    : capacity (c), dataCapacity (dc)
+{
+    events.calloc ((size_t) capacity);
+    data.calloc ((size_t) dataCapacity);
+    spare.calloc ((size_t) dataCapacity);
+}
+
+bool MidiInputCollector::Schedule::insert (double timeMs, const uint8* bytes, int numBytes) noexcept
+{
+    if (numEvents >= capacity || dataUsed + numBytes > dataCapacity)
+        return false;
+
+    // after any events at the same time, so they keep their order
+    int index = numEvents;
+    while (index > 0 && events[index - 1].timeMs > timeMs)
+        --index;
+
+    if (index < numEvents)
+        memmove (events + index + 1, events + index, sizeof (Event) * (size_t) (numEvents - index));
+
+    memcpy (data + dataUsed, bytes, (size_t) numBytes);
+    events[index] = { timeMs, dataUsed, numBytes };
+    dataUsed += numBytes;
+    ++numEvents;
+    return true;
+}
+
+const uint8* MidiInputCollector::Schedule::getEvent (int index, double& timeMs, int& numBytes) const noexcept
+{
+    if (! isPositiveAndBelow (index, numEvents))
+        return nullptr;
+    timeMs   = events[index].timeMs;
+    numBytes = events[index].size;
+    return data + events[index].offset;
+}
+
+void MidiInputCollector::Schedule::removeFirst (int count) noexcept
+{
+    count = jmin (count, numEvents);
+    if (count <= 0)
+        return;
+
+    // pack the bytes of the events left so the space can be reused
+    numEvents -= count;
+    dataUsed = 0;
+    for (int i = 0; i < numEvents; ++i)
+    {
+        auto& event = events[i];
+        event = events[i + count];
+        memcpy (spare + dataUsed, data + event.offset, (size_t) event.size);
+        event.offset = dataUsed;
+        dataUsed += event.size;
+    }
+
+    data.swapWith (spare);
+}
+
+//==============================================================================
+MidiInputCollector::MidiInputCollector (int maxThreads, int capacity)
+    : sharedLane (capacity),
+      scheduledLane (capacity),
+      schedule (capacity, capacity * 16)
+{
+    for (int i = 0; i < maxThreads; ++i)
+        lanes.add (new Lane (capacity));
+    scratchSize = lanes.getFirst()->fifo.getDataCapacity();
+    scratch.calloc ((size_t) scratchSize);
+}
+
+MidiInputCollector::~MidiInputCollector() { }
+
+void MidiInputCollector::reset (double newSampleRate)
+{
+    if (newSampleRate > 0.0)
+        sampleRate = newSampleRate;
+    clock.reset();
+    for (auto* const lane : lanes)
+        lane->fifo.clear();
+    sharedLane.fifo.clear();
+    scheduledLane.fifo.clear();
+    schedule.clear();
+}
+
+MidiEventFifo* MidiInputCollector::getLaneForThisThread() noexcept
+{
+    const auto thread = Thread::getCurrentThreadId();
+
+    for (auto* const lane : lanes)
+        if (lane->owner.load() == thread)
+            return &lane->fifo;
+
+    // lanes are never released, threads adding midi are few and long lived.
+    // Any beyond the number of lanes share the locked lane
+    for (auto* const lane : lanes)
+    {
+        Thread::ThreadID expected = nullptr;
+        if (lane->owner.compare_exchange_strong (expected, thread))
+            return &lane->fifo;
+    }
+
+    return nullptr;
+}
+
+void MidiInputCollector::addMessageToQueue (const MidiMessage& message)
+{
+    const double nowMs = Time::getMillisecondCounterHiRes();
+    double timeMs = message.getTimeStamp() * 1000.0;
+    if (timeMs <= 0.0 || std::abs (timeMs - nowMs) > maxTimestampErrorMs)
+        timeMs = nowMs;
+
+    if (auto* const fifo = getLaneForThisThread())
+    {
+        if (! fifo->push (timeMs, message.getRawData(), message.getRawDataSize()))
+            ++numDropped;
+        return;
+    }
+
+    const SpinLock::ScopedLockType sl (sharedLock);
+    if (! sharedLane.fifo.push (timeMs, message.getRawData(), message.getRawDataSize()))
+        ++numDropped;
+}
+
+bool MidiInputCollector::addScheduledMessage (const MidiMessage& message)
+{
+    const SpinLock::ScopedLockType sl (scheduledLock);
+    if (scheduledLane.fifo.push (message.getTimeStamp() * 1000.0,
+                                 message.getRawData(), message.getRawDataSize()))
+        return true;
+
+    ++numDropped;
+    return false;
+}
+
+void MidiInputCollector::removeNextBlockOfMessages (MidiBuffer& buffer, int numSamples, double callbackTimeMs)
+{
+    if (numSamples <= 0)
+        return;
+
+    clock.advance (callbackTimeMs, numSamples, sampleRate);
+
+    // messages which arrived during the last block play in this one
+    const double windowEndMs = clock.getBlockTime();
+    const double windowStartMs = windowEndMs - clock.getBlockLength();
+    const double latency = latencyMs.load();
+    const double samplesPerMs = sampleRate * 0.001;
+
+    auto removeFrom = [&] (MidiEventFifo& fifo)
+    {
+        double timeMs = 0.0;
+        while (fifo.getNextTime (timeMs) && timeMs + latency < windowEndMs)
+        {
+            const int frame = jlimit (0, numSamples - 1,
+                roundToInt ((timeMs + latency - windowStartMs) * samplesPerMs));
+            const int size = fifo.pop (scratch, scratchSize);
+            if (size > 0)
+                buffer.addEvent (scratch, size, frame);
+        }
+    };
+
+    for (auto* const lane : lanes)
+    {
+        if (lane->owner.load() == nullptr)
+            break;
+        removeFrom (lane->fifo);
+    }
+
+    removeFrom (sharedLane.fifo);
+
+    // scheduled messages are sorted as they come off their queue, so one
+    // far in the future doesn't keep earlier ones from playing
+    double timeMs = 0.0;
+    while (scheduledLane.fifo.getNextTime (timeMs))
+    {
+        const int size = scheduledLane.fifo.pop (scratch, scratchSize);
+        if (size > 0 && ! schedule.insert (timeMs, scratch, size))
+            ++numDropped;
+    }
+
+    // time tags are already exact, so they don't get the jitter latency
+    int numDue = 0, size = 0;
+    while (auto* const data = schedule.getEvent (numDue, timeMs, size))
+    {
+        if (timeMs >= windowEndMs)
+            break;
+        const int frame = jlimit (0, numSamples - 1,
+            roundToInt ((timeMs - windowStartMs) * samplesPerMs));
+        buffer.addEvent (data, size, frame);
+        ++numDue;
+    }
+
+    schedule.removeFirst (numDue);
+}
+
+//==============================================================================
+void MidiInputCollector::handleIncomingMidiMessage (MidiInput*, const MidiMessage& message)
+{
+    addMessageToQueue (message);
+}
+
+void MidiInputCollector::handleNoteOn (MidiKeyboardState*, int midiChannel, int midiNoteNumber, float velocity)
+{
+    MidiMessage message (MidiMessage::noteOn (midiChannel, midiNoteNumber, velocity));
+    message.setTimeStamp (Time::getMillisecondCounterHiRes() * 0.001);
+    addMessageToQueue (message);
+}
+
+void MidiInputCollector::handleNoteOff (MidiKeyboardState*, int midiChannel, int midiNoteNumber, float velocity)
+{
+    MidiMessage message (MidiMessage::noteOff (midiChannel, midiNoteNumber, velocity));
+    message.setTimeStamp (Time::getMillisecondCounterHiRes() * 0.001);
+    addMessageToQueue (message);
+}
+
+}
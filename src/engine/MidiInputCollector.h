@@ -0,0 +1,145 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "ElementApp.h"
+#include "engine/MidiBlockClock.h"
+#include "engine/MidiEventFifo.h"
+
+namespace Element {
+
+/** Collects incoming MIDI for the audio thread without locking.
+
+    Each thread which adds messages gets its own wait-free queue the first
+    time it adds one, so neither side ever locks. Once every queue is taken,
+    further threads share one more queue behind a spin lock, which the audio
+    thread still reads without locking. Messages keep the
+    timestamp given by the driver. Messages scheduled for a later time, like
+    those in a time tagged OSC bundle, wait in a separate time ordered queue
+    so they never hold back messages which arrive after them. When a block is removed, messages which
+    arrived during the previous block are placed at the matching sample
+    offset on the device callback's time base. An optional latency delays
+    every message by a fixed amount so jitter in arrival times doesn't
+    change their relative timing.
+ */
+class MidiInputCollector : public MidiInputCallback,
+                           public MidiKeyboardStateListener
+{
+public:
+    /** Create a collector
+
+        @param maxThreads   Number of threads which get their own queue
+        @param capacity     Maximum number of messages queued per thread
+     */
+    explicit MidiInputCollector (int maxThreads = 4, int capacity = 512);
+    ~MidiInputCollector();
+
+    /** Discard pending messages and restart the clock. Don't call this while
+        the audio thread is removing messages.
+     */
+    void reset (double sampleRate);
+
+    /** Set the jitter absorption latency in milliseconds */
+    void setLatency (double ms) noexcept        { latencyMs.store (jmax (0.0, ms)); }
+
+    /** Returns the jitter absorption latency in milliseconds */
+    double getLatency() const noexcept          { return latencyMs.load(); }
+
+    /** Add a message from any thread. The timestamp is in seconds on the
+        Time::getMillisecondCounterHiRes() clock, as given by MidiInput.
+        A timestamp of zero, or one too far from now, is replaced with now.
+     */
+    void addMessageToQueue (const MidiMessage& message);
+
+    /** Add a message from any thread which should play at its timestamp,
+        however far ahead that is. The timestamp is in seconds on the
+        Time::getMillisecondCounterHiRes() clock. Messages already due play
+        in the next block. Returns false if the schedule was full, in which
+        case the message is counted as dropped.
+     */
+    bool addScheduledMessage (const MidiMessage& message);
+
+    /** Adds the messages due in the next block to a buffer. Call from the
+        audio thread once per block.
+
+        @param buffer           Buffer to add messages to
+        @param numSamples       Size of the block
+        @param callbackTimeMs   Time::getMillisecondCounterHiRes() at the device callback
+     */
+    void removeNextBlockOfMessages (MidiBuffer& buffer, int numSamples, double callbackTimeMs);
+
+    /** Returns the number of scheduled messages waiting to play. Call from
+        the audio thread
+     */
+    int getNumScheduled() const noexcept        { return schedule.size(); }
+
+    /** Returns the number of messages dropped because a queue was full */
+    int getNumDropped() const noexcept          { return numDropped.load(); }
+
+    /** @internal */
+    void handleIncomingMidiMessage (MidiInput*, const MidiMessage&) override;
+    /** @internal */
+    void handleNoteOn (MidiKeyboardState*, int midiChannel, int midiNoteNumber, float velocity) override;
+    /** @internal */
+    void handleNoteOff (MidiKeyboardState*, int midiChannel, int midiNoteNumber, float velocity) override;
+
+private:
+    struct Lane
+    {
+        Lane (int capacity) : fifo (capacity, capacity * 16) { }
+        std::atomic<Thread::ThreadID> owner { nullptr };
+        MidiEventFifo fifo;
+    };
+
+    /** Scheduled messages in time order, owned by the audio thread */
+    class Schedule
+    {
+    public:
+        Schedule (int capacity, int dataCapacity);
+        int size() const noexcept { return numEvents; }
+        void clear() noexcept { numEvents = 0; dataUsed = 0; }
+        bool insert (double timeMs, const uint8* bytes, int numBytes) noexcept;
+        const uint8* getEvent (int index, double& timeMs, int& numBytes) const noexcept;
+        void removeFirst (int count) noexcept;
+    private:
+        struct Event { double timeMs; int offset, size; };
+        HeapBlock<Event> events;
+        HeapBlock<uint8> data, spare;
+        int capacity, dataCapacity;
+        int numEvents = 0, dataUsed = 0;
+    };
+
+    OwnedArray<Lane> lanes;
+    Lane sharedLane, scheduledLane;
+    SpinLock sharedLock, scheduledLock;
+    Schedule schedule;
+    HeapBlock<uint8> scratch;
+    int scratchSize = 0;
+    double sampleRate = 44100.0;
+    MidiBlockClock clock;
+    std::atomic<double> latencyMs { 0.0 };
+    std::atomic<int> numDropped { 0 };
+
+    MidiEventFifo* getLaneForThisThread() noexcept;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MidiInputCollector)
+};
+
+}
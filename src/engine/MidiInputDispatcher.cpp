@@ -0,0 +1,115 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "engine/MidiInputDispatcher.h"
+
+namespace Element {
+
+// number of dispatches in progress on this thread, for any dispatcher
+static thread_local int dispatchDepth = 0;
+
+MidiInputDispatcher::MidiInputDispatcher (int inputId)
+    : id (inputId)
+{
+    numReaders[0].store (0);
+    numReaders[1].store (0);
+    callbacks.store (new Array<Entry>());
+}
+
+MidiInputDispatcher::~MidiInputDispatcher()
+{
+    jassert (numReaders[0].load() == 0 && numReaders[1].load() == 0);
+    delete callbacks.exchange (nullptr);
+    for (auto* const entries : retired)
+        delete entries;
+}
+
+bool MidiInputDispatcher::isDispatching() noexcept
+{
+    return dispatchDepth > 0;
+}
+
+void MidiInputDispatcher::setCallbacks (const Array<Entry>& newCallbacks)
+{
+    auto* const old = callbacks.exchange (new Array<Entry> (newCallbacks));
+    const SpinLock::ScopedLockType sl (retiredLock);
+    retired.add (old);
+}
+
+void MidiInputDispatcher::synchronise()
+{
+    if (isDispatching())
+        return;
+
+    const ScopedLock sl (syncLock);
+
+    // arrays retired before the flip can't be picked up by dispatches in the
+    // new epoch, they were swapped out before it started
+    Array<Array<Entry>*> toFree;
+    {
+        const SpinLock::ScopedLockType rl (retiredLock);
+        toFree.swapWith (retired);
+    }
+
+    const int previous = epoch.load();
+    epoch.store (1 - previous);
+
+    while (numReaders[previous].load() > 0)
+        Thread::yield();
+
+    for (auto* const entries : toFree)
+        delete entries;
+}
+
+int MidiInputDispatcher::dispatch (MidiInput* source, const MidiMessage& message, bool active) const noexcept
+{
+    // count this dispatch in the current epoch, trying again if it flipped
+    // before the count was visible to synchronise()
+    int current = epoch.load();
+    for (;;)
+    {
+        numReaders[current].fetch_add (1);
+        const int now = epoch.load();
+        if (now == current)
+            break;
+        numReaders[current].fetch_sub (1);
+        current = now;
+    }
+
+    ++dispatchDepth;
+    int numCalled = 0;
+
+    if (auto* const entries = callbacks.load())
+    {
+        for (const auto& entry : *entries)
+        {
+            if (active || entry.consumer)
+            {
+                entry.callback->handleIncomingMidiMessage (source, message);
+                ++numCalled;
+            }
+        }
+    }
+
+    --dispatchDepth;
+    numReaders[current].fetch_sub (1);
+    return numCalled;
+}
+
+}
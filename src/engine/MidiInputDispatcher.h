@@ -0,0 +1,95 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "ElementApp.h"
+
+namespace Element {
+
+/** Fans out messages from one MIDI input to its callbacks.
+
+    The callbacks are held in a copy-on-write array. Dispatching only reads
+    the current array, so it never locks or allocates. Replacing the array
+    doesn't wait: the old one is retired and freed by synchronise(), which
+    waits for dispatches that started before it to finish.
+ */
+class MidiInputDispatcher
+{
+public:
+    struct Entry
+    {
+        MidiInputCallback* callback = nullptr;
+
+        /** If true, receives messages even when the input isn't active */
+        bool consumer = false;
+    };
+
+    explicit MidiInputDispatcher (int inputId);
+    ~MidiInputDispatcher();
+
+    /** Returns the ID of the input this dispatches for */
+    int getId() const noexcept { return id; }
+
+    /** Replace the callbacks. This doesn't block, so dispatches already in
+        progress may still call the previous callbacks until synchronise()
+        has returned. Safe to call from one of the callbacks.
+     */
+    void setCallbacks (const Array<Entry>& newCallbacks);
+
+    /** Waits for dispatches which might still be using replaced callbacks,
+        then frees the retired arrays. Only dispatches that started before
+        the call are waited for, so busy inputs can't hold it up.
+
+        Returns straight away if this thread is inside a dispatch, in which
+        case the old callbacks may still be called. Don't hold a lock the
+        callbacks can take while calling this.
+     */
+    void synchronise();
+
+    /** Returns true if the calling thread is inside a callback of any dispatcher */
+    static bool isDispatching() noexcept;
+
+    /** Sends a message to the callbacks. Safe to call from any thread.
+
+        @param source   The input passed to the callbacks
+        @param message  The message
+        @param active   If false, only consumers receive the message
+
+        @returns the number of callbacks called
+     */
+    int dispatch (MidiInput* source, const MidiMessage& message, bool active) const noexcept;
+
+private:
+    const int id;
+    std::atomic<Array<Entry>*> callbacks { nullptr };
+
+    // readers count themselves in the current epoch. synchronise() flips the
+    // epoch and waits only for the previous one to drain
+    mutable std::atomic<int> numReaders[2];
+    std::atomic<int> epoch { 0 };
+
+    SpinLock retiredLock;
+    Array<Array<Entry>*> retired;
+    CriticalSection syncLock;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MidiInputDispatcher)
+};
+
+}
@@ -0,0 +1,169 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "engine/MidiOutputScheduler.h"
+
+namespace Element {
+
+/** The send thread spins instead of sleeping this close to a message */
+static const double spinThresholdMs = 1.5;
+
+MidiOutputScheduler::MidiOutputScheduler (MidiOutput* o, int capacity)
+    : Thread ("MidiOutputScheduler"),
+      output (o),
+      fifo (capacity, jmax (capacity * 16, 64 * 1024))
+{
+    scratch.calloc ((size_t) fifo.getDataCapacity());
+}
+
+MidiOutputScheduler::~MidiOutputScheduler()
+{
+    // fine for this class, but a subclass overriding deliver() must have
+    // stopped the thread in its own destructor
+    stop();
+}
+
+void MidiOutputScheduler::start()
+{
+    if (! isThreadRunning())
+        startThread (9);
+}
+
+void MidiOutputScheduler::stop()
+{
+    stopThread (1000);
+    fifo.clear();
+}
+
+//==============================================================================
+void MidiOutputScheduler::send (const MidiBuffer& buffer, int numSamples, double sampleRate, double callbackTimeMs) noexcept
+{
+    if (numSamples <= 0 || sampleRate <= 0.0)
+        return;
+
+    clock.advance (callbackTimeMs, numSamples, sampleRate);
+    if (buffer.isEmpty())
+        return;
+
+    const double startMs = clock.getBlockTime() + latencyMs.load();
+    MidiBuffer::Iterator iter (buffer);
+    const uint8* bytes = nullptr;
+    int size = 0, frame = 0;
+
+    while (iter.getNextEvent (bytes, size, frame))
+    {
+        if (frame >= numSamples)
+            break;
+
+        const double timeMs = jmax (lastTimeMs, startMs + 1000.0 * frame / sampleRate);
+        if (fifo.push (timeMs, bytes, size))
+            lastTimeMs = timeMs;
+        else
+            numDropped.fetch_add (1);
+    }
+}
+
+//==============================================================================
+MidiOutputScheduler::Stats MidiOutputScheduler::getStats() const noexcept
+{
+    Stats stats;
+    stats.numSent       = numSent.load();
+    stats.numLate       = numLate.load();
+    stats.numDropped    = numDropped.load();
+    stats.maxJitterMs   = maxJitterMs.load();
+    stats.meanJitterMs  = stats.numSent > 0 ? totalJitterMs.load() / (double) stats.numSent : 0.0;
+    return stats;
+}
+
+void MidiOutputScheduler::resetStats() noexcept
+{
+    numSent.store (0);
+    numLate.store (0);
+    numDropped.store (0);
+    totalJitterMs.store (0.0);
+    maxJitterMs.store (0.0);
+}
+
+void MidiOutputScheduler::updateStats (double jitterMs)
+{
+    numSent.fetch_add (1);
+    if (jitterMs > 1.0)
+        numLate.fetch_add (1);
+    totalJitterMs.store (totalJitterMs.load() + jitterMs);
+    if (jitterMs > maxJitterMs.load())
+        maxJitterMs.store (jitterMs);
+}
+
+//==============================================================================
+void MidiOutputScheduler::deliver (const MidiMessage& message)
+{
+    if (output != nullptr)
+        output->sendMessageNow (message);
+}
+
+double MidiOutputScheduler::getCurrentTime() const
+{
+    return Time::getMillisecondCounterHiRes();
+}
+
+int MidiOutputScheduler::sendDue (double nowMs)
+{
+    int numDelivered = 0;
+    double timeMs = 0.0;
+
+    while (fifo.getNextTime (timeMs) && timeMs <= nowMs)
+    {
+        const int size = fifo.pop (scratch, fifo.getDataCapacity());
+        if (size <= 0)
+            break;
+
+        deliver (MidiMessage (scratch.getData(), size, timeMs));
+        updateStats (std::abs (getCurrentTime() - timeMs));
+        ++numDelivered;
+    }
+
+    return numDelivered;
+}
+
+void MidiOutputScheduler::run()
+{
+    while (! threadShouldExit())
+    {
+        double timeMs = 0.0;
+        if (! fifo.getNextTime (timeMs))
+        {
+            wait (1);
+            continue;
+        }
+
+        const double remainingMs = timeMs - getCurrentTime();
+        if (remainingMs > spinThresholdMs)
+        {
+            wait (jmax (1, (int) (remainingMs - spinThresholdMs)));
+            continue;
+        }
+
+        while (getCurrentTime() < timeMs && ! threadShouldExit())
+            Thread::yield();
+
+        sendDue (getCurrentTime());
+    }
+}
+
+}
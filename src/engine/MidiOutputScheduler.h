@@ -0,0 +1,131 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "ElementApp.h"
+#include "engine/MidiBlockClock.h"
+#include "engine/MidiEventFifo.h"
+
+namespace Element {
+
+/** Sends MIDI from the audio thread to one output device at sample accurate times.
+
+    The audio thread calls send() once per block with the time of the device
+    callback. Block start times are tracked on a smoothed monotonic clock, so
+    callback wake-up jitter doesn't reach the output. Each message is stamped
+    with its block start plus its sample offset plus the latency budget, then
+    pushed to a preallocated lock-free queue. A dedicated thread sleeps until
+    shortly before each message is due and spins for the rest.
+ */
+class MidiOutputScheduler : private Thread
+{
+public:
+    struct Stats
+    {
+        int64 numSent = 0;
+        int64 numLate = 0;
+        int64 numDropped = 0;
+        double meanJitterMs = 0.0;
+        double maxJitterMs = 0.0;
+    };
+
+    /** Create a scheduler for an output. The output must outlive the
+        scheduler. It can be nullptr if deliver() is overridden. Subclasses
+        overriding deliver() must call stop() in their destructor, otherwise
+        the send thread can call it after the subclass is gone.
+
+        @param output       The device to send to
+        @param capacity     Maximum number of queued messages
+     */
+    explicit MidiOutputScheduler (MidiOutput* output, int capacity = 2048);
+    virtual ~MidiOutputScheduler();
+
+    /** Start the send thread */
+    void start();
+
+    /** Stop the send thread and discard pending messages */
+    void stop();
+
+    /** Sets the time added to every message, in milliseconds. This must cover
+        the time from the device callback to send() being called.
+     */
+    void setLatency (double ms) noexcept            { latencyMs.store (jmax (0.0, ms)); }
+
+    /** Returns the latency budget in milliseconds */
+    double getLatency() const noexcept              { return latencyMs.load(); }
+
+    /** Queue a block of messages. Call this from the audio thread for every
+        block, even if the buffer is empty, so the block clock stays locked.
+
+        @param buffer           Messages to send. Only events before numSamples are used
+        @param numSamples       Size of the block
+        @param sampleRate       Current sample rate
+        @param callbackTimeMs   Start time of the engine's block, in getCurrentTime() units
+     */
+    void send (const MidiBuffer& buffer, int numSamples, double sampleRate, double callbackTimeMs) noexcept;
+
+    /** Delivers every queued message due at or before a time. The send
+        thread calls this, tests can call it instead of starting the thread.
+
+        @returns the number of messages delivered
+     */
+    int sendDue (double nowMs);
+
+    /** Returns the time the current block starts on the scheduler clock */
+    double getBlockTime() const noexcept            { return clock.getBlockTime(); }
+
+    /** Returns send timing statistics. Jitter is the difference between the
+        time a message was due and the time it was actually sent.
+     */
+    Stats getStats() const noexcept;
+
+    /** Reset timing statistics */
+    void resetStats() noexcept;
+
+protected:
+    /** Sends a message to the device. Called on the send thread. The message
+        timestamp is the time it was due, in milliseconds.
+     */
+    virtual void deliver (const MidiMessage& message);
+
+    /** Returns the time messages are scheduled against, in milliseconds.
+        Defaults to Time::getMillisecondCounterHiRes()
+     */
+    virtual double getCurrentTime() const;
+
+private:
+    MidiOutput* const output;
+    MidiEventFifo fifo;
+    HeapBlock<uint8> scratch;
+
+    std::atomic<double> latencyMs { 2.0 };
+    MidiBlockClock clock;
+    double lastTimeMs = 0.0;
+
+    std::atomic<int64> numSent { 0 }, numLate { 0 }, numDropped { 0 };
+    std::atomic<double> totalJitterMs { 0.0 }, maxJitterMs { 0.0 };
+
+    void updateStats (double jitterMs);
+    void run() override;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MidiOutputScheduler)
+};
+
+}
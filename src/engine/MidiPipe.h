@@ -23,7 +23,11 @@
 
 namespace Element {
 
-/** A glorified array of MidiBuffers used in rendering graph nodes */
+/** A glorified array of MidiBuffers used in rendering graph nodes.
+
+    The pipe refers to the caller's buffers and channel list without copying
+    them, so it has no limit on the number of buffers. Both must outlive it.
+ */
 class MidiPipe
 {
 public:
@@ -41,10 +45,10 @@ public:
     void clear (int index, int startSample, int numSamples);
 
 private:
-    enum { maxReferencedBuffers = 32 };
     int size = 0;
-    MidiBuffer* referencedBuffers [maxReferencedBuffers];
+    MidiBuffer* const* referencedBuffers = nullptr;
+    const OwnedArray<MidiBuffer>* sharedBuffers = nullptr;
+    const int* channels = nullptr;
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MidiPipe);
 };
-
 }
@@ -0,0 +1,207 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "engine/NetAudioPacket.h"
+
+namespace Element {
+
+static const uint32 packetMagic = 0x414e4c45; // "ELNA"
+static const uint8 packetVersion = 1;
+static const uint8 packedFlag = 1;
+
+static inline uint32 floatBits (float f) noexcept
+{
+    uint32 bits; memcpy (&bits, &f, 4);
+    return bits;
+}
+
+static inline float bitsFloat (uint32 bits) noexcept
+{
+    float f; memcpy (&f, &bits, 4);
+    return f;
+}
+
+static inline void writeInt (uint8* dest, uint32 value) noexcept
+{
+    for (int b = 0; b < 4; ++b)
+        dest[b] = (uint8) (value >> (8 * b));
+}
+
+static inline int significantBytes (uint32 x) noexcept
+{
+    return x == 0 ? 0 : x < 0x100u ? 1 : x < 0x10000u ? 2 : x < 0x1000000u ? 3 : 4;
+}
+
+/** Packs one channel. Returns the number of bytes written or -1 if it didn't fit */
+static int packChannel (uint8* dest, int maxBytes, const float* samples, int numFrames) noexcept
+{
+    int pos = 0;
+    uint32 last = 0;
+
+    for (int i = 0; i < numFrames; i += 2)
+    {
+        uint32 x[2] = { 0, 0 };
+        int n[2] = { 0, 0 };
+        for (int j = 0; j < 2 && i + j < numFrames; ++j)
+        {
+            const uint32 bits = floatBits (samples[i + j]);
+            x[j] = bits ^ last;
+            n[j] = significantBytes (x[j]);
+            last = bits;
+        }
+
+        if (pos + 1 + n[0] + n[1] > maxBytes)
+            return -1;
+
+        dest[pos++] = (uint8) ((n[0] << 4) | n[1]);
+        for (int j = 0; j < 2; ++j)
+            for (int b = 0; b < n[j]; ++b)
+                dest[pos++] = (uint8) (x[j] >> (8 * b));
+    }
+
+    return pos;
+}
+
+/** Unpacks one channel. Returns the number of bytes read or -1 if malformed */
+static int unpackChannel (const uint8* src, int size, float* samples, int numFrames) noexcept
+{
+    int pos = 0;
+    uint32 last = 0;
+
+    for (int i = 0; i < numFrames; i += 2)
+    {
+        if (pos >= size)
+            return -1;
+
+        const uint8 tag = src[pos++];
+        const int n[2] = { tag >> 4, tag & 0x0f };
+        for (int j = 0; j < 2 && i + j < numFrames; ++j)
+        {
+            if (n[j] > 4 || pos + n[j] > size)
+                return -1;
+
+            uint32 x = 0;
+            for (int b = 0; b < n[j]; ++b)
+                x |= (uint32) src[pos++] << (8 * b);
+
+            last ^= x;
+            if (samples != nullptr)
+                samples[i + j] = bitsFloat (last);
+        }
+    }
+
+    return pos;
+}
+
+//=============================================================================
+int NetAudioPacket::write (uint8* dest, int maxBytes, uint32 sequence, uint32 sampleRate,
+                           const float* const* channels, int numChannels, int numFrames,
+                           bool pack) noexcept
+{
+    jassert (isPositiveAndNotGreaterThan (numChannels, (int) maxChannels));
+    jassert (isPositiveAndNotGreaterThan (numFrames, (int) maxFrames));
+
+    const int rawSize = headerSize + 4 * numChannels * numFrames;
+    if (maxBytes < headerSize)
+        return 0;
+
+    int size = headerSize;
+    bool packed = false;
+
+    if (pack)
+    {
+        packed = true;
+        for (int c = 0; c < numChannels && packed; ++c)
+        {
+            const int written = packChannel (dest + size, jmin (maxBytes, rawSize) - size, channels[c], numFrames);
+            if (written < 0)
+                packed = false;
+            else
+                size += written;
+        }
+    }
+
+    if (! packed)
+    {
+        if (maxBytes < rawSize)
+            return 0;
+
+        size = headerSize;
+        for (int c = 0; c < numChannels; ++c)
+            for (int i = 0; i < numFrames; ++i, size += 4)
+                writeInt (dest + size, floatBits (channels[c][i]));
+    }
+
+    writeInt (dest, packetMagic);
+    dest[4] = packetVersion;
+    dest[5] = packed ? packedFlag : 0;
+    dest[6] = (uint8) numChannels;
+    dest[7] = 0;
+    writeInt (dest + 8, (uint32) numFrames);
+    writeInt (dest + 12, sequence);
+    writeInt (dest + 16, sampleRate);
+    return size;
+}
+
+bool NetAudioPacket::readHeader (const uint8* data, int size, NetAudioPacket& header) noexcept
+{
+    if (size < headerSize || ByteOrder::littleEndianInt (data) != packetMagic || data[4] != packetVersion)
+        return false;
+
+    header.packed       = (data[5] & packedFlag) != 0;
+    header.numChannels  = data[6];
+    header.numFrames    = (int) ByteOrder::littleEndianInt (data + 8);
+    header.sequence     = ByteOrder::littleEndianInt (data + 12);
+    header.sampleRate   = ByteOrder::littleEndianInt (data + 16);
+
+    if (! isPositiveAndNotGreaterThan (header.numChannels, (int) maxChannels)
+        || ! isPositiveAndNotGreaterThan (header.numFrames, (int) maxFrames))
+        return false;
+
+    return header.packed || size >= headerSize + 4 * header.numChannels * header.numFrames;
+}
+
+bool NetAudioPacket::readSamples (const uint8* data, int size, const NetAudioPacket& header,
+                                  float* const* dest, int numDestChannels) noexcept
+{
+    int pos = headerSize;
+    for (int c = 0; c < header.numChannels; ++c)
+    {
+        float* const samples = c < numDestChannels ? dest[c] : nullptr;
+
+        if (header.packed)
+        {
+            const int read = unpackChannel (data + pos, size - pos, samples, header.numFrames);
+            if (read < 0)
+                return false;
+            pos += read;
+        }
+        else
+        {
+            if (samples != nullptr)
+                for (int i = 0; i < header.numFrames; ++i)
+                    samples[i] = bitsFloat (ByteOrder::littleEndianInt (data + pos + 4 * i));
+            pos += 4 * header.numFrames;
+        }
+    }
+
+    return true;
+}
+
+}
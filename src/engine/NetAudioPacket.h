@@ -0,0 +1,72 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "ElementApp.h"
+
+namespace Element {
+
+/** The datagram format used by the network audio nodes.
+
+    Each packet carries a fixed number of frames of every channel along with
+    a sequence number, so the receiver can reorder and detect loss. Samples
+    are raw 32 bit floats, or optionally packed: each sample is XORed with
+    the one before it and only its non-zero low bytes are kept. Packing is
+    lossless and helps most with quiet or silent material. Every packet can
+    be decoded on its own.
+ */
+struct NetAudioPacket
+{
+    enum
+    {
+        headerSize      = 20,
+        maxChannels     = 16,
+        maxFrames       = 256,
+        maxSize         = headerSize + maxChannels * maxFrames * 4
+    };
+
+    uint32 sequence = 0;
+    uint32 sampleRate = 0;
+    int numChannels = 0;
+    int numFrames = 0;
+    bool packed = false;
+
+    /** Writes a packet. If packing doesn't save space, the samples are
+        written raw.
+
+        @returns the packet size in bytes, or 0 if dest is too small
+     */
+    static int write (uint8* dest, int maxBytes, uint32 sequence, uint32 sampleRate,
+                      const float* const* channels, int numChannels, int numFrames,
+                      bool pack) noexcept;
+
+    /** Reads a packet's header. Returns false if this isn't a valid packet */
+    static bool readHeader (const uint8* data, int size, NetAudioPacket& header) noexcept;
+
+    /** Decodes the samples of a packet whose header has been read. Channels
+        beyond numDestChannels are skipped.
+
+        @returns false if the packet is malformed
+     */
+    static bool readSamples (const uint8* data, int size, const NetAudioPacket& header,
+                             float* const* dest, int numDestChannels) noexcept;
+};
+
+}
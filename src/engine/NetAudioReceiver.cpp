@@ -0,0 +1,345 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "engine/NetAudioReceiver.h"
+
+namespace Element {
+
+NetAudioReceiver::NetAudioReceiver (int channels)
+    : Thread ("NetAudioReceiver"),
+      numChannels (jlimit (1, (int) NetAudioPacket::maxChannels, channels))
+{
+    packet.calloc ((size_t) NetAudioPacket::maxSize);
+    ring.setSize (numChannels, fifo.getTotalSize());
+    ring.clear();
+    slotAudio.setSize (numChannels, windowSize * NetAudioPacket::maxFrames);
+    slotChannels.calloc ((size_t) numChannels);
+    for (auto& slot : slots)
+        slot = { false, 0, 0 };
+}
+
+NetAudioReceiver::~NetAudioReceiver()
+{
+    disconnect();
+}
+
+bool NetAudioReceiver::connect (int port)
+{
+    disconnect();
+
+    socket.reset (new DatagramSocket());
+    if (! socket->bindToPort (port))
+    {
+        socket.reset();
+        return false;
+    }
+
+    started = false;
+    lastTransitMs = jitterMs = reorderMs = 0.0;
+    for (auto& slot : slots)
+        slot.valid = false;
+    flushRequested.store (true);
+    startThread (8);
+    return true;
+}
+
+void NetAudioReceiver::disconnect()
+{
+    signalThreadShouldExit();
+    if (socket != nullptr)
+        socket->shutdown();
+    stopThread (500);
+    socket.reset();
+}
+
+int NetAudioReceiver::getPort() const noexcept
+{
+    return socket != nullptr ? socket->getBoundPort() : -1;
+}
+
+void NetAudioReceiver::setLatencyRange (double minMs, double maxMs) noexcept
+{
+    minLatencyMs.store (jmax (0.0, minMs));
+    maxLatencyMs.store (jlimit (minMs, 500.0, maxMs));
+}
+
+void NetAudioReceiver::prepare (double sampleRate, int newBlockSize)
+{
+    localRate.store (sampleRate);
+    blockSize.store (jmax (1, newBlockSize));
+    buffering = true;
+    readPos = 0.0;
+}
+
+NetAudioReceiver::Stats NetAudioReceiver::getStats() const noexcept
+{
+    const double msPerFrame = 1000.0 / localRate.load();
+    Stats stats;
+    stats.numReceived   = numReceived.load();
+    stats.numLost       = numLost.load();
+    stats.numLate       = numLate.load();
+    stats.numUnderruns  = numUnderruns.load();
+    stats.numOverruns   = numOverruns.load();
+    stats.jitterMs      = currentJitterMs.load();
+    stats.targetMs      = msPerFrame * targetFrames.load();
+    stats.bufferedMs    = msPerFrame * fifo.getNumReady();
+    stats.ratio         = currentRatio.load();
+    return stats;
+}
+
+//=============================================================================
+void NetAudioReceiver::run()
+{
+    while (! threadShouldExit())
+    {
+        if (socket->waitUntilReady (true, 10) <= 0)
+            continue;
+
+        const int size = socket->read (packet, NetAudioPacket::maxSize, false);
+        if (size > 0)
+            receive (packet, size, Time::getMillisecondCounterHiRes());
+    }
+}
+
+void NetAudioReceiver::receive (const uint8* data, int size, double arrivalMs)
+{
+    NetAudioPacket header;
+    if (! NetAudioPacket::readHeader (data, size, header))
+        return;
+
+    numReceived.fetch_add (1);
+    remoteRate.store ((double) header.sampleRate);
+    if (! started)
+    {
+        started = true;
+        nextSequence = header.sequence;
+    }
+
+    updateTarget (header, arrivalMs);
+
+    const auto ahead = (int32) (header.sequence - nextSequence);
+    if (ahead < 0)
+    {
+        // already played or given up on
+        numLate.fetch_add (1);
+        return;
+    }
+
+    if (ahead >= 4 * windowSize)
+    {
+        // a long outage or the sender restarted
+        numLost.fetch_add (ahead);
+        for (auto& slot : slots)
+            slot.valid = false;
+        nextSequence = header.sequence;
+    }
+
+    while ((int32) (header.sequence - nextSequence) >= windowSize)
+    {
+        auto& slot = slots [nextSequence % windowSize];
+        if (slot.valid && slot.sequence == nextSequence)
+            push (&slot);
+        else
+            push (nullptr);
+        slot.valid = false;
+        ++nextSequence;
+    }
+
+    const int index = (int) (header.sequence % windowSize);
+    auto& slot = slots [index];
+    if (slot.valid && slot.sequence == header.sequence)
+        return; // duplicate
+
+    for (int c = 0; c < numChannels; ++c)
+        slotChannels[c] = slotAudio.getWritePointer (c, index * NetAudioPacket::maxFrames);
+    if (! NetAudioPacket::readSamples (data, size, header, slotChannels, numChannels))
+        return;
+    for (int c = header.numChannels; c < numChannels; ++c)
+        FloatVectorOperations::clear (slotChannels[c], header.numFrames);
+
+    slot = { true, header.sequence, header.numFrames };
+    lastNumFrames = header.numFrames;
+    release();
+}
+
+void NetAudioReceiver::updateTarget (const NetAudioPacket& header, double arrivalMs)
+{
+    // interarrival jitter as in RFC 3550
+    const double packetMs = 1000.0 * header.numFrames / jmax (1.0, (double) header.sampleRate);
+    const double transitMs = arrivalMs - packetMs * (double) header.sequence;
+    if (lastTransitMs != 0.0)
+        jitterMs += (std::abs (transitMs - lastTransitMs) - jitterMs) / 16.0;
+    lastTransitMs = transitMs;
+
+    // once packets go missing or come out of order, also cover the time
+    // spent waiting for them
+    if (header.sequence != nextSequence)
+        reorderMs = packetMs * reorderDepth;
+
+    const double rate = localRate.load();
+    const double targetMs = jlimit (minLatencyMs.load(), maxLatencyMs.load(),
+        1000.0 * blockSize.load() / rate + packetMs + reorderMs + 4.0 * jitterMs);
+    targetFrames.store (jmin (fifo.getTotalSize() / 2, roundToInt (targetMs * rate / 1000.0)));
+    currentJitterMs.store (jitterMs);
+}
+
+void NetAudioReceiver::release()
+{
+    for (;;)
+    {
+        auto& slot = slots [nextSequence % windowSize];
+        if (slot.valid && slot.sequence == nextSequence)
+        {
+            push (&slot);
+            slot.valid = false;
+            ++nextSequence;
+            continue;
+        }
+
+        // give up on the missing packet once enough later ones are here
+        int numNewer = 0;
+        for (const auto& s : slots)
+            if (s.valid && (int32) (s.sequence - nextSequence) > 0)
+                ++numNewer;
+        if (numNewer < reorderDepth)
+            break;
+
+        push (nullptr);
+        ++nextSequence;
+    }
+}
+
+void NetAudioReceiver::push (const Slot* slot)
+{
+    const int numFrames = slot != nullptr ? slot->numFrames : lastNumFrames;
+    if (slot == nullptr)
+        numLost.fetch_add (1);
+    if (numFrames <= 0)
+        return;
+
+    if (fifo.getFreeSpace() < numFrames)
+    {
+        numOverruns.fetch_add (1);
+        return;
+    }
+
+    const int offset = slot != nullptr ? (int) (slot->sequence % windowSize) * NetAudioPacket::maxFrames : 0;
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite (numFrames, start1, size1, start2, size2);
+    for (int c = 0; c < numChannels; ++c)
+    {
+        if (slot == nullptr)
+        {
+            // lost packets play as silence
+            ring.clear (c, start1, size1);
+            if (size2 > 0)
+                ring.clear (c, start2, size2);
+            continue;
+        }
+
+        ring.copyFrom (c, start1, slotAudio, c, offset, size1);
+        if (size2 > 0)
+            ring.copyFrom (c, start2, slotAudio, c, offset + size1, size2);
+    }
+    fifo.finishedWrite (size1 + size2);
+}
+
+//=============================================================================
+void NetAudioReceiver::read (AudioSampleBuffer& buffer, int numSamples) noexcept
+{
+    if (flushRequested.exchange (false))
+    {
+        fifo.finishedRead (fifo.getNumReady());
+        buffering = true;
+    }
+
+    int available = fifo.getNumReady();
+    const int target = jmax (1, targetFrames.load());
+
+    if (buffering)
+    {
+        if (available < target)
+        {
+            buffer.clear (0, numSamples);
+            return;
+        }
+
+        buffering = false;
+        readPos = 0.0;
+        smoothedFill = (double) available;
+    }
+
+    // after a burst don't hold more latency than needed
+    if (available > 2 * target + 2 * blockSize.load())
+    {
+        fifo.finishedRead (available - target);
+        available = target;
+        smoothedFill = (double) target;
+        readPos = 0.0;
+    }
+
+    // the nominal ratio, corrected to hold the fill level at the target
+    smoothedFill += 0.05 * ((double) available - smoothedFill);
+    const double rates = remoteRate.load() > 0.0 ? remoteRate.load() / localRate.load() : 1.0;
+    const double correction = jlimit (-0.005, 0.005, 0.01 * (smoothedFill - target) / target);
+    const double ratio = rates * (1.0 + correction);
+    currentRatio.store (ratio);
+
+    const double endPos = readPos + ratio * numSamples;
+    const int needed = (int) endPos + 2;
+    if (available < needed)
+    {
+        numUnderruns.fetch_add (1);
+        buffering = true;
+        buffer.clear (0, numSamples);
+        return;
+    }
+
+    int start1, size1, start2, size2;
+    fifo.prepareToRead (needed, start1, size1, start2, size2);
+    const int ringSize = ring.getNumSamples();
+
+    for (int c = 0; c < buffer.getNumChannels(); ++c)
+    {
+        if (c >= numChannels)
+        {
+            buffer.clear (c, 0, numSamples);
+            continue;
+        }
+
+        const float* src = ring.getReadPointer (c);
+        float* dst = buffer.getWritePointer (c);
+        double pos = readPos;
+
+        for (int i = 0; i < numSamples; ++i, pos += ratio)
+        {
+            const int index = (int) pos;
+            const float frac = (float) (pos - index);
+            const float a = src [(start1 + index) % ringSize];
+            const float b = src [(start1 + index + 1) % ringSize];
+            dst[i] = a + frac * (b - a);
+        }
+    }
+
+    const int consumed = (int) endPos;
+    readPos = endPos - consumed;
+    fifo.finishedRead (consumed);
+}
+
+}
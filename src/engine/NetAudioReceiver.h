@@ -0,0 +1,141 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "ElementApp.h"
+#include "engine/NetAudioPacket.h"
+
+namespace Element {
+
+/** Receives audio sent by a NetAudioSender.
+
+    A dedicated thread reads packets, puts them back in order and hands
+    them to the audio thread through a preallocated lock-free ring. A packet
+    is counted lost once a few later ones have arrived, and silence is
+    played in its place.
+
+    The audio thread waits until the ring holds the target latency before
+    playing. The target adapts to the measured network jitter. The ring is
+    read with a fractional resampler whose ratio is nudged to hold the fill
+    level at the target, which absorbs the drift between the two clocks
+    and any sample rate difference.
+ */
+class NetAudioReceiver : private Thread
+{
+public:
+    struct Stats
+    {
+        int64 numReceived = 0;
+        int64 numLost = 0;
+        int64 numLate = 0;
+        int64 numUnderruns = 0;
+        int64 numOverruns = 0;
+        double jitterMs = 0.0;
+        double targetMs = 0.0;
+        double bufferedMs = 0.0;
+        double ratio = 1.0;
+    };
+
+    explicit NetAudioReceiver (int numChannels = 2);
+    ~NetAudioReceiver();
+
+    /** Start listening on a UDP port. Port 0 picks a free one */
+    bool connect (int port);
+
+    /** Stop listening */
+    void disconnect();
+
+    /** Returns true if listening */
+    bool isConnected() const noexcept           { return socket != nullptr; }
+
+    /** Returns the port being listened on, or -1 */
+    int getPort() const noexcept;
+
+    /** Sets the range the target latency adapts within */
+    void setLatencyRange (double minMs, double maxMs) noexcept;
+
+    /** Prepare for rendering. Not realtime safe */
+    void prepare (double sampleRate, int blockSize);
+
+    /** Renders received audio. Called on the audio thread */
+    void read (AudioSampleBuffer& buffer, int numSamples) noexcept;
+
+    /** Handles one datagram. The network thread calls this with the time it
+        arrived, tests can call it directly without connecting.
+
+        @param data         The datagram
+        @param size         Its size in bytes
+        @param arrivalMs    When it arrived, in milliseconds
+     */
+    void receive (const uint8* data, int size, double arrivalMs);
+
+    /** Returns the number of channels received */
+    int getNumChannels() const noexcept         { return numChannels; }
+
+    /** Returns receive statistics */
+    Stats getStats() const noexcept;
+
+private:
+    const int numChannels;
+    std::unique_ptr<DatagramSocket> socket;
+    HeapBlock<uint8> packet;
+
+    // network thread
+    enum { windowSize = 32, reorderDepth = 3 };
+    struct Slot
+    {
+        bool valid;
+        uint32 sequence;
+        int numFrames;
+    };
+    Slot slots [windowSize];
+    AudioSampleBuffer slotAudio;
+    HeapBlock<float*> slotChannels;
+    bool started = false;
+    uint32 nextSequence = 0;
+    int lastNumFrames = 0;
+    double lastTransitMs = 0.0, jitterMs = 0.0, reorderMs = 0.0;
+
+    // hand-off
+    AbstractFifo fifo { 1 << 15 };
+    AudioSampleBuffer ring;
+    std::atomic<int> targetFrames { 0 };
+    std::atomic<bool> flushRequested { false };
+    std::atomic<double> localRate { 44100.0 }, remoteRate { 0.0 };
+    std::atomic<double> minLatencyMs { 2.0 }, maxLatencyMs { 250.0 };
+    std::atomic<int> blockSize { 512 };
+
+    // audio thread
+    bool buffering = true;
+    double readPos = 0.0, smoothedFill = 0.0;
+
+    std::atomic<int64> numReceived { 0 }, numLost { 0 }, numLate { 0 },
+                       numUnderruns { 0 }, numOverruns { 0 };
+    std::atomic<double> currentJitterMs { 0.0 }, currentRatio { 1.0 };
+
+    void run() override;
+    void updateTarget (const NetAudioPacket& header, double arrivalMs);
+    void release();
+    void push (const Slot* slot);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (NetAudioReceiver)
+};
+
+}
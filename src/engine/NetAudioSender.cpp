@@ -0,0 +1,222 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "engine/NetAudioSender.h"
+
+namespace Element {
+
+NetAudioSender::NetAudioSender (int channels, int frames)
+    : Thread ("NetAudioSender"),
+      numChannels (jlimit (1, (int) NetAudioPacket::maxChannels, channels)),
+      framesPerPacket (jlimit (16, (int) NetAudioPacket::maxFrames, frames))
+{
+    ring.setSize (numChannels, fifo.getTotalSize());
+    scratch.setSize (numChannels, framesPerPacket);
+    packet.calloc ((size_t) NetAudioPacket::maxSize);
+    for (auto& d : delayed)
+    {
+        d.dueMs = 0.0;
+        d.size = 0;
+        d.data.calloc ((size_t) NetAudioPacket::maxSize);
+    }
+}
+
+NetAudioSender::~NetAudioSender()
+{
+    disconnect();
+}
+
+bool NetAudioSender::connect (const String& newHost, int newPort, bool startSending)
+{
+    disconnect();
+    host = newHost;
+    port = newPort;
+    sequence = 0;
+    flushRequested.store (true);
+    connected.store (true);
+    if (startSending)
+        startThread (8);
+    return true;
+}
+
+void NetAudioSender::disconnect()
+{
+    connected.store (false);
+    stopThread (500);
+    for (auto& d : delayed)
+        d.size = 0;
+}
+
+void NetAudioSender::setImpairment (float loss, double jitter)
+{
+    jassert (! isThreadRunning());
+    lossRatio = jlimit (0.f, 1.f, loss);
+    jitterMs  = jmax (0.0, jitter);
+}
+
+void NetAudioSender::prepare (double newSampleRate, int blockSize)
+{
+    ignoreUnused (blockSize);
+    sampleRate.store ((uint32) roundToInt (newSampleRate));
+}
+
+NetAudioSender::Stats NetAudioSender::getStats() const noexcept
+{
+    Stats stats;
+    stats.numSent       = numSent.load();
+    stats.numBytes      = numBytes.load();
+    stats.numOverruns   = numOverruns.load();
+    return stats;
+}
+
+//=============================================================================
+void NetAudioSender::write (const AudioSampleBuffer& buffer, int numSamples) noexcept
+{
+    if (! connected.load() || numSamples <= 0)
+        return;
+
+    if (fifo.getFreeSpace() < numSamples)
+    {
+        // the send thread is behind, drop the whole block
+        numOverruns.fetch_add (1);
+        return;
+    }
+
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite (numSamples, start1, size1, start2, size2);
+    for (int c = 0; c < numChannels; ++c)
+    {
+        if (c >= buffer.getNumChannels())
+        {
+            ring.clear (c, start1, size1);
+            if (size2 > 0)
+                ring.clear (c, start2, size2);
+            continue;
+        }
+
+        ring.copyFrom (c, start1, buffer, c, 0, size1);
+        if (size2 > 0)
+            ring.copyFrom (c, start2, buffer, c, size1, size2);
+    }
+    fifo.finishedWrite (size1 + size2);
+}
+
+//=============================================================================
+void NetAudioSender::run()
+{
+    while (! threadShouldExit())
+    {
+        sendPending (getCurrentTime());
+        wait (1);
+    }
+}
+
+int NetAudioSender::sendPending (double nowMs)
+{
+    // only the reading side may move the read position
+    if (flushRequested.exchange (false))
+        fifo.finishedRead (fifo.getNumReady());
+
+    int numPackets = 0;
+    while (fifo.getNumReady() >= framesPerPacket && ! threadShouldExit())
+    {
+        sendPacket (nowMs);
+        ++numPackets;
+    }
+
+    sendDelayed (nowMs);
+    return numPackets;
+}
+
+double NetAudioSender::getCurrentTime() const
+{
+    return Time::getMillisecondCounterHiRes();
+}
+
+bool NetAudioSender::deliver (const uint8* data, int size)
+{
+    return socket.write (host, port, data, size) == size;
+}
+
+void NetAudioSender::sendPacket (double nowMs)
+{
+    int start1, size1, start2, size2;
+    fifo.prepareToRead (framesPerPacket, start1, size1, start2, size2);
+    for (int c = 0; c < numChannels; ++c)
+    {
+        scratch.copyFrom (c, 0, ring, c, start1, size1);
+        if (size2 > 0)
+            scratch.copyFrom (c, size1, ring, c, start2, size2);
+    }
+    fifo.finishedRead (size1 + size2);
+
+    const int size = NetAudioPacket::write (packet, NetAudioPacket::maxSize, sequence++, sampleRate.load(),
+                                            scratch.getArrayOfReadPointers(), numChannels,
+                                            framesPerPacket, packing.load());
+    if (size <= 0)
+        return;
+
+    if (lossRatio > 0.f && random.nextFloat() < lossRatio)
+        return;
+
+    if (jitterMs <= 0.0)
+    {
+        send (packet, size);
+        return;
+    }
+
+    // hold the packet back for a random time, which can reorder packets
+    for (auto& d : delayed)
+    {
+        if (d.size > 0)
+            continue;
+        d.dueMs = nowMs + jitterMs * random.nextDouble();
+        d.size = size;
+        memcpy (d.data, packet, (size_t) size);
+        return;
+    }
+
+    send (packet, size);
+}
+
+void NetAudioSender::sendDelayed (double nowMs)
+{
+    if (jitterMs <= 0.0)
+        return;
+
+    for (auto& d : delayed)
+    {
+        if (d.size > 0 && d.dueMs <= nowMs)
+        {
+            send (d.data, d.size);
+            d.size = 0;
+        }
+    }
+}
+
+void NetAudioSender::send (const uint8* data, int size)
+{
+    if (deliver (data, size))
+    {
+        numSent.fetch_add (1);
+        numBytes.fetch_add (size);
+    }
+}
+
+}
@@ -0,0 +1,144 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "ElementApp.h"
+#include "engine/NetAudioPacket.h"
+
+namespace Element {
+
+/** Streams audio from the audio thread to another host over UDP.
+
+    The audio thread writes each block into a preallocated lock-free ring.
+    A dedicated thread cuts the ring into fixed size packets, numbers them
+    and sends them. Loss and jitter can be simulated for testing, in which
+    case packets are randomly dropped or held back on the send thread.
+ */
+class NetAudioSender : private Thread
+{
+public:
+    struct Stats
+    {
+        int64 numSent = 0;
+        int64 numBytes = 0;
+        int64 numOverruns = 0;
+    };
+
+    /** Create a sender
+
+        @param numChannels      Number of channels to send
+        @param framesPerPacket  Frames in each packet
+     */
+    explicit NetAudioSender (int numChannels = 2, int framesPerPacket = 128);
+    virtual ~NetAudioSender();
+
+    /** Start sending to a host. Returns false if the socket couldn't be created
+
+        @param host         Host to send to
+        @param port         UDP port to send to
+        @param startThread  If false, no send thread is started and
+                            sendPending() must be called instead
+     */
+    bool connect (const String& host, int port, bool startThread = true);
+
+    /** Stop sending */
+    void disconnect();
+
+    /** Returns true if connected */
+    bool isConnected() const noexcept                   { return connected.load(); }
+
+    /** Turns on lossless sample packing */
+    void setPacking (bool shouldPack) noexcept          { packing.store (shouldPack); }
+
+    /** Returns true if samples are packed */
+    bool isPacking() const noexcept                     { return packing.load(); }
+
+    /** Simulates a bad network. Call before connect().
+
+        @param lossRatio    Portion of packets to drop, 0 to 1
+        @param jitterMs     Maximum random delay added to each packet
+     */
+    void setImpairment (float lossRatio, double jitterMs);
+
+    /** Prepare for rendering. Not realtime safe */
+    void prepare (double sampleRate, int blockSize);
+
+    /** Queue a block to send. Called on the audio thread */
+    void write (const AudioSampleBuffer& buffer, int numSamples) noexcept;
+
+    /** Sends every complete packet and any held back ones due by a time.
+        The send thread calls this, tests can call it instead.
+
+        @returns the number of packets cut from the ring
+     */
+    int sendPending (double nowMs);
+
+    /** Returns the number of channels sent */
+    int getNumChannels() const noexcept                 { return numChannels; }
+
+    /** Returns send statistics */
+    Stats getStats() const noexcept;
+
+protected:
+    /** Sends a packet. Defaults to the UDP socket. Subclasses overriding
+        this must call disconnect() in their destructor */
+    virtual bool deliver (const uint8* data, int size);
+
+    /** Returns the time impairment delays are measured against, in
+        milliseconds. Defaults to Time::getMillisecondCounterHiRes() */
+    virtual double getCurrentTime() const;
+
+private:
+    const int numChannels, framesPerPacket;
+    AbstractFifo fifo { 1 << 15 };
+    AudioSampleBuffer ring;
+    AudioSampleBuffer scratch;
+    HeapBlock<uint8> packet;
+
+    DatagramSocket socket;
+    String host;
+    int port = 0;
+    std::atomic<bool> connected { false }, packing { false }, flushRequested { false };
+    std::atomic<uint32> sampleRate { 44100 };
+    uint32 sequence = 0;
+
+    struct Delayed
+    {
+        double dueMs;
+        int size;
+        HeapBlock<uint8> data;
+    };
+    enum { maxDelayed = 64 };
+    Delayed delayed [maxDelayed];
+    float lossRatio = 0.f;
+    double jitterMs = 0.0;
+    Random random;
+
+    std::atomic<int64> numSent { 0 }, numBytes { 0 }, numOverruns { 0 };
+
+    void run() override;
+    void sendPacket (double nowMs);
+    void send (const uint8* data, int size);
+    void sendDelayed (double nowMs);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (NetAudioSender)
+};
+
+}
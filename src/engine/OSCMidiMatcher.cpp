@@ -0,0 +1,353 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "engine/OSCMidiMatcher.h"
+
+namespace Element {
+
+static const char* const commandNames[] =
+{
+    "", "raw", "noteOn", "noteOff", "programChange", "pitchBend", "afterTouch",
+    "channelPressure", "controlChange", "allNotesOff", "allSoundOff", "allControllersOff",
+    "start", "continue", "stop", "clock", "songPositionPointer", "activeSense"
+};
+
+static_assert (sizeof (commandNames) / sizeof (commandNames[0]) == (size_t) OSCMidiMatcher::numCommands,
+               "a command is missing a name");
+
+static uint32 hashSegment (const char* start, const char* end) noexcept
+{
+    uint32 hash = 2166136261u;
+    for (; start < end; ++start)
+        hash = (hash ^ (uint8) *start) * 16777619u;
+    return hash;
+}
+
+static bool hasWildcards (const char* start, const char* end) noexcept
+{
+    for (; start < end; ++start)
+        if (*start == '*' || *start == '?' || *start == '[' || *start == '{')
+            return true;
+    return false;
+}
+
+/** Open addressed table from command name hashes to commands, built once */
+struct CommandTable
+{
+    enum { numSlots = 64 };
+
+    CommandTable()
+    {
+        for (int i = 0; i < numSlots; ++i)
+            slots[i] = OSCMidiMatcher::unknown;
+
+        for (int c = 1; c < OSCMidiMatcher::numCommands; ++c)
+        {
+            const char* name = commandNames[c];
+            const uint32 hash = hashSegment (name, name + strlen (name));
+            int slot = (int) (hash & (numSlots - 1));
+            while (slots[slot] != OSCMidiMatcher::unknown)
+                slot = (slot + 1) & (numSlots - 1);
+            slots[slot] = (OSCMidiMatcher::Command) c;
+        }
+    }
+
+    OSCMidiMatcher::Command find (const char* start, const char* end) const noexcept
+    {
+        const auto length = (size_t) (end - start);
+        int slot = (int) (hashSegment (start, end) & (numSlots - 1));
+        while (slots[slot] != OSCMidiMatcher::unknown)
+        {
+            const char* name = commandNames[slots[slot]];
+            if (strlen (name) == length && memcmp (name, start, length) == 0)
+                return slots[slot];
+            slot = (slot + 1) & (numSlots - 1);
+        }
+        return OSCMidiMatcher::unknown;
+    }
+
+    OSCMidiMatcher::Command slots [numSlots];
+};
+
+static const CommandTable& getCommandTable()
+{
+    static const CommandTable table;
+    return table;
+}
+
+//==============================================================================
+bool OSCMidiMatcher::matchesSegment (const char* p, const char* pe, const char* s, const char* se) noexcept
+{
+    while (p < pe)
+    {
+        switch (*p)
+        {
+            case '*':
+            {
+                for (const char* t = se; t >= s; --t)
+                    if (matchesSegment (p + 1, pe, t, se))
+                        return true;
+                return false;
+            }
+
+            case '?':
+            {
+                if (s >= se)
+                    return false;
+                ++p; ++s;
+                break;
+            }
+
+            case '[':
+            {
+                const char* close = p + 1;
+                while (close < pe && *close != ']')
+                    ++close;
+                if (s >= se || close >= pe)
+                    return false;
+
+                const bool negate = p[1] == '!';
+                bool found = false;
+                for (const char* q = p + (negate ? 2 : 1); q < close;)
+                {
+                    if (q + 2 < close && q[1] == '-')
+                    {
+                        found = found || (*s >= q[0] && *s <= q[2]);
+                        q += 3;
+                    }
+                    else
+                    {
+                        found = found || *q == *s;
+                        ++q;
+                    }
+                }
+
+                if (found == negate)
+                    return false;
+                p = close + 1; ++s;
+                break;
+            }
+
+            case '{':
+            {
+                const char* close = p + 1;
+                while (close < pe && *close != '}')
+                    ++close;
+                if (close >= pe)
+                    return false;
+
+                for (const char* option = p + 1; option <= close;)
+                {
+                    const char* optionEnd = option;
+                    while (optionEnd < close && *optionEnd != ',')
+                        ++optionEnd;
+                    const auto length = (size_t) (optionEnd - option);
+                    if ((size_t) (se - s) >= length && memcmp (s, option, length) == 0
+                        && matchesSegment (close + 1, pe, s + length, se))
+                        return true;
+                    option = optionEnd + 1;
+                }
+                return false;
+            }
+
+            default:
+            {
+                if (s >= se || *p != *s)
+                    return false;
+                ++p; ++s;
+                break;
+            }
+        }
+    }
+
+    return s == se;
+}
+
+OSCMidiMatcher::Command OSCMidiMatcher::match (const char* address) noexcept
+{
+    if (address == nullptr || *address != '/')
+        return unknown;
+
+    // split into at most three segments
+    enum { maxSegments = 3 };
+    const char* starts [maxSegments + 1];
+    const char* ends [maxSegments + 1];
+    int numSegments = 0;
+
+    for (const char* c = address; *c != 0;)
+    {
+        ++c;    // skip the slash
+        if (numSegments > maxSegments)
+            return unknown;
+        starts[numSegments] = c;
+        while (*c != 0 && *c != '/')
+            ++c;
+        ends[numSegments] = c;
+        if (ends[numSegments] > starts[numSegments])
+            ++numSegments;
+    }
+
+    if (numSegments < 2 || numSegments > maxSegments)
+        return unknown;
+
+    static const char midiName[] = "midi";
+    if (! matchesSegment (starts[0], ends[0], midiName, midiName + 4))
+        return unknown;
+
+    const char* command = starts[numSegments - 1];
+    const char* commandEnd = ends[numSegments - 1];
+
+    if (! hasWildcards (command, commandEnd))
+        return getCommandTable().find (command, commandEnd);
+
+    for (int c = 1; c < numCommands; ++c)
+    {
+        const char* name = commandNames[c];
+        if (matchesSegment (command, commandEnd, name, name + strlen (name)))
+            return (Command) c;
+    }
+
+    return unknown;
+}
+
+OSCMidiMatcher::Command OSCMidiMatcher::match (const OSCAddressPattern& pattern) noexcept
+{
+    // toString() shares the pattern's string, so this doesn't copy
+    const auto address = pattern.toString();
+    return match (address.toRawUTF8());
+}
+
+const char* OSCMidiMatcher::getCommandName (Command command) noexcept
+{
+    return isPositiveAndBelow ((int) command, (int) numCommands) ? commandNames[command] : "";
+}
+
+//==============================================================================
+static int intArg (const OSCMessage& message, int index) noexcept
+{
+    const auto& arg = message[index];
+    if (arg.isInt32())      return arg.getInt32();
+    if (arg.isFloat32())    return (int) arg.getFloat32();
+    return 0;
+}
+
+bool OSCMidiMatcher::toMidi (const OSCMessage& message, MidiMessage& result) noexcept
+{
+    return toMidi (match (message.getAddressPattern()), message, result);
+}
+
+bool OSCMidiMatcher::toMidi (Command command, const OSCMessage& message, MidiMessage& result) noexcept
+{
+    const int numArgs = message.size();
+
+    switch (command)
+    {
+        case raw:
+        {
+            for (const auto& arg : message)
+            {
+                if (arg.isBlob() && arg.getBlob().getSize() > 0)
+                {
+                    const auto& blob = arg.getBlob();
+                    result = MidiMessage (blob.getData(), (int) blob.getSize());
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        case noteOn:
+        case noteOff:
+        {
+            if (numArgs < 3)
+                return false;
+
+            /** channel, noteNumber, velocity as 0 to 1 or 0 to 127 */
+            const auto& velocity = message[2];
+            if (velocity.isFloat32())
+                result = command == noteOn
+                    ? MidiMessage::noteOn (intArg (message, 0), intArg (message, 1), velocity.getFloat32())
+                    : MidiMessage::noteOff (intArg (message, 0), intArg (message, 1), velocity.getFloat32());
+            else
+                result = command == noteOn
+                    ? MidiMessage::noteOn (intArg (message, 0), intArg (message, 1), (uint8) jlimit (0, 127, intArg (message, 2)))
+                    : MidiMessage::noteOff (intArg (message, 0), intArg (message, 1), (uint8) jlimit (0, 127, intArg (message, 2)));
+            return true;
+        }
+
+        case programChange:
+            if (numArgs < 2) return false;
+            result = MidiMessage::programChange (intArg (message, 0), intArg (message, 1));
+            return true;
+
+        case pitchBend:
+            if (numArgs < 2) return false;
+            result = MidiMessage::pitchWheel (intArg (message, 0), intArg (message, 1));
+            return true;
+
+        case afterTouch:
+            if (numArgs < 3) return false;
+            result = MidiMessage::aftertouchChange (intArg (message, 0), intArg (message, 1), intArg (message, 2));
+            return true;
+
+        case channelPressure:
+            if (numArgs < 2) return false;
+            result = MidiMessage::channelPressureChange (intArg (message, 0), intArg (message, 1));
+            return true;
+
+        case controlChange:
+            if (numArgs < 3) return false;
+            result = MidiMessage::controllerEvent (intArg (message, 0), intArg (message, 1), intArg (message, 2));
+            return true;
+
+        case allNotesOff:
+            if (numArgs < 1) return false;
+            result = MidiMessage::allNotesOff (intArg (message, 0));
+            return true;
+
+        case allSoundOff:
+            if (numArgs < 1) return false;
+            result = MidiMessage::allSoundOff (intArg (message, 0));
+            return true;
+
+        case allControllersOff:
+            if (numArgs < 1) return false;
+            result = MidiMessage::allControllersOff (intArg (message, 0));
+            return true;
+
+        case start:             result = MidiMessage::midiStart();      return true;
+        case continuePlaying:   result = MidiMessage::midiContinue();   return true;
+        case stop:              result = MidiMessage::midiStop();       return true;
+        case clock:             result = MidiMessage::midiClock();      return true;
+
+        case songPositionPointer:
+            if (numArgs < 1) return false;
+            result = MidiMessage::songPositionPointer (intArg (message, 0));
+            return true;
+
+        case activeSense:
+        case unknown:
+        case numCommands:
+            break;
+    }
+
+    return false;
+}
+
+}
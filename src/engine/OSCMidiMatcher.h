@@ -0,0 +1,82 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "ElementApp.h"
+
+namespace Element {
+
+/** Matches OSC addresses in the /midi namespace and converts them to MIDI.
+
+    Addresses are /midi/<command> or /midi/<device>/<command>. Command names
+    are hashed into a table built once, so matching a plain address is a
+    hash and one compare. Patterns with OSC wildcards (*, ?, [], {}) are
+    matched segment by segment. Nothing here allocates.
+ */
+class OSCMidiMatcher
+{
+public:
+    enum Command
+    {
+        unknown = 0,
+        raw,
+        noteOn,
+        noteOff,
+        programChange,
+        pitchBend,
+        afterTouch,
+        channelPressure,
+        controlChange,
+        allNotesOff,
+        allSoundOff,
+        allControllersOff,
+        start,
+        continuePlaying,
+        stop,
+        clock,
+        songPositionPointer,
+        activeSense,
+        numCommands
+    };
+
+    /** Returns the command for an address or address pattern */
+    static Command match (const char* address) noexcept;
+
+    /** Returns the command for an address or address pattern */
+    static Command match (const OSCAddressPattern& pattern) noexcept;
+
+    /** Returns the name used in addresses for a command */
+    static const char* getCommandName (Command command) noexcept;
+
+    /** Converts a message to MIDI
+
+        @returns false if the address isn't a MIDI command or there are too few arguments
+     */
+    static bool toMidi (const OSCMessage& message, MidiMessage& result) noexcept;
+
+    /** Converts a command and its arguments to MIDI */
+    static bool toMidi (Command command, const OSCMessage& message, MidiMessage& result) noexcept;
+
+    /** Returns true if a segment of a pattern matches a name, OSC 1.0 rules */
+    static bool matchesSegment (const char* pattern, const char* patternEnd,
+                                const char* name, const char* nameEnd) noexcept;
+};
+
+}
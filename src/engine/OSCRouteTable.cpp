@@ -0,0 +1,117 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "engine/OSCRouteTable.h"
+
+namespace Element {
+
+OSCRouteTable::OSCRouteTable() { }
+OSCRouteTable::~OSCRouteTable() { }
+
+uint32 OSCRouteTable::hash (const char* address) noexcept
+{
+    uint32 h = 2166136261u;
+    while (*address != 0)
+    {
+        h ^= (uint8) *address++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+void OSCRouteTable::add (const String& address, const OSCRoute& route)
+{
+    jassert (address.startsWithChar ('/'));
+    const uint32 h = hash (address.toRawUTF8());
+
+    if (mask >= 0)
+    {
+        for (int i = (int) (h & (uint32) mask); slots[i] >= 0; i = (i + 1) & mask)
+        {
+            auto& entry = entries.getReference (slots[i]);
+            if (entry.hash == h && entry.address == address)
+            {
+                entry.route = route;
+                return;
+            }
+        }
+    }
+
+    entries.add ({ h, address, route });
+
+    // keep the load under a half so probes stay short
+    if (entries.size() * 2 > mask + 1)
+        rehash (jmax (64, (mask + 1) * 2));
+    else
+        insert (entries.size() - 1);
+}
+
+const OSCRoute* OSCRouteTable::find (const char* address) const noexcept
+{
+    if (mask < 0 || address == nullptr)
+        return nullptr;
+
+    const uint32 h = hash (address);
+    for (int i = (int) (h & (uint32) mask); slots[i] >= 0; i = (i + 1) & mask)
+    {
+        const auto& entry = entries.getReference (slots[i]);
+        if (entry.hash == h && entry.address == address)
+            return &entry.route;
+    }
+
+    return nullptr;
+}
+
+int OSCRouteTable::findMatches (const OSCAddressPattern& pattern, std::function<void(const OSCRoute&)> callback) const
+{
+    int numMatches = 0;
+    for (const auto& entry : entries)
+    {
+        if (pattern.matches (OSCAddress (entry.address)))
+        {
+            ++numMatches;
+            if (callback)
+                callback (entry.route);
+        }
+    }
+    return numMatches;
+}
+
+void OSCRouteTable::insert (int entry) noexcept
+{
+    const uint32 h = entries.getReference(entry).hash;
+    int i = (int) (h & (uint32) mask);
+    while (slots[i] >= 0)
+        i = (i + 1) & mask;
+    slots[i] = entry;
+}
+
+void OSCRouteTable::rehash (int capacity)
+{
+    jassert (isPowerOfTwo (capacity));
+    slots.malloc ((size_t) capacity);
+    for (int i = 0; i < capacity; ++i)
+        slots[i] = -1;
+    mask = capacity - 1;
+
+    for (int i = 0; i < entries.size(); ++i)
+        insert (i);
+}
+
+}
@@ -0,0 +1,124 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "ElementApp.h"
+#include "engine/GraphNode.h"
+
+namespace Element {
+
+/** A target in the OSC remote-control namespace */
+struct OSCRoute
+{
+    enum Kind
+    {
+        invalid = 0,
+        parameter,
+        gain,
+        inputGain,
+        mute,
+        bypass,
+        activateGraph,
+        connect,
+        disconnect,
+        play,
+        stop,
+        record,
+        seek,
+        feedback,
+        subscribe,
+        unsubscribe,
+        refresh,
+        probe,
+        unprobe
+    };
+
+    Kind kind = invalid;
+
+    /** Index of the session graph, or -1 */
+    int graph = -1;
+
+    /** Parameter index for parameter routes, or -1 */
+    int index = -1;
+
+    /** The node for node routes. This keeps the node alive, so tables
+        holding nodes must be released on the message thread */
+    GraphNodePtr node;
+};
+
+/** An immutable hash table from OSC addresses to routes. Build a new table
+    on the message thread when the session changes and swap it in.
+ */
+class OSCRouteTable : public ReferenceCountedObject
+{
+public:
+    using Ptr = ReferenceCountedObjectPtr<OSCRouteTable>;
+
+    OSCRouteTable();
+    ~OSCRouteTable();
+
+    /** Adds a route, replacing any with the same address. Only call this
+        before the table is shared */
+    void add (const String& address, const OSCRoute& route);
+
+    /** Returns the route for an address or nullptr. Doesn't lock or allocate */
+    const OSCRoute* find (const char* address) const noexcept;
+
+    /** Returns the route for an address or nullptr. Doesn't lock or allocate */
+    const OSCRoute* find (const String& address) const noexcept { return find (address.toRawUTF8()); }
+
+    /** Calls a function for each route matching an address pattern. This
+        checks every route so only use it for patterns with wildcards.
+
+        @returns the number of matches
+     */
+    int findMatches (const OSCAddressPattern& pattern, std::function<void(const OSCRoute&)> callback) const;
+
+    /** Returns the number of routes */
+    int size() const noexcept                       { return entries.size(); }
+
+    /** Returns the address of a route, in the order they were added */
+    const String& getAddress (int index) const      { return entries.getReference(index).address; }
+
+    /** Returns a route, in the order they were added */
+    const OSCRoute& getRoute (int index) const      { return entries.getReference(index).route; }
+
+    /** FNV-1a hash of a null terminated address */
+    static uint32 hash (const char* address) noexcept;
+
+private:
+    struct Entry
+    {
+        uint32 hash;
+        String address;
+        OSCRoute route;
+    };
+
+    Array<Entry> entries;
+    HeapBlock<int> slots;
+    int mask = -1;
+
+    void insert (int entry) noexcept;
+    void rehash (int capacity);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (OSCRouteTable)
+};
+
+}
@@ -20,6 +20,7 @@
 */
 
 #include "engine/Parameter.h"
+#include "engine/ParameterChangeSet.h"
 
 namespace Element {
 
@@ -75,12 +76,23 @@ void Parameter::endChangeGesture()
 
 void Parameter::sendValueChangedMessageToListeners (float newValue)
 {
+    if (auto* const set = changes.get())
+        set->mark (getParameterIndex());
+
     ScopedLock lock (listenerLock);
     for (int i = listeners.size(); --i >= 0;)
         if (auto* l = listeners [i])
             l->controlValueChanged (getParameterIndex(), newValue);
 }
 
+void Parameter::sendValueChangedMessageToObservers()
+{
+    jassert (MessageManager::getInstance()->isThisTheMessageThread());
+    for (int i = observers.size(); --i >= 0;)
+        if (auto* const observer = observers [i])
+            observer->handleNewParameterValue();
+}
+
 void Parameter::sendGestureChangedMessageToListeners (bool touched)
 {
     ScopedLock lock (listenerLock);
@@ -25,6 +25,9 @@
 
 namespace Element {
 
+class ParameterChangeSet;
+class ParameterListener;
+
 /** An abstract base class for parameter objects that can be added to a Node
     Based on juce::AudioProcessorParameter, but designed for GraphNodes which 
     can change parameters.
@@ -290,6 +293,7 @@ public:
 
 private:
     friend class GraphNode;
+    friend class ParameterListener;
 
     //==============================================================================
     int parameterIndex = -1;
@@ -297,6 +301,10 @@ private:
     Array<Listener*> listeners;
     mutable StringArray valueStrings;
 
+    Atomic<ParameterChangeSet*> changes { nullptr };
+    Array<ParameterListener*> observers;
+    void sendValueChangedMessageToObservers();
+
    #if JUCE_DEBUG
     bool isPerformingGesture = false;
    #endif
@@ -345,22 +353,24 @@ private:
     float value { 0.0 };
 };
 
-class ParameterListener : private Parameter::Listener,
-                          private Timer
+/** Receives value changes of a node parameter on the message thread.
+
+    Changes are coalesced by the node's ParameterChangeSet, so a parameter
+    that changes many times between two dispatches is reported once.
+ */
+class ParameterListener
 {
 public:
     ParameterListener (Parameter::Ptr param)
         : parameter (param)
     {
         jassert (parameter != nullptr);
-        parameter->addListener (this);
-        startTimer (100);
+        parameter->observers.addIfNotAlreadyThere (this);
     }
 
-    ~ParameterListener() override
+    virtual ~ParameterListener()
     {
-        stopTimer();
-        parameter->removeListener (this);
+        parameter->observers.removeFirstMatchingValue (this);
         parameter = nullptr;
     }
 
@@ -369,32 +379,7 @@ public:
     virtual void handleNewParameterValue() = 0;
 
 private:
-    //==============================================================================
-  
-    void controlValueChanged (int, float) override
-    {
-        parameterValueHasChanged = 1;
-    }
-
-    void controlTouched (int, bool) override {}
-
-    //==============================================================================
-
-    void timerCallback() override
-    {
-        if (parameterValueHasChanged.compareAndSetBool (0, 1))
-        {
-            handleNewParameterValue();
-            startTimerHz (50);
-        }
-        else
-        {
-            startTimer (jmin (250, getTimerInterval() + 10));
-        }
-    }
-
     Parameter::Ptr parameter;
-    Atomic<int> parameterValueHasChanged { 0 };
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ParameterListener)
 };
@@ -0,0 +1,130 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "engine/ParameterChangeSet.h"
+
+namespace Element {
+
+static Atomic<int> sDispatchRate { 30 };
+
+struct ParameterChangeSet::Dispatcher : private Timer
+{
+    Dispatcher()    { startTimerHz (sDispatchRate.get()); }
+    ~Dispatcher()   { stopTimer(); }
+
+    void add (ParameterChangeSet* set)
+    {
+        const ScopedLock sl (lock);
+        sets.addIfNotAlreadyThere (set);
+    }
+
+    void remove (ParameterChangeSet* set)
+    {
+        const ScopedLock sl (lock);
+        sets.removeFirstMatchingValue (set);
+    }
+
+    void timerCallback() override
+    {
+        const int rate = jlimit (1, 100, sDispatchRate.get());
+        if (getTimerInterval() != 1000 / rate)
+            startTimerHz (rate);
+
+        const ScopedLock sl (lock);
+        // sets can be removed by the callbacks, so check the size each time
+        for (int i = 0; i < sets.size(); ++i)
+            if (auto* const set = sets.getUnchecked (i))
+                if (set->isDirty())
+                    set->dispatch();
+    }
+
+    CriticalSection lock;
+    Array<ParameterChangeSet*> sets;
+};
+
+ParameterChangeSet::ParameterChangeSet()
+{
+    dispatcher->add (this);
+}
+
+ParameterChangeSet::~ParameterChangeSet()
+{
+    dispatcher->remove (this);
+}
+
+void ParameterChangeSet::setDispatchRate (int hz)
+{
+    sDispatchRate.set (jlimit (1, 100, hz));
+}
+
+void ParameterChangeSet::setNumParameters (int numParameters)
+{
+    const int numNeeded = (numParameters + 31) / 32;
+    const int numOld = numWords.load (std::memory_order_acquire);
+    if (numNeeded <= numOld)
+        return;
+
+    // old blocks are kept until destruction in case another thread is still
+    // marking them
+    auto* const block = blocks.add (new HeapBlock<std::atomic<uint32>> ((size_t) numNeeded, true));
+    if (auto* const old = words.load (std::memory_order_acquire))
+        for (int i = 0; i < numOld; ++i)
+            (*block)[i].store (old[i].exchange (0));
+
+    words.store (block->get(), std::memory_order_release);
+    numWords.store (numNeeded, std::memory_order_release);
+}
+
+void ParameterChangeSet::mark (int index) noexcept
+{
+    const int size = numWords.load (std::memory_order_acquire);
+    if (! isPositiveAndBelow (index, size * 32))
+        return;
+
+    words.load (std::memory_order_acquire)[index >> 5].fetch_or (1u << (index & 31), std::memory_order_relaxed);
+    dirty.store (true, std::memory_order_release);
+}
+
+int ParameterChangeSet::collect (Array<int>& indexes)
+{
+    indexes.clearQuick();
+    if (! dirty.exchange (false, std::memory_order_acq_rel))
+        return 0;
+
+    const int size = numWords.load (std::memory_order_acquire);
+    auto* const bits = words.load (std::memory_order_acquire);
+
+    for (int i = 0; i < size; ++i)
+    {
+        auto word = bits[i].exchange (0, std::memory_order_acq_rel);
+        for (int bit = 0; word != 0; ++bit, word >>= 1)
+            if ((word & 1u) != 0)
+                indexes.add (i * 32 + bit);
+    }
+
+    return indexes.size();
+}
+
+void ParameterChangeSet::dispatch()
+{
+    if (collect (batch) > 0 && onChanged)
+        onChanged (batch);
+}
+
+}
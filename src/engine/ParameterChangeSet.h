@@ -0,0 +1,78 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "ElementApp.h"
+
+namespace Element {
+
+/** A lock-free set of changed parameter indexes.
+
+    Changes can be marked from any thread, including the audio thread. A timer
+    shared by all sets collects the marked indexes on the message thread at a
+    bounded rate and passes them to onChanged in a single batch. Repeated
+    changes to a parameter between two dispatches are only reported once.
+ */
+class ParameterChangeSet
+{
+public:
+    ParameterChangeSet();
+    ~ParameterChangeSet();
+
+    /** Called on the message thread with the indexes which changed since
+        the last call, in ascending order */
+    std::function<void(const Array<int>&)> onChanged;
+
+    /** Make room for a number of parameters. The set never shrinks. Call
+        this on the message thread */
+    void setNumParameters (int numParameters);
+
+    /** Mark a parameter as changed. Safe to call from any thread */
+    void mark (int index) noexcept;
+
+    /** Returns true if anything has been marked since the last collect() */
+    bool isDirty() const noexcept { return dirty.load (std::memory_order_acquire); }
+
+    /** Moves the marked indexes into an array and clears them
+
+        @returns the number of indexes collected
+     */
+    int collect (Array<int>& indexes);
+
+    /** Collects changes and calls onChanged if there were any */
+    void dispatch();
+
+    /** Set how often changes are dispatched, in Hz */
+    static void setDispatchRate (int hz);
+
+private:
+    struct Dispatcher;
+    SharedResourcePointer<Dispatcher> dispatcher;
+
+    std::atomic<std::atomic<uint32>*> words { nullptr };
+    std::atomic<int> numWords { 0 };
+    std::atomic<bool> dirty { false };
+    OwnedArray<HeapBlock<std::atomic<uint32>>> blocks;
+    Array<int> batch;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ParameterChangeSet)
+};
+
+}
@@ -0,0 +1,106 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "engine/ParameterEventQueue.h"
+
+namespace Element {
+
+ParameterEventQueue::ParameterEventQueue (int capacity)
+    : fifo (jmax (2, capacity))
+{
+    slots.calloc ((size_t) fifo.getTotalSize());
+    events.calloc ((size_t) fifo.getTotalSize());
+}
+
+ParameterEventQueue::~ParameterEventQueue() { }
+
+void ParameterEventQueue::prepare (double newSampleRate)
+{
+    jassert (newSampleRate > 0.0);
+    sampleRate = newSampleRate;
+}
+
+bool ParameterEventQueue::post (int parameter, float value, double timeMs)
+{
+    const SpinLock::ScopedLockType sl (writeLock);
+
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite (1, start1, size1, start2, size2);
+    if (size1 + size2 <= 0)
+        return false;
+
+    auto& event = slots [size1 > 0 ? start1 : start2];
+    event.parameter = parameter;
+    event.value     = value;
+    event.time      = timeMs;
+    event.frame     = 0;
+    fifo.finishedWrite (1);
+    return true;
+}
+
+int ParameterEventQueue::collect (int numSamples, int granularity) noexcept
+{
+    numEvents = 0;
+    const int numReady = fifo.getNumReady();
+    if (numReady <= 0 || numSamples <= 0)
+        return 0;
+
+    const double now = Time::getMillisecondCounterHiRes();
+    const double blockStart = now - (1000.0 * numSamples / sampleRate);
+    const double samplesPerMs = sampleRate * 0.001;
+
+    int start1, size1, start2, size2;
+    fifo.prepareToRead (numReady, start1, size1, start2, size2);
+
+    int numRead = 0;
+    for (int i = 0; i < size1 + size2; ++i)
+    {
+        const auto& event = slots [i < size1 ? start1 + i : start2 + i - size1];
+
+        // posted after this block started, leave it for the next one
+        if (event.time >= now)
+            break;
+
+        int frame = 0;
+        if (granularity > 0)
+        {
+            frame = jlimit (0, numSamples - 1, roundToInt ((event.time - blockStart) * samplesPerMs));
+            if (granularity > 1)
+                frame -= frame % granularity;
+        }
+
+        // insertion keeps events sorted by frame and in posted order
+        int index = numEvents;
+        while (index > 0 && events [index - 1].frame > frame)
+        {
+            events [index] = events [index - 1];
+            --index;
+        }
+
+        events [index] = event;
+        events [index].frame = frame;
+        ++numEvents;
+        ++numRead;
+    }
+
+    fifo.finishedRead (numRead);
+    return numEvents;
+}
+
+}
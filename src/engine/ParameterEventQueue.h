@@ -0,0 +1,100 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "ElementApp.h"
+
+namespace Element {
+
+/** A timestamped parameter change */
+struct ParameterEvent
+{
+    /** Index of the parameter in the node's parameter array */
+    int parameter = -1;
+
+    /** The new normalized value */
+    float value = 0.f;
+
+    /** When the event was posted, in Time::getMillisecondCounterHiRes() units */
+    double time = 0.0;
+
+    /** Sample offset in the current block. Set when the event is collected */
+    int frame = 0;
+};
+
+/** A queue of parameter changes for a single node.
+
+    Control threads post events stamped with the time they happened. Each
+    block, the audio thread collects the events which arrived during the
+    previous block and places them at the matching sample offsets, so changes
+    land with a constant one block latency instead of jittering with the
+    callback.
+ */
+class ParameterEventQueue
+{
+public:
+    explicit ParameterEventQueue (int capacity = 128);
+    ~ParameterEventQueue();
+
+    /** Set the sample rate used to convert event times to sample offsets */
+    void prepare (double sampleRate);
+
+    /** Post an event. Can be called from any non-realtime thread.
+
+        @returns false if the queue is full
+     */
+    bool post (int parameter, float value, double timeMs);
+
+    /** Moves events posted before now into the current block, sorted by
+        sample offset. Call this on the audio thread once per block.
+
+        @param numSamples   The size of the block
+        @param granularity  Offsets are rounded down to a multiple of this. If
+                            less than 1, every event is placed at the start of
+                            the block.
+
+        @returns the number of events in the block
+     */
+    int collect (int numSamples, int granularity) noexcept;
+
+    /** Returns the number of events collected for the current block */
+    int getNumEvents() const noexcept { return numEvents; }
+
+    /** Returns a collected event */
+    const ParameterEvent& getEvent (int index) const noexcept
+    {
+        jassert (isPositiveAndBelow (index, numEvents));
+        return events [index];
+    }
+
+    /** Returns the number of events waiting to be collected */
+    int getNumPending() const noexcept { return fifo.getNumReady(); }
+
+private:
+    AbstractFifo fifo;
+    HeapBlock<ParameterEvent> slots, events;
+    int numEvents = 0;
+    double sampleRate = 44100.0;
+    SpinLock writeLock;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ParameterEventQueue)
+};
+
+}
@@ -0,0 +1,447 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "engine/PartitionedConvolver.h"
+
+namespace Element {
+
+static int getFFTOrder (int size) noexcept
+{
+    int order = 0;
+    while ((1 << order) < size)
+        ++order;
+    return order;
+}
+
+/** One run of uniform partitions. Spectra are stored split, all real parts
+    followed by all imaginary parts, so the complex multiply-accumulate over
+    partitions runs on contiguous arrays.
+ */
+struct PartitionedConvolver::Stage
+{
+    enum State { idle = 0, pending, running, done };
+
+    Stage (const float* impulse, int length, int partitionSize, int partitions,
+           bool isImmediate, bool isBackground)
+        : size (partitionSize),
+          numBins (partitionSize + 1),
+          numPartitions (partitions),
+          immediate (isImmediate),
+          background (isBackground),
+          fft (getFFTOrder (2 * partitionSize))
+    {
+        filters.calloc ((size_t) (numPartitions * 2 * numBins));
+        history.calloc ((size_t) (numPartitions * 2 * numBins));
+        accumulator.calloc ((size_t) (2 * numBins));
+        buffer.calloc ((size_t) (4 * size));
+
+        for (auto* block : { &input, &jobInput, &previousInput, &output, &result, &lateInput })
+            block->calloc ((size_t) size);
+
+        for (int p = 0; p < numPartitions; ++p)
+        {
+            const int num = jmin (size, length - p * size);
+            FloatVectorOperations::clear (buffer, 4 * size);
+            if (num > 0)
+                FloatVectorOperations::copy (buffer, impulse + p * size, num);
+            fft.performRealOnlyForwardTransform (buffer, true);
+            storeSpectrum (filters + p * 2 * numBins);
+        }
+    }
+
+    void reset() noexcept
+    {
+        int expected = pending;
+        state.compare_exchange_strong (expected, (int) idle);
+
+        // a job the worker is computing can't be stopped, so its buffers
+        // are cleared when it is collected
+        if (state.load() == running)
+        {
+            stale = true;
+        }
+        else
+        {
+            clearJob();
+            state.store (idle);
+        }
+
+        for (auto* block : { &input, &output, &lateInput })
+            FloatVectorOperations::clear (*block, size);
+        pos = numDropped = 0;
+        late = false;
+    }
+
+    /** Clears what the worker uses, only while it doesn't have a job */
+    void clearJob() noexcept
+    {
+        FloatVectorOperations::clear (history, numPartitions * 2 * numBins);
+        for (auto* block : { &jobInput, &previousInput, &result })
+            FloatVectorOperations::clear (*block, size);
+        historyPos = 0;
+        stale = false;
+    }
+
+    /** Adds this stage's output to a block, which must not cross a partition.
+        Returns true if a job was posted for the worker */
+    bool process (const float* in, float* out, int num) noexcept
+    {
+        FloatVectorOperations::copy (input + pos, in, num);
+        FloatVectorOperations::add (out, output + pos, num);
+        pos += num;
+        if (pos < size)
+            return false;
+
+        pos = 0;
+        if (immediate)
+        {
+            jobInput.swapWith (input);
+            compute();
+            output.swapWith (result);
+            return false;
+        }
+
+        if (! collect())
+        {
+            // the worker is still computing the last job. Rather than wait
+            // for it, this stage is silent for a partition and the input is
+            // kept until the job is done. Further input while it is late is
+            // lost
+            FloatVectorOperations::clear (output, size);
+            if (late)
+                ++numDropped;
+            late = true;
+            lateInput.swapWith (input);
+            overruns.store (overruns.load() + 1);
+            return false;
+        }
+
+        jobInput.swapWith (input);
+        if (background)
+        {
+            state.store (pending);
+            return true;
+        }
+
+        compute();
+        state.store (done);
+        return false;
+    }
+
+    /** Takes the result of the job posted one partition ago. If the worker
+        hasn't started it, it is computed here. Returns false without
+        waiting if the worker is still busy with it.
+     */
+    bool collect() noexcept
+    {
+        if (! runPendingJob() && state.load() == running)
+            return false;
+
+        if (state.load() == done)
+        {
+            if (stale)
+                clearJob();
+            else if (! late)
+                output.swapWith (result);
+            state.store (idle);
+        }
+
+        if (late)
+            catchUp();
+        return true;
+    }
+
+    /** After an overrun, the result of the late job is out of date. Lost
+        input counts as silence, then the kept input is computed here since
+        its output is due now */
+    void catchUp() noexcept
+    {
+        if (numDropped > 0)
+        {
+            for (; numDropped > 0; --numDropped)
+            {
+                FloatVectorOperations::clear (history + historyPos * 2 * numBins, 2 * numBins);
+                historyPos = (historyPos + 1) % numPartitions;
+            }
+            FloatVectorOperations::clear (previousInput, size);
+        }
+
+        jobInput.swapWith (lateInput);
+        compute();
+        output.swapWith (result);
+        late = false;
+    }
+
+    bool runPendingJob() noexcept
+    {
+        int expected = pending;
+        if (! state.compare_exchange_strong (expected, (int) running))
+            return false;
+        compute();
+        state.store (done);
+        return true;
+    }
+
+    void compute() noexcept
+    {
+        // overlap-save: transform the last two blocks of input
+        FloatVectorOperations::copy (buffer, previousInput, size);
+        FloatVectorOperations::copy (buffer + size, jobInput, size);
+        FloatVectorOperations::clear (buffer + 2 * size, 2 * size);
+        fft.performRealOnlyForwardTransform (buffer, true);
+        storeSpectrum (history + historyPos * 2 * numBins);
+
+        FloatVectorOperations::clear (accumulator, 2 * numBins);
+        for (int p = 0, slot = historyPos; p < numPartitions; ++p)
+        {
+            multiplyAdd (history + slot * 2 * numBins, filters + p * 2 * numBins);
+            slot = (slot > 0 ? slot : numPartitions) - 1;
+        }
+
+        historyPos = (historyPos + 1) % numPartitions;
+
+        // the inverse transform takes the full, conjugate symmetric, spectrum
+        const int fftSize = 2 * size;
+        const float* const re = accumulator;
+        const float* const im = accumulator + numBins;
+        for (int i = 0; i < numBins; ++i)
+        {
+            buffer[2 * i]     = re[i];
+            buffer[2 * i + 1] = im[i];
+        }
+        for (int i = 1; i < size; ++i)
+        {
+            buffer[2 * (fftSize - i)]     = re[i];
+            buffer[2 * (fftSize - i) + 1] = -im[i];
+        }
+
+        fft.performRealOnlyInverseTransform (buffer);
+        FloatVectorOperations::copy (result, buffer + size, size);
+        previousInput.swapWith (jobInput);
+    }
+
+    void storeSpectrum (float* dest) const noexcept
+    {
+        for (int i = 0; i < numBins; ++i)
+        {
+            dest[i]           = buffer[2 * i];
+            dest[numBins + i] = buffer[2 * i + 1];
+        }
+    }
+
+    void multiplyAdd (const float* a, const float* b) noexcept
+    {
+        float* const accRe = accumulator;
+        float* const accIm = accumulator + numBins;
+        const float* const aRe = a;
+        const float* const aIm = a + numBins;
+        const float* const bRe = b;
+        const float* const bIm = b + numBins;
+
+        for (int i = 0; i < numBins; ++i)
+        {
+            accRe[i] += aRe[i] * bRe[i] - aIm[i] * bIm[i];
+            accIm[i] += aRe[i] * bIm[i] + aIm[i] * bRe[i];
+        }
+    }
+
+    const int size, numBins, numPartitions;
+    const bool immediate, background;
+    dsp::FFT fft;
+
+    HeapBlock<float> filters, history, accumulator, buffer;
+    HeapBlock<float> input, jobInput, previousInput, output, result, lateInput;
+    int historyPos = 0;
+    int pos = 0;
+    int numDropped = 0;
+    bool late = false, stale = false;
+    std::atomic<int> state { idle };
+    std::atomic<int> overruns { 0 };
+};
+
+//==============================================================================
+PartitionedConvolver::PartitionedConvolver (const float* impulse, int length, int maxBlockSize,
+                                            int headSizeIn, int maxPartitionSize)
+    : impulseLength (jmax (0, length)),
+      headSize (jmax (1, headSizeIn))
+{
+    jassert (isPowerOfTwo (headSize) && isPowerOfTwo (maxPartitionSize));
+    jassert (maxPartitionSize >= headSize);
+
+    headLength = jmin (headSize, impulseLength);
+    head.calloc ((size_t) headSize);
+    headInput.calloc ((size_t) (2 * headSize));
+    if (headLength > 0)
+        FloatVectorOperations::copy (head, impulse, headLength);
+
+    // each stage starts where its output is due, one partition after its
+    // input for the first stage and two for the rest
+    int size = headSize, start = headSize;
+    while (start < impulseLength)
+    {
+        const int nextSize = jmin (size * 8, jmax (size, maxPartitionSize));
+        const int end = nextSize > size ? jmin (2 * nextSize, impulseLength) : impulseLength;
+        const bool immediate = stages.isEmpty();
+        const bool background = ! immediate && size >= 2 * maxBlockSize;
+
+        stages.add (new Stage (impulse + start, end - start, size,
+                               (end - start + size - 1) / size,
+                               immediate, background));
+        start = end;
+        size = nextSize;
+    }
+}
+
+PartitionedConvolver::~PartitionedConvolver() { }
+
+int PartitionedConvolver::getNumBackgroundStages() const noexcept
+{
+    int num = 0;
+    for (const auto* stage : stages)
+        if (stage->background)
+            ++num;
+    return num;
+}
+
+int PartitionedConvolver::getNumOverruns() const noexcept
+{
+    int num = 0;
+    for (const auto* stage : stages)
+        num += stage->overruns.load();
+    return num;
+}
+
+void PartitionedConvolver::reset()
+{
+    FloatVectorOperations::clear (headInput, 2 * headSize);
+    headPos = 0;
+    for (auto* stage : stages)
+        stage->reset();
+}
+
+void PartitionedConvolver::process (const float* input, float* output, int numSamples) noexcept
+{
+    // blocks are split on the head size, which every partition is a multiple of
+    bool posted = false;
+    while (numSamples > 0)
+    {
+        const int num = jmin (numSamples, headSize - headPos);
+
+        // direct form head, summed per output sample in tap order
+        float* const x = headInput + headSize - 1;
+        FloatVectorOperations::copy (x, input, num);
+        FloatVectorOperations::clear (output, num);
+        for (int k = 0; k < headLength; ++k)
+            FloatVectorOperations::addWithMultiply (output, x - k, head[k], num);
+        memmove (headInput, headInput + num, (size_t) (headSize - 1) * sizeof (float));
+
+        for (auto* stage : stages)
+            if (stage->process (input, output, num))
+                posted = true;
+
+        headPos = (headPos + num) % headSize;
+        input += num;
+        output += num;
+        numSamples -= num;
+    }
+
+    if (posted)
+        if (auto* const w = worker.load())
+            w->notify();
+}
+
+bool PartitionedConvolver::runPendingJobs()
+{
+    bool ran = false;
+    for (auto* stage : stages)
+        if (stage->background && stage->runPendingJob())
+            ran = true;
+    return ran;
+}
+
+//==============================================================================
+ConvolutionWorker::ConvolutionWorker()
+    : Thread ("ConvolutionWorker") { }
+
+ConvolutionWorker::~ConvolutionWorker()
+{
+    stop();
+}
+
+void ConvolutionWorker::start()
+{
+    if (! isThreadRunning())
+        startThread (7);
+}
+
+void ConvolutionWorker::stop()
+{
+    stopThread (1000);
+}
+
+void ConvolutionWorker::add (PartitionedConvolver* convolver)
+{
+    const ScopedLock sl (lock);
+    convolvers.addIfNotAlreadyThere (convolver);
+    convolver->worker.store (this);
+}
+
+void ConvolutionWorker::remove (PartitionedConvolver* convolver)
+{
+    {
+        const ScopedLock sl (lock);
+        convolvers.removeFirstMatchingValue (convolver);
+        convolver->worker.store (nullptr);
+    }
+
+    // only the convolver being computed holds this up, and only until its jobs finish
+    while (current.load() == convolver)
+        Thread::yield();
+}
+
+void ConvolutionWorker::run()
+{
+    while (! threadShouldExit())
+    {
+        bool ran = false;
+
+        // the lock is only held to pick the next convolver, so adding and
+        // removing others doesn't wait for a job
+        for (int i = 0;; ++i)
+        {
+            PartitionedConvolver* convolver = nullptr;
+            {
+                const ScopedLock sl (lock);
+                if (i < convolvers.size())
+                    convolver = convolvers.getUnchecked (i);
+                current.store (convolver);
+            }
+
+            if (convolver == nullptr)
+                break;
+            if (convolver->runPendingJobs())
+                ran = true;
+        }
+
+        if (! ran)
+            wait (-1);
+    }
+}
+
+}
@@ -0,0 +1,137 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "ElementApp.h"
+
+namespace Element {
+
+class ConvolutionWorker;
+
+/** Convolves one channel with an impulse response, without latency.
+
+    The first headSize taps are applied in direct form. The rest of the
+    response is split into stages of uniform FFT partitions, overlap-save
+    with a frequency domain delay line. The first stage uses partitions the
+    size of the head, each later stage uses partitions eight times larger,
+    up to maxPartitionSize.
+
+    Every stage after the first starts two of its partitions into the
+    response, so a block of input has one partition period to be computed
+    before its output is due. Stages with partitions of at least twice the
+    block size are handed to a ConvolutionWorker for that time, which is
+    woken when a job is posted. If the worker
+    hasn't started a job when its output is due the audio thread computes it
+    instead, so the output doesn't depend on the worker. If the worker is
+    still computing it, the audio thread doesn't wait: the stage is silent
+    for a partition and the overrun is counted.
+ */
+class PartitionedConvolver
+{
+public:
+    enum { defaultHeadSize = 64, defaultMaxPartitionSize = 16384 };
+
+    /** Create a convolver. The impulse response is copied.
+
+        @param impulse          The impulse response
+        @param impulseLength    Number of samples in the impulse response
+        @param maxBlockSize     Largest block process() is expected to see
+        @param headSize         Taps applied directly, a power of two
+        @param maxPartitionSize Largest FFT partition, a power of two of at least headSize
+     */
+    PartitionedConvolver (const float* impulse, int impulseLength, int maxBlockSize,
+                          int headSize = defaultHeadSize,
+                          int maxPartitionSize = defaultMaxPartitionSize);
+    ~PartitionedConvolver();
+
+    /** Returns the length of the impulse response */
+    int getImpulseLength() const noexcept       { return impulseLength; }
+
+    /** Returns the number of FFT stages */
+    int getNumStages() const noexcept           { return stages.size(); }
+
+    /** Returns the number of stages that can be computed on a worker */
+    int getNumBackgroundStages() const noexcept;
+
+    /** Returns how many times a stage's output was due while the worker
+        was still computing it */
+    int getNumOverruns() const noexcept;
+
+    /** Clears the input history. Don't call this while processing */
+    void reset();
+
+    /** Convolves a block of input. The output replaces the contents of
+        output, which must not overlap input.
+     */
+    void process (const float* input, float* output, int numSamples) noexcept;
+
+private:
+    friend class ConvolutionWorker;
+    struct Stage;
+
+    const int impulseLength;
+    const int headSize;
+    int headLength = 0;
+    int headPos = 0;
+    HeapBlock<float> head;
+    HeapBlock<float> headInput;
+    OwnedArray<Stage> stages;
+    std::atomic<ConvolutionWorker*> worker { nullptr };
+
+    /** Computes jobs posted for the worker. Returns true if any ran */
+    bool runPendingJobs();
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PartitionedConvolver)
+};
+
+/** Computes the background stages of PartitionedConvolvers on one thread.
+    Add and remove convolvers from the message thread. The thread sleeps
+    until a convolver it computes for posts a job.
+ */
+class ConvolutionWorker : private Thread
+{
+public:
+    ConvolutionWorker();
+    ~ConvolutionWorker();
+
+    /** Start the worker thread */
+    void start();
+
+    /** Stop the worker thread. Pending jobs are then computed by the audio thread */
+    void stop();
+
+    /** Adds a convolver to compute jobs for */
+    void add (PartitionedConvolver* convolver);
+
+    /** Removes a convolver, waiting for a job in progress to finish */
+    void remove (PartitionedConvolver* convolver);
+
+private:
+    friend class PartitionedConvolver;
+    CriticalSection lock;
+    Array<PartitionedConvolver*> convolvers;
+    std::atomic<PartitionedConvolver*> current { nullptr };
+
+    void run() override;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ConvolutionWorker)
+};
+
+}
@@ -0,0 +1,145 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "engine/SignalProbe.h"
+
+namespace Element {
+
+SignalProbe::SignalProbe (PortType t, int capacity, int d)
+    : type (t),
+      decimation (jmax (1, d)),
+      audioFifo (t == PortType::Audio ? jmax (2, capacity + 1) : 2)
+{
+    jassert (type == PortType::Audio || type == PortType::Midi);
+    if (type == PortType::Midi)
+    {
+        midi.reset (new MidiEventFifo (jmax (2, capacity), jmax (64, capacity * 8)));
+        scratch.calloc ((size_t) midi->getDataCapacity());
+    }
+    else
+    {
+        audio.calloc ((size_t) audioFifo.getTotalSize());
+    }
+}
+
+SignalProbe::~SignalProbe() { }
+
+//=============================================================================
+void SignalProbe::writeAudio (const float* samples, int numSamples) noexcept
+{
+    if (type != PortType::Audio || numSamples <= 0)
+        return;
+
+    const auto range = FloatVectorOperations::findMinAndMax (samples, numSamples);
+    const float blockPeak = jmax (std::abs (range.getStart()), std::abs (range.getEnd()));
+    if (blockPeak > peak.load())
+        peak.store (blockPeak);
+
+    // number of samples kept from this block, continuing the last block's phase
+    const int numKept = phase < numSamples ? 1 + (numSamples - 1 - phase) / decimation : 0;
+    const int numToWrite = jmin (numKept, audioFifo.getFreeSpace());
+    if (numToWrite < numKept)
+        numDropped.fetch_add (numKept - numToWrite);
+
+    int start1, size1, start2, size2;
+    audioFifo.prepareToWrite (numToWrite, start1, size1, start2, size2);
+    const float* src = samples + phase;
+
+    if (decimation == 1)
+    {
+        FloatVectorOperations::copy (audio + start1, src, size1);
+        if (size2 > 0)
+            FloatVectorOperations::copy (audio + start2, src + size1, size2);
+    }
+    else
+    {
+        for (int i = 0; i < size1; ++i, src += decimation)
+            audio[start1 + i] = *src;
+        for (int i = 0; i < size2; ++i, src += decimation)
+            audio[start2 + i] = *src;
+    }
+
+    audioFifo.finishedWrite (size1 + size2);
+    phase = phase + numKept * decimation - numSamples;
+}
+
+void SignalProbe::writeMidi (const MidiBuffer& buffer, int numSamples, double sampleRate) noexcept
+{
+    if (type != PortType::Midi || buffer.isEmpty())
+        return;
+
+    const double blockMs = Time::getMillisecondCounterHiRes();
+    MidiBuffer::Iterator iter (buffer);
+    const uint8* data = nullptr;
+    int size = 0, frame = 0;
+
+    while (iter.getNextEvent (data, size, frame))
+    {
+        if (frame >= numSamples)
+            break;
+        if (! midi->push (blockMs + 1000.0 * frame / sampleRate, data, size))
+            numDropped.fetch_add (1);
+    }
+}
+
+//=============================================================================
+int SignalProbe::getNumReady() const noexcept
+{
+    return type == PortType::Midi ? midi->getNumReady() : audioFifo.getNumReady();
+}
+
+int SignalProbe::readAudio (float* dest, int maxSamples) noexcept
+{
+    if (type != PortType::Audio || maxSamples <= 0)
+        return 0;
+
+    int start1, size1, start2, size2;
+    audioFifo.prepareToRead (maxSamples, start1, size1, start2, size2);
+    if (size1 > 0)
+        FloatVectorOperations::copy (dest, audio + start1, size1);
+    if (size2 > 0)
+        FloatVectorOperations::copy (dest + size1, audio + start2, size2);
+    audioFifo.finishedRead (size1 + size2);
+    return size1 + size2;
+}
+
+bool SignalProbe::readMidi (MidiMessage& message)
+{
+    double timeMs = 0.0;
+    if (type != PortType::Midi || ! midi->getNextTime (timeMs))
+        return false;
+
+    const int size = midi->pop (scratch, midi->getDataCapacity());
+    if (size <= 0)
+        return false;
+
+    message = MidiMessage (scratch.getData(), size, timeMs);
+    return true;
+}
+
+void SignalProbe::clear() noexcept
+{
+    if (type == PortType::Midi)
+        midi->clear();
+    else
+        audioFifo.finishedRead (audioFifo.getNumReady());
+    peak.store (0.f);
+}
+
+}
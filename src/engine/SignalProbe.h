@@ -0,0 +1,119 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "ElementApp.h"
+#include "engine/MidiEventFifo.h"
+
+namespace Element {
+
+/** Reads the signal of a node output while the graph is running.
+
+    A probe is attached to an audio or MIDI output port with
+    GraphProcessor::attachProbe() and sees what every connection from that
+    port carries. The audio thread copies into a preallocated lock-free ring,
+    so writing never locks or allocates. Audio can be decimated to keep only
+    every Nth sample, which is plenty for scopes and meters.
+
+    One thread may read at a time, e.g. a GUI timer, a script or the OSC
+    feedback thread. Data which doesn't fit because nobody is reading is
+    dropped and counted.
+ */
+class SignalProbe : public ReferenceCountedObject
+{
+public:
+    using Ptr = ReferenceCountedObjectPtr<SignalProbe>;
+
+    /** Create a probe
+
+        @param type         PortType::Audio or PortType::Midi
+        @param capacity     Samples kept after decimation, or messages for MIDI
+        @param decimation   Keep every Nth audio sample
+     */
+    SignalProbe (PortType type, int capacity = 8192, int decimation = 1);
+    ~SignalProbe();
+
+    /** Returns the type of port this probe reads */
+    PortType getType() const noexcept               { return type; }
+
+    /** Returns the audio decimation factor */
+    int getDecimation() const noexcept              { return decimation; }
+
+    //=========================================================================
+    /** Copies a block of audio into the ring. Called on the audio thread */
+    void writeAudio (const float* samples, int numSamples) noexcept;
+
+    /** Copies a block of MIDI into the ring, stamped with the
+        Time::getMillisecondCounterHiRes() clock. Called on the audio thread */
+    void writeMidi (const MidiBuffer& buffer, int numSamples, double sampleRate) noexcept;
+
+    //=========================================================================
+    /** Returns the number of samples or messages waiting to be read */
+    int getNumReady() const noexcept;
+
+    /** Reads up to maxSamples of audio. Returns the number read */
+    int readAudio (float* dest, int maxSamples) noexcept;
+
+    /** Reads the next MIDI message. Returns false if there isn't one */
+    bool readMidi (MidiMessage& message);
+
+    /** Returns the highest absolute sample value written since the last call */
+    float readPeak() noexcept                       { return peak.exchange (0.f); }
+
+    /** Discards everything waiting to be read. Call from the reading thread */
+    void clear() noexcept;
+
+    /** Returns the number of samples or messages dropped because the ring was full */
+    int64 getNumDropped() const noexcept            { return numDropped.load(); }
+
+private:
+    const PortType type;
+    const int decimation;
+    int phase = 0;
+
+    AbstractFifo audioFifo;
+    HeapBlock<float> audio;
+    std::unique_ptr<MidiEventFifo> midi;
+    HeapBlock<uint8> scratch;
+
+    std::atomic<float> peak { 0.f };
+    std::atomic<int64> numDropped { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SignalProbe)
+};
+
+/** The probes attached to one node's outputs. Built on the message thread and
+    swapped into the node on the audio thread, so the render loop only checks
+    a pointer when nothing is attached.
+ */
+struct SignalTaps
+{
+    struct Tap
+    {
+        PortType type;
+        int channel;
+        SignalProbe::Ptr probe;
+    };
+
+    Array<Tap> taps;
+    double sampleRate = 44100.0;
+};
+
+}
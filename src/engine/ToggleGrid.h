@@ -40,23 +40,16 @@ public:
         resize (matrix.getNumRows(), matrix.getNumColumns());
         for (int i = 0; i < matrix.getNumRows(); ++i)
             for (int o = 0; o < matrix.getNumColumns(); ++o)
-                toggles[i][o] = matrix.connected (i, o);
-    }
-
-    ~ToggleGrid() noexcept 
-    {
-        free();
+                toggles[i * numOuts + o] = matrix.connected (i, o);
     }
 
+    /** Resizes the grid, the toggles are all off after. This allocates */
     inline void resize (int ins, int outs)
     {
-        free();
         jassert(ins > 0 && outs > 0);
         numIns = ins;
         numOuts = outs;
-        toggles = new bool* [numIns];
-        for (int i = 0; i < numIns; ++i)
-            toggles[i] = new bool [numOuts];
+        toggles.calloc ((size_t) (numIns * numOuts));
     }
 
     inline bool sameSizeAs (const ToggleGrid& other) const noexcept
@@ -71,21 +64,19 @@ public:
 
     inline void clear() noexcept
     {
-        for (int i = 0; i < numIns; ++i)
-            for (int o = 0; o < numOuts; ++o)
-                toggles[i][o] = false;
+        zeromem (toggles, sizeof (bool) * (size_t) (numIns * numOuts));
     }
 
     inline bool get (const int in, const int out) const noexcept
     {
         jassert (isPositiveAndBelow (in, numIns) && isPositiveAndBelow (out, numOuts));
-        return toggles[in][out];
+        return toggles[in * numOuts + out];
     }
 
     inline void set (const int in, const int out, const bool value) noexcept
     {
         jassert (isPositiveAndBelow (in, numIns) && isPositiveAndBelow (out, numOuts));
-        toggles[in][out] = value;
+        toggles[in * numOuts + out] = value;
     }
 
     inline int getNumInputs() const noexcept    { return numIns; }
@@ -93,7 +84,7 @@ public:
 
     inline void swapWith (ToggleGrid& other) noexcept
     {
-        std::swap (toggles, other.toggles);
+        toggles.swapWith (other.toggles);
         std::swap (numIns, other.numIns);
         std::swap (numOuts, other.numOuts);
     }
@@ -102,35 +93,21 @@ public:
     {
         if (sameSizeAs (other))
         {
-            for (int i = 0; i < numIns; ++i)
-                for (int o = 0; o < numOuts; ++o)
-                    toggles[i][o] = other.toggles[i][o];
+            memcpy (toggles, other.toggles, sizeof (bool) * (size_t) (numIns * numOuts));
         }
         else
         {
             for (int i = 0; i < jmin (numIns, other.numIns); ++i)
                 for (int o = 0; o < jmin (numOuts, other.numOuts); ++o)
-                    toggles[i][o] = other.toggles[i][o];
+                    toggles[i * numOuts + o] = other.toggles[i * other.numOuts + o];
         }
 
         return *this;
     }
 
 private:
-    int numIns, numOuts;
-    bool** toggles = nullptr;
-
-    void free()
-    {
-        if (toggles != nullptr)
-        {
-            for (int i = 0; i < numIns; ++i)
-                delete [] toggles [i];
-            delete [] toggles;
-            toggles = nullptr;
-        }
-        numIns = numOuts = 0;
-    }
+    int numIns = 0, numOuts = 0;
+    HeapBlock<bool> toggles;
 };
 
 }
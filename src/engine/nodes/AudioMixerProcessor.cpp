@@ -360,25 +360,101 @@ private:
     }
 };
 
-AudioMixerProcessor::~AudioMixerProcessor()
+//=============================================================================
+/** A track as the audio thread sees it */
+struct AudioMixerProcessor::TrackList
 {
-    Array<Track*> oldTracks;
+    struct Entry
     {
-        ScopedLock sl (getCallbackLock());
-        masterMute = nullptr;
-        masterVolume = nullptr;
-        tracks.swapWith (oldTracks);
+        int firstChannel    = 0;
+        int numChannels     = 0;
+        float gain          = 1.f;  // gain applied at the end of the last block
+        Monitor* monitor    = nullptr;
+    };
+
+    HeapBlock<Entry> entries;
+    int size = 0;
+
+    // keeps the monitors alive, only released on the message thread
+    ReferenceCountedArray<Monitor> monitors;
+};
+
+/** Adds src to dst with a linear gain ramp and returns the sum of the squares
+    of src. Done in one pass with four independent lanes the compiler can
+    vectorize */
+static float addWithRampAndSumSquares (float* dst, const float* src, const int numSamples,
+                                       const float startGain, const float endGain) noexcept
+{
+    const float step = (endGain - startGain) / (float) jmax (1, numSamples);
+    float sums[4] = { 0.f, 0.f, 0.f, 0.f };
+    int i = 0;
+
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        const float gain = startGain + step * (float) i;
+        for (int k = 0; k < 4; ++k)
+        {
+            const float x = src[i + k];
+            dst[i + k] += x * (gain + step * (float) k);
+            sums[k] += x * x;
+        }
     }
 
-    for (auto* t : oldTracks)
-        delete t;
+    float sum = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+    for (; i < numSamples; ++i)
+    {
+        dst[i] += src[i] * (startGain + step * (float) i);
+        sum += src[i] * src[i];
+    }
+
+    return sum;
+}
+
+/** Writes src to dst with a linear gain ramp and returns the sum of the
+    squares of what was written */
+static float copyWithRampAndSumSquares (float* dst, const float* src, const int numSamples,
+                                        const float startGain, const float endGain) noexcept
+{
+    const float step = (endGain - startGain) / (float) jmax (1, numSamples);
+    float sums[4] = { 0.f, 0.f, 0.f, 0.f };
+    int i = 0;
+
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        const float gain = startGain + step * (float) i;
+        for (int k = 0; k < 4; ++k)
+        {
+            const float y = src[i + k] * (gain + step * (float) k);
+            dst[i + k] = y;
+            sums[k] += y * y;
+        }
+    }
+
+    float sum = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+    for (; i < numSamples; ++i)
+    {
+        dst[i] = src[i] * (startGain + step * (float) i);
+        sum += dst[i] * dst[i];
+    }
+
+    return sum;
+}
+
+AudioMixerProcessor::~AudioMixerProcessor()
+{
+    masterMute = nullptr;
+    masterVolume = nullptr;
+    cancelPendingUpdate();
+    delete pending.exchange (nullptr);
+    delete retired.exchange (nullptr);
+    delete active;
+    active = nullptr;
 }
 
 AudioMixerProcessor::MonitorPtr AudioMixerProcessor::getMonitor (const int track) const
 {
     if (track < 0)
         return masterMonitor;
-    ScopedLock sl (getCallbackLock());
     if (! isPositiveAndBelow (track, tracks.size()))
         return nullptr;
     return tracks.getUnchecked(track)->monitor;
@@ -419,10 +495,7 @@ void AudioMixerProcessor::addStereoTrack()
         track->gain         = 1.0;
         track->mute         = false;
         track->monitor      = new Monitor (track->index, track->numOutputs);
-
-        ScopedLock sl (getCallbackLock());
         tracks.add (track);
-        numTracks = tracks.size();
     }
     else
     {
@@ -430,6 +503,56 @@ void AudioMixerProcessor::addStereoTrack()
     }
 }
 
+void AudioMixerProcessor::publishTracks()
+{
+    auto* const list = new TrackList();
+    list->entries.calloc ((size_t) tracks.size());
+
+    for (auto* const track : tracks)
+    {
+        // the channel offsets are looked up here so rendering is linear in tracks
+        if (! isPositiveAndBelow (track->busIdx, getBusCount (true)) || track->monitor == nullptr)
+            continue;
+        auto& entry = list->entries [list->size++];
+        entry.firstChannel  = getChannelIndexInProcessBlockBuffer (true, track->busIdx, 0);
+        entry.numChannels   = jmin (track->numInputs, track->monitor->getNumChannels(),
+                                    getChannelCountOfBus (true, track->busIdx));
+        entry.gain          = track->monitor->nextMute.get() > 0 ? 0.f : track->monitor->nextGain.get();
+        entry.monitor       = track->monitor.get();
+        list->monitors.add (track->monitor);
+    }
+
+    delete retired.exchange (nullptr);
+    delete pending.exchange (list); // one that was never picked up
+}
+
+void AudioMixerProcessor::takePendingTracks() noexcept
+{
+    // the old list can only be handed back once the last one was collected
+    if (retired.load() != nullptr)
+        return;
+    auto* const next = pending.exchange (nullptr);
+    if (next == nullptr)
+        return;
+
+    // tracks that stay keep ramping from where they were
+    if (active != nullptr)
+        for (int i = 0; i < next->size; ++i)
+            for (int j = 0; j < active->size; ++j)
+                if (active->entries[j].monitor == next->entries[i].monitor)
+                    { next->entries[i].gain = active->entries[j].gain; break; }
+
+    retired.store (active);
+    if (active != nullptr)
+        triggerAsyncUpdate();
+    active = next;
+}
+
+void AudioMixerProcessor::handleAsyncUpdate()
+{
+    delete retired.exchange (nullptr);
+}
+
 AudioProcessorEditor* AudioMixerProcessor::createEditor()
 {
     auto* ed = new AudioMixerEditor (*this);
@@ -443,62 +566,77 @@ void AudioMixerProcessor::prepareToPlay (const double sampleRate, const int buff
     jassert (tracks.size() == getBusCount (true));
     jassert (1 == getBusCount (false));
     tempBuffer.setSize (getMainBusNumOutputChannels(), bufferSize, false, true, true);
+
+    // not rendering, so the layout can be applied right away
+    publishTracks();
+    takePendingTracks();
 }
 
 void AudioMixerProcessor::processBlock (AudioSampleBuffer& audio, MidiBuffer& midi)
 {
     midi.clear();
+    takePendingTracks();
 
-    ScopedLock sl (getCallbackLock());
+    auto output (getBusBuffer<float> (audio, false, 0));
+    const int numSamples = audio.getNumSamples();
+    const int numMixChannels = jmin (tempBuffer.getNumChannels(), output.getNumChannels());
 
-    if (tracks.size() <= 0)
+    if (active == nullptr || active->size <= 0 || numMixChannels <= 0
+        || numSamples > tempBuffer.getNumSamples())
     {
         audio.clear();
         return;
     }
 
-    auto output (getBusBuffer<float> (audio, false, 0));
-    const int numSamples = audio.getNumSamples();
     tempBuffer.clear (0, numSamples);
 
-    for (int i = 0; i < tracks.size(); ++i)
+    // gain ramp, mix and metering are one pass over each channel
+    for (int i = 0; i < active->size; ++i)
     {
-        auto* const track = tracks.getUnchecked (i);
-        auto input (getBusBuffer<float> (audio, true, track->busIdx));
-        auto& rms = track->monitor->rms;
+        auto& track = active->entries[i];
+        auto& monitor = *track.monitor;
+        const bool mute = monitor.nextMute.get() > 0;
+        const float gain = monitor.nextGain.get();
+        const float endGain = mute ? 0.f : gain;
 
-        if (track->mute)
+        for (int c = 0; c < track.numChannels; ++c)
         {
-            for (int c = 0; c < track->numInputs; ++c)
-                rms.getReference(c).set (0.0);
-        }
-        else
-        {
-            for (int c = 0; c < track->numInputs; ++c)
+            float level = 0.f;
+            if (track.gain != 0.f || endGain != 0.f)
             {
-                rms.getReference(c).set (track->gain * input.getRMSLevel (c, 0, numSamples));
-                tempBuffer.addFromWithRamp (c, 0, input.getReadPointer(c), numSamples,
-                                            track->lastGain, track->gain);
+                const float sum = addWithRampAndSumSquares (
+                    tempBuffer.getWritePointer (c % numMixChannels),
+                    audio.getReadPointer (track.firstChannel + c),
+                    numSamples, track.gain, endGain);
+                level = endGain * std::sqrt (sum / (float) numSamples);
             }
+            monitor.rms.getReference(c).set (level);
         }
 
-        track->lastGain = track->gain;
-
-        if (track->gain != track->monitor->nextGain.get())
-            track->gain = track->monitor->nextGain.get();
-        track->monitor->gain.set (track->gain);
-
-        if (static_cast<int> (track->mute) != track->monitor->nextMute.get())
-            track->mute = track->monitor->nextMute.get() > 0;
-        track->monitor->muted.set (track->mute ? 1 : 0);
+        track.gain = endGain;
+        monitor.gain.set (gain);
+        monitor.muted.set (mute ? 1 : 0);
     }
 
-    output.clear (0, numSamples);
     const float gain = Decibels::decibelsToGain ((float)*masterVolume, (float) EL_FADER_MIN_DB);
-    if (! *masterMute)
-        for (int c = 0; c < output.getNumChannels(); ++c)
-            output.copyFromWithRamp (c, 0, tempBuffer.getReadPointer(c), numSamples,
-                                     lastGain, gain);
+    const bool muted = *masterMute;
+    for (int c = 0; c < output.getNumChannels(); ++c)
+    {
+        float level = 0.f;
+        if (muted || c >= numMixChannels)
+        {
+            output.clear (c, 0, numSamples);
+        }
+        else
+        {
+            const float sum = copyWithRampAndSumSquares (output.getWritePointer (c),
+                tempBuffer.getReadPointer (c), numSamples, lastGain, gain);
+            level = std::sqrt (sum / (float) numSamples);
+        }
+
+        if (c < masterMonitor->rms.size())
+            masterMonitor->rms.getReference(c).set (level);
+    }
 
     if (gain != masterMonitor->nextGain.get())
         *masterVolume = Decibels::gainToDecibels (masterMonitor->nextGain.get(), (float) EL_FADER_MIN_DB);
@@ -507,12 +645,7 @@ void AudioMixerProcessor::processBlock (AudioSampleBuffer& audio, MidiBuffer& mi
 
     masterMonitor->muted.set (*masterMute);
     masterMonitor->gain.set (gain);
-
-    for (int i = 0; i < 2; ++i)
-        masterMonitor->rms.getReference(i).set (
-            output.getRMSLevel (i, 0, numSamples));
-
-    lastGain = gain;
+    lastGain = muted ? 0.f : gain;
 }
 
 void AudioMixerProcessor::releaseResources()
@@ -544,63 +677,53 @@ bool AudioMixerProcessor::canApplyBusCountChange (bool isInput, bool isAdding,
 
 void AudioMixerProcessor::setTrackGain (const int track, const float gain)
 {
-    if (! isPositiveAndBelow (track, numTracks))
-        return;
-    ScopedLock sl (getCallbackLock());
-    tracks.getUnchecked(track)->gain = gain;
+    if (auto* const trk = tracks [track])
+    {
+        trk->gain = gain;
+        trk->monitor->requestGain (gain);
+    }
 }
 
-void AudioMixerProcessor::setTrackMuted (const int track, const bool mute) {
-    if (! isPositiveAndBelow (track, numTracks))
-        return;
-    ScopedLock sl (getCallbackLock());
-    tracks.getUnchecked(track)->mute = mute;
+void AudioMixerProcessor::setTrackMuted (const int track, const bool mute)
+{
+    if (auto* const trk = tracks [track])
+    {
+        trk->mute = mute;
+        trk->monitor->requestMute (mute);
+    }
 }
 
 bool AudioMixerProcessor::isTrackMuted (const int track) const
 {
-    if (! isPositiveAndBelow (track, numTracks))
-        return false;
-    ScopedLock sl (getCallbackLock());
-    return tracks.getUnchecked(track)->mute;
+    if (auto* const trk = tracks [track])
+        return trk->monitor->nextMute.get() > 0;
+    return false;
 }
 
 float AudioMixerProcessor::getTrackGain (const int track) const
 {
-    if (! isPositiveAndBelow (track, numTracks))
-        return 1.f;
-    ScopedLock sl (getCallbackLock());
-    return tracks.getUnchecked(track)->gain;
+    if (auto* const trk = tracks [track])
+        return trk->monitor->nextGain.get();
+    return 1.f;
 }
 
 void AudioMixerProcessor::getStateInformation (juce::MemoryBlock& block)
 {
-    OwnedArray<Track> t;
-    while (t.size() < numTracks)
-        t.add (new Track());
-    float volume = 0.0f;
-    bool mute = false;
-    {
-        ScopedLock sl (getCallbackLock());
-        for (int i = 0; i < numTracks; ++i)
-            t.getUnchecked(i)->update (tracks.getUnchecked (i));
-        volume = *masterVolume;
-        mute = *masterMute;
-    }
+    const float volume = *masterVolume;
+    const bool mute = *masterMute;
 
     ValueTree state ("audiomixer");
     state.setProperty (Tags::volume, volume, 0)
          .setProperty ("mute", mute, 0);
-    for (int i = 0; i < numTracks; ++i)
+    for (auto* const track : tracks)
     {
         ValueTree trk ("track");
-        auto* const track = t.getUnchecked (i);
         trk.setProperty ("index",       track->index, 0)
            .setProperty ("busIdx",      track->busIdx, 0)
            .setProperty ("numInputs",   track->numInputs, 0)
            .setProperty ("numOutputs",  track->numOutputs, 0)
-           .setProperty ("gain",        track->gain, 0)
-           .setProperty ("mute",        track->mute, 0);
+           .setProperty ("gain",        track->monitor->nextGain.get(), 0)
+           .setProperty ("mute",        track->monitor->nextMute.get() > 0, 0);
         state.addChild (trk, -1, 0);
     }
 
@@ -621,7 +744,7 @@ void AudioMixerProcessor::setStateInformation (const void* data, int size)
     if (! state.isValid())
         return;
 
-    Array<Track*> newTracks;
+    OwnedArray<Track> newTracks;
     for (int i = 0; i < state.getNumChildren(); ++i)
     {
         const ValueTree trk (state.getChild (i));
@@ -643,21 +766,16 @@ void AudioMixerProcessor::setStateInformation (const void* data, int size)
         newTracks.add (track);
     }
 
-    {
-        ScopedLock sl (getCallbackLock());
-        *masterVolume = (float) state.getProperty (Tags::volume, 0.0);
-        *masterMute = (bool) state.getProperty ("mute", false);
-        masterMonitor->nextGain.set (Decibels::decibelsToGain ((float)*masterVolume, (float)EL_FADER_MIN_DB));
-        masterMonitor->gain.set (masterMonitor->nextGain.get());
-        masterMonitor->nextMute.set (*masterMute ? 1 : 0);
-        masterMonitor->muted.set (masterMonitor->nextMute.get());
-        tracks.swapWith (newTracks);
-        numTracks = tracks.size();
-    }
+    *masterVolume = (float) state.getProperty (Tags::volume, 0.0);
+    *masterMute = (bool) state.getProperty ("mute", false);
+    masterMonitor->nextGain.set (Decibels::decibelsToGain ((float)*masterVolume, (float)EL_FADER_MIN_DB));
+    masterMonitor->gain.set (masterMonitor->nextGain.get());
+    masterMonitor->nextMute.set (*masterMute ? 1 : 0);
+    masterMonitor->muted.set (masterMonitor->nextMute.get());
 
-    for (auto* dt : newTracks)
-        delete dt;
-    newTracks.clear();
+    // the audio thread keeps the old monitors until it takes the new list
+    tracks.swapWith (newTracks);
+    publishTracks();
 }
 
 }
@@ -23,7 +23,8 @@
 
 namespace Element {
 
-class AudioMixerProcessor : public BaseProcessor
+class AudioMixerProcessor : public BaseProcessor,
+                            private AsyncUpdater
 {
     AudioParameterBool* masterMute;
     AudioParameterFloat* masterVolume;
@@ -119,19 +120,24 @@ public:
         }
     };
 
+    /** The most stereo tracks a mixer can have */
+    enum { maxTracks = 128 };
+
     explicit AudioMixerProcessor (int numTracks = 4,
                                   const double sampleRate = 44100.0,
                                   const int bufferSize = 1024)
         : BaseProcessor (BusesProperties()
             .withOutput ("Master",  AudioChannelSet::stereo(), false))
     {
-        tracks.ensureStorageAllocated (16);
+        numTracks = jlimit (0, (int) maxTracks, numTracks);
+        tracks.ensureStorageAllocated (numTracks);
         while (--numTracks >= 0)
             addStereoTrack();
         setRateAndBufferSizeDetails (sampleRate, bufferSize);
         addParameter (masterMute = new AudioParameterBool ("masterMute", "Master Mute", false));
         addParameter (masterVolume  = new AudioParameterFloat ("masterVolume",  "Master Volume", -120.0f, 12.0f, 0.f));
         masterMonitor = new Monitor (-1, 2);
+        publishTracks();
     }
 
     ~AudioMixerProcessor();
@@ -153,7 +159,7 @@ public:
         desc.version            = "1.0.0";
     }
 
-    int getNumTracks() const { ScopedLock sl (getCallbackLock()); return tracks.size(); }
+    int getNumTracks() const { return tracks.size(); }
     
     MonitorPtr getMonitor (const int track = -1) const;
     
@@ -183,7 +189,7 @@ public:
         return true;
     }
 
-    bool canAddBus (bool) const override { return true; }
+    bool canAddBus (bool isInput) const override { return ! isInput || getBusCount (true) < maxTracks; }
     bool canRemoveBus (bool) const override { return true; }
     bool canApplyBusCountChange (bool isInput, bool isAdding,
                                  AudioProcessor::BusProperties& outProperties) override;
@@ -200,13 +206,26 @@ public:
     void setStateInformation (const void*, int) override;
 
 private:
+    struct TrackList;
     MonitorPtr masterMonitor;
-    Array<Track*> tracks;
-    int numTracks = 0;
+
+    // the tracks as edited on the message thread
+    OwnedArray<Track> tracks;
+
+    // the audio thread renders a snapshot of the tracks. New snapshots are
+    // handed over through pending and the old one comes back in retired,
+    // which is freed asynchronously so the next snapshot isn't held up
+    TrackList* active = nullptr;
+    std::atomic<TrackList*> pending { nullptr };
+    std::atomic<TrackList*> retired { nullptr };
+
     AudioSampleBuffer tempBuffer;
     float lastGain = 0.f;
     void addMonoTrack();
     void addStereoTrack();
+    void publishTracks();
+    void takePendingTracks() noexcept;
+    void handleAsyncUpdate() override;
 };
 
 }
@@ -19,36 +19,43 @@
 
 #include "engine/nodes/BaseProcessor.h"
 #include "engine/nodes/AudioRouterNode.h"
+#include "engine/EngineCommandQueue.h"
 #include "Common.h"
 
-#define TRACE_AUDIO_ROUTER(output) 
-
 namespace Element {
 
+//=============================================================================
+/** Gain snapshots of the programs, and which program each MIDI program selects */
+struct AudioRouterNode::ProgramTable
+{
+    OwnedArray<GainMatrix> matrices;
+    int midiPrograms [128];
+};
+
 AudioRouterNode::AudioRouterNode (int ins, int outs)
     : GraphNode (0),
       numSources (ins),
       numDestinations (outs),
       state (ins, outs),
-      toggles (ins, outs),
-      nextToggles (ins, outs)
+      gains (ins, outs),
+      targets (ins, outs)
 {
     jassert (metadata.hasType (Tags::node));
     metadata.setProperty (Tags::format, "Element", nullptr);
     metadata.setProperty (Tags::identifier, EL_INTERNAL_ID_AUDIO_ROUTER, nullptr);
     
-    fadeIn.setFadesIn (true);
-    fadeIn.setLength (fadeLengthSeconds);
-    fadeOut.setFadesIn (false);
-    fadeOut.setLength (fadeLengthSeconds);
-
+    updateRampStep();
     clearPatches();
 
     auto* program = programs.add (new Program ("Linear Stereo"));
     program->matrix.resize (ins, outs);
     for (int i = 0; i < jmin (ins, outs); ++i)
         program->matrix.set (i, i, true);
-    setMatrixState (program->matrix);
+
+    // not owned by a graph yet, so apply directly instead of via a command
+    state = program->matrix;
+    GainMatrix patches (state);
+    targets.swapWith (patches);
 
     if (ins == 4 && outs == 4)
     {
@@ -79,43 +86,185 @@ AudioRouterNode::AudioRouterNode (int ins, int outs)
         program->matrix.set (2, 2, true);
         program->matrix.set (3, 3, true);
     }
+
+    programTable.reset (createProgramTable());
 }
 
-AudioRouterNode::~AudioRouterNode() { }
+AudioRouterNode::~AudioRouterNode()
+{
+    cancelPendingUpdate();
+}
 
-void AudioRouterNode::setCurrentProgram (int index)
+void AudioRouterNode::prepareToRender (double newSampleRate, int maxBufferSize)
 {
+    sampleRate = newSampleRate;
+    blockSize  = maxBufferSize;
+    updateRampStep();
+    tempAudio.setSize (jmax (1, numDestinations), jmax (1, blockSize), false, false, true);
+}
+
+void AudioRouterNode::updateRampStep()
+{
+    rampStep = static_cast<float> (1.0 / jmax (1.0, fadeLengthSeconds * sampleRate));
+}
+
+MatrixState AudioRouterNode::getProgramMatrix (int index) const
+{
+    MatrixState matrix;
     if (auto* program = programs [index])
     {
-        currentProgram = index;
-        setMatrixState (program->matrix);
+        matrix = program->matrix;
+        if (! matrix.sameSizeAs (state))
+            matrix.resize (state.getNumRows(), state.getNumColumns(), true);
     }
+    return matrix;
 }
 
-void AudioRouterNode::applyMatrix (const MatrixState& matrix)
+AudioRouterNode::ProgramTable* AudioRouterNode::createProgramTable() const
 {
-    jassert (matrix.sameSizeAs (state));
-    ToggleGrid newPatches (matrix);
+    auto* table = new ProgramTable();
+    for (int i = 0; i < programs.size(); ++i)
+        table->matrices.add (new GainMatrix (getProgramMatrix (i)));
+
+    // programs with a MIDI program take it, the rest are selected by index
+    for (int m = 0; m < 128; ++m)
+        table->midiPrograms[m] = isPositiveAndBelow (m, programs.size()) ? m : -1;
+    for (int i = 0; i < programs.size(); ++i)
+        if (isPositiveAndBelow (programs.getUnchecked(i)->midiProgram, 128))
+            table->midiPrograms [programs.getUnchecked(i)->midiProgram] = i;
+
+    return table;
+}
+
+void AudioRouterNode::setCurrentProgram (int index)
+{
+    if (isPositiveAndBelow (index, programs.size()))
     {
-        ScopedLock sl (getLock());
-        nextToggles.swapWith (newPatches);
-        togglesChanged = true; // initiate the crossfade
+        currentProgram = index;
+        setMatrixState (getProgramMatrix (index));
     }
+}
 
+void AudioRouterNode::handleAsyncUpdate()
+{
+    // a MIDI program change was rendered, show it
+    const int index = renderedProgram.load();
+    if (! isPositiveAndBelow (index, programs.size()))
+        return;
+    currentProgram = index;
+    state = getProgramMatrix (index);
     sendChangeMessage();
 }
 
-String AudioRouterNode::getSizeString() const
+//=============================================================================
+struct AudioRouterNode::ApplyMatrixCommand : public EngineCommand
+{
+    ApplyMatrixCommand (AudioRouterNode* n, const MatrixState& matrix)
+        : node (n), targets (matrix) { }
+
+    void perform() override
+    {
+        // the old targets get deleted with this command on the message thread
+        if (! targets.sameSizeAs (node->targets))
+            return;
+        node->targets.swapWith (targets); // gains ramp towards them
+    }
+
+    void completed() override
+    {
+        node->sendChangeMessage();
+    }
+
+    ReferenceCountedObjectPtr<AudioRouterNode> node;
+    GainMatrix targets;
+};
+
+struct AudioRouterNode::ResizeCommand : public EngineCommand
 {
-    int s = 0, d = 0;
+    ResizeCommand (AudioRouterNode* n, const MatrixState& matrix)
+        : node (n), 
+          numSources (matrix.getNumRows()),
+          numDestinations (matrix.getNumColumns()),
+          gains (matrix), 
+          targets (matrix),
+          tempAudio (numDestinations, jmax (1, n->blockSize)),
+          programTable (n->createProgramTable()) { }
+
+    void perform() override
     {
-        ScopedLock sl (lock);
-        s = numSources;
-        d = numDestinations;
+        // resizing doesn't fade
+        node->gains.swapWith (gains);
+        node->targets.swapWith (targets);
+        std::swap (node->tempAudio, tempAudio);
+        node->programTable.swap (programTable);
+        node->numSources = numSources;
+        node->numDestinations = numDestinations;
     }
 
-    String result (s);
-    result << "x" << d;
+    void completed() override
+    {
+        node->rebuildPorts = true;
+        node->triggerPortReset();
+        node->sendChangeMessage();
+    }
+
+    ReferenceCountedObjectPtr<AudioRouterNode> node;
+    const int numSources, numDestinations;
+    GainMatrix gains, targets;
+    AudioSampleBuffer tempAudio;
+    std::unique_ptr<ProgramTable> programTable;
+};
+
+struct AudioRouterNode::ProgramTableCommand : public EngineCommand
+{
+    ProgramTableCommand (AudioRouterNode* n)
+        : node (n), programTable (n->createProgramTable()) { }
+
+    void perform() override
+    {
+        node->programTable.swap (programTable);
+    }
+
+    ReferenceCountedObjectPtr<AudioRouterNode> node;
+    std::unique_ptr<ProgramTable> programTable;
+};
+
+void AudioRouterNode::addProgram (const String& name, const MatrixState& matrix, int midiProgram)
+{
+    auto* program = programs.add (new Program (name, midiProgram));
+    program->matrix = matrix;
+    EngineCommandQueue::post (getCommandQueue(), new ProgramTableCommand (this));
+}
+
+void AudioRouterNode::applyMatrix (const MatrixState& matrix)
+{
+    jassert (matrix.sameSizeAs (state));
+    EngineCommandQueue::post (getCommandQueue(), new ApplyMatrixCommand (this, matrix));
+}
+
+void AudioRouterNode::setFadeLength (double seconds)
+{
+    struct FadeLengthCommand : public EngineCommand
+    {
+        FadeLengthCommand (AudioRouterNode* n, double s) : node (n), seconds (s) { }
+        void perform() override
+        {
+            node->fadeLengthSeconds = seconds;
+            node->updateRampStep();
+        }
+
+        ReferenceCountedObjectPtr<AudioRouterNode> node;
+        const double seconds;
+    };
+
+    seconds = jlimit (0.001, 5.0, seconds);
+    EngineCommandQueue::post (getCommandQueue(), new FadeLengthCommand (this, seconds));
+}
+
+String AudioRouterNode::getSizeString() const
+{
+    String result (numSources);
+    result << "x" << numDestinations;
     return result;
 }
 
@@ -123,29 +272,11 @@ void AudioRouterNode::setSize (int newIns, int newOuts)
 {
     newIns  = jmax (1, newIns);
     newOuts = jmax (1, newOuts);
-    
-    {
-        ScopedLock sl1 (getLock());
-        if (newIns == numSources && newOuts == numDestinations)
-            return;
-    }
+    if (newIns == state.getNumRows() && newOuts == state.getNumColumns())
+        return;
 
     state.resize (newIns, newOuts, true);
-    ToggleGrid newPatches (state);
-    ToggleGrid newNextPatches (state);
-    
-    {
-        ScopedLock sl (getLock());
-        nextToggles.swapWith (newNextPatches);
-        toggles.swapWith (newPatches);
-        numSources = newIns;
-        numDestinations = newOuts;
-        sizeChanged = true; // initiate the size change
-    }
-
-    rebuildPorts = true;
-    triggerPortReset();
-    sendChangeMessage();
+    EngineCommandQueue::post (getCommandQueue(), new ResizeCommand (this, state));
 }
 
 void AudioRouterNode::setMatrixState (const MatrixState& matrix)
@@ -159,45 +290,76 @@ MatrixState AudioRouterNode::getMatrixState() const
     return state;
 }
 
-void AudioRouterNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
+//=============================================================================
+void AudioRouterNode::renderRange (const AudioSampleBuffer& audio, const int start, const int numFrames) noexcept
 {
-    jassert (midi.getNumBuffers() == 1);
-    const auto& midiBuffer = *midi.getReadBuffer (0);
+    const int numWords = gains.getNumWords();
 
-    MidiBuffer::Iterator iter (midiBuffer);
-    MidiMessage msg; int midiFrame = 0;
-    
-    while (iter.getNextEvent (msg, midiFrame))
+    for (int dst = 0; dst < numDestinations; ++dst)
     {
-        if (! msg.isProgramChange())
-            continue;
-        if (3 == msg.getProgramChangeNumber())
-            { DBG("program "); }
-    }
+        float* const out = tempAudio.getWritePointer (dst, start);
+        const uint64* const current = gains.getActive (dst);
+        const uint64* const next    = targets.getActive (dst);
+        bool written = false;
 
-    const int numFrames = audio.getNumSamples();
-    const int numChannels = audio.getNumChannels();
+        // only sources with a gain now or after the ramp are mixed
+        for (int word = 0; word < numWords; ++word)
+        {
+            for (uint64 bits = current[word] | next[word]; bits != 0; bits &= bits - 1)
+            {
+                const int src = (word << 6) + GainMatrix::findLowestBit (bits);
+                const float* const in = audio.getReadPointer (src, start);
+                const float gain   = gains.get (src, dst);
+                const float target = targets.get (src, dst);
+                int frame = 0;
 
-    tempAudio.setSize (numChannels, numFrames, false, false, true);
-    tempAudio.clear (0, numFrames);
+                if (gain != target)
+                {
+                    if (! written)
+                        FloatVectorOperations::clear (out, numFrames);
+                    written = true;
+
+                    // ramp until the target is reached, then hold it
+                    const float distance = std::abs (target - gain);
+                    const int rampFrames = jmin (numFrames, (int) std::ceil (distance / rampStep));
+                    const float step = target > gain ? rampStep : -rampStep;
+                    for (; frame < rampFrames; ++frame)
+                        out[frame] += in[frame] * (gain + step * (float) frame);
+
+                    gains.set (src, dst, rampStep * (float) rampFrames >= distance
+                                            ? target : gain + step * (float) rampFrames);
+                    if (frame >= numFrames || target == 0.f)
+                        continue;
+                }
 
-    if (sizeChanged)
-    {
-        fadeIn.reset();
-        fadeOut.reset();
-        sizeChanged = false;
-        TRACE_AUDIO_ROUTER("size changed");
-    }
+                const int count = numFrames - frame;
+                if (written)
+                {
+                    if (target == 1.f)
+                        FloatVectorOperations::add (out + frame, in + frame, count);
+                    else
+                        FloatVectorOperations::addWithMultiply (out + frame, in + frame, target, count);
+                }
+                else
+                {
+                    if (target == 1.f)
+                        FloatVectorOperations::copy (out, in, count);
+                    else
+                        FloatVectorOperations::copyWithMultiply (out, in, target, count);
+                    written = true;
+                }
+            }
+        }
 
-    if (togglesChanged)
-    {
-        fadeIn.reset();
-        fadeIn.startFading();
-        fadeOut.reset();
-        fadeOut.startFading();
-        togglesChanged = false;
-        TRACE_AUDIO_ROUTER("fade start");
+        if (! written)
+            FloatVectorOperations::clear (out, numFrames);
     }
+}
+
+void AudioRouterNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
+{
+    const int numFrames = audio.getNumSamples();
+    const int numChannels = audio.getNumChannels();
 
     if (numSources > numChannels || numDestinations > numChannels)
     {
@@ -206,117 +368,49 @@ void AudioRouterNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
         return;
     }
 
-    if (fadeIn.isActive() || fadeOut.isActive())
+    if (numFrames > tempAudio.getNumSamples() || numDestinations > tempAudio.getNumChannels())
     {
-        auto framesToProcess = numFrames;
-        int frame = 0;
-        ScopedLock sl (lock);
-        
-        float fadeInGain  = 0.0f;
-        float fadeOutGain = 1.0f;
-
-        while (--framesToProcess >= 0)
-        {
-            fadeInGain  = fadeIn.isActive()  ? fadeIn.getNextEnvelopeValue()  : 1.0f;
-            fadeOutGain = fadeOut.isActive() ? fadeOut.getNextEnvelopeValue() : 0.0f;
-
-            if (!fadeIn.isActive() && !fadeOut.isActive())
-            {
-                TRACE_AUDIO_ROUTER("last frame fade in gain  : " << fadeInGain);
-                TRACE_AUDIO_ROUTER("last frame fade out gain : " << fadeOutGain);
-            }
-
-            for (int i = 0; i < numSources; ++i)
-            {
-                for (int j = 0; j < numDestinations; ++j)
-                {
-                    if (toggles.get (i, j) && nextToggles.get (i, j))
-                    {
-                        // no patch change and on means 1 to 1 mix
-                        tempAudio.getWritePointer(j)[frame] += 
-                            audio.getReadPointer(i)[frame];
-                    }
-                    else if (! toggles.get (i, j) && ! nextToggles.get (i, j))
-                    {
-                        // no patch change and off means no fade and zero'd
-                        tempAudio.getWritePointer(j)[frame] += 0.0f;
-                    }
-                    else if (!toggles.get (i, j) && nextToggles.get (i, j))
-                    {
-                        tempAudio.getWritePointer(j)[frame] += 
-                            (audio.getReadPointer(i)[frame] * fadeInGain);
-                    }
-                    else if (toggles.get (i, j) && !nextToggles.get (i, j))
-                    {
-                        tempAudio.getWritePointer(j)[frame] += 
-                            (audio.getReadPointer(i)[frame] * fadeOutGain);
-                    }
-                }
-            }
-
-            ++frame;
+        // the block is bigger than prepared for
+        jassertfalse;
+        tempAudio.setSize (jmax (1, numDestinations), numFrames, false, false, true);
+    }
 
-            if (!fadeIn.isActive() && !fadeOut.isActive())
-                break;
-        }
+    // program changes switch snapshots at their frame, the block is
+    // rendered in ranges between them
+    int frame = 0;
+    if (programTable != nullptr && midi.getNumBuffers() > 0)
+    {
+        MidiBuffer::Iterator iter (*midi.getReadBuffer (0));
+        const uint8* data = nullptr;
+        int size = 0, eventFrame = 0;
 
-        if (!fadeOut.isActive() && !fadeIn.isActive())
+        while (iter.getNextEvent (data, size, eventFrame))
         {
-            TRACE_AUDIO_ROUTER("fade stopped @ frame: " << (frame));
-            TRACE_AUDIO_ROUTER("fade in level  : " << fadeInGain);
-            TRACE_AUDIO_ROUTER("fade out level : " << fadeOutGain);
-
-            if (framesToProcess > 0)
-            {
-                TRACE_AUDIO_ROUTER("rendering " << framesToProcess << " remainging frames");
-                for (int i = 0; i < numSources; ++i)
-                {
-                    for (int j = 0; j < numDestinations; ++j)
-                    {
-                        if (toggles.get(i, j) && nextToggles.get (i, j))
-                        {
-                            // no patch change and on means 1 to 1 mix
-                            tempAudio.addFrom (j, frame, audio.getReadPointer (i, frame), 
-                                               framesToProcess);
-                        }
-                        else if (! toggles.get (i, j) && ! nextToggles.get (i, j))
-                        {
-                            // patch not changed and of, so clear the out channel.
-                            // nothing to do
-                        }
-                        else if (!toggles.get (i, j) && nextToggles.get (i, j))
-                        {
-                            tempAudio.addFromWithRamp (j, frame, audio.getReadPointer (i, frame), 
-                                                          framesToProcess, fadeInGain, 1.0f);
-                        }
-                        else if (toggles.get (i, j) && !nextToggles.get (i, j))
-                        {
-                            tempAudio.addFromWithRamp (j, frame, audio.getReadPointer (i, frame),
-                                                          framesToProcess, fadeOutGain, 0.0f);
-                        }
-                        else
-                        {
-                            // this would be an unhandled fading scenario
-                            jassertfalse;
-                        }
-                    }
-                }
-            }
-
-            toggles.swapWith (nextToggles);
+            if (size < 2 || (data[0] & 0xf0) != 0xc0)
+                continue;
+            const int program = programTable->midiPrograms [data[1] & 0x7f];
+            auto* const snapshot = programTable->matrices [program];
+            if (snapshot == nullptr || ! snapshot->sameSizeAs (targets))
+                continue;
+
+            eventFrame = jlimit (frame, numFrames, eventFrame);
+            if (eventFrame > frame)
+                renderRange (audio, frame, eventFrame - frame);
+            frame = eventFrame;
+
+            targets = *snapshot;
+            renderedProgram.store (program);
+            triggerAsyncUpdate();
         }
     }
-    else
-    {
-        ScopedLock sl (lock);
-        for (int i = 0; i < numSources; ++i)
-            for (int j = 0; j < numDestinations; ++j)
-                if (toggles.get (i, j))
-                    tempAudio.addFrom (j, 0, audio, i, 0, numFrames);
-    }
 
-    for (int c = 0; c < numChannels; ++c)
-        audio.copyFrom (c, 0, tempAudio.getReadPointer(c), numFrames);
+    if (frame < numFrames)
+        renderRange (audio, frame, numFrames - frame);
+
+    for (int c = 0; c < numDestinations; ++c)
+        audio.copyFrom (c, 0, tempAudio, c, 0, numFrames);
+    for (int c = numDestinations; c < numChannels; ++c)
+        audio.clear (c, 0, numFrames);
     midi.clear();
 }
 
@@ -338,21 +432,7 @@ void AudioRouterNode::setState (const void* data, int sizeInBytes)
         if (matrix.getNumRows() > 0 && matrix.getNumColumns() > 0)
         {
             state = matrix;
-
-            ToggleGrid newPatches (state);
-            ToggleGrid newNextPatches (state);
-            {
-                ScopedLock sl (getLock());
-                numSources = matrix.getNumRows();
-                numDestinations = matrix.getNumColumns();
-                nextToggles.swapWith (newNextPatches);
-                toggles.swapWith (newPatches);
-                sizeChanged = true;
-            }
-
-            rebuildPorts = true;
-            sendChangeMessage();
-            triggerPortReset();
+            EngineCommandQueue::post (getCommandQueue(), new ResizeCommand (this, state));
         }
     }
 }
@@ -360,24 +440,16 @@ void AudioRouterNode::setState (const void* data, int sizeInBytes)
 void AudioRouterNode::setWithoutLocking (int src, int dst, bool set)
 {
     jassert (src >= 0 && src < numSources && dst >= 0 && dst < numDestinations);
-    toggles.set (src, dst, set);
+    if (! isPositiveAndBelow (src, state.getNumRows()) || ! isPositiveAndBelow (dst, state.getNumColumns()))
+        return;
     state.set (src, dst, set);
-}
-
-void AudioRouterNode::set (int src, int dst, bool patched)
-{
-    jassert (src >= 0 && src < numSources && dst >= 0 && numDestinations < 4);
-    toggles.set (src, dst, patched);
-    state.set (src, dst, patched);
+    applyMatrix (state);
 }
 
 void AudioRouterNode::clearPatches()
 {
-    {
-        ScopedLock sl (getLock());
-        toggles.clear();
-        nextToggles.clear();
-    }
+    gains.clear();
+    targets.clear();
 
     for (int r = 0; r < state.getNumRows(); ++r)
         for (int c = 0; c < state.getNumColumns(); ++c)
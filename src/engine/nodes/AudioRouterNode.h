@@ -20,20 +20,20 @@
 #pragma once
 
 #include "engine/GraphNode.h"
-#include "engine/LinearFade.h"
-#include "engine/ToggleGrid.h"
+#include "engine/GainMatrix.h"
 #include "engine/nodes/BaseProcessor.h"
 
 namespace Element {
 
 class AudioRouterNode : public GraphNode,
-                        public ChangeBroadcaster
+                        public ChangeBroadcaster,
+                        private AsyncUpdater
 {
 public:
     explicit AudioRouterNode (int ins = 4, int outs = 4);
     ~AudioRouterNode();
 
-    void prepareToRender (double sampleRate, int maxBufferSize) override { ignoreUnused (sampleRate, maxBufferSize); }
+    void prepareToRender (double sampleRate, int maxBufferSize) override;
     void releaseResources() override { }
 
     inline bool wantsMidiPipe() const override { return true; }
@@ -45,12 +45,25 @@ public:
     String getSizeString() const;
     void setMatrixState (const MatrixState&);
     MatrixState getMatrixState() const;
+
+    /** Patches or unpatches one source to one destination. Like
+        setMatrixState, the gains change on the audio thread */
     void setWithoutLocking (int src, int dst, bool set);
-    CriticalSection& getLock() { return lock; }
 
     int getNumPrograms() const override { return jmax (1, programs.size()); }
     int getCurrentProgram() const override { return currentProgram; }
     void setCurrentProgram (int index) override;
+
+    /** Adds a program. Programs are kept on the audio thread as gain
+        snapshots, so MIDI program changes switch to them at the exact
+        frame of the event.
+
+        @param name         The program name
+        @param matrix       The patches, resized to the router if needed
+        @param midiProgram  The MIDI program which selects it, or -1 to
+                            select it by its index
+     */
+    void addProgram (const String& name, const MatrixState& matrix, int midiProgram = -1);
     const String getProgramName (int index) const override 
     {
         if (auto* prog = programs [index])
@@ -58,14 +71,9 @@ public:
         return "Audio Router " + String (index + 1); 
     }
 
-    void setFadeLength (double seconds)
-    {
-        seconds = jlimit (0.001, 5.0, seconds);
-        ScopedLock sl (lock);
-        fadeLengthSeconds = seconds;
-        fadeIn.setLength (static_cast<float> (fadeLengthSeconds));
-        fadeOut.setLength (static_cast<float> (fadeLengthSeconds));
-    }
+    /** Set the crossfade length used when patches change. This is applied
+        on the audio thread */
+    void setFadeLength (double seconds);
 
     void getPluginDescription (PluginDescription& desc) const override
     {
@@ -113,9 +121,14 @@ protected:
     }
 
 private:
-    CriticalSection lock;
+    struct ApplyMatrixCommand;
+    struct ResizeCommand;
+    struct ProgramTable;
+    struct ProgramTableCommand;
     int numSources, nextNumSources;
     int numDestinations, nextNumDestinations;
+    int blockSize { 512 };
+    double sampleRate { 44100.0 };
     AudioSampleBuffer tempAudio { 1, 1 };
     bool rebuildPorts = true;
 
@@ -131,21 +144,28 @@ private:
     OwnedArray<Program> programs;
     int currentProgram = -1;
 
-    void set (int src, int dst, bool patched);
+    // constructor only, nothing renders the node yet
     void clearPatches();
 
     // used by the UI, but not the rendering
     MatrixState state;
 
+    // the rendered gains move towards the targets by rampStep per frame
     double fadeLengthSeconds { 0.001 }; // 1 ms
-    LinearFade fadeIn;
-    LinearFade fadeOut;
-    ToggleGrid toggles;
-    ToggleGrid nextToggles;
-    bool togglesChanged { false },
-         sizeChanged { false };
+    float rampStep { 1.f };
+    GainMatrix gains;
+    GainMatrix targets;
+
+    // snapshots of the programs at the current size, owned by the audio thread
+    std::unique_ptr<ProgramTable> programTable;
+    std::atomic<int> renderedProgram { -1 };
 
     void applyMatrix (const MatrixState&);
+    void updateRampStep();
+    void renderRange (const AudioSampleBuffer&, int start, int numFrames) noexcept;
+    MatrixState getProgramMatrix (int index) const;
+    ProgramTable* createProgramTable() const;
+    void handleAsyncUpdate() override;
 };
 
 }
@@ -47,6 +47,9 @@
 #define EL_INTERNAL_ID_LUA                      "element.lua"
 #define EL_INTERNAL_ID_COMPRESSOR               "element.compressor"
 #define EL_INTERNAL_ID_MIDI_ROUTER              "element.midiRouter"
+#define EL_INTERNAL_ID_NET_AUDIO_SEND           "element.netAudioSend"
+#define EL_INTERNAL_ID_NET_AUDIO_RECEIVE        "element.netAudioReceive"
+#define EL_INTERNAL_ID_CONVOLUTION              "element.convolution"
 
 #define EL_INTERNAL_UID_AUDIO_FILE_PLAYER        1000
 #define EL_INTERNAL_UID_AUDIO_MIXER              1001
@@ -72,6 +75,9 @@
 #define EL_INTERNAL_UID_LUA                      1021
 #define EL_INTERNAL_UID_COMPRESSOR               1022
 #define EL_INTERNAL_UID_MIDI_ROUTER              1023
+#define EL_INTERNAL_UID_NET_AUDIO_SEND           1024
+#define EL_INTERNAL_UID_NET_AUDIO_RECEIVE        1025
+#define EL_INTERNAL_UID_CONVOLUTION              1026
 
 namespace Element {
 
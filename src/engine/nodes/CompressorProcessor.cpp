@@ -48,6 +48,7 @@ CompressorProcessor::CompressorProcessor (const int _numChannels)
     addParameter (releaseMs = new AudioParameterFloat ("release",   "Release [ms]",   releaseRange, 100.0f));
     addParameter (makeupDB  = new AudioParameterFloat ("makeup",    "Makeup [dB]",    -18.0f, 18.0f, 0.0f));
     addParameter (sideChain = new AudioParameterFloat ("sidechain", "Side Chain",     0.0f, 1.0f, 0.0f));
+    addParameter (stereoLink = new AudioParameterChoice ("link",     "Stereo Link",    { "Off", "On" }, 0));
 
     makeupGain.reset (numSteps);
 }
@@ -94,34 +95,86 @@ void CompressorProcessor::prepareToPlay (double sampleRate, int maximumExpectedS
 
 void CompressorProcessor::releaseResources() {}
 
+void CompressorProcessor::getDetectorInput (const AudioBuffer<float>& buffer, int start, int numSamples, float* dest) const noexcept
+{
+    const int numChans = buffer.getNumChannels();
+    if (numChans <= 0)
+    {
+        FloatVectorOperations::clear (dest, numSamples);
+        return;
+    }
+
+    if (stereoLink->getIndex() > 0)
+    {
+        FloatVectorOperations::abs (dest, buffer.getReadPointer (0, start), numSamples);
+        for (int ch = 1; ch < numChans; ++ch)
+            for (int n = 0; n < numSamples; ++n)
+                dest[n] = jmax (dest[n], std::abs (buffer.getReadPointer (ch, start)[n]));
+        return;
+    }
+
+    FloatVectorOperations::copy (dest, buffer.getReadPointer (0, start), numSamples);
+    for (int ch = 1; ch < numChans; ++ch)
+        FloatVectorOperations::add (dest, buffer.getReadPointer (ch, start), numSamples);
+    if (numChans > 1)
+        FloatVectorOperations::multiply (dest, 1.0f / (float) numChans, numSamples);
+}
+
 void CompressorProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuffer&)
 {
     auto mainBuffer = getBusBuffer (buffer, true, 0);
     auto sideBuffer = getBusBuffer (buffer, true, 1);
-
-    auto numBuffChannels = mainBuffer.getNumChannels();
+    const int numSamples = buffer.getNumSamples();
 
     updateParams();
 
-    float level = 0.0f;
-    for (int n = 0; n < buffer.getNumSamples(); ++n)
+    const float side = *sideChain;
+    const bool hasSideChain = sideBuffer.getNumChannels() > 0;
+    float minGain = 1.0f;
+
+    for (int start = 0; start < numSamples; start += chunkSize)
     {
-        // Get Main mono input
-        float mainInput = getSummedMonoSample (mainBuffer, n, numBuffChannels);
+        const int num = jmin ((int) chunkSize, numSamples - start);
 
-        // Get sidechain mono input
-        float sideInput = getSummedMonoSample (sideBuffer, n, numBuffChannels);
+        // envelope detection, the sidechain detector keeps following its
+        // input while it isn't mixed in so automating it back doesn't jump
+        getDetectorInput (mainBuffer, start, num, detectorInput);
+        if (hasSideChain)
+        {
+            getDetectorInput (sideBuffer, start, num, sideInput);
+            LevelDetector::processMixed (detector, detectorInput, sideDetector, sideInput, side, levels, num);
+        }
+        else
+        {
+            detector.process (detectorInput, levels, num);
+            sideDetector.setLevelEstimate (0.0f);
+        }
 
-        // Get level estimate, and compute gain
-        level = detector.process (mainInput) * (1.0f - *sideChain)
-              + sideDetector.process (sideInput) * *sideChain;
-        float gain = gainComputer.process (level);
+        // static curve
+        gainComputer.process (levels, gains, num);
+        minGain = jmin (minGain, FloatVectorOperations::findMinimum (gains, num));
 
-        // Apply gain
-        mainBuffer.applyGain (n, 1, gain * makeupGain.getNextValue());
+        // makeup smoothing
+        if (makeupGain.isSmoothing())
+        {
+            for (int n = 0; n < num; ++n)
+                gains[n] *= makeupGain.getNextValue();
+        }
+        else
+        {
+            FloatVectorOperations::multiply (gains, makeupGain.getTargetValue(), num);
+        }
+
+        // gain application
+        for (int ch = 0; ch < mainBuffer.getNumChannels(); ++ch)
+            FloatVectorOperations::multiply (mainBuffer.getWritePointer (ch, start), gains, num);
     }
 
-    listeners.call (&Listener::updateInGainDB, Decibels::gainToDecibels (level));
+    if (numSamples > 0)
+    {
+        inputLevelDB.store (Decibels::gainToDecibels (levels [(numSamples - 1) % chunkSize]), std::memory_order_relaxed);
+        gainReductionDB.store (-Decibels::gainToDecibels (minGain), std::memory_order_relaxed);
+    }
 }
 
 float CompressorProcessor::calcGainDB (float db)
@@ -143,6 +196,7 @@ void CompressorProcessor::getStateInformation (juce::MemoryBlock& destData)
     state.setProperty ("release",   (float) *releaseMs, 0);
     state.setProperty ("makeup",    (float) *makeupDB,  0);
     state.setProperty ("sidechain", (float) *sideChain, 0);
+    state.setProperty ("link",      stereoLink->getIndex(), 0);
     if (auto e = state.createXml())
         AudioProcessor::copyXmlToBinary (*e, destData);
 }
@@ -161,6 +215,7 @@ void CompressorProcessor::setStateInformation (const void* data, int sizeInBytes
             *releaseMs = (float) state.getProperty ("release",   (float) *releaseMs);
             *makeupDB  = (float) state.getProperty ("makeup",    (float) *makeupDB);
             *sideChain = (float) state.getProperty ("sidechain", (float) *sideChain);
+            *stereoLink = (int)  state.getProperty ("link",      0);
         }
     }
 }
@@ -74,6 +74,39 @@ public:
         return levelEstimate;
     }
 
+    /* Process a block of samples into levels */
+    void process (const float* input, float* levels, int numSamples) noexcept
+    {
+        float estimate = levelEstimate;
+        for (int n = 0; n < numSamples; ++n)
+        {
+            const float x = std::abs (input[n]);
+            estimate += (x > estimate ? b0_a : b0_r) * (x - estimate);
+            levels[n] = estimate;
+        }
+        levelEstimate = estimate;
+    }
+
+    /* Process two detectors with the same timing side by side and mix their
+       levels. The envelopes don't depend on each other so they overlap */
+    static void processMixed (LevelDetector& a, const float* inputA,
+                              LevelDetector& b, const float* inputB,
+                              float mix, float* levels, int numSamples) noexcept
+    {
+        const float b0Attack = a.b0_a, b0Release = a.b0_r;
+        float estimateA = a.levelEstimate, estimateB = b.levelEstimate;
+        for (int n = 0; n < numSamples; ++n)
+        {
+            const float xA = std::abs (inputA[n]);
+            const float xB = std::abs (inputB[n]);
+            estimateA += (xA > estimateA ? b0Attack : b0Release) * (xA - estimateA);
+            estimateB += (xB > estimateB ? b0Attack : b0Release) * (xB - estimateB);
+            levels[n] = estimateA * (1.0f - mix) + estimateB * mix;
+        }
+        a.levelEstimate = estimateA;
+        b.levelEstimate = estimateB;
+    }
+
     void setLevelEstimate (float levelEst) { levelEstimate = levelEst; }
     float getLevelEstimate() { return levelEstimate; }
 
@@ -159,7 +192,86 @@ public:
         return calcGain (x, thresh.getNextValue(), ratio.getNextValue());
     }
 
+    /* Process a block of levels into gains. With steady parameters the curve
+       is evaluated in the log2 domain without branches, so the loop can be
+       vectorized */
+    void process (const float* levels, float* gains, int numSamples) noexcept
+    {
+        if (thresh.isSmoothing() || ratio.isSmoothing())
+        {
+            for (int n = 0; n < numSamples; ++n)
+                gains[n] = process (levels[n]);
+            return;
+        }
+
+        const float threshLog2 = std::log2 (thresh.getTargetValue());
+        const float slope = (1.0f / ratio.getTargetValue()) - 1.0f;
+        const float dBPerLog2 = 6.02059991f;
+        const float halfKnee = 0.5f * kneeDB;
+        const float kneeScale = -aFF / dBPerLog2;
+
+        // levels are positive so their bits compare like the floats do
+        // without the float compares that stop loops from vectorizing
+        const int32 lowerBits = floatBits (kneeLower);
+        const int32 upperBits = floatBits (kneeUpper);
+        const int32 maxBits = floatBits (1.0e6f);
+
+        for (int n = 0; n < numSamples; ++n)
+        {
+            int32 bits = floatBits (levels[n]);
+            bits = bits > maxBits ? maxBits : bits;
+
+            // both curves are computed and then selected with bit masks,
+            // a zero mask leaves 0.0f for levels below the knee
+            const float over = fastLog2 (bits) - threshLog2;
+            const float kneeCorr = dBPerLog2 * over + halfKnee;
+            const int32 compress = bits >= upperBits ? -1 : 0;
+            const int32 active = bits > lowerBits ? -1 : 0;
+            const int32 gainLog2 = ((floatBits (slope * over) & compress)
+                                 | (floatBits (kneeScale * kneeCorr * kneeCorr) & ~compress)) & active;
+            gains[n] = fastExp2 (bitsToFloat (gainLog2));
+        }
+    }
+
 private:
+    static inline int32 floatBits (float x) noexcept
+    {
+        int32 bits;
+        std::memcpy (&bits, &x, sizeof (bits));
+        return bits;
+    }
+
+    static inline float bitsToFloat (int32 bits) noexcept
+    {
+        float x;
+        std::memcpy (&x, &bits, sizeof (x));
+        return x;
+    }
+
+    /** log2 of a positive float given as its bits, within about 1e-6 */
+    static inline float fastLog2 (int32 bits) noexcept
+    {
+        // split into exponent and a mantissa in [sqrt(0.5), sqrt(2))
+        int32 mantissa = (bits & 0x7fffff) | 0x3f800000;
+        const int32 high = mantissa > 0x3fb504f3 ? 1 : 0;
+        mantissa -= high << 23;
+        const float exponent = (float) (((bits >> 23) & 0xff) - 127 + high);
+
+        const float m = bitsToFloat (mantissa);
+        const float t = (m - 1.0f) / (m + 1.0f), t2 = t * t;
+        return exponent + t * (2.88539008f + t2 * (0.961796694f + t2 * (0.577078016f + t2 * 0.412198583f)));
+    }
+
+    /** 2^x within about 3e-7, for x well inside the float exponent range */
+    static inline float fastExp2 (float x) noexcept
+    {
+        const int32 i = (int32) (x + 128.5f) - 128;
+        const float f = (x - (float) i) * 0.693147181f;
+        const float p = 1.0f + f * (1.0f + f * (0.5f + f * (0.166666667f + f * (0.0416666667f
+                      + f * (0.00833333333f + f * 0.00138888889f)))));
+        return p * bitsToFloat ((i + 127) << 23);
+    }
+
     // recalculate knee values for a new threshold or knee width
     void recalcKnees()
     {
@@ -223,15 +335,13 @@ public:
     void setStateInformation (const void* data, int sizeInBytes) override;
     void numChannelsChanged() override;
 
-    class Listener
-    {
-    public:
-        virtual ~Listener() {}
-        virtual void updateInGainDB (float /*inDB*/) {}
-    };
+    /** Returns the detector level at the end of the last block, safe to poll
+        from any thread */
+    float getInputLevelDB() const noexcept      { return inputLevelDB.load (std::memory_order_relaxed); }
 
-    void addListener (Listener* l) { listeners.add (l); }
-    void removeListener (Listener* l) { listeners.remove (l); }
+    /** Returns the most gain reduction in the last block as a positive
+        number of dB, safe to poll from any thread */
+    float getGainReductionDB() const noexcept   { return gainReductionDB.load (std::memory_order_relaxed); }
 
 protected:
     inline bool isBusesLayoutSupported (const BusesLayout& layout) const override 
@@ -260,13 +370,12 @@ protected:
     }
 
 private:
-    inline float getSummedMonoSample (AudioBuffer<float>& buffer, int idx, int numChans)
-    {
-        float sum = 0.0f;
-        for (int ch = 0; ch < numChans; ++ch)
-            sum += buffer.getSample (ch, idx);
-        return sum / (float) numChans;
-    };
+    /** Blocks are processed in chunks of this many samples */
+    enum { chunkSize = 256 };
+
+    /** Writes the signal the detector follows, the channels averaged or when
+        linked the loudest channel */
+    void getDetectorInput (const AudioBuffer<float>& buffer, int start, int numSamples, float* dest) const noexcept;
 
     int numChannels = 0;
     AudioParameterFloat* threshDB  = nullptr;
@@ -276,6 +385,7 @@ private:
     AudioParameterFloat* releaseMs = nullptr;
     AudioParameterFloat* makeupDB  = nullptr;
     AudioParameterFloat* sideChain = nullptr;
+    AudioParameterChoice* stereoLink = nullptr;
 
     SmoothedValue<float, ValueSmoothingTypes::Multiplicative> makeupGain = 1.0f;
     const int numSteps = 200;
@@ -284,7 +394,13 @@ private:
     LevelDetector sideDetector;
     GainComputer gainComputer;
 
-    ListenerList<Listener> listeners;
+    float detectorInput [chunkSize];
+    float sideInput [chunkSize];
+    float levels [chunkSize];
+    float gains [chunkSize];
+
+    std::atomic<float> inputLevelDB { -100.0f };
+    std::atomic<float> gainReductionDB { 0.0f };
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CompressorProcessor)
 };
@@ -0,0 +1,462 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "engine/nodes/ConvolutionProcessor.h"
+#include "gui/LookAndFeel.h"
+
+namespace Element {
+
+/** Longest impulse response read from a file */
+static const double maxImpulseSeconds = 20.0;
+
+//==============================================================================
+class ConvolutionEditor : public AudioProcessorEditor,
+                          public FilenameComponentListener,
+                          public Timer
+{
+public:
+    ConvolutionEditor (ConvolutionProcessor& o)
+        : AudioProcessorEditor (&o),
+          processor (o)
+    {
+        setOpaque (true);
+        chooser.reset (new FilenameComponent ("Impulse Response", File(),
+                                              false, false, false,
+                                              o.getWildcard(), String(),
+                                              TRANS("Select Impulse Response")));
+        addAndMakeVisible (chooser.get());
+        chooser->addListener (this);
+
+        addAndMakeVisible (info);
+        info.setJustificationType (Justification::centredLeft);
+
+        for (auto* slider : { &wet, &dry })
+        {
+            addAndMakeVisible (slider);
+            slider->setSliderStyle (Slider::LinearBar);
+            slider->setRange (0.0, 1.0, 0.001);
+        }
+
+        wet.setTextValueSuffix (" wet");
+        dry.setTextValueSuffix (" dry");
+        wet.onValueChange = [this]() { setParameter (ConvolutionProcessor::WetLevel, wet); };
+        dry.onValueChange = [this]() { setParameter (ConvolutionProcessor::DryLevel, dry); };
+
+        stabilizeComponents();
+        setSize (360, 92);
+        startTimer (1001);
+    }
+
+    ~ConvolutionEditor() noexcept
+    {
+        stopTimer();
+        wet.onValueChange = nullptr;
+        dry.onValueChange = nullptr;
+        chooser->removeListener (this);
+        chooser = nullptr;
+    }
+
+    void timerCallback() override { stabilizeComponents(); }
+    void stabilizeComponents()
+    {
+        if (chooser->getCurrentFile() != processor.getImpulseFile())
+            chooser->setCurrentFile (processor.getImpulseFile(), dontSendNotification);
+
+        const int numChannels = processor.getImpulseNumChannels();
+        String text;
+        if (numChannels <= 0)
+            text = "No impulse response";
+        else
+            text << (numChannels >= 4 ? "True stereo" : numChannels >= 2 ? "Stereo" : "Mono")
+                 << ", " << String (processor.getImpulseLengthSeconds(), 2) << " s";
+        info.setText (text, dontSendNotification);
+
+        const auto& params = processor.getParameters();
+        wet.setValue (params [ConvolutionProcessor::WetLevel]->getValue(), dontSendNotification);
+        dry.setValue (params [ConvolutionProcessor::DryLevel]->getValue(), dontSendNotification);
+    }
+
+    void filenameComponentChanged (FilenameComponent*) override
+    {
+        processor.loadImpulseResponse (chooser->getCurrentFile());
+        stabilizeComponents();
+    }
+
+    void resized() override
+    {
+        auto r (getLocalBounds().reduced (4));
+        chooser->setBounds (r.removeFromTop (18));
+        r.removeFromTop (4);
+        info.setBounds (r.removeFromTop (18));
+        r.removeFromTop (4);
+        wet.setBounds (r.removeFromTop (18));
+        r.removeFromTop (4);
+        dry.setBounds (r.removeFromTop (18));
+    }
+
+    void paint (Graphics& g) override
+    {
+        g.fillAll (LookAndFeel::widgetBackgroundColor);
+    }
+
+private:
+    ConvolutionProcessor& processor;
+    std::unique_ptr<FilenameComponent> chooser;
+    Label info;
+    Slider wet, dry;
+
+    void setParameter (int index, Slider& slider)
+    {
+        if (auto* const param = dynamic_cast<AudioParameterFloat*> (processor.getParameters()[index]))
+            *param = static_cast<float> (slider.getValue());
+    }
+};
+
+//==============================================================================
+/** The convolvers for one impulse response and the channels they route */
+struct ConvolutionProcessor::Kernel
+{
+    struct Route { int input, output; };
+
+    Kernel (ConvolutionWorker& w, const AudioBuffer<float>& ir, int maxBlockSize)
+        : worker (w)
+    {
+        const int numChannels = ir.getNumChannels();
+        if (numChannels >= 4)
+        {
+            addRoute (ir, 0, 0, 0, maxBlockSize);
+            addRoute (ir, 1, 0, 1, maxBlockSize);
+            addRoute (ir, 2, 1, 0, maxBlockSize);
+            addRoute (ir, 3, 1, 1, maxBlockSize);
+        }
+        else if (numChannels >= 2)
+        {
+            addRoute (ir, 0, 0, 0, maxBlockSize);
+            addRoute (ir, 1, 1, 1, maxBlockSize);
+        }
+        else if (numChannels == 1)
+        {
+            addRoute (ir, 0, 0, 0, maxBlockSize);
+            addRoute (ir, 0, 1, 1, maxBlockSize);
+        }
+
+        scratch.calloc ((size_t) jmax (1, maxBlockSize));
+        for (auto* convolver : convolvers)
+            worker.add (convolver);
+    }
+
+    ~Kernel()
+    {
+        for (auto* convolver : convolvers)
+            worker.remove (convolver);
+    }
+
+    void process (const float* const* input, float* const* output, int numChannels, int numSamples) noexcept
+    {
+        for (int ch = 0; ch < numChannels; ++ch)
+            FloatVectorOperations::clear (output[ch], numSamples);
+
+        for (int i = 0; i < convolvers.size(); ++i)
+        {
+            const auto& route = routes.getReference (i);
+            if (route.input >= numChannels || route.output >= numChannels)
+                continue;
+            convolvers.getUnchecked(i)->process (input [route.input], scratch, numSamples);
+            FloatVectorOperations::add (output [route.output], scratch, numSamples);
+        }
+    }
+
+    ConvolutionWorker& worker;
+    OwnedArray<PartitionedConvolver> convolvers;
+    Array<Route> routes;
+    HeapBlock<float> scratch;
+
+private:
+    void addRoute (const AudioBuffer<float>& ir, int channel, int input, int output, int maxBlockSize)
+    {
+        convolvers.add (new PartitionedConvolver (ir.getReadPointer (channel), ir.getNumSamples(), maxBlockSize));
+        routes.add ({ input, output });
+    }
+};
+
+//==============================================================================
+ConvolutionProcessor::ConvolutionProcessor()
+    : BaseProcessor()
+{
+    setPlayConfigDetails (2, 2, 44100.0, 1024);
+    addParameter (wetLevel = new AudioParameterFloat ("wetLevel", "Wet Level", 0.0f, 1.0f, 1.0f));
+    addParameter (dryLevel = new AudioParameterFloat ("dryLevel", "Dry Level", 0.0f, 1.0f, 0.0f));
+    formats.registerBasicFormats();
+}
+
+ConvolutionProcessor::~ConvolutionProcessor()
+{
+    deleteKernels();
+    worker.stop();
+    wetLevel = dryLevel = nullptr;
+}
+
+void ConvolutionProcessor::fillInPluginDescription (PluginDescription& desc) const
+{
+    desc.name = getName();
+    desc.fileOrIdentifier   = EL_INTERNAL_ID_CONVOLUTION;
+    desc.descriptiveName    = "Convolves audio with an impulse response";
+    desc.numInputChannels   = 2;
+    desc.numOutputChannels  = 2;
+    desc.hasSharedContainer = false;
+    desc.isInstrument       = false;
+    desc.manufacturerName   = "Element";
+    desc.pluginFormatName   = "Element";
+    desc.version            = "1.0.0";
+    desc.uid                = EL_INTERNAL_UID_CONVOLUTION;
+}
+
+double ConvolutionProcessor::getImpulseLengthSeconds() const
+{
+    return impulseRate > 0.0 ? (double) impulse.getNumSamples() / impulseRate : 0.0;
+}
+
+//==============================================================================
+bool ConvolutionProcessor::loadImpulseResponse (const File& file)
+{
+    std::unique_ptr<AudioFormatReader> reader (formats.createReaderFor (file));
+    if (reader == nullptr || reader->sampleRate <= 0.0)
+        return false;
+
+    const int numSamples = (int) jmin (reader->lengthInSamples, (int64) (maxImpulseSeconds * reader->sampleRate));
+    AudioBuffer<float> buffer (jlimit (1, 4, (int) reader->numChannels), jmax (0, numSamples));
+    reader->read (&buffer, 0, buffer.getNumSamples(), 0, true, true);
+
+    setImpulseResponse (buffer, reader->sampleRate);
+    impulseFile = file;
+    return true;
+}
+
+void ConvolutionProcessor::setImpulseResponse (const AudioBuffer<float>& newImpulse, double sampleRate)
+{
+    impulse.makeCopyOf (newImpulse);
+    impulseRate = sampleRate;
+    impulseFile = File();
+    if (blockSize > 0)
+        publish (createKernel());
+}
+
+void ConvolutionProcessor::clearImpulseResponse()
+{
+    setImpulseResponse (AudioBuffer<float>(), 0.0);
+}
+
+ConvolutionProcessor::Kernel* ConvolutionProcessor::createKernel()
+{
+    const double sampleRate = getSampleRate();
+    if (impulse.getNumSamples() <= 0 || impulseRate <= 0.0 || sampleRate <= 0.0)
+        return new Kernel (worker, AudioBuffer<float>(), blockSize);
+
+    if (impulseRate == sampleRate)
+        return new Kernel (worker, impulse, blockSize);
+
+    const double ratio = impulseRate / sampleRate;
+    const int numChannels = impulse.getNumChannels();
+    const int numSamples = jmax (1, roundToInt (impulse.getNumSamples() / ratio));
+
+    // the interpolator reads a few samples past the last one it produces
+    AudioBuffer<float> padded (numChannels, impulse.getNumSamples() + 16);
+    padded.clear();
+    AudioBuffer<float> resampled (numChannels, numSamples);
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        padded.copyFrom (ch, 0, impulse, ch, 0, impulse.getNumSamples());
+        LagrangeInterpolator interpolator;
+        interpolator.process (ratio, padded.getReadPointer (ch), resampled.getWritePointer (ch), numSamples);
+    }
+
+    // keep the level of the response when the number of taps changes
+    resampled.applyGain ((float) ratio);
+    return new Kernel (worker, resampled, blockSize);
+}
+
+void ConvolutionProcessor::publish (Kernel* kernel)
+{
+    delete retired.exchange (nullptr);
+    delete pending.exchange (kernel); // one that was never picked up
+}
+
+void ConvolutionProcessor::takePendingKernel() noexcept
+{
+    if (fadePos < fadeLength || retired.load() != nullptr)
+        return;
+
+    auto* const next = pending.exchange (nullptr);
+    if (next == nullptr)
+        return;
+
+    fading = active;
+    active = next;
+    fadePos = 0;
+}
+
+void ConvolutionProcessor::deleteKernels()
+{
+    cancelPendingUpdate();
+    delete pending.exchange (nullptr);
+    delete retired.exchange (nullptr);
+    delete fading;
+    fading = nullptr;
+    delete active;
+    active = nullptr;
+    fadePos = fadeLength;
+}
+
+void ConvolutionProcessor::handleAsyncUpdate()
+{
+    delete retired.exchange (nullptr);
+}
+
+//==============================================================================
+void ConvolutionProcessor::prepareToPlay (double sampleRate, int maximumExpectedSamplesPerBlock)
+{
+    setPlayConfigDetails (2, 2, sampleRate, maximumExpectedSamplesPerBlock);
+    blockSize = jmax (1, maximumExpectedSamplesPerBlock);
+    dryBuffer.setSize (2, blockSize);
+    wetBuffer.setSize (2, blockSize);
+    fadeBuffer.setSize (2, blockSize);
+
+    wetGain.reset (sampleRate, 0.02);
+    dryGain.reset (sampleRate, 0.02);
+    wetGain.setCurrentAndTargetValue (*wetLevel);
+    dryGain.setCurrentAndTargetValue (*dryLevel);
+
+    deleteKernels();
+    active = createKernel();
+    worker.start();
+}
+
+void ConvolutionProcessor::releaseResources()
+{
+    worker.stop();
+}
+
+void ConvolutionProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuffer&)
+{
+    const int numChannels = jmin (2, buffer.getNumChannels());
+    const int numSamples = buffer.getNumSamples();
+    if (blockSize <= 0)
+        return;
+
+    takePendingKernel();
+    wetGain.setTargetValue (*wetLevel);
+    dryGain.setTargetValue (*dryLevel);
+
+    auto** const dry = dryBuffer.getArrayOfWritePointers();
+    auto** const wet = wetBuffer.getArrayOfWritePointers();
+    auto** const old = fadeBuffer.getArrayOfWritePointers();
+
+    for (int start = 0; start < numSamples; start += blockSize)
+    {
+        const int num = jmin (blockSize, numSamples - start);
+        float* out[2] = { nullptr, nullptr };
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            out[ch] = buffer.getWritePointer (ch, start);
+            FloatVectorOperations::copy (dry[ch], out[ch], num);
+        }
+
+        if (active != nullptr)
+            active->process (dry, wet, numChannels, num);
+        else
+            for (int ch = 0; ch < numChannels; ++ch)
+                FloatVectorOperations::clear (wet[ch], num);
+
+        // crossfade from the previous impulse, which may be none
+        if (fadePos < fadeLength)
+        {
+            if (fading != nullptr)
+                fading->process (dry, old, numChannels, num);
+            else
+                for (int ch = 0; ch < numChannels; ++ch)
+                    FloatVectorOperations::clear (old[ch], num);
+
+            for (int ch = 0; ch < numChannels; ++ch)
+                for (int i = 0; i < num; ++i)
+                    wet[ch][i] = old[ch][i] + (wet[ch][i] - old[ch][i])
+                        * jmin (1.0f, (float) (fadePos + i) / (float) fadeLength);
+
+            fadePos += num;
+            if (fadePos >= fadeLength && fading != nullptr)
+            {
+                retired.store (fading);
+                fading = nullptr;
+                triggerAsyncUpdate();
+            }
+        }
+
+        if (wetGain.isSmoothing() || dryGain.isSmoothing())
+        {
+            for (int i = 0; i < num; ++i)
+            {
+                const float wetValue = wetGain.getNextValue();
+                const float dryValue = dryGain.getNextValue();
+                for (int ch = 0; ch < numChannels; ++ch)
+                    out[ch][i] = wet[ch][i] * wetValue + dry[ch][i] * dryValue;
+            }
+        }
+        else
+        {
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                FloatVectorOperations::copyWithMultiply (out[ch], wet[ch], wetGain.getTargetValue(), num);
+                FloatVectorOperations::addWithMultiply (out[ch], dry[ch], dryGain.getTargetValue(), num);
+            }
+        }
+    }
+}
+
+AudioProcessorEditor* ConvolutionProcessor::createEditor()
+{
+    return new ConvolutionEditor (*this);
+}
+
+//==============================================================================
+void ConvolutionProcessor::getStateInformation (juce::MemoryBlock& destData)
+{
+    ValueTree state (Tags::state);
+    state.setProperty ("impulseFile", impulseFile.getFullPathName(), nullptr)
+         .setProperty ("wetLevel", (float) *wetLevel, nullptr)
+         .setProperty ("dryLevel", (float) *dryLevel, nullptr);
+    MemoryOutputStream stream (destData, false);
+    state.writeToStream (stream);
+}
+
+void ConvolutionProcessor::setStateInformation (const void* data, int sizeInBytes)
+{
+    const auto state = ValueTree::readFromData (data, (size_t) sizeInBytes);
+    if (! state.isValid())
+        return;
+
+    const String path = state["impulseFile"].toString();
+    if (File::isAbsolutePath (path))
+        loadImpulseResponse (File (path));
+    else
+        clearImpulseResponse();
+
+    *wetLevel = (float) state.getProperty ("wetLevel", (float) *wetLevel);
+    *dryLevel = (float) state.getProperty ("dryLevel", (float) *dryLevel);
+}
+
+}
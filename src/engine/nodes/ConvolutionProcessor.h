@@ -0,0 +1,118 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "engine/nodes/BaseProcessor.h"
+#include "engine/PartitionedConvolver.h"
+
+namespace Element {
+
+/** Stereo convolution with an impulse response file.
+
+    Mono impulses are applied to both channels, stereo impulses per channel
+    and four channel impulses as true stereo, in the order left to left,
+    left to right, right to left and right to right.
+
+    Impulses are resampled to the current rate and built on the message
+    thread, then handed to the audio thread, which crossfades from the
+    previous impulse.
+ */
+class ConvolutionProcessor : public BaseProcessor,
+                             private AsyncUpdater
+{
+public:
+    enum Parameters { WetLevel = 0, DryLevel };
+
+    ConvolutionProcessor();
+    virtual ~ConvolutionProcessor();
+
+    /** Loads an impulse response file. Returns false if it can't be read */
+    bool loadImpulseResponse (const File& file);
+
+    /** Uses an impulse response recorded at the given rate */
+    void setImpulseResponse (const AudioBuffer<float>& impulse, double sampleRate);
+
+    /** Removes the impulse response */
+    void clearImpulseResponse();
+
+    const File& getImpulseFile() const                  { return impulseFile; }
+    int getImpulseNumChannels() const                   { return impulse.getNumChannels(); }
+    double getImpulseLengthSeconds() const;
+    String getWildcard() const                          { return formats.getWildcardForAllFormats(); }
+
+    void fillInPluginDescription (PluginDescription& desc) const override;
+
+    const String getName() const override               { return "Convolution"; }
+    void prepareToPlay (double sampleRate, int maximumExpectedSamplesPerBlock) override;
+    void releaseResources() override;
+    void processBlock (AudioBuffer<float>& buffer, MidiBuffer& midiMessages) override;
+
+    AudioProcessorEditor* createEditor() override;
+    bool hasEditor() const override                     { return true; }
+
+    double getTailLengthSeconds() const override        { return getImpulseLengthSeconds(); }
+    bool acceptsMidi() const override                   { return false; }
+    bool producesMidi() const override                  { return false; }
+
+    int getNumPrograms() override                       { return 1; };
+    int getCurrentProgram() override                    { return 0; };
+    void setCurrentProgram (int index) override         { ignoreUnused (index); };
+    const String getProgramName (int index) override    { ignoreUnused (index); return getName(); }
+    void changeProgramName (int index, const String& newName) override { ignoreUnused (index, newName); }
+
+    void getStateInformation (juce::MemoryBlock& destData) override;
+    void setStateInformation (const void* data, int sizeInBytes) override;
+
+private:
+    struct Kernel;
+    enum { fadeLength = 2048 };
+
+    AudioFormatManager formats;
+    ConvolutionWorker worker;
+
+    AudioParameterFloat* wetLevel   { nullptr };
+    AudioParameterFloat* dryLevel   { nullptr };
+    SmoothedValue<float, ValueSmoothingTypes::Linear> wetGain, dryGain;
+
+    File impulseFile;
+    AudioBuffer<float> impulse;
+    double impulseRate = 0.0;
+
+    int blockSize = 0;
+    AudioBuffer<float> dryBuffer, wetBuffer, fadeBuffer;
+
+    // built on the message thread, handed over through pending and given
+    // back through retired once the crossfade from it has finished
+    Kernel* active = nullptr;
+    Kernel* fading = nullptr;
+    int fadePos = fadeLength;
+    std::atomic<Kernel*> pending { nullptr };
+    std::atomic<Kernel*> retired { nullptr };
+
+    Kernel* createKernel();
+    void publish (Kernel* kernel);
+    void takePendingKernel() noexcept;
+    void deleteKernels();
+    void handleAsyncUpdate() override;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ConvolutionProcessor)
+};
+
+}
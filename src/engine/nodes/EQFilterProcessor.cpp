@@ -61,21 +61,17 @@ void EQFilterProcessor::fillInPluginDescription (PluginDescription &desc) const
 
 void EQFilterProcessor::updateParams()
 {
-    for (int ch = 0; ch < 2; ++ch)
-    {
-        eqFilter[ch].setFrequency (*freq);
-        eqFilter[ch].setQ (*q);
-        eqFilter[ch].setGain (Decibels::decibelsToGain ((float) *gainDB));
-        eqFilter[ch].setShape ((EQFilter::Shape) eqShape->getIndex());
-    }
+    eqFilter.setFrequency (*freq);
+    eqFilter.setQ (*q);
+    eqFilter.setGain (Decibels::decibelsToGain ((float) *gainDB));
+    eqFilter.setShape ((EQFilter::Shape) eqShape->getIndex());
 }
 
 void EQFilterProcessor::prepareToPlay (double sampleRate, int maximumExpectedSamplesPerBlock)
 {
     updateParams();
 
-    for (int ch = 0; ch < 2; ++ch)
-        eqFilter[ch].reset (sampleRate);
+    eqFilter.reset (sampleRate);
 
     setPlayConfigDetails (numChannels, numChannels, sampleRate, maximumExpectedSamplesPerBlock);
 }
@@ -87,8 +83,10 @@ void EQFilterProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuffer&)
 
     updateParams();
 
-    for (int c = 0; c < numChans; ++c)
-        eqFilter[c].processBlock (output[c], buffer.getNumSamples());
+    if (numChans == 2)
+        eqFilter.processBlock (output[0], output[1], buffer.getNumSamples());
+    else if (numChans == 1)
+        eqFilter.processBlock (output[0], buffer.getNumSamples());
 }
 
 AudioProcessorEditor* EQFilterProcessor::createEditor()
@@ -48,20 +48,29 @@ public:
     void setFrequency (float newFreq)
     {
         if (newFreq != freq.getTargetValue())
+        {
             // don't allow the cutoff frequency to get to close to Nyquist (could go unstable)
             freq.setTargetValue (jmin (newFreq, fs / 2.0f - 100.0f));
+            smoothingLeft = smoothSteps;
+        }
     }
 
     void setQ (float newQ)
     {
         if (newQ != Q.getTargetValue())
+        {
             Q.setTargetValue (newQ);
+            smoothingLeft = smoothSteps;
+        }
     }
 
     void setGain (float newGain)
     {
         if (newGain != gain.getTargetValue())
+        {
             gain.setTargetValue (newGain);
+            smoothingLeft = smoothSteps;
+        }
     }
 
     void setShape (Shape newShape)
@@ -101,7 +110,15 @@ public:
             return;
         }
 
-        calcCoefs (freq.skip (smoothSteps), Q.skip (smoothSteps), gain.skip (smoothSteps));
+        skipSmoothing();
+    }
+
+    /** Sets how many samples apart the coefficients are calculated while
+        parameters are smoothing. They are interpolated in between, an
+        interval of 1 calculates them on every sample */
+    void setCoefficientInterval (int numSamples)
+    {
+        coefficientInterval = jlimit (1, smoothSteps, numSamples);
     }
 
     /* Calculate filter coefficients for an EQ band (see "Audio EQ Cookbook") */
@@ -211,35 +228,100 @@ public:
         a[2] = (phi - K + 1.0f) / a0;
     }
 
-    inline float process (float x)
+    /** The coefficients and state of a filter held in locals while rendering,
+        one lane per channel so the channels are filtered side by side */
+    template<int numLanes>
+    struct Kernel
     {
-        // process input sample, direct form II transposed
-        float y = z[1] + x * b[0];
+        float c[5];         // b0 b1 b2 a1 a2
+        float dc[5];        // per sample change while interpolating
+        float z1[numLanes];
+        float z2[numLanes];
 
-        z[1] = z[2] + x*b[1] - y*a[1];
-        z[2] = x*b[2] - y*a[2];
+        inline void process (float (&x)[numLanes]) noexcept
+        {
+            for (int k = 0; k < 5; ++k)
+                c[k] += dc[k];
+
+            // direct form II transposed
+            for (int l = 0; l < numLanes; ++l)
+            {
+                const float y = z1[l] + x[l] * c[0];
+                z1[l] = z2[l] + x[l] * c[1] - y * c[3];
+                z2[l] = x[l] * c[2] - y * c[4];
+                x[l] = y;
+            }
+        }
+    };
 
-        return y;
+    /** Returns how many of the next maxSamples can be rendered with one
+        kernel, starting a new coefficient ramp if parameters are smoothing */
+    int prepareSamples (int maxSamples) noexcept
+    {
+        if (rampLeft <= 0 && smoothingLeft > 0)
+            startRamp();
+        return rampLeft > 0 ? jmin (rampLeft, maxSamples) : maxSamples;
     }
 
-    void processBlock (float* buffer, int numSamples)
+    template<int numLanes>
+    Kernel<numLanes> getKernel() const noexcept
+    {
+        Kernel<numLanes> k;
+        for (int i = 0; i < 5; ++i)
+        {
+            k.c[i] = coefs[i];
+            k.dc[i] = rampLeft > 0 ? steps[i] : 0.f;
+        }
+        for (int l = 0; l < numLanes; ++l)
+        {
+            k.z1[l] = z1[l];
+            k.z2[l] = z2[l];
+        }
+        return k;
+    }
+
+    /** Stores a kernel back after it rendered numSamples */
+    template<int numLanes>
+    void setKernel (const Kernel<numLanes>& k, int numSamples) noexcept
     {
-        for (int n = 0; n < numSamples; n++)
+        for (int l = 0; l < numLanes; ++l)
         {
-            if (freq.isSmoothing() || Q.isSmoothing() || gain.isSmoothing())
-                calcCoefs (freq.getNextValue(), Q.getNextValue(), gain.getNextValue());
-            buffer[n] = process (buffer[n]);
+            z1[l] = k.z1[l];
+            z2[l] = k.z2[l];
         }
+
+        if (rampLeft <= 0)
+            return;
+        rampLeft -= numSamples;
+        if (rampLeft <= 0)
+            loadCoefs(); // lands exactly on the target
+        else
+            for (int i = 0; i < 5; ++i)
+                coefs[i] = k.c[i];
+    }
+
+    /** Filters one channel in place */
+    void processBlock (float* buffer, int numSamples)
+    {
+        float* channels[1] = { buffer };
+        processLanes<1> (channels, numSamples);
+    }
+
+    /** Filters two channels in place with the same coefficients */
+    void processBlock (float* left, float* right, int numSamples)
+    {
+        float* channels[2] = { left, right };
+        processLanes<2> (channels, numSamples);
     }
 
     void reset (double sampleRate)
     {
         // clear state
-        for (int n = 0; n < 3; ++n)
-            z[n] = 0.0f;
+        for (int l = 0; l < maxLanes; ++l)
+            z1[l] = z2[l] = 0.0f;
 
         fs = (float) sampleRate;
-        calcCoefs (freq.skip (smoothSteps), Q.skip (smoothSteps), gain.skip (smoothSteps));
+        skipSmoothing();
     }
 
     /** Get the magnitude of the filter at this frequency, in units of linear gain */
@@ -320,17 +402,77 @@ private:
     SmoothedValue<float, ValueSmoothingTypes::Linear> Q;
     SmoothedValue<float, ValueSmoothingTypes::Linear> gain;
     const int smoothSteps = 500;
+    int coefficientInterval = 32;
+    int smoothingLeft = 0;  // samples until the parameters reach their targets
+    int rampLeft = 0;       // samples left in the current coefficient ramp
 
     Shape eqShape = Bell;
     typedef std::function<void (float, float, float)> CalcCoefsLambda;
     CalcCoefsLambda calcCoefs = [this] (float fc, float Q, float gain) { calcCoefsBell (fc, Q, gain); }; // lambda function to calculate coefficients for any shape
 
+    // the coefficients last calculated, targets while interpolating
     float b[3] = { 1.0f, 0.0f, 0.0f };
     float a[3] = { 1.0f, 0.0f, 0.0f };
-    float z[3] = { 0.0f, 0.0f, 0.0f };
+
+    // the coefficients in use
+    float coefs[5] = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+    float steps[5] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+
+    enum { maxLanes = 2 };
+    float z1[maxLanes] = { 0.0f, 0.0f };
+    float z2[maxLanes] = { 0.0f, 0.0f };
 
     float fs = 44100.0f;
 
+    void loadCoefs() noexcept
+    {
+        coefs[0] = b[0]; coefs[1] = b[1]; coefs[2] = b[2];
+        coefs[3] = a[1]; coefs[4] = a[2];
+        rampLeft = 0;
+    }
+
+    void skipSmoothing()
+    {
+        calcCoefs (freq.skip (smoothSteps), Q.skip (smoothSteps), gain.skip (smoothSteps));
+        smoothingLeft = 0;
+        loadCoefs();
+    }
+
+    void startRamp() noexcept
+    {
+        const int numSamples = jmin (coefficientInterval, smoothingLeft);
+        smoothingLeft -= numSamples;
+        calcCoefs (freq.skip (numSamples), Q.skip (numSamples), gain.skip (numSamples));
+
+        const float target[5] = { b[0], b[1], b[2], a[1], a[2] };
+        for (int i = 0; i < 5; ++i)
+            steps[i] = (target[i] - coefs[i]) / (float) numSamples;
+        rampLeft = numSamples;
+    }
+
+    template<int numLanes>
+    void processLanes (float* const (&channels)[numLanes], int numSamples) noexcept
+    {
+        for (int n = 0; n < numSamples;)
+        {
+            const int numToDo = prepareSamples (numSamples - n);
+            auto k = getKernel<numLanes>();
+            float x[numLanes];
+
+            for (int i = n; i < n + numToDo; ++i)
+            {
+                for (int l = 0; l < numLanes; ++l)
+                    x[l] = channels[l][i];
+                k.process (x);
+                for (int l = 0; l < numLanes; ++l)
+                    channels[l][i] = x[l];
+            }
+
+            setKernel (k, numToDo);
+            n += numToDo;
+        }
+    }
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (EQFilter)
 };
 
@@ -349,7 +491,7 @@ public:
     void processBlock (AudioBuffer<float>& buffer, MidiBuffer&) override;
 
     void updateParams();
-    float getMagnitudeAtFreq (float freq) { return eqFilter[0].getMagnitudeAtFreq (freq); }
+    float getMagnitudeAtFreq (float freq) { return eqFilter.getMagnitudeAtFreq (freq); }
 
     AudioProcessorEditor* createEditor() override;
     bool hasEditor() const override                 { return true; }
@@ -397,7 +539,7 @@ private:
     AudioParameterFloat* q        = nullptr;
     AudioParameterFloat* gainDB   = nullptr;
     AudioParameterChoice* eqShape = nullptr;
-    EQFilter eqFilter[2];
+    EQFilter eqFilter;
 };
 
 }
@@ -75,13 +75,10 @@ namespace Element {
                 filt.reset (sampleRate);
             };
 
-            for (int ch = 0; ch < 2; ++ch)
-            {
-                setupFilter (lowLPF[ch],  *lowFreq,  EQFilter::Shape::LowPass);
-                setupFilter (lowHPF[ch],  *lowFreq,  EQFilter::Shape::HighPass);
-                setupFilter (highLPF[ch], *highFreq, EQFilter::Shape::LowPass);
-                setupFilter (highHPF[ch], *highFreq, EQFilter::Shape::HighPass);
-            }
+            setupFilter (lowLPF,  *lowFreq,  EQFilter::Shape::LowPass);
+            setupFilter (lowHPF,  *lowFreq,  EQFilter::Shape::HighPass);
+            setupFilter (highLPF, *highFreq, EQFilter::Shape::LowPass);
+            setupFilter (highHPF, *highFreq, EQFilter::Shape::HighPass);
 
             setBusesLayout (getBusesLayout());
             setRateAndBufferSizeDetails (sampleRate, maximumExpectedSamplesPerBlock);
@@ -101,35 +98,16 @@ namespace Element {
             const auto numChannels = inBuffer.getNumChannels();
             const auto numSamples = buffer.getNumSamples();
 
-            // copy input into extra output channels
-            for (int ch = 0; ch < numChannels; ++ch)
-            {
-                lowBuffer.copyFrom (ch, 0, inBuffer.getReadPointer (ch), numSamples);
-                midBuffer.copyFrom (ch, 0, inBuffer.getReadPointer (ch), numSamples);
-                highBuffer.copyFrom (ch, 0, inBuffer.getReadPointer (ch), numSamples);
-            }
-
             // update filter parameters
-            for (int c = 0; c < 2; ++c)
-            {
-                lowLPF[c].setFrequency (*lowFreq);
-                lowHPF[c].setFrequency (*lowFreq);
-                highLPF[c].setFrequency (*highFreq);
-                highHPF[c].setFrequency (*highFreq);
-            }
-
-            for (int ch = 0; ch < numChannels; ++ch)
-            {
-                // Low freq band
-                lowLPF[ch].processBlock (lowBuffer.getWritePointer (ch), numSamples);
-
-                // Mid freq band
-                lowHPF[ch].processBlock  (midBuffer.getWritePointer (ch), numSamples);
-                highLPF[ch].processBlock (midBuffer.getWritePointer (ch), numSamples);
-
-                // High freq band
-                highHPF[ch].processBlock (highBuffer.getWritePointer (ch), numSamples);
-            }
+            lowLPF.setFrequency (*lowFreq);
+            lowHPF.setFrequency (*lowFreq);
+            highLPF.setFrequency (*highFreq);
+            highHPF.setFrequency (*highFreq);
+
+            if (numChannels == 2)
+                processLanes<2> (inBuffer, lowBuffer, midBuffer, highBuffer, numSamples);
+            else if (numChannels == 1)
+                processLanes<1> (inBuffer, lowBuffer, midBuffer, highBuffer, numSamples);
         }
 
         AudioProcessorEditor* createEditor() override   { return new GenericAudioProcessorEditor (this); }
@@ -203,10 +181,70 @@ namespace Element {
         int numChannelsOut = 0;
         AudioParameterFloat* lowFreq    = nullptr;
         AudioParameterFloat* highFreq   = nullptr;
-        EQFilter lowLPF[2];
-        EQFilter lowHPF[2];
-        EQFilter highLPF[2];
-        EQFilter highHPF[2];
+        EQFilter lowLPF;
+        EQFilter lowHPF;
+        EQFilter highLPF;
+        EQFilter highHPF;
+
+        /** Splits the input into all three bands in one pass, each filter
+            runs the channels side by side */
+        template<int numLanes>
+        void processLanes (const AudioBuffer<float>& in, AudioBuffer<float>& low,
+                           AudioBuffer<float>& mid, AudioBuffer<float>& high, int numSamples) noexcept
+        {
+            const float* input[numLanes];
+            float* lowOut[numLanes];
+            float* midOut[numLanes];
+            float* highOut[numLanes];
+            for (int l = 0; l < numLanes; ++l)
+            {
+                input[l]    = in.getReadPointer (l);
+                lowOut[l]   = low.getWritePointer (l);
+                midOut[l]   = mid.getWritePointer (l);
+                highOut[l]  = high.getWritePointer (l);
+            }
+
+            for (int n = 0; n < numSamples;)
+            {
+                int numToDo = numSamples - n;
+                numToDo = lowLPF.prepareSamples (numToDo);
+                numToDo = lowHPF.prepareSamples (numToDo);
+                numToDo = highLPF.prepareSamples (numToDo);
+                numToDo = highHPF.prepareSamples (numToDo);
+
+                auto lowLP  = lowLPF.getKernel<numLanes>();
+                auto lowHP  = lowHPF.getKernel<numLanes>();
+                auto highLP = highLPF.getKernel<numLanes>();
+                auto highHP = highHPF.getKernel<numLanes>();
+
+                for (int i = n; i < n + numToDo; ++i)
+                {
+                    // the input is read before any output is written, the
+                    // low band shares its channels in place
+                    float lo[numLanes], md[numLanes], hi[numLanes];
+                    for (int l = 0; l < numLanes; ++l)
+                        lo[l] = md[l] = hi[l] = input[l][i];
+
+                    lowLP.process (lo);
+                    lowHP.process (md);
+                    highLP.process (md);
+                    highHP.process (hi);
+
+                    for (int l = 0; l < numLanes; ++l)
+                    {
+                        lowOut[l][i]  = lo[l];
+                        midOut[l][i]  = md[l];
+                        highOut[l][i] = hi[l];
+                    }
+                }
+
+                lowLPF.setKernel (lowLP, numToDo);
+                lowHPF.setKernel (lowHP, numToDo);
+                highLPF.setKernel (highLP, numToDo);
+                highHPF.setKernel (highHP, numToDo);
+                n += numToDo;
+            }
+        }
     };
 
 }
@@ -20,12 +20,17 @@
 #include <math.h>
 #include "sol/sol.hpp"
 #include "lua-kv.h"
+#include "modules/dsp/audio.h"
 
 #include "ElementApp.h"
 #include "engine/nodes/LuaNode.h"
+#include "engine/EngineCommandQueue.h"
 #include "engine/MidiPipe.h"
 #include "engine/Parameter.h"
+#include "scripting/LuaAllocator.h"
 #include "scripting/LuaBindings.h"
+#include "scripting/LuaBytecodeCache.h"
+#include "scripting/LuaMidiView.h"
 
 #define EL_LUA_DBG(x)
 // #define EL_LUA_DBG(x) DBG(x)
@@ -46,10 +51,16 @@ R"(--- Stereo Amplifier in Lua
 
 local kv = require ('kv')
 
+-- Render with views of the engine's buffers instead of copies
+node_views = true
+
 -- Our gain parameters. Used for fading between changes in volume
 local start_gain = 1.0
 local end_gain = 1.0
 
+-- State handed to the next script when this one is replaced
+node_state = { gain = 1.0 }
+
 -- Return a table of audio/midi inputs and outputs
 function node_io_ports()
    return {
@@ -83,8 +94,8 @@ end
 
 --- Render audio and midi
 -- Use the provided audio and midi objects to process your plugin
--- @param a     The source kv.audio.Buffer
--- @param m     The source kv.midi.Pipe
+-- @param a     The source el.audio.Buffer
+-- @param m     The source el.midi.Pipe
 function node_render (a, m)
    end_gain = kv.dbtogain (Param.values[1])
 
@@ -92,10 +103,9 @@ function node_render (a, m)
    -- process a fade frame by frame
    local increment = (end_gain - start_gain) / a:length()
    for c = 1, a:channels() do
-      local vec = a:vector (c)
       local gain = start_gain
       for f = 1, a:length() do
-         vec[f] = gain * vec[f]
+         a:set (c, f, gain * a:get (c, f))
          gain = gain + increment
       end
    end
@@ -114,6 +124,17 @@ function node_render (a, m)
    --]]
 
    start_gain = end_gain
+   node_state.gain = end_gain
+end
+
+--- Carry state over from the script this one replaced
+-- This optional function is called when the node is already running.
+-- `old_state` is a copy of the old script's global `node_state` table.
+-- Only booleans, numbers, strings and tables are copied.
+function node_migrate (old_state)
+   if type (old_state.gain) == 'number' then
+      start_gain = old_state.gain
+   end
 end
 
 --- Release node resources
@@ -128,7 +149,8 @@ end
 -- `io.write(...)` your data
 --
 -- Note: Parameter values will automatically be saved and restored,
--- you do not need to handle them here.
+-- you do not need to handle them here. This runs in a copy of the
+-- script so playback never stops, only `node_state` is copied to it.
 function node_save()
    io.write("some custom state data")
 end
@@ -146,8 +168,7 @@ end
 namespace Element {
 
 //=============================================================================
-class LuaParameter : public ControlPortParameter,
-                     public Parameter::Listener
+class LuaParameter : public ControlPortParameter
 {
 public:
     LuaParameter (LuaNode::Context* c, const PortDescription& port)
@@ -156,7 +177,6 @@ public:
     {
         const auto sp = getPort();
         set (sp.defaultValue);
-        addListener (this);
     }
 
     ~LuaParameter()
@@ -168,42 +188,64 @@ public:
 
     void unlink()
     {
-        removeListener (this);
         ctx = nullptr;
     }
 
-    void controlValueChanged (int parameterIndex, float newValue) override;
-    void controlTouched (int parameterIndex, bool gestureIsStarting) override;
+    /** Also hands the value to the script. Parameter events are set on the
+        audio thread and only reported to listeners later, so this is where
+        the script sees them */
+    void setValue (float newValue) override;
     
 private:
     LuaNode::Context* ctx { nullptr };
 };
 
+/** How long validation lets a script run before it counts as hung */
+static const double validateSeconds = 1.0;
+
 //=============================================================================
 struct LuaNode::Context
 {
+    /** Largest node_state copy handed to node_migrate */
+    enum { snapshotCapacity = 64 * 1024 };
+
     explicit Context ()
+        : state (sol::default_at_panic, LuaAllocator::alloc, &allocator)
     { 
         L = state.lua_state();
+        // lets the watchdog hook find its context, coroutines inherit it
+        *static_cast<Context**> (lua_getextraspace (L)) = this;
+        ticksPerFrame = (double) Time::getHighResolutionTicksPerSecond() / 44100.0;
     }
 
     ~Context()
     {
-        for (auto* ip : inParams)
-            dynamic_cast<LuaParameter*>(ip)->unlink();
-        for (auto* op : outParams)
-            dynamic_cast<LuaParameter*>(op)->unlink();
+        unlinkParameters();
         inParams.clear();
         outParams.clear();
 
         luaL_unref (state, LUA_REGISTRYINDEX, renderRef);
+        luaL_unref (state, LUA_REGISTRYINDEX, stateKeyRef);
+        luaL_unref (state, LUA_REGISTRYINDEX, deadlineErrorRef);
         audioBuffer = nullptr;
+        audioView = nullptr;
         luaL_unref (state, LUA_REGISTRYINDEX, audioBufRef);
         midiPipe = nullptr;
+        midiView = nullptr;
         luaL_unref (state, LUA_REGISTRYINDEX, midiPipeRef);
         state.collect_garbage();
     }
 
+    /** Stops parameter changes reaching this context. Call on the message
+        thread before the context is handed to another thread to delete */
+    void unlinkParameters()
+    {
+        for (auto* ip : inParams)
+            dynamic_cast<LuaParameter*>(ip)->unlink();
+        for (auto* op : outParams)
+            dynamic_cast<LuaParameter*>(op)->unlink();
+    }
+
     String getName() const { return name; }
 
     bool ready() const { return loaded; }
@@ -220,9 +262,14 @@ struct LuaNode::Context
                                   sol::lib::io, sol::lib::package,
                                   sol::lib::math);
             Lua::openDSP (state);
-            auto res = state.script (script.toRawUTF8());
-            
-            if (res.valid())
+
+            // compiled chunks are shared by every node running the same script
+            if (bytecode->load (L, script) != LUA_OK || lua_pcall (L, 0, 0, 0) != LUA_OK)
+            {
+                errorMsg = String::fromUTF8 (lua_tostring (L, -1));
+                lua_pop (L, 1);
+            }
+            else
             {
                 bool ok = false;
                 if (lua_getglobal (state, "node_render") == LUA_TFUNCTION)
@@ -232,19 +279,37 @@ struct LuaNode::Context
                 }
 
                 if (ok)
+                {
+                    useViews = lua_getglobal (state, "node_views") == LUA_TBOOLEAN
+                        && lua_toboolean (state, -1);
+                    lua_pop (state, 1);
+                }
+
+                if (ok && ! useViews)
                 {
                     audioBuffer = kv_audio_buffer_new (state, 0, 0);
                     audioBufRef = luaL_ref (state, LUA_REGISTRYINDEX);
                     ok = audioBufRef != LUA_REFNIL && audioBufRef != LUA_NOREF;
                 }
 
-                if (ok)
+                if (ok && ! useViews)
                 {
                     midiPipe = kv_midi_pipe_new (state, 0);
                     midiPipeRef = luaL_ref (state, LUA_REGISTRYINDEX);
                     ok = midiPipeRef != LUA_REFNIL && midiPipeRef != LUA_NOREF;
                 }
                 
+                if (ok)
+                {
+                    lua_pushliteral (state, "node_state");
+                    stateKeyRef = luaL_ref (state, LUA_REGISTRYINDEX);
+                    snapshot.malloc (snapshotCapacity);
+
+                    // raised by the watchdog without allocating
+                    lua_pushliteral (state, "node_render ran past its deadline");
+                    deadlineErrorRef = luaL_ref (state, LUA_REGISTRYINDEX);
+                }
+
                 loaded = ok;
             }
         }
@@ -259,6 +324,8 @@ struct LuaNode::Context
         {
             addIOPorts();
             addParameters();
+            if (useViews)
+                createViews();
             auto param = state["Param"].get_or_create<sol::table>();
             param["values"] = &paramData;
         }
@@ -303,10 +370,46 @@ struct LuaNode::Context
             
             ctx->prepare (rate, block);
 
+            if (ctx->useViews)
+            {
+                // a first render may be slow, only scripts that hang fail
+                ctx->setRenderBudget (validateSeconds * rate / block);
+
+                AudioSampleBuffer audio (nchans, block);
+                OwnedArray<MidiBuffer> buffers;
+                Array<int> channels;
+                for (int i = 0; i < nmidi; ++i)
+                {
+                    buffers.add (new MidiBuffer());
+                    channels.add (i);
+                }
+                MidiPipe midi (buffers, channels);
+
+                for (int i = 0; i < 4; ++i)
+                {
+                    audio.clear();
+                    for (auto* buffer : buffers)
+                    {
+                        buffer->clear();
+                        buffer->addEvent (MidiMessage::noteOn (1, 60, (uint8) (1 + Random::getSystemRandom().nextInt (127))), 0);
+                        buffer->addEvent (MidiMessage::noteOff (1, 60), 10);
+                    }
+
+                    ctx->render (audio, midi);
+                    if (ctx->getNumErrors() > 0 || ctx->getNumOverruns() > 0)
+                        return Result::fail (ctx->lastError);
+                }
+
+                ctx->release();
+                return Result::ok();
+            }
+
             ctx->state["__ln_validate_rate"]    = rate;
             ctx->state["__ln_validate_nmidi"]   = nmidi;
             ctx->state["__ln_validate_nchans"]  = nchans;
             ctx->state["__ln_validate_nframes"] = block;
+            ctx->armWatchdog (Time::getHighResolutionTicks()
+                + Time::secondsToHighResolutionTicks (validateSeconds));
             ctx->state.script (R"(
                 function __ln_validate_render()
                     local audio = require ('kv.audio')
@@ -332,6 +435,7 @@ struct LuaNode::Context
 
                 __ln_validate_render()
             )");
+            ctx->disarmWatchdog();
 
             ctx->release();
             ctx.reset();
@@ -350,6 +454,8 @@ struct LuaNode::Context
         if (! ready())
             return;
 
+        ticksPerFrame = (double) Time::getHighResolutionTicksPerSecond() / rate;
+
         if (auto fn = state ["node_prepare"])
             fn (rate, block);
         
@@ -371,7 +477,11 @@ struct LuaNode::Context
             kv_midi_pipe_clear (midiPipe, -1);
         }
 
+        // from here on the collector only runs in bounded steps after render
         state.collect_garbage();
+        lua_gc (L, LUA_GCSTOP, 0);
+        allocator.takeBytesAllocated();
+        gcDebt = 0;
     }
 
     void release()
@@ -393,6 +503,7 @@ struct LuaNode::Context
             kv_midi_pipe_resize (L, midiPipe, 0);
         }
 
+        lua_gc (L, LUA_GCRESTART, 0);
         state.collect_garbage();
     }
 
@@ -401,74 +512,248 @@ struct LuaNode::Context
         if (! loaded)
             return;
 
+        // state is being saved or restored, this block can't run the script
+        const SpinLock::ScopedTryLockType entry (entryLock);
+        if (faulted.load (std::memory_order_relaxed) || ! entry.isLocked())
+        {
+            silence (audio, midi);
+            return;
+        }
+
         const auto nchans  = audio.getNumChannels();
         const auto nframes = audio.getNumSamples();
         const auto nmidi   = midi.getNumBuffers();
+        const int top      = lua_gettop (L);
 
-        if (lua_rawgeti (L, LUA_REGISTRYINDEX, renderRef) == LUA_TFUNCTION)
+        if (lua_rawgeti (L, LUA_REGISTRYINDEX, renderRef) != LUA_TFUNCTION ||
+            lua_rawgeti (L, LUA_REGISTRYINDEX, audioBufRef) != LUA_TUSERDATA ||
+            lua_rawgeti (L, LUA_REGISTRYINDEX, midiPipeRef) != LUA_TUSERDATA)
         {
-            if (lua_rawgeti (L, LUA_REGISTRYINDEX, audioBufRef) == LUA_TUSERDATA)
-            {
-                if (lua_rawgeti (L, LUA_REGISTRYINDEX, midiPipeRef) == LUA_TUSERDATA)
-                {
-                   #if ! LRT_FORCE_FLOAT32
-                    kv_audio_buffer_duplicate_32 (audioBuffer,
-                        audio.getArrayOfReadPointers(), nchans, nframes);
-                   #else
-                    kv_audio_buffer_refer_to (audioBuffer,
-                        audio.getArrayOfWritePointers(), nchans, nframes);
-                   #endif
-                
-                    kv_midi_pipe_resize (L, midiPipe, midi.getNumBuffers());
-                    kv_midi_pipe_clear (midiPipe, -1);
-                    
-                    int bytes = 0, frame = 0;
-                    const uint8* data = nullptr;
-                    for (int i = 0; i < nmidi; ++i)
-                    {
-                        auto* src = midi.getWriteBuffer (i);
-                        auto* dst = kv_midi_pipe_get (midiPipe, i);
-                        if (src->isEmpty())
-                            continue;
-                        MidiBuffer::Iterator iter (*src);
-                        while (iter.getNextEvent (data, bytes, frame))
-                            kv_midi_buffer_insert (dst, data, bytes, frame);
-                        src->clear();
-                    }
+            lua_settop (L, top);
+            return;
+        }
 
-                    lua_call (L, 2, 0);
-                    
-                    for (int i = 0; i < nmidi; ++i) 
-                    {
-                        auto* src = kv_midi_pipe_get (midiPipe, i);
-                        auto* dst = midi.getWriteBuffer (i);
-                        kv_midi_buffer_foreach (src, iter)
-                        {
-                            dst->addEvent (
-                                kv_midi_buffer_iter_data (iter),
-                                kv_midi_buffer_iter_size (iter),
-                                kv_midi_buffer_iter_frame (iter)
-                            );
-                        }
-                    }
+        if (useViews)
+        {
+            // the script works on the engine's buffers in place
+            el_audio_buffer_refer_to (audioView, audio.getArrayOfWritePointers(), nchans, nframes);
+            Lua::referTo (midiView, midi, nframes);
+            const auto status = callRender (nframes);
+            el_audio_buffer_detach (audioView);
+            Lua::detach (midiView);
+
+            if (status == rendered)
+                collectGarbage();
+            else
+                renderFailed (audio, midi, top, status);
+            return;
+        }
 
-                   #if ! LRT_FORCE_FLOAT32
-                    const kv_sample_t* const* src = kv_audio_buffer_array (audioBuffer);
-                    auto** dst = audio.getArrayOfWritePointers();
-                    for (int c = 0; c < nchans; ++c)
-                    {
-                        for (int f = 0; f < nframes; ++f)
-                            dst[c][f] = static_cast<float> (src[c][f]);
-                    }
-                   #endif
-                }
+       #if ! LRT_FORCE_FLOAT32
+        kv_audio_buffer_duplicate_32 (audioBuffer,
+            audio.getArrayOfReadPointers(), nchans, nframes);
+       #else
+        kv_audio_buffer_refer_to (audioBuffer,
+            audio.getArrayOfWritePointers(), nchans, nframes);
+       #endif
+    
+        kv_midi_pipe_resize (L, midiPipe, midi.getNumBuffers());
+        kv_midi_pipe_clear (midiPipe, -1);
+        
+        int bytes = 0, frame = 0;
+        const uint8* data = nullptr;
+        for (int i = 0; i < nmidi; ++i)
+        {
+            auto* src = midi.getWriteBuffer (i);
+            auto* dst = kv_midi_pipe_get (midiPipe, i);
+            if (src->isEmpty())
+                continue;
+            MidiBuffer::Iterator iter (*src);
+            while (iter.getNextEvent (data, bytes, frame))
+                kv_midi_buffer_insert (dst, data, bytes, frame);
+            src->clear();
+        }
+
+        const auto status = callRender (nframes);
+        if (status != rendered)
+        {
+            renderFailed (audio, midi, top, status);
+            return;
+        }
+        
+        for (int i = 0; i < nmidi; ++i) 
+        {
+            auto* src = kv_midi_pipe_get (midiPipe, i);
+            auto* dst = midi.getWriteBuffer (i);
+            kv_midi_buffer_foreach (src, iter)
+            {
+                dst->addEvent (
+                    kv_midi_buffer_iter_data (iter),
+                    kv_midi_buffer_iter_size (iter),
+                    kv_midi_buffer_iter_frame (iter)
+                );
             }
         }
-        else
+
+       #if ! LRT_FORCE_FLOAT32
+        const kv_sample_t* const* src = kv_audio_buffer_array (audioBuffer);
+        auto** dst = audio.getArrayOfWritePointers();
+        for (int c = 0; c < nchans; ++c)
+        {
+            for (int f = 0; f < nframes; ++f)
+                dst[c][f] = static_cast<float> (src[c][f]);
+        }
+       #endif
+
+        collectGarbage();
+    }
+
+    /** How a call to node_render ended */
+    enum RenderStatus { rendered = 0, renderError, renderOverran };
+
+    /** Called when node_render doesn't finish the block, which plays silent.
+        A script error, most likely out of memory, is on top of the stack.
+        An overrun leaves nothing there when the script caught the watchdog's
+        error, so it is reported on its own and counted as an overrun */
+    void renderFailed (AudioSampleBuffer& audio, MidiPipe& midi, int top, RenderStatus status) noexcept
+    {
+        const char* msg = status == renderOverran ? "node_render ran past its deadline"
+                                                  : lua_tostring (L, -1);
+        if (msg != nullptr)
+        {
+            strncpy (lastError, msg, sizeof (lastError) - 1);
+            lastError[sizeof (lastError) - 1] = 0;
+        }
+
+        lua_settop (L, top);
+        if (status == renderError)
+            numErrors.fetch_add (1, std::memory_order_relaxed);
+        silence (audio, midi);
+        collectGarbage();
+    }
+
+    void silence (AudioSampleBuffer& audio, MidiPipe& midi) noexcept
+    {
+        audio.clear (0, audio.getNumSamples());
+        for (int i = 0; i < midi.getNumBuffers(); ++i)
+            midi.getWriteBuffer(i)->clear();
+    }
+
+    //=========================================================================
+    /** Sets how long node_render may run as a fraction of the block */
+    void setRenderBudget (double fraction) noexcept { renderBudget.store (fraction); }
+
+    /** Raises an error in the script once the deadline passes */
+    void armWatchdog (int64 deadlineTicks) noexcept
+    {
+        deadline = deadlineTicks;
+        overran = false;
+        lua_sethook (L, watchdog, LUA_MASKCOUNT, watchdogInterval);
+    }
+
+    void disarmWatchdog() noexcept
+    {
+        lua_sethook (L, nullptr, 0, 0);
+    }
+
+    /** Calls node_render with its arguments on the stack and the watchdog
+        armed for the block. A context that overruns several blocks in a row
+        is faulted and stops running the script */
+    RenderStatus callRender (int nframes) noexcept
+    {
+        const double blockTicks = ticksPerFrame * (double) nframes;
+        const int64 start = Time::getHighResolutionTicks();
+        armWatchdog (start + (int64) (blockTicks * renderBudget.load (std::memory_order_relaxed)));
+        const bool ok = lua_pcall (L, 2, 0, 0) == LUA_OK;
+        disarmWatchdog();
+
+        const float load = (float) ((double) (Time::getHighResolutionTicks() - start) / jmax (1.0, blockTicks));
+        if (load > peakLoad.load (std::memory_order_relaxed))
+            peakLoad.store (load, std::memory_order_relaxed);
+
+        if (! overran)
         {
-            DBG("didn't get render fucntion in callback");
+            consecutiveOverruns = 0;
+            return ok ? rendered : renderError;
         }
+
+        numOverruns.fetch_add (1, std::memory_order_relaxed);
+        if (++consecutiveOverruns >= maxConsecutiveOverruns)
+            faulted.store (true, std::memory_order_relaxed);
+        return renderOverran;
     }
+
+    int64 getNumOverruns() const noexcept   { return numOverruns.load (std::memory_order_relaxed); }
+    float getPeakLoad() const noexcept      { return peakLoad.load (std::memory_order_relaxed); }
+    bool isFaulted() const noexcept         { return faulted.load (std::memory_order_relaxed); }
+
+    //=========================================================================
+    /** True if the script has a node_migrate function */
+    bool wantsMigration()
+    {
+        const bool wants = lua_getglobal (L, "node_migrate") == LUA_TFUNCTION;
+        lua_pop (L, 1);
+        return wants;
+    }
+
+    /** Copies node_state to the snapshot. Doesn't allocate in the Lua state,
+        so it is safe on the audio thread, where it must not wait for the
+        context. Returns false if there is none, it didn't fit or the
+        context was busy */
+    bool takeSnapshot (bool canWait) noexcept
+    {
+        snapshotSize = 0;
+        if (canWait)
+        {
+            const SpinLock::ScopedLockType entry (entryLock);
+            return writeSnapshot();
+        }
+
+        const SpinLock::ScopedTryLockType entry (entryLock);
+        return entry.isLocked() && writeSnapshot();
+    }
+
+    const char* getSnapshotData() const noexcept    { return snapshot.getData(); }
+    size_t getSnapshotSize() const noexcept         { return snapshotSize; }
+
+    /** True if the script has a node_save function */
+    bool wantsSave()
+    {
+        const bool wants = lua_getglobal (L, "node_save") == LUA_TFUNCTION;
+        lua_pop (L, 1);
+        return wants;
+    }
+
+    /** Replaces node_state with a copy of another context's */
+    void restoreSnapshot (const char* data, size_t size)
+    {
+        if (data == nullptr || size == 0)
+            return;
+
+        const int top = lua_gettop (L);
+        size_t pos = 0;
+        if (readValue (data, size, pos, 0) && lua_istable (L, -1))
+            lua_setglobal (L, "node_state");
+        lua_settop (L, top);
+    }
+
+    /** Calls node_migrate with a copy of another context's node_state */
+    void migrate (const char* data, size_t size)
+    {
+        if (data == nullptr || size == 0)
+            return;
+
+        const int top = lua_gettop (L);
+        size_t pos = 0;
+        lua_getglobal (L, "node_migrate");
+        if (readValue (data, size, pos, 0) && lua_istable (L, -1))
+            if (lua_pcall (L, 1, 0, 0) != LUA_OK)
+                DBG("[EL] node_migrate: " << lua_tostring (L, -1));
+        lua_settop (L, top);
+    }
+
+    LuaAllocator::Stats getMemoryStats() const noexcept { return allocator.getStats(); }
+    int64 getNumErrors() const noexcept { return numErrors.load (std::memory_order_relaxed); }
     
     const OwnedArray<PortDescription>& getPortArray() const noexcept
     {
@@ -524,8 +809,11 @@ struct LuaNode::Context
         }
     }
 
+    /** Calls node_save. Only call this on a context nothing renders, the
+        script may take as long as it likes */
     void getState (MemoryBlock& block)
     {
+        const SpinLock::ScopedLockType entry (entryLock);
         sol::function save = state ["node_save"];
         if (! save.valid())
             return;
@@ -553,8 +841,10 @@ struct LuaNode::Context
         }
     }
 
+    /** Calls node_restore. Only call this on a context nothing renders */
     void setState (const void* data, size_t size)
     {
+        const SpinLock::ScopedLockType entry (entryLock);
         sol::function restore = state["node_restore"];
         if (! restore.valid())
             return;
@@ -580,7 +870,13 @@ struct LuaNode::Context
     }
 
 private:
+    SharedResourcePointer<LuaBytecodeCache> bytecode;
+    LuaAllocator allocator;
     sol::state state;
+
+    // held by whichever thread is running code in the state, the heap has no
+    // locks of its own. The audio thread only ever tries it
+    SpinLock entryLock;
     lua_State* L { nullptr };
     sol::function renderf;
     std::function<void(AudioSampleBuffer&, MidiPipe&)> renderstdf;
@@ -593,6 +889,227 @@ private:
     kv_midi_pipe_t* midiPipe { nullptr };
     kv_audio_buffer_t* audioBuffer { nullptr };
 
+    // scripts that set node_views get views of the engine buffers instead
+    bool useViews = false;
+    el_audio_buffer_t* audioView { nullptr };
+    Lua::MidiPipeView* midiView { nullptr };
+    char lastError [256] = { 0 };
+
+    // the watchdog checks the clock every watchdogInterval instructions
+    enum { watchdogInterval = 1000, maxConsecutiveOverruns = 3 };
+    std::atomic<double> renderBudget { LuaNode::defaultRenderBudget };
+    double ticksPerFrame = 0.0;
+    int64 deadline = 0;
+    bool overran = false;
+    int consecutiveOverruns = 0;
+    int deadlineErrorRef = LUA_NOREF;
+    std::atomic<int64> numOverruns { 0 };
+    std::atomic<float> peakLoad { 0.f };
+    std::atomic<bool> faulted { false };
+
+    static void watchdog (lua_State* L, lua_Debug*)
+    {
+        auto* const ctx = *static_cast<Context**> (lua_getextraspace (L));
+        if (! ctx->overran && Time::getHighResolutionTicks() < ctx->deadline)
+            return;
+
+        // from here every instruction raises, so scripts that catch the
+        // error with pcall still unwind
+        if (! ctx->overran)
+        {
+            ctx->overran = true;
+            lua_sethook (L, watchdog, LUA_MASKCOUNT, 1);
+        }
+
+        lua_rawgeti (L, LUA_REGISTRYINDEX, ctx->deadlineErrorRef);
+        lua_error (L);
+    }
+
+    void createViews()
+    {
+        using PT = kv::PortType;
+        audioView = el_audio_buffer_new_view (L);
+        audioBufRef = luaL_ref (L, LUA_REGISTRYINDEX);
+        midiView = Lua::newMidiPipeView (L, jmax (ports.size (PT::Midi, true),
+                                                  ports.size (PT::Midi, false)));
+        midiPipeRef = luaL_ref (L, LUA_REGISTRYINDEX);
+    }
+
+    enum { maxSnapshotDepth = 8 };
+    enum SnapshotTag : char { tagNil, tagFalse, tagTrue, tagInteger, tagNumber, tagString, tagTable, tagEnd };
+    int stateKeyRef = LUA_NOREF;
+    HeapBlock<char> snapshot;
+    size_t snapshotSize = 0;
+
+    bool writeSnapshot() noexcept
+    {
+        const int top = lua_gettop (L);
+        bool ok = lua_rawgeti (L, LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS) == LUA_TTABLE
+               && lua_rawgeti (L, LUA_REGISTRYINDEX, stateKeyRef) == LUA_TSTRING
+               && lua_rawget (L, -2) == LUA_TTABLE
+               && writeValue (lua_gettop (L), 0);
+        lua_settop (L, top);
+        return ok;
+    }
+
+    bool writeBytes (const void* data, size_t size) noexcept
+    {
+        if (snapshotSize + size > snapshotCapacity)
+            return false;
+        memcpy (snapshot + snapshotSize, data, size);
+        snapshotSize += size;
+        return true;
+    }
+
+    bool writeTag (SnapshotTag tag) noexcept { return writeBytes (&tag, 1); }
+
+    /** Writes the value at an absolute stack index. Unsupported types are
+        written as nil */
+    bool writeValue (int idx, int depth) noexcept
+    {
+        switch (lua_type (L, idx))
+        {
+            case LUA_TBOOLEAN:
+                return writeTag (lua_toboolean (L, idx) ? tagTrue : tagFalse);
+
+            case LUA_TNUMBER:
+            {
+                if (lua_isinteger (L, idx))
+                {
+                    const lua_Integer value = lua_tointeger (L, idx);
+                    return writeTag (tagInteger) && writeBytes (&value, sizeof (value));
+                }
+                const lua_Number value = lua_tonumber (L, idx);
+                return writeTag (tagNumber) && writeBytes (&value, sizeof (value));
+            }
+
+            case LUA_TSTRING:
+            {
+                size_t len = 0;
+                const char* str = lua_tolstring (L, idx, &len);
+                const uint32 size = (uint32) len;
+                return writeTag (tagString) && writeBytes (&size, sizeof (size)) && writeBytes (str, len);
+            }
+
+            case LUA_TTABLE:
+            {
+                if (depth >= maxSnapshotDepth)
+                    return writeTag (tagNil);
+                if (! writeTag (tagTable))
+                    return false;
+
+                lua_pushnil (L);
+                while (lua_next (L, idx) != 0)
+                {
+                    const int key = lua_gettop (L) - 1;
+                    const int type = lua_type (L, key);
+                    if (type == LUA_TBOOLEAN || type == LUA_TNUMBER || type == LUA_TSTRING)
+                    {
+                        if (! writeValue (key, depth + 1) || ! writeValue (key + 1, depth + 1))
+                            return false;
+                    }
+                    lua_pop (L, 1);
+                }
+
+                return writeTag (tagEnd);
+            }
+
+            default:
+                break;
+        }
+
+        return writeTag (tagNil);
+    }
+
+    /** Pushes the next value of a snapshot */
+    bool readValue (const char* data, size_t size, size_t& pos, int depth)
+    {
+        auto read = [&] (void* dest, size_t n) -> bool {
+            if (pos + n > size)
+                return false;
+            memcpy (dest, data + pos, n);
+            pos += n;
+            return true;
+        };
+
+        char tag = tagNil;
+        if (! read (&tag, 1) || depth > maxSnapshotDepth)
+            return false;
+
+        switch (tag)
+        {
+            case tagNil:    lua_pushnil (L); return true;
+            case tagFalse:  lua_pushboolean (L, 0); return true;
+            case tagTrue:   lua_pushboolean (L, 1); return true;
+
+            case tagInteger:
+            {
+                lua_Integer value = 0;
+                if (! read (&value, sizeof (value)))
+                    return false;
+                lua_pushinteger (L, value);
+                return true;
+            }
+
+            case tagNumber:
+            {
+                lua_Number value = 0;
+                if (! read (&value, sizeof (value)))
+                    return false;
+                lua_pushnumber (L, value);
+                return true;
+            }
+
+            case tagString:
+            {
+                uint32 len = 0;
+                if (! read (&len, sizeof (len)) || pos + len > size)
+                    return false;
+                lua_pushlstring (L, data + pos, len);
+                pos += len;
+                return true;
+            }
+
+            case tagTable:
+            {
+                lua_newtable (L);
+                while (pos < size && data[pos] != tagEnd)
+                {
+                    if (! readValue (data, size, pos, depth + 1) || ! readValue (data, size, pos, depth + 1))
+                        return false;
+                    if (lua_isnil (L, -2) || lua_isnil (L, -1))
+                        lua_pop (L, 2);
+                    else
+                        lua_rawset (L, -3);
+                }
+                ++pos;
+                return pos <= size;
+            }
+
+            default:
+                break;
+        }
+
+        return false;
+    }
+
+    enum { gcStepBudget = 16 * 1024 };
+    size_t gcDebt = 0;
+    std::atomic<int64> numErrors { 0 };
+
+    /** Runs the collector for a bounded step, paced by what was allocated
+        since the last one. Work over the budget carries to later blocks */
+    void collectGarbage() noexcept
+    {
+        gcDebt = jmin (gcDebt + allocator.takeBytesAllocated(), allocator.getArenaSize());
+        if (gcDebt == 0)
+            return;
+
+        const size_t step = jmin (gcDebt, (size_t) gcStepBudget);
+        lua_gc (L, LUA_GCSTEP, jmax (1, (int) (step / 1024)));
+        gcDebt -= step;
+    }
+
     PortList ports;
     ParameterArray inParams, outParams;
 
@@ -741,43 +1258,168 @@ private:
     }
 };
 
-void LuaParameter::controlValueChanged (int index, float value)
+void LuaParameter::setValue (float newValue)
 {
+    ControlPortParameter::setValue (newValue);
     if (ctx != nullptr) // index may not be set so use port channel.
-        ctx->setParameter (getPortChannel(), convertFrom0to1 (value));
+        ctx->setParameter (getPortChannel(), get());
 }
 
-void LuaParameter::controlTouched (int, bool) {}
+/** How long the old and new scripts render together after a swap */
+static const double crossfadeSeconds = 0.02;
+
+//=============================================================================
+/** Deletes contexts the audio thread retired, away from the audio thread */
+struct LuaNode::Reaper : private Thread
+{
+    Reaper() : Thread ("LuaNode reaper")    { startThread (2); }
+    ~Reaper()                               { stopThread (1000); }
+
+    void add (LuaNode* node)
+    {
+        ScopedLock sl (lock);
+        nodes.addIfNotAlreadyThere (node);
+    }
+
+    void remove (LuaNode* node)
+    {
+        ScopedLock sl (lock);
+        nodes.removeFirstMatchingValue (node);
+    }
+
+private:
+    CriticalSection lock;
+    Array<LuaNode*> nodes;
 
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            wait (20);
+            ScopedLock sl (lock);
+            for (auto* node : nodes)
+                node->deleteRetiredContexts();
+        }
+    }
+};
+
+//=============================================================================
 LuaNode::LuaNode() noexcept
     : GraphNode (0)
 {
-    context = std::make_unique<Context>();
     jassert (metadata.hasType (Tags::node));
     metadata.setProperty (Tags::format, EL_INTERNAL_FORMAT_NAME, nullptr);
     metadata.setProperty (Tags::identifier, EL_INTERNAL_ID_LUA, nullptr);
+
+    for (int i = 0; i < maxFadeMidi; ++i)
+        fadeMidiPointers[i] = fadeMidi.add (new MidiBuffer());
+
+    reaper->add (this);
     loadScript (stereoAmpScript);
 }
 
 LuaNode::~LuaNode()
 {
-    context.reset();
+    reaper->remove (this);
+    deleteRetiredContexts();
+
+    delete pending.exchange (nullptr);
+    delete fading;
+    delete context;
+    fading = context = latest = nullptr;
 }
 
 void LuaNode::createPorts()
 {
-    if (context == nullptr)
+    if (latest == nullptr)
         return;
     ports.clearQuick();
-    context->getPorts (ports);
+    latest->getPorts (ports);
 }
 
 Parameter::Ptr LuaNode::getParameter (const PortDescription& port)
 {
-    return context->getParameter (port);
+    return latest->getParameter (port);
 }
 
+//=============================================================================
+/** Copies the running script's node_state on the audio thread, then
+    migrates it into the loaded script and hands that over */
+struct LuaNode::LoadCommand : public EngineCommand
+{
+    LoadCommand (LuaNode& n, int s)
+        : node (&n), serial (s)
+    {
+        snapshot.malloc ((size_t) Context::snapshotCapacity);
+    }
+
+    ~LoadCommand()
+    {
+        // dropped by a full queue, swap without the old state
+        if (! finished)
+            node->finishLoading (serial, nullptr, 0);
+    }
+
+    void perform() override
+    {
+        // performed on the posting thread when nothing renders, which may wait
+        auto* const live = node->context;
+        if (live != nullptr && live->takeSnapshot (MessageManager::existsAndIsCurrentThread()))
+        {
+            size = live->getSnapshotSize();
+            memcpy (snapshot, live->getSnapshotData(), size);
+        }
+    }
+
+    void completed() override
+    {
+        finished = true;
+        node->finishLoading (serial, snapshot, size);
+    }
+
+    LuaNode::Ptr node;
+    const int serial;
+    HeapBlock<char> snapshot;
+    size_t size = 0;
+    bool finished = false;
+};
+
+//=============================================================================
+/** Copies the running script's node_state between blocks, so it can be
+    saved without stopping the script */
+struct LuaNode::SnapshotCommand : public EngineCommand
+{
+    struct Copy : public ReferenceCountedObject
+    {
+        Copy() { data.malloc ((size_t) Context::snapshotCapacity); }
+        HeapBlock<char> data;
+        size_t size = 0;
+        std::atomic<bool> done { false };
+    };
+
+    SnapshotCommand (LuaNode& n, Copy* c) : node (&n), copy (c) { }
+
+    void perform() override
+    {
+        auto* const live = node->context;
+        if (live != nullptr && live->takeSnapshot (false))
+        {
+            copy->size = live->getSnapshotSize();
+            memcpy (copy->data, live->getSnapshotData(), copy->size);
+        }
+        copy->done.store (true);
+    }
+
+    LuaNode::Ptr node;
+    ReferenceCountedObjectPtr<Copy> copy;
+};
+
 Result LuaNode::loadScript (const String& newScript)
+{
+    return load (newScript, true);
+}
+
+Result LuaNode::load (const String& newScript, bool migrateState, const MemoryBlock* restoreData)
 {
     auto result = Context::validate (newScript);
     if (result.failed())
@@ -785,28 +1427,102 @@ Result LuaNode::loadScript (const String& newScript)
     
     auto newContext = std::make_unique<Context>();
     result = newContext->load (newScript);
+    if (result.failed())
+        return result;
 
-    if (result.wasOk())
+    if (latest != nullptr)
+        newContext->copyParameterValues (*latest);
+    newContext->setRenderBudget (renderBudget);
+    if (prepared)
+        newContext->prepare (sampleRate, blockSize);
+
+    // a context published but not yet picked up never rendered, take it back
+    std::unique_ptr<Context> unused (pending.exchange (nullptr));
+
+    // the audio thread copies node_state unless nothing renders the current script
+    const bool migrating = migrateState && latest != nullptr && newContext->wantsMigration();
+    const bool fromAudioThread = migrating && prepared && unused == nullptr;
+    if (migrating && ! fromAudioThread && latest->takeSnapshot (true))
     {
-        script = draftScript = newScript;
-        if (prepared)
-            newContext->prepare (sampleRate, blockSize);
-        triggerPortReset();
-        ScopedLock sl (lock);
-        if (context != nullptr)
-            newContext->copyParameterValues (*context);
-        context.swap (newContext);
+        try { newContext->migrate (latest->getSnapshotData(), latest->getSnapshotSize()); }
+        catch (const std::exception& e) { DBG("[EL] node_migrate: " << e.what()); }
     }
 
-    if (newContext != nullptr)
+    // node_restore runs before the audio thread can see the context
+    if (restoreData != nullptr)
+        newContext->setState (restoreData->getData(), restoreData->getSize());
+
+    script = draftScript = newScript;
+
     {
-        newContext->release();
-        newContext.reset();
+        ScopedLock sl (lock);
+        if (latest != nullptr)
+            latest->unlinkParameters();
+        latest = newContext.get();
     }
 
+    // a load still waiting for its copy is superseded
+    loading = std::move (newContext);
+    if (fromAudioThread)
+        EngineCommandQueue::post (getCommandQueue(), new LoadCommand (*this, ++loadSerial));
+    else
+        finishLoading (++loadSerial, nullptr, 0);
+
+    triggerPortReset();
     return result;
 }
 
+void LuaNode::finishLoading (int serial, const char* snapshot, size_t snapshotSize)
+{
+    if (serial != loadSerial || loading == nullptr)
+        return;
+
+    try { loading->migrate (snapshot, snapshotSize); }
+    catch (const std::exception& e) { DBG("[EL] node_migrate: " << e.what()); }
+
+    // only the newest load publishes, so this normally replaces nothing
+    std::unique_ptr<Context> unused (pending.exchange (loading.release(), std::memory_order_release));
+}
+
+void LuaNode::retire (Context* ctx) noexcept
+{
+    int start1, size1, start2, size2;
+    retiredFifo.prepareToWrite (1, start1, size1, start2, size2);
+    jassert (size1 == 1); // render only swaps when there's room, so this shouldn't fail
+    if (size1 > 0)
+        retired[start1] = ctx;
+    retiredFifo.finishedWrite (size1);
+}
+
+void LuaNode::deleteRetiredContexts()
+{
+    int start1, size1, start2, size2;
+    retiredFifo.prepareToRead (retiredFifo.getNumReady(), start1, size1, start2, size2);
+    for (int i = 0; i < size1 + size2; ++i)
+    {
+        std::unique_ptr<Context> ctx (retired[i < size1 ? start1 + i : start2 + i - size1]);
+        ctx->release();
+    }
+    retiredFifo.finishedRead (size1 + size2);
+}
+
+void LuaNode::settle()
+{
+    // only called when the audio thread isn't rendering this node
+    if (auto* next = pending.exchange (nullptr))
+    {
+        std::unique_ptr<Context> old (context);
+        if (old != nullptr)
+            old->release();
+        context = next;
+    }
+
+    std::unique_ptr<Context> old (fading);
+    if (old != nullptr)
+        old->release();
+    fading = nullptr;
+}
+
 void LuaNode::fillInPluginDescription (PluginDescription& desc)
 {
     desc.name               = "Lua";
@@ -828,7 +1544,17 @@ void LuaNode::prepareToRender (double rate, int block)
         return;
     sampleRate = rate;
     blockSize = block;
-    context->prepare (sampleRate, blockSize);
+    settle();
+
+    fadeLength = jmax (1, roundToInt (sampleRate * crossfadeSeconds));
+    fadeBuffer.setSize (maxFadeChannels, blockSize, false, false, true);
+    for (auto* buffer : fadeMidi)
+        buffer->ensureSize (1024);
+
+    if (context != nullptr)
+        context->prepare (sampleRate, blockSize);
+    if (loading != nullptr)
+        loading->prepare (sampleRate, blockSize);
     prepared = true;
 }
 
@@ -837,13 +1563,71 @@ void LuaNode::releaseResources()
     if (! prepared)
         return;
     prepared = false;
-    context->release();
+    settle();
+    if (context != nullptr)
+        context->release();
+    if (loading != nullptr)
+        loading->release();
 }
 
 void LuaNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
 {
-    ScopedLock sl (lock);
+    // each swap retires one context, wait for the reaper if there's no room
+    if (pending.load (std::memory_order_relaxed) != nullptr && retiredFifo.getFreeSpace() >= 2)
+    {
+        // loadScript may have taken it back since the load
+        if (auto* const next = pending.exchange (nullptr, std::memory_order_acquire))
+        {
+            // a swap during a crossfade cuts the oldest script off
+            if (fading != nullptr)
+                retire (fading);
+            fading = context;
+            context = next;
+            fadePosition = 0;
+        }
+    }
+
+    if (context == nullptr)
+        return;
+
+    const int nframes = audio.getNumSamples();
+    if (fading != nullptr && nframes > fadeBuffer.getNumSamples())
+    {
+        retire (fading);
+        fading = nullptr;
+    }
+
+    if (fading == nullptr)
+    {
+        context->render (audio, midi);
+        return;
+    }
+
+    // the old script renders a copy of the input with no MIDI
+    const int nchans = jmin (audio.getNumChannels(), fadeBuffer.getNumChannels());
+    for (int c = 0; c < nchans; ++c)
+        fadeBuffer.copyFrom (c, 0, audio, c, 0, nframes);
+    AudioSampleBuffer oldAudio (fadeBuffer.getArrayOfWritePointers(), nchans, nframes);
+    MidiPipe oldMidi (fadeMidiPointers, jmin ((int) maxFadeMidi, midi.getNumBuffers()));
+    fading->render (oldAudio, oldMidi);
+    oldMidi.clear();
+
     context->render (audio, midi);
+
+    const float g0 = (float) fadePosition / (float) fadeLength;
+    fadePosition = jmin (fadeLength, fadePosition + nframes);
+    const float g1 = (float) fadePosition / (float) fadeLength;
+    for (int c = 0; c < nchans; ++c)
+    {
+        audio.applyGainRamp (c, 0, nframes, g0, g1);
+        audio.addFromWithRamp (c, 0, oldAudio.getReadPointer (c), nframes, 1.f - g0, 1.f - g1);
+    }
+
+    if (fadePosition >= fadeLength)
+    {
+        retire (fading);
+        fading = nullptr;
+    }
 }
 
 void LuaNode::setState (const void* data, int size)
@@ -851,26 +1635,30 @@ void LuaNode::setState (const void* data, int size)
     const auto state = ValueTree::readFromGZIPData (data, size);
     if (state.isValid())
     {
-        // May want to do this procedure async with a Message::post()
-        auto result = loadScript (state["script"].toString());
+        if (state.hasProperty ("budget"))
+            setRenderBudget ((double) state.getProperty ("budget"));
 
-        if (result.wasOk())
+        const MemoryBlock* restoreData = nullptr;
+        if (state.hasProperty ("data"))
         {
-            if (state.hasProperty ("params"))
-            {
-                const var& params = state.getProperty ("params");
-                if (params.isBinaryData())
-                    if (auto* block = params.getBinaryData())
-                        context->setParameterData (*block);
-            }
+            const var& data = state.getProperty ("data");
+            if (data.isBinaryData())
+                restoreData = data.getBinaryData();
+        }
 
-            if (state.hasProperty ("data"))
-            {
-                const var& data = state.getProperty ("data");
-                if (data.isBinaryData())
-                    if (auto* block = data.getBinaryData())
-                        context->setState (block->getData(), block->getSize());
-            }
+        // the script is only compiled again if it changed or has data to
+        // restore, which happens in a context that isn't rendering yet.
+        // Restored data replaces node_state, so it isn't migrated
+        const String newScript = state["script"].toString();
+        auto result = newScript == script && latest != nullptr && latest->ready() && restoreData == nullptr
+            ? Result::ok() : load (newScript, restoreData == nullptr, restoreData);
+
+        if (result.wasOk() && state.hasProperty ("params"))
+        {
+            const var& params = state.getProperty ("params");
+            if (params.isBinaryData())
+                if (auto* block = params.getBinaryData())
+                    latest->setParameterData (*block);
         }
         sendChangeMessage();
     }
@@ -880,15 +1668,16 @@ void LuaNode::getState (MemoryBlock& block)
 {
     ValueTree state ("LuaNodeState");
     state.setProperty ("script", script, nullptr)
-         .setProperty ("draft",  draftScript, nullptr);
+         .setProperty ("draft",  draftScript, nullptr)
+         .setProperty ("budget", renderBudget, nullptr);
 
     MemoryBlock scriptBlock;
-    context->getParameterData (scriptBlock);
+    latest->getParameterData (scriptBlock);
     if (scriptBlock.getSize() > 0)
         state.setProperty ("params", scriptBlock, nullptr);
 
     scriptBlock.reset();
-    context->getState (scriptBlock);
+    saveScriptState (scriptBlock);
     if (scriptBlock.getSize() > 0)
         state.setProperty ("data", scriptBlock, nullptr);
 
@@ -899,10 +1688,91 @@ void LuaNode::getState (MemoryBlock& block)
     }
 }
 
+void LuaNode::saveScriptState (MemoryBlock& block)
+{
+    // node_save runs in a copy of the script holding the live node_state,
+    // so the running one never waits on the script or its file I/O
+    if (latest == nullptr || ! latest->ready())
+        return;
+    auto copy = std::make_unique<Context>();
+    if (copy->load (script).failed() || ! copy->wantsSave())
+        return;
+
+    ReferenceCountedObjectPtr<SnapshotCommand::Copy> snapshot (new SnapshotCommand::Copy());
+    auto* const queue = getCommandQueue();
+    if (prepared && queue != nullptr && queue->isActive()
+        && queue->post (new SnapshotCommand (*this, snapshot.get())))
+    {
+        // bounded, a stalled device shouldn't hang the save
+        const auto timeout = Time::getMillisecondCounter() + 250;
+        while (! snapshot->done.load() && Time::getMillisecondCounter() < timeout)
+            Thread::sleep (1);
+    }
+
+    const char* data = nullptr;
+    size_t size = 0;
+    if (snapshot->done.load())
+    {
+        data = snapshot->data;
+        size = snapshot->size;
+    }
+    else
+    {
+        // without a queue only try, so a render in progress isn't held up
+        for (int i = 0; i < 10; ++i)
+        {
+            if (latest->takeSnapshot (! prepared))
+            {
+                data = latest->getSnapshotData();
+                size = latest->getSnapshotSize();
+                break;
+            }
+            Thread::sleep (1);
+        }
+    }
+
+    try { copy->restoreSnapshot (data, size); }
+    catch (const std::exception& e) { DBG("[EL] node_save: " << e.what()); }
+
+    copy->copyParameterValues (*latest);
+    copy->getState (block);
+}
+
+LuaAllocator::Stats LuaNode::getMemoryStats() const
+{
+    return latest != nullptr ? latest->getMemoryStats() : LuaAllocator::Stats();
+}
+
+int64 LuaNode::getNumRenderErrors() const
+{
+    return latest != nullptr ? latest->getNumErrors() : 0;
+}
+
+LuaNode::RenderStats LuaNode::getRenderStats() const
+{
+    RenderStats stats;
+    if (latest != nullptr)
+    {
+        stats.overruns = latest->getNumOverruns();
+        stats.peakLoad = latest->getPeakLoad();
+        stats.faulted  = latest->isFaulted();
+    }
+    return stats;
+}
+
+void LuaNode::setRenderBudget (double fraction)
+{
+    ScopedLock sl (lock);
+    renderBudget = jlimit (0.05, 1.0, fraction);
+    if (latest != nullptr)
+        latest->setRenderBudget (renderBudget);
+}
+
 void LuaNode::setParameter (int index, float value)
 {
     ScopedLock sl (lock);
-    context->setParameter (index, value);
+    if (latest != nullptr)
+        latest->setParameter (index, value);
 }
 
 }
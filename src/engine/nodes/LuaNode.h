@@ -21,6 +21,7 @@
 
 #include "engine/nodes/BaseProcessor.h"
 #include "engine/GraphNode.h"
+#include "scripting/LuaAllocator.h"
 
 namespace Element {
 
@@ -42,6 +43,17 @@ public:
     void setState (const void* data, int size) override;
     void getState (MemoryBlock& block) override;
     
+    /** Load a new script. The script is compiled, validated and prepared on
+        the calling thread, then picked up by the audio thread at the start
+        of a block. Both scripts render for a short crossfade, and the old
+        one is deleted on a background thread.
+
+        If the new script has a node_migrate function, it is called with a
+        copy of the old script's node_state table before the swap. While the
+        node renders, the copy is taken by the audio thread through the
+        engine's command queue and the swap happens once it comes back, so
+        this doesn't wait for the audio thread.
+     */
     Result loadScript (const String&);
 
     const String& getScript() const { return script; }
@@ -56,19 +68,82 @@ public:
     */
     void setParameter (int index, float value);
 
+    /** Returns memory use of the script's Lua state. Each state has its own
+        fixed arena, scripts that outgrow it get a Lua memory error */
+    LuaAllocator::Stats getMemoryStats() const;
+
+    /** Returns the number of render calls that raised an error */
+    int64 getNumRenderErrors() const;
+
+    /** Default time node_render may run, as a fraction of the block */
+    static constexpr double defaultRenderBudget = 0.5;
+
+    /** Set how long node_render may run as a fraction of the block's
+        duration. Scripts that run over are stopped and the block is
+        silent. A script that overruns several blocks in a row is faulted
+        and stays silent until a script is loaded again */
+    void setRenderBudget (double fraction);
+    double getRenderBudget() const { return renderBudget; }
+
+    struct RenderStats
+    {
+        int64 overruns = 0;     // blocks stopped at the deadline
+        float peakLoad = 0.f;   // longest render as a fraction of its block
+        bool faulted = false;   // the script no longer runs
+    };
+
+    /** Returns how the running script keeps to its budget */
+    RenderStats getRenderStats() const;
+
 protected:
     inline bool wantsMidiPipe() const override { return true; }
     void createPorts() override;
     Parameter::Ptr getParameter (const PortDescription& port) override;
 
 private:
+    struct Reaper;
+    struct LoadCommand;
+    struct SnapshotCommand;
     String script, draftScript;
     int blockSize = 512;
     double sampleRate = 44100.0;
     bool prepared = false;
-    CriticalSection lock;
-    std::unique_ptr<Context> context;
+    double renderBudget = defaultRenderBudget;
     ParameterArray inParams, outParams;
+
+    // the newest loaded context, used on the message thread. The lock
+    // keeps setParameter off it while it is replaced
+    CriticalSection lock;
+    Context* latest = nullptr;
+
+    // the newest context while the audio thread copies node_state for it
+    std::unique_ptr<Context> loading;
+    int loadSerial = 0;
+
+    // handed from loadScript to the audio thread
+    std::atomic<Context*> pending { nullptr };
+
+    // owned by the audio thread while prepared
+    Context* context = nullptr;
+    Context* fading = nullptr;
+    int fadePosition = 0, fadeLength = 0;
+    AudioSampleBuffer fadeBuffer;
+    enum { maxFadeChannels = 32, maxFadeMidi = 16 };
+    OwnedArray<MidiBuffer> fadeMidi;
+    MidiBuffer* fadeMidiPointers [maxFadeMidi];
+
+    // contexts the audio thread is done with, deleted by the reaper
+    enum { maxRetired = 16 };
+    AbstractFifo retiredFifo { maxRetired };
+    Context* retired [maxRetired];
+    SharedResourcePointer<Reaper> reaper;
+
+    Result load (const String& script, bool migrateState, const MemoryBlock* restoreData = nullptr);
+    void finishLoading (int serial, const char* snapshot, size_t snapshotSize);
+    void retire (Context*) noexcept;
+    void deleteRetiredContexts();
+    void settle();
+    void saveScriptState (MemoryBlock&);
 };
 
 }
@@ -20,6 +20,7 @@
 #pragma once
 
 #include "engine/nodes/MidiFilterNode.h"
+#include "engine/MidiEventArena.h"
 #include "engine/MidiPipe.h"
 #include "engine/nodes/BaseProcessor.h"
 
@@ -58,26 +59,25 @@ public:
             return;
         }
 
-        buffers[0] = &tempMidi;
-        for (int ch = 1; ch < 16; ++ch)
-        {
-            buffers[ch] = midi.getWriteBuffer (ch);
-            buffers[ch]->clear();
-        }
-        
-        MidiBuffer& input (*midi.getWriteBuffer (0));
-        MidiBuffer::Iterator iter (input);
-        MidiMessage msg; int frame = 0;
+        // one pass over the input, channels only collect indices
+        arena.clear();
+        for (auto& view : channels)
+            view.clear();
+
+        MidiBuffer::Iterator iter (*midi.getReadBuffer (0));
+        const uint8* data = nullptr;
+        int size = 0, frame = 0;
 
-        while (iter.getNextEvent (msg, frame))
+        while (iter.getNextEvent (data, size, frame))
         {
-            if (msg.getChannel() <= 0)
+            const auto status = data[0];
+            if (status < 0x80 || status >= 0xf0)
                 continue;
-            buffers[msg.getChannel() - 1]->addEvent (msg, frame);
+            channels[status & 0x0f].add (arena.add (data, size, frame));
         }
 
-        input.swapWith (tempMidi);
-        tempMidi.clear();
+        for (int ch = 0; ch < 16; ++ch)
+            channels[ch].writeTo (arena, *midi.getWriteBuffer (ch));
     }
 
     void getPluginDescription (PluginDescription& desc) const override
@@ -98,8 +98,8 @@ public:
 protected:
     bool assertedLowChannels = false;
     bool createdPorts = false;
-    MidiBuffer* buffers [16];
-    MidiBuffer tempMidi;
+    MidiEventArena arena;
+    MidiEventView channels [16];
 
     inline void createPorts() override
     {
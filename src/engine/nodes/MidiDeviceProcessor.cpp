@@ -178,8 +178,8 @@ void MidiDeviceProcessor::prepareToPlay (double sampleRate, int maximumExpectedS
         output = MidiOutput::openDevice (deviceIdx);
         if (output)
         {
-            output->clearAllPendingMessages();
-            output->startBackgroundThread();
+            scheduler.reset (new MidiOutputScheduler (output.get()));
+            scheduler->start();
         } 
         else
         {
@@ -197,16 +197,12 @@ void MidiDeviceProcessor::processBlock (AudioBuffer<float>& audio, MidiBuffer& m
     if (inputDevice)
     {
         midi.clear (0, nframes);
-        inputMessages.removeNextBlockOfMessages (midi, nframes);
+        inputMessages.removeNextBlockOfMessages (midi, nframes, this->midi.getBlockTime());
     }
     else
     {
-        if (output && !midi.isEmpty())
-        {
-            const double delayMs = 6.0;
-            output->sendBlockOfMessages (
-                midi, delayMs + Time::getMillisecondCounterHiRes(), getSampleRate());
-        }
+        if (scheduler)
+            scheduler->send (midi, nframes, getSampleRate(), this->midi.getBlockTime());
 
         midi.clear (0, nframes);
     }
@@ -224,11 +220,8 @@ void MidiDeviceProcessor::releaseResources()
         input = nullptr;
     }
 
-    if (output)
-    {
-        output->stopBackgroundThread();
-        output = nullptr;
-    }
+    scheduler = nullptr;
+    output = nullptr;
 }
 
 AudioProcessorEditor* MidiDeviceProcessor::createEditor()
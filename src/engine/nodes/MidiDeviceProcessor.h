@@ -20,6 +20,8 @@
 #pragma once
 
 #include "engine/nodes/BaseProcessor.h"
+#include "engine/MidiInputCollector.h"
+#include "engine/MidiOutputScheduler.h"
 
 namespace Element {
 
@@ -135,7 +137,8 @@ private:
     String deviceName;
     std::unique_ptr<MidiInput> input;
     std::unique_ptr<MidiOutput> output;
-    MidiMessageCollector inputMessages;
+    std::unique_ptr<MidiOutputScheduler> scheduler;
+    MidiInputCollector inputMessages { 2 };
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MidiDeviceProcessor);
 };
 
@@ -28,7 +28,7 @@ MidiMonitorNode::MidiMonitorNode()
     jassert (metadata.hasType (Tags::node));
     metadata.setProperty (Tags::format, "Element", nullptr);
     metadata.setProperty (Tags::identifier, EL_INTERNAL_ID_MIDI_MONITOR, nullptr);
-    midiTemp.ensureSize (3 * 32);
+    probe = new SignalProbe (PortType::Midi, 1024);
 }
 
 MidiMonitorNode::~MidiMonitorNode()
@@ -39,9 +39,7 @@ MidiMonitorNode::~MidiMonitorNode()
 
 void MidiMonitorNode::prepareToRender (double sampleRate, int maxBufferSize)
 {
-    inputMessages.reset (sampleRate);
     currentSampleRate = sampleRate;
-    numSamples = 0;
     startTimerHz (refreshRateHz);
 };
 
@@ -52,66 +50,30 @@ void MidiMonitorNode::releaseResources()
 
 void MidiMonitorNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
 {
-    auto timestamp = Time::getMillisecondCounterHiRes();
     const auto nframes = audio.getNumSamples();
-
     if (nframes == 0)
         return;
 
-    auto* const midiIn = midi.getWriteBuffer (0);
-    MidiBuffer::Iterator iter (*midiIn);
-    MidiMessage msg;
-    int frame;
-
-    ScopedLock sl (lock);
-    while (iter.getNextEvent (msg, frame))
-    {
-        msg.setTimeStamp (timestamp + (1000.0 * (static_cast<double> (frame) / currentSampleRate)));
-        inputMessages.addMessageToQueue (msg);
-    }
-
-    numSamples += nframes;
-}
-
-void MidiMonitorNode::getMessages (MidiBuffer& destBuffer)
-{
-    ScopedLock sl (lock);
-    if (numSamples <= 0)
-        return;
-    inputMessages.removeNextBlockOfMessages (destBuffer, numSamples);
-    numSamples = 0;
+    probe->writeMidi (*midi.getReadBuffer (0), nframes, currentSampleRate);
 }
 
 void MidiMonitorNode::clearMessages()
 {
     midiLog.clearQuick();
-    {
-        ScopedLock sl (lock);
-        inputMessages.reset (currentSampleRate);
-        numSamples = 0;
-    }
+    probe->clear();
     messagesLogged();
 }
 
 void MidiMonitorNode::timerCallback()
 {
-    midiTemp.clear();
-    getMessages (midiTemp);
-    if (midiTemp.getNumEvents() <= 0)
-        return;
-
-    MidiBuffer::Iterator iter (midiTemp);
-    MidiMessage msg; int frame = 0;
-
+    MidiMessage msg;
     int numLogged = 0;
     String text;
-    while (iter.getNextEvent (msg, frame))
+
+    while (probe->readMidi (msg))
     {
         if (msg.isMidiClock())
-        {
-            text.clear();
             continue;
-        }
 
         if (msg.isMidiStart())
             text << "Start";
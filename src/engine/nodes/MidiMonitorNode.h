@@ -23,6 +23,7 @@
 #include "engine/MidiPipe.h"
 #include "engine/nodes/BaseProcessor.h"
 #include "engine/nodes/MidiFilterNode.h"
+#include "engine/SignalProbe.h"
 #include "Signals.h"
 
 namespace Element {
@@ -67,12 +68,9 @@ private:
     friend class MidiMonitorNodeEditor;
      Signal<void()> messagesLogged;
     double currentSampleRate = 44100.0;
-    int numSamples = 0;
-    MidiMessageCollector inputMessages;
+    SignalProbe::Ptr probe;
     bool createdPorts = false;
-    CriticalSection lock;
     
-    MidiBuffer  midiTemp;
     StringArray midiLog;
     int maxLoggedMessages { 100 };
     float refreshRateHz { 60.0 };
@@ -88,7 +86,6 @@ private:
         createdPorts = true;
     }
 
-    void getMessages (MidiBuffer &destBuffer);
     void timerCallback() override;
 };
 
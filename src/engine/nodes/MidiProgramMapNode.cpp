@@ -72,32 +72,44 @@ void MidiProgramMapNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
     auto* const midiIn = midi.getWriteBuffer (0);
 
     ScopedLock sl (lock);
-    MidiMessage msg; int frame = 0;
 
     if (! toSendMidi.isEmpty())
     {
-        MidiBuffer::Iterator iter1 (toSendMidi);
-        while (iter1.getNextEvent (msg, frame))
-            midiIn->addEvent (msg, frame);
+        midiIn->addEvents (toSendMidi, 0, -1, 0);
         toSendMidi.clear();
     }
 
-    MidiBuffer::Iterator iter2 (*midiIn);
+    auto isMapped = [this] (const uint8* data, int size) {
+        return size == 2 && (data[0] & 0xf0) == 0xc0 && programMap [data[1] & 0x7f] >= 0;
+    };
+
+    MidiBuffer::Iterator iter (*midiIn);
+    const uint8* data = nullptr;
+    int size = 0, frame = 0;
     int program = -1;
 
-    while (iter2.getNextEvent (msg, frame))
+    while (iter.getNextEvent (data, size, frame))
+        if (isMapped (data, size))
+            program = data[1] & 0x7f;
+
+    // the buffer passes through untouched unless a program change is mapped,
+    // then only the mapped messages are rewritten
+    if (program >= 0)
     {
-        if (msg.isProgramChange() && programMap [msg.getProgramChangeNumber()] >= 0)
-        {
-            program = msg.getProgramChangeNumber();
-            tempMidi.addEvent (MidiMessage::programChange (
-                msg.getChannel(), programMap [msg.getProgramChangeNumber()]),
-                frame);
-        }
-        else
+        arena.clear();
+        view.clear();
+        view.addFromBuffer (arena, *midiIn, std::numeric_limits<int>::max());
+
+        for (int i = 0; i < view.size(); ++i)
         {
-            tempMidi.addEvent (msg, frame);
+            const uint8* event = arena.getData (view[i]);
+            if (! isMapped (event, arena.getSize (view[i])))
+                continue;
+            const uint8 mapped[2] = { event[0], (uint8) programMap [event[1] & 0x7f] };
+            view.replace (arena, i, mapped, 2);
         }
+
+        view.writeTo (arena, *midiIn);
     }
 
     if (program >= 0 && program != lastProgram)
@@ -106,9 +118,7 @@ void MidiProgramMapNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
         triggerAsyncUpdate();
     }
 
-    midiIn->swapWith (tempMidi);
     traceMidi (*midiIn);
-    tempMidi.clear();
 }
 
 void MidiProgramMapNode::sendProgramChange (int program, int channel)
@@ -20,6 +20,7 @@
 #pragma once
 
 #include "engine/nodes/MidiFilterNode.h"
+#include "engine/MidiEventArena.h"
 #include "engine/MidiPipe.h"
 #include "engine/nodes/BaseProcessor.h"
 #include "Signals.h"
@@ -153,8 +154,8 @@ protected:
 
     bool assertedLowChannels = false;
     bool createdPorts = false;
-    MidiBuffer* buffers [16];
-    MidiBuffer tempMidi;
+    MidiEventArena arena;
+    MidiEventView view { 4096 };
     MidiBuffer toSendMidi;
 
     int width = 360;
@@ -19,6 +19,7 @@
 
 #include "engine/nodes/BaseProcessor.h"
 #include "engine/nodes/MidiRouterNode.h"
+#include "engine/EngineCommandQueue.h"
 #include "Common.h"
 
 #define TRACE_MIDI_ROUTER(output) 
@@ -30,21 +31,27 @@ MidiRouterNode::MidiRouterNode (int ins, int outs)
       numSources (ins),
       numDestinations (outs),
       state (ins, outs),
-      toggles (ins, outs),
-      nextToggles (ins, outs)
+      toggles (ins, outs)
 {
     jassert (metadata.hasType (Tags::node));
     metadata.setProperty (Tags::format, "Element", nullptr);
     metadata.setProperty (Tags::identifier, EL_INTERNAL_ID_MIDI_ROUTER, nullptr);
 
     clearPatches();
-    initMidiOuts (midiOuts);
+    for (int i = 0; i < numSources; ++i)
+        sourceViews.add (new MidiEventView (4096));
+    for (int i = 0; i < numDestinations; ++i)
+        destViews.add (new MidiEventView (4096));
 
     auto* program = programs.add (new Program ("Linear"));
     program->matrix.resize (ins, outs);
     for (int i = 0; i < jmin (ins, outs); ++i)
         program->matrix.set (i, i, true);
-    setMatrixState (program->matrix);
+
+    // not owned by a graph yet, so apply directly instead of via a command
+    state = program->matrix;
+    ToggleGrid patches (state);
+    toggles.swapWith (patches);
 
     if (ins == 4 && outs == 4)
     {
@@ -81,19 +88,32 @@ void MidiRouterNode::setCurrentProgram (int index)
     }
 }
 
-void MidiRouterNode::setMatrixState (const MatrixState& matrix)
+struct MidiRouterNode::ApplyMatrixCommand : public EngineCommand
 {
-    jassert (state.sameSizeAs (matrix));
-    state = matrix;
-    ToggleGrid newPatches (state);
+    ApplyMatrixCommand (MidiRouterNode* n, const MatrixState& matrix)
+        : node (n), toggles (matrix) { }
 
+    void perform() override
     {
-        ScopedLock sl (getLock());
-        toggles.swapWith (newPatches);
-        togglesChanged = true; // initiate the crossfade
+        // the old toggles get deleted with this command on the message thread
+        if (toggles.sameSizeAs (node->toggles))
+            node->toggles.swapWith (toggles);
     }
 
-    sendChangeMessage();
+    void completed() override
+    {
+        node->sendChangeMessage();
+    }
+
+    ReferenceCountedObjectPtr<MidiRouterNode> node;
+    ToggleGrid toggles;
+};
+
+void MidiRouterNode::setMatrixState (const MatrixState& matrix)
+{
+    jassert (state.sameSizeAs (matrix));
+    state = matrix;
+    EngineCommandQueue::post (getCommandQueue(), new ApplyMatrixCommand (this, matrix));
 }
 
 MatrixState MidiRouterNode::getMatrixState() const
@@ -108,25 +128,29 @@ void MidiRouterNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
     const auto nsamples = audio.getNumSamples();
     const auto nbuffers = midi.getNumBuffers();
     audio.clear();
+    arena.clear();
 
-    ScopedLock sl (getLock());
+    // each source is written to the arena once, however many destinations
+    // it goes to. Inputs and outputs can share buffers so all are read first
     for (int src = 0; src < numSources; ++src)
     {
-        if (src >= nbuffers)
-            break;
-        
-        const auto& rb = *midi.getReadBuffer (src);
-        for (int dst = 0; dst < numDestinations; ++dst)
-            if (toggles.get (src, dst))
-                midiOuts.getUnchecked(dst)->addEvents (rb, 0, nsamples, 0);
+        auto& view = *sourceViews.getUnchecked (src);
+        view.clear();
+        if (src < nbuffers)
+            view.addFromBuffer (arena, *midi.getReadBuffer (src), nsamples);
     }
 
-    for (int i = midiOuts.size(); --i >= 0;)
+    for (int dst = 0; dst < numDestinations; ++dst)
     {
-        auto* const ob = midiOuts.getUnchecked (i);
-        ob->swapWith (*midi.getWriteBuffer (i));
-        ob->clear();
+        auto& view = *destViews.getUnchecked (dst);
+        view.clear();
+        for (int src = 0; src < numSources; ++src)
+            if (toggles.get (src, dst))
+                view.merge (arena, *sourceViews.getUnchecked (src));
     }
+
+    for (int dst = jmin (numDestinations, nbuffers); --dst >= 0;)
+        destViews.getUnchecked(dst)->writeTo (arena, *midi.getWriteBuffer (dst));
 }
 
 void MidiRouterNode::getState (MemoryBlock& block)
@@ -164,24 +188,11 @@ void MidiRouterNode::set (int src, int dst, bool patched)
 
 void MidiRouterNode::clearPatches()
 {
-    {
-        ScopedLock sl (getLock());
-        toggles.clear();
-        nextToggles.clear();
-    }
+    toggles.clear();
 
     for (int r = 0; r < state.getNumRows(); ++r)
         for (int c = 0; c < state.getNumColumns(); ++c)
             state.set (r, c, false);
 }
 
-void MidiRouterNode::initMidiOuts (OwnedArray<MidiBuffer>& outs)
-{
-    while (outs.size() < numDestinations)
-    {
-        auto* const buf = outs.add (new MidiBuffer());
-        buf->ensureSize (16 * 3);
-    }
-}
-
 }
@@ -21,6 +21,7 @@
 
 #include "engine/GraphNode.h"
 #include "engine/LinearFade.h"
+#include "engine/MidiEventArena.h"
 #include "engine/ToggleGrid.h"
 #include "engine/nodes/BaseProcessor.h"
 
@@ -44,7 +45,6 @@ public:
     void setMatrixState (const MatrixState&);
     MatrixState getMatrixState() const;
     void setWithoutLocking (int src, int dst, bool set);
-    CriticalSection& getLock() { return lock; }
 
     int getNumPrograms() const override { return jmax (1, programs.size()); }
     int getCurrentProgram() const override { return currentProgram; }
@@ -90,7 +90,6 @@ protected:
     }
 
 private:
-    CriticalSection lock;
     const int numSources;
     const int numDestinations;
     
@@ -113,11 +112,11 @@ private:
     MatrixState state;
 
     ToggleGrid toggles;
-    ToggleGrid nextToggles;
-    bool togglesChanged { false };
+    struct ApplyMatrixCommand;
 
-    OwnedArray<MidiBuffer> midiOuts;
-    void initMidiOuts (OwnedArray<MidiBuffer>& outs);
+    // events are written once per block, destinations are lists of indices
+    MidiEventArena arena;
+    OwnedArray<MidiEventView> sourceViews, destViews;
 };
 
 }
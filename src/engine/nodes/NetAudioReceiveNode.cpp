@@ -0,0 +1,109 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "engine/nodes/NetAudioReceiveNode.h"
+#include "Utils.h"
+
+namespace Element {
+
+NetAudioReceiveNode::NetAudioReceiveNode()
+    : GraphNode (0)
+{
+    jassert (metadata.hasType (Tags::node));
+    metadata.setProperty (Tags::format, "Element", nullptr);
+    metadata.setProperty (Tags::identifier, EL_INTERNAL_ID_NET_AUDIO_RECEIVE, nullptr);
+}
+
+NetAudioReceiveNode::~NetAudioReceiveNode()
+{
+    receiver.disconnect();
+}
+
+void NetAudioReceiveNode::setState (const void* data, int size)
+{
+    const auto tree = ValueTree::readFromGZIPData (data, (size_t) size);
+    if (! tree.isValid())
+        return;
+
+    const int newPortNumber = jlimit (1, 65535, (int) tree.getProperty ("portNumber", 9002));
+    if ((bool) tree.getProperty ("connected", false))
+        connect (newPortNumber);
+    else
+        disconnect();
+
+    portNumber = newPortNumber;
+    sendChangeMessage();
+}
+
+void NetAudioReceiveNode::getState (MemoryBlock& block)
+{
+    ValueTree tree ("state");
+    tree.setProperty ("portNumber", portNumber, nullptr);
+    tree.setProperty ("connected", isConnected(), nullptr);
+
+    MemoryOutputStream stream (block, false);
+
+    {
+        GZIPCompressorOutputStream gzip (stream);
+        tree.writeToStream (gzip);
+    }
+}
+
+inline void NetAudioReceiveNode::createPorts()
+{
+    if (createdPorts)
+        return;
+
+    ports.clearQuick();
+    for (int i = 0; i < numChannels; ++i)
+        ports.add (PortType::Audio, i, i, String ("audio_out_") + String (i),
+                   String ("Output ") + String (i + 1), false);
+    createdPorts = true;
+}
+
+void NetAudioReceiveNode::prepareToRender (double sampleRate, int maxBufferSize)
+{
+    receiver.prepare (sampleRate, maxBufferSize);
+}
+
+void NetAudioReceiveNode::render (AudioSampleBuffer& audio, MidiPipe&)
+{
+    receiver.read (audio, audio.getNumSamples());
+}
+
+bool NetAudioReceiveNode::connect (int newPortNumber)
+{
+    if (! Util::isValidOscPort (newPortNumber))
+        return false;
+
+    portNumber = newPortNumber;
+    const bool result = receiver.connect (portNumber);
+    sendChangeMessage();
+    return result;
+}
+
+void NetAudioReceiveNode::disconnect()
+{
+    if (! receiver.isConnected())
+        return;
+    receiver.disconnect();
+    sendChangeMessage();
+}
+
+}
@@ -0,0 +1,121 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "engine/nodes/NetAudioSendNode.h"
+#include "Utils.h"
+
+namespace Element {
+
+NetAudioSendNode::NetAudioSendNode()
+    : GraphNode (0)
+{
+    jassert (metadata.hasType (Tags::node));
+    metadata.setProperty (Tags::format, "Element", nullptr);
+    metadata.setProperty (Tags::identifier, EL_INTERNAL_ID_NET_AUDIO_SEND, nullptr);
+}
+
+NetAudioSendNode::~NetAudioSendNode()
+{
+    sender.disconnect();
+}
+
+void NetAudioSendNode::setState (const void* data, int size)
+{
+    const auto tree = ValueTree::readFromGZIPData (data, (size_t) size);
+    if (! tree.isValid())
+        return;
+
+    const String newHostName = tree.getProperty ("hostName", "127.0.0.1").toString();
+    const int newPortNumber = jlimit (1, 65535, (int) tree.getProperty ("portNumber", 9002));
+    setPacking ((bool) tree.getProperty ("packed", false));
+
+    if ((bool) tree.getProperty ("connected", false))
+        connect (newHostName, newPortNumber);
+    else
+        disconnect();
+
+    hostName = newHostName;
+    portNumber = newPortNumber;
+    sendChangeMessage();
+}
+
+void NetAudioSendNode::getState (MemoryBlock& block)
+{
+    ValueTree tree ("state");
+    tree.setProperty ("hostName", hostName, nullptr);
+    tree.setProperty ("portNumber", portNumber, nullptr);
+    tree.setProperty ("connected", isConnected(), nullptr);
+    tree.setProperty ("packed", isPacking(), nullptr);
+
+    MemoryOutputStream stream (block, false);
+
+    {
+        GZIPCompressorOutputStream gzip (stream);
+        tree.writeToStream (gzip);
+    }
+}
+
+inline void NetAudioSendNode::createPorts()
+{
+    if (createdPorts)
+        return;
+
+    ports.clearQuick();
+    for (int i = 0; i < numChannels; ++i)
+        ports.add (PortType::Audio, i, i, String ("audio_in_") + String (i),
+                   String ("Input ") + String (i + 1), true);
+    createdPorts = true;
+}
+
+void NetAudioSendNode::prepareToRender (double sampleRate, int maxBufferSize)
+{
+    sender.prepare (sampleRate, maxBufferSize);
+}
+
+void NetAudioSendNode::render (AudioSampleBuffer& audio, MidiPipe&)
+{
+    sender.write (audio, audio.getNumSamples());
+}
+
+bool NetAudioSendNode::connect (const String& newHostName, int newPortNumber)
+{
+    if (! Util::isValidOscPort (newPortNumber))
+        return false;
+
+    hostName = newHostName;
+    portNumber = newPortNumber;
+    const bool result = sender.connect (hostName, portNumber);
+    sendChangeMessage();
+    return result;
+}
+
+void NetAudioSendNode::disconnect()
+{
+    if (! sender.isConnected())
+        return;
+    sender.disconnect();
+    sendChangeMessage();
+}
+
+void NetAudioSendNode::setPacking (bool shouldPack)
+{
+    sender.setPacking (shouldPack);
+}
+
+}
@@ -0,0 +1,81 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "engine/GraphNode.h"
+#include "engine/NetAudioSender.h"
+#include "engine/nodes/BaseProcessor.h"
+
+namespace Element {
+
+/** Sends its audio inputs to a NetAudioReceiveNode on another host */
+class NetAudioSendNode : public GraphNode,
+                         public ChangeBroadcaster
+{
+public:
+    NetAudioSendNode();
+    virtual ~NetAudioSendNode();
+
+    void getPluginDescription (PluginDescription& desc) const override
+    {
+        desc.name               = "Net Audio Send";
+        desc.fileOrIdentifier   = EL_INTERNAL_ID_NET_AUDIO_SEND;
+        desc.uid                = EL_INTERNAL_UID_NET_AUDIO_SEND;
+        desc.descriptiveName    = "Stream audio over UDP";
+        desc.numInputChannels   = numChannels;
+        desc.numOutputChannels  = 0;
+        desc.hasSharedContainer = false;
+        desc.isInstrument       = false;
+        desc.manufacturerName   = "Element";
+        desc.pluginFormatName   = "Element";
+        desc.version            = "1.0.0";
+    }
+
+    void prepareToRender (double sampleRate, int maxBufferSize) override;
+    void releaseResources() override { }
+    void render (AudioSampleBuffer& audio, MidiPipe& midi) override;
+    void setState (const void* data, int size) override;
+    void getState (MemoryBlock& block) override;
+
+    /** For node editor */
+
+    bool connect (const String& hostName, int portNumber);
+    void disconnect();
+    bool isConnected() const                        { return sender.isConnected(); }
+    String getHostName() const                      { return hostName; }
+    int getPortNumber() const                       { return portNumber; }
+    void setPacking (bool shouldPack);
+    bool isPacking() const                          { return sender.isPacking(); }
+    NetAudioSender::Stats getStats() const          { return sender.getStats(); }
+
+protected:
+    inline void createPorts() override;
+
+private:
+    enum { numChannels = 2 };
+    NetAudioSender sender { numChannels };
+    String hostName { "127.0.0.1" };
+    int portNumber = 9002;
+    bool createdPorts = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (NetAudioSendNode)
+};
+
+}
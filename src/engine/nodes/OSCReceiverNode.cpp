@@ -19,6 +19,7 @@
 */
 
 #include "engine/nodes/OSCReceiverNode.h"
+#include "engine/OSCMidiMatcher.h"
 #include "Utils.h"
 
 namespace Element {
@@ -95,11 +96,9 @@ inline void OSCReceiverNode::createPorts()
 
 void OSCReceiverNode::prepareToRender (double sampleRate, int maxBufferSize)
 {
-    if (! outputMidiMessagesInitDone) {
-        outputMidiMessages.reset (sampleRate);
-        currentSampleRate = sampleRate;
-        outputMidiMessagesInitDone = true;
-    }
+    ignoreUnused (maxBufferSize);
+    outputMidiMessages.reset (sampleRate);
+    currentSampleRate = sampleRate;
 }
 
 void OSCReceiverNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
@@ -109,27 +108,71 @@ void OSCReceiverNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
         return;
     }
 
-    outputMidiMessages.removeNextBlockOfMessages ( *midi.getWriteBuffer (0), nframes );
+    outputMidiMessages.removeNextBlockOfMessages (*midi.getWriteBuffer (0), nframes,
+                                                  getBlockTime());
 }
 
 /** OSCReceiver real-time callbacks */
 
 void OSCReceiverNode::oscMessageReceived (const OSCMessage& message)
 {
+    // stamped on arrival, render places it against the engine's block time
+    const double arrivalMs = Time::getMillisecondCounterHiRes();
     if (paused)
         return;
+    addMessage (message, arrivalMs);
+}
 
-    auto timestamp = Time::getMillisecondCounterHiRes();
+void OSCReceiverNode::oscBundleReceived (const OSCBundle& bundle)
+{
+    if (paused)
+        return;
+    addBundle (bundle);
+}
 
-    MidiMessage midiMsg = Util::processOscToMidiMessage (message);
-    midiMsg.setTimeStamp (timestamp);
+void OSCReceiverNode::addMessage (const OSCMessage& message, double timeMs)
+{
+    MidiMessage midiMsg;
+    if (! OSCMidiMatcher::toMidi (message, midiMsg))
+        return;
 
-    outputMidiMessages.addMessageToQueue( midiMsg );
-};
+    midiMsg.setTimeStamp (timeMs * 0.001);
+    outputMidiMessages.addMessageToQueue (midiMsg);
+}
 
-void OSCReceiverNode::oscBundleReceived(const OSCBundle& bundle)
+void OSCReceiverNode::addBundle (const OSCBundle& bundle)
 {
-};
+    // immediate bundles play as they arrive, others at their time tag
+    if (bundle.getTimeTag().isImmediately())
+    {
+        const double arrivalMs = Time::getMillisecondCounterHiRes();
+        for (const auto& element : bundle)
+        {
+            if (element.isMessage())
+                addMessage (element.getMessage(), arrivalMs);
+            else if (element.isBundle())
+                addBundle (element.getBundle());
+        }
+        return;
+    }
+
+    const double timeMs = Util::oscTimeTagToMillisecondCounter (bundle.getTimeTag());
+    for (const auto& element : bundle)
+    {
+        if (element.isMessage())
+        {
+            MidiMessage midiMsg;
+            if (! OSCMidiMatcher::toMidi (element.getMessage(), midiMsg))
+                continue;
+            midiMsg.setTimeStamp (timeMs * 0.001);
+            outputMidiMessages.addScheduledMessage (midiMsg);
+        }
+        else if (element.isBundle())
+        {
+            addBundle (element.getBundle());
+        }
+    }
+}
 
 /** For node editor */
 
@@ -20,6 +20,7 @@
 
 #pragma once
 
+#include "engine/MidiInputCollector.h"
 #include "engine/MidiPipe.h"
 #include "engine/nodes/BaseProcessor.h"
 #include "engine/nodes/MidiFilterNode.h"
@@ -81,8 +82,7 @@ private:
     /** MIDI */
     bool createdPorts = false;
     double currentSampleRate;
-    bool outputMidiMessagesInitDone = false;
-    MidiMessageCollector outputMidiMessages;
+    MidiInputCollector outputMidiMessages { 2 };
 
     /** OSC */
     OSCReceiver oscReceiver;
@@ -91,8 +91,10 @@ private:
     int currentPortNumber = 9001;
     String currentHostName = "";
 
-    void oscMessageReceived(const OSCMessage& message) override;
-    void oscBundleReceived(const OSCBundle& bundle) override;
+    void oscMessageReceived (const OSCMessage& message) override;
+    void oscBundleReceived (const OSCBundle& bundle) override;
+    void addMessage (const OSCMessage& message, double timeMs);
+    void addBundle (const OSCBundle& bundle);
 };
 
 
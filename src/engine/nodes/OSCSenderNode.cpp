@@ -23,6 +23,27 @@
 
 namespace Element {
 
+/** Marks a pending message replaced by a later one with the same key */
+static const int supersededKey = -2;
+
+/** Returns a key for messages where only the latest value matters, or -1.
+    Keys index a table of 128 entries per channel for each coalesced type */
+static int getCoalescingKey (const MidiMessage& msg)
+{
+    const uint8* data = msg.getRawData();
+    const int channel = data[0] & 0x0f;
+    switch (data[0] & 0xf0)
+    {
+        case 0xa0:  return (0 * 16 + channel) * 128 + (data[1] & 0x7f);
+        case 0xb0:  return (1 * 16 + channel) * 128 + (data[1] & 0x7f);
+        case 0xc0:  return (2 * 16 + channel) * 128;
+        case 0xd0:  return (3 * 16 + channel) * 128;
+        case 0xe0:  return (4 * 16 + channel) * 128;
+        default:    break;
+    }
+    return -1;
+}
+
 OSCSenderNode::OSCSenderNode()
     : MidiFilterNode (0),
       Thread ("osc sender midi processing thread")
@@ -31,6 +52,13 @@ OSCSenderNode::OSCSenderNode()
     metadata.setProperty (Tags::format, "Element", nullptr);
     metadata.setProperty (Tags::identifier, EL_INTERNAL_ID_OSC_SENDER, nullptr);
 
+    blocks.calloc ((size_t) blockFifo.getTotalSize());
+    scratch.calloc ((size_t) events.getDataCapacity());
+    oscMessagesToLog.reserve (maxOscMessages);
+    pending.ensureStorageAllocated (maxMessagesPerBundle);
+    pendingKeys.ensureStorageAllocated (maxMessagesPerBundle);
+    pendingSlots.calloc ((size_t) numCoalescingKeys);
+
     startThread();
 }
 
@@ -50,6 +78,7 @@ void OSCSenderNode::setState (const void* data, int size)
     int newPortNumber = jlimit (1, 65536, (int) tree.getProperty ("portNumber", 9001));
     bool newConnected = (bool) tree.getProperty ("connected", false);
     bool newPaused = (bool) tree.getProperty ("paused", false);
+    setCoalescing ((bool) tree.getProperty ("coalesce", false));
 
     if (newHostName != currentHostName || newPortNumber != currentPortNumber)
         disconnect();
@@ -71,6 +100,7 @@ void OSCSenderNode::getState (MemoryBlock& block)
     tree.setProperty ("portNumber", currentPortNumber, nullptr);
     tree.setProperty ("connected", connected, nullptr);
     tree.setProperty ("paused", paused, nullptr);
+    tree.setProperty ("coalesce", isCoalescing(), nullptr);
 
     MemoryOutputStream stream (block, false);
 
@@ -84,50 +114,127 @@ void OSCSenderNode::run ()
 {
     while (! threadShouldExit())
     {
-        sem.wait();
+        int start1, size1, start2, size2;
+        blockFifo.prepareToRead (1, start1, size1, start2, size2);
+        if (size1 <= 0)
+        {
+            // polled once a block so the audio thread never signals
+            wait (pollIntervalMs.load());
+            continue;
+        }
 
-        if (threadShouldExit())
-            break;
+        const Block block = blocks[start1];
+        blockFifo.finishedRead (1);
+        sendBlock (block);
+    }
 
-        /** MIDI queue -> OSC messages */
+    DBG("[EL] OSCSenderNode: OSC -> MIDI processing thread exited");
+}
 
-        MidiBuffer messages;
+void OSCSenderNode::sendBlock (const Block& block)
+{
+    /** MIDI queue -> OSC bundles */
 
-        midiMessageQueue.removeNextBlockOfMessages (messages, numSamples.get());
-        numSamples = 0;
+    const bool coalesce = isCoalescing();
+    const double latency = latencyMs.load();
+    pending.clearQuick();
+    pendingKeys.clearQuick();
 
-        MidiBuffer::Iterator iter1 (messages);
-        MidiMessage msg;
-        int frame;
+    for (int i = 0; i < block.numEvents; ++i)
+    {
+        double timeMs = 0.0;
+        events.getNextTime (timeMs);
+        const int size = events.pop (scratch, events.getDataCapacity());
+        if (size <= 0)
+            continue;
+
+        MidiMessage msg (scratch.getData(), size, timeMs);
+        const int key = coalesce ? getCoalescingKey (msg) : -1;
+
+        // last value wins, at its own position so it stays in order with
+        // other messages, e.g. a sustain release after its note offs
+        if (key >= 0)
+        {
+            if (const int slot = pendingSlots[key])
+                pendingKeys.setUnchecked (slot - 1, supersededKey);
+            pendingSlots[key] = pending.size() + 1;
+        }
 
-        ScopedLock sl (lock);
+        pending.add (msg);
+        pendingKeys.add (key);
+    }
+
+    for (const auto key : pendingKeys)
+        if (key >= 0)
+            pendingSlots[key] = 0;
 
-        while (iter1.getNextEvent (msg, frame))
+    if (pending.isEmpty() || ! connected)
+        return;
+
+    // the outer bundle is at the block start, messages later in the block
+    // are nested in bundles stamped with their own sample position
+    const OSCTimeTag blockTag = Util::millisecondCounterToOscTimeTag (block.timeMs + latency);
+    OSCBundle bundle (blockTag);
+    int numInBundle = 0;
+
+    for (int i = 0; i < pending.size();)
+    {
+        const double timeMs = pending.getReference (i).getTimeStamp();
+        OSCBundle group (Util::millisecondCounterToOscTimeTag (timeMs + latency));
+        const bool nested = timeMs > block.timeMs;
+        int numInGroup = 0;
+
+        for (; i < pending.size() && pending.getReference (i).getTimeStamp() == timeMs; ++i)
         {
-            OSCMessage oscMsg = Util::processMidiToOscMessage (msg);
-            oscSender.send ( oscMsg );
+            if (pendingKeys.getUnchecked (i) == supersededKey)
+                continue;
 
+            const auto& msg = pending.getReference (i);
+            OSCMessage oscMsg = Util::processMidiToOscMessage (msg);
             if (! msg.isMidiClock())
-            {
-                oscMessagesToLog.push_back ( oscMsg );
-            }
+                addToLog (oscMsg);
+
+            if (nested)
+                group.addElement (oscMsg);
+            else
+                bundle.addElement (oscMsg);
+            ++numInGroup;
+            ++numInBundle;
         }
 
-        while (oscMessagesToLog.size() > maxOscMessages)
-            oscMessagesToLog.erase ( oscMessagesToLog.begin() );
+        if (nested && numInGroup > 0)
+            bundle.addElement (group);
+
+        if (numInBundle >= maxMessagesPerBundle)
+        {
+            oscSender.send (bundle);
+            bundle = OSCBundle (blockTag);
+            numInBundle = 0;
+        }
     }
 
-    DBG("[EL] OSCSenderNode: OSC -> MIDI processing thread exited");
+    if (numInBundle > 0)
+        oscSender.send (bundle);
+}
+
+void OSCSenderNode::addToLog (const OSCMessage& message)
+{
+    ScopedLock sl (lock);
+    const auto slot = (size_t) ((logStart + logSize) % maxOscMessages);
+    if (slot < oscMessagesToLog.size())
+        oscMessagesToLog[slot] = message;
+    else
+        oscMessagesToLog.push_back (message);
+
+    if (logSize < maxOscMessages)
+        ++logSize;
+    else
+        logStart = (logStart + 1) % maxOscMessages;
 }
 
 void OSCSenderNode::stop ()
 {
-    if (isThreadRunning())
-    {
-        signalThreadShouldExit();
-        sem.post();
-        stopThread (100);
-    }
+    stopThread (100);
 }
 
 /** MIDI */
@@ -143,37 +250,54 @@ inline void OSCSenderNode::createPorts()
     createdPorts = true;
 }
 
-void OSCSenderNode::prepareToRender (double sampleRate, int maxBufferSize) {
-    if (! midiMessageQueueInitDone) {
-        midiMessageQueue.reset (sampleRate);
-        currentSampleRate = sampleRate;
-        midiMessageQueueInitDone = true;
-    }
-};
+void OSCSenderNode::prepareToRender (double sampleRate, int maxBufferSize)
+{
+    currentSampleRate = sampleRate;
+    if (sampleRate > 0.0 && maxBufferSize > 0)
+        pollIntervalMs.store (jmax (1, roundToInt (1000.0 * maxBufferSize / sampleRate)));
+}
 
 void OSCSenderNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
 {
     const auto nframes = audio.getNumSamples();
     auto* const midiIn = midi.getWriteBuffer (0);
 
-    if (nframes == 0 || !connected || paused) {
+    if (nframes == 0 || !connected || paused || midiIn->isEmpty()) {
+        midiIn->clear();
+        return;
+    }
+
+    // a block is only published with all of its messages, so without room
+    // for its record the messages would be read as part of the next block
+    if (blockFifo.getFreeSpace() < 1)
+    {
+        numDropped.fetch_add (midiIn->getNumEvents());
         midiIn->clear();
         return;
     }
 
-    MidiBuffer::Iterator iter1 (*midiIn);
-    MidiMessage msg;
-    int frame;
-    auto timestamp = Time::getMillisecondCounterHiRes();
+    Block block { getBlockTime(), 0 };
+    MidiBuffer::Iterator iter (*midiIn);
+    const uint8* data = nullptr;
+    int size = 0, frame = 0;
+
+    while (iter.getNextEvent (data, size, frame))
+    {
+        const double timeMs = block.timeMs + (1000.0 * frame / currentSampleRate);
+        if (events.push (timeMs, data, size))
+            ++block.numEvents;
+        else
+            numDropped.fetch_add (1);
+    }
 
-    while (iter1.getNextEvent (msg, frame))
+    if (block.numEvents > 0)
     {
-        msg.setTimeStamp ( timestamp + (1000.0 * (static_cast<double> (frame) / currentSampleRate)) );
-        midiMessageQueue.addMessageToQueue ( msg );
+        int start1, size1, start2, size2;
+        blockFifo.prepareToWrite (1, start1, size1, start2, size2);
+        blocks[start1] = block;
+        blockFifo.finishedWrite (1);
     }
 
-    numSamples += nframes;
-    sem.post();
     midiIn->clear();
 }
 
@@ -255,8 +379,10 @@ std::vector<OSCMessage> OSCSenderNode::getOscMessages()
 
     {
         ScopedLock sl (lock);
-        std::copy ( oscMessagesToLog.begin(), oscMessagesToLog.end(), std::back_inserter( copied ) );
-        oscMessagesToLog.clear();
+        copied.reserve ((size_t) logSize);
+        for (int i = 0; i < logSize; ++i)
+            copied.push_back (oscMessagesToLog[(size_t) ((logStart + i) % maxOscMessages)]);
+        logStart = logSize = 0;
     }
 
     return copied;
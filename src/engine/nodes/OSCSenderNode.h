@@ -20,12 +20,22 @@
 
 #pragma once
 
+#include "engine/MidiEventFifo.h"
 #include "engine/MidiPipe.h"
 #include "engine/nodes/BaseProcessor.h"
 #include "engine/nodes/MidiFilterNode.h"
 
 namespace Element {
 
+/** Sends incoming MIDI as OSC.
+
+    The audio thread stamps each message with its sample position from the
+    engine's block time and hands the block to the send thread through
+    lock-free queues. The send thread polls once a block, so the audio
+    thread never wakes it. The send thread
+    packs each block into one OSC bundle, so a dense stream costs one
+    datagram per block instead of one per message.
+ */
 class OSCSenderNode   : public MidiFilterNode,
                         public ChangeBroadcaster,
                         public Thread
@@ -81,11 +91,26 @@ public:
     void setPortNumber (int port);
     void setHostName (String hostName);
 
+    /** Returns logged messages since the last call, oldest first */
     std::vector<OSCMessage> getOscMessages();
 
+    /** When enabled only the last controller, pressure, program and pitch
+        bend value of each block is sent. Notes are never coalesced.
+     */
+    void setCoalescing (bool shouldCoalesce)        { coalescing.store (shouldCoalesce); }
+    bool isCoalescing() const                       { return coalescing.load(); }
+
+    /** Sets the time added to bundle time tags, in milliseconds. Receivers
+        which honor time tags can then play messages with block accurate spacing.
+     */
+    void setTimeTagLatency (double ms)              { latencyMs.store (jmax (0.0, ms)); }
+    double getTimeTagLatency() const                { return latencyMs.load(); }
+
+    /** Returns the number of messages dropped because the queue was full */
+    int getNumDropped() const                       { return numDropped.load(); }
+
 private:
 
-    Semaphore sem;
     CriticalSection lock;
 
     /** MIDI */
@@ -100,18 +125,46 @@ private:
     int currentPortNumber = 9002;
     String currentHostName = "127.0.0.1";
 
-    /** Max messages in queue before they start getting dropped */
-    int maxOscMessages = 100;
+    /** Max messages in the log before the oldest are overwritten */
+    enum { maxOscMessages = 100 };
 
-    /** GUI */
+    /** Max messages in one bundle, to keep datagrams well under the UDP limit */
+    enum { maxMessagesPerBundle = 128 };
+
+    /** Poly pressure and controllers per number, program, channel pressure
+        and pitch bend per channel */
+    enum { numCoalescingKeys = 5 * 16 * 128 };
+
+    /** GUI, a fixed ring of logged messages */
     std::vector<OSCMessage> oscMessagesToLog;
+    int logStart = 0, logSize = 0;
 
-    /** To be processed and sent as OSC messages */
-    MidiMessageCollector midiMessageQueue;
+    /** A rendered block, the next numEvents messages in the event queue */
+    struct Block
+    {
+        double timeMs;
+        int numEvents;
+    };
 
-    Atomic<int> numSamples = 0;
+    /** To be processed and sent as OSC messages */
+    AbstractFifo blockFifo { 512 };
+    HeapBlock<Block> blocks;
+    MidiEventFifo events { 8192, 32 * 1024 };
     double currentSampleRate = 0;
-    bool midiMessageQueueInitDone = false;
+    std::atomic<int> pollIntervalMs { 5 };
+
+    std::atomic<bool> coalescing { false };
+    std::atomic<double> latencyMs { 0.0 };
+    std::atomic<int> numDropped { 0 };
+
+    /** Send thread scratch */
+    HeapBlock<uint8> scratch;
+    Array<MidiMessage> pending;
+    Array<int> pendingKeys;
+    HeapBlock<int> pendingSlots;     // 1 + index in pending for each key, 0 if none
+
+    void sendBlock (const Block& block);
+    void addToLog (const OSCMessage& message);
 };
 
 }
@@ -33,6 +33,7 @@
 #include "gui/nodes/MidiMonitorNodeEditor.h"
 #include "gui/nodes/MidiProgramMapEditor.h"
 #include "gui/nodes/MidiRouterEditor.h"
+#include "gui/nodes/NetAudioNodeEditor.h"
 #include "gui/nodes/OSCReceiverNodeEditor.h"
 #include "gui/nodes/OSCSenderNodeEditor.h"
 #include "gui/nodes/VolumeNodeEditor.h"
@@ -208,6 +209,11 @@ public:
         {
             return createPluginWindowFor (node, new OSCSenderNodeEditor (node));
         }
+        else if (node.getIdentifier().toString() == EL_INTERNAL_ID_NET_AUDIO_SEND ||
+                 node.getIdentifier().toString() == EL_INTERNAL_ID_NET_AUDIO_RECEIVE)
+        {
+            return createPluginWindowFor (node, new NetAudioNodeEditor (node));
+        }
         else if (node.getIdentifier().toString().contains ("element.volume"))
         {
             return createPluginWindowFor (node, new VolumeNodeEditor (node, gui));
@@ -30,13 +30,10 @@ CompressorNodeEditor::CompViz::CompViz (CompressorProcessor& proc) :
     startTimer (40);
 
     updateCurve();
-
-    proc.addListener (this);
 }
 
 CompressorNodeEditor::CompViz::~CompViz()
 {
-    proc.removeListener (this);
 }
 
 float CompressorNodeEditor::CompViz::getDBForX (float x)
@@ -86,6 +83,8 @@ void CompressorNodeEditor::CompViz::updateInGainDB (float inDB)
 
 void CompressorNodeEditor::CompViz::timerCallback()
 {
+    updateInGainDB (proc.getInputLevelDB());
+    reductionDB = proc.getGainReductionDB();
     repaint();
 }
 
@@ -113,6 +112,12 @@ void CompressorNodeEditor::CompViz::paint (Graphics& g)
     g.setColour (Colours::orange);
     g.fillEllipse (dotX - 5, dotY - 5, 10, 10);
 
+    // draw gain reduction
+    g.setColour (Colours::white);
+    g.setFont (12.0f);
+    g.drawText (String ("GR ") + String (reductionDB, 1) + " dB",
+                getLocalBounds().reduced (6), Justification::topLeft);
+
     // Draw outline
     g.setColour (Colours::white);
     g.drawRect (getLocalBounds().toFloat().reduced (0.5f));
@@ -40,14 +40,13 @@ private:
     KnobsComponent knobs;
 
     class CompViz : public Component,
-                    private CompressorProcessor::Listener,
                     private Timer
     {
     public:
         CompViz (CompressorProcessor& proc);
         ~CompViz();
 
-        void updateInGainDB (float inDB) override;
+        void updateInGainDB (float inDB);
         void timerCallback() override;
 
         void updateCurve();
@@ -62,8 +61,9 @@ private:
         Path curvePath; // path for compression response curve
 
         // Dot coordinates
-        std::atomic<float> dotX = 0.0f;
-        std::atomic<float> dotY = 0.0f;
+        float dotX = 0.0f;
+        float dotY = 0.0f;
+        float reductionDB = 0.0f;
 
         const float lowDB = -36.0f;
         const float highDB = 6.0f;
@@ -134,6 +134,24 @@ private:
     }
 };
 
+/** Sets the share of each block the script may use */
+class LuaNodeBudgetProperty : public SliderPropertyComponent
+{
+public:
+    LuaNodeBudgetProperty (LuaNode::Ptr n)
+        : SliderPropertyComponent ("Render Budget (%)", 5.0, 100.0, 1.0, 1.0, false),
+          node (n)
+    {
+        refresh();
+    }
+
+    void setValue (double value) override   { node->setRenderBudget (0.01 * value); }
+    double getValue() const override        { return 100.0 * node->getRenderBudget(); }
+
+private:
+    LuaNode::Ptr node;
+};
+
 LuaNodeEditor::LuaNodeEditor (const Node& node)
     : NodeEditorComponent (node)
 {
@@ -177,6 +195,12 @@ LuaNodeEditor::LuaNodeEditor (const Node& node)
     addAndMakeVisible (props);
     props.setVisible (editorButton.getToggleState());
 
+    addAndMakeVisible (memoryLabel);
+    memoryLabel.setJustificationType (Justification::centredRight);
+    memoryLabel.setFont (Font (12.f));
+    timerCallback();
+    startTimer (500);
+
     updateProperties();
     lua->addChangeListener (this);
     portsChangedConnection = lua->portsChanged.connect (
@@ -186,6 +210,7 @@ LuaNodeEditor::LuaNodeEditor (const Node& node)
 
 LuaNodeEditor::~LuaNodeEditor()
 {
+    stopTimer();
     portsChangedConnection.disconnect();
     if (auto* const lua = getNodeObjectOfType<LuaNode>())
     {
@@ -204,9 +229,30 @@ void LuaNodeEditor::updateProperties()
             continue;
         pcs.add (new LuaNodeParameterPropertyFloat (param));
     }
+    pcs.add (new LuaNodeBudgetProperty (lua));
     props.addProperties (pcs);
 }
 
+void LuaNodeEditor::timerCallback()
+{
+    const auto stats = lua->getMemoryStats();
+    String text;
+    text << File::descriptionOfSizeInBytes ((int64) stats.used) << " of "
+         << File::descriptionOfSizeInBytes ((int64) stats.arenaSize) << ", peak "
+         << File::descriptionOfSizeInBytes ((int64) stats.peak);
+    if (const auto errors = lua->getNumRenderErrors())
+        text << ", " << String (errors) << " errors";
+
+    const auto render = lua->getRenderStats();
+    text << ", load " << String (roundToInt (100.f * render.peakLoad)) << "%";
+    if (render.overruns > 0)
+        text << ", " << String (render.overruns) << " overruns";
+    if (render.faulted)
+        text << ", faulted";
+    memoryLabel.setColour (Label::textColourId, render.faulted ? Colour (0xffcc0000) : Element::LookAndFeel::textColor);
+    memoryLabel.setText (text, dontSendNotification);
+}
+
 void LuaNodeEditor::onPortsChanged()
 {
     updateProperties();
@@ -233,6 +279,7 @@ void LuaNodeEditor::resized()
     compileButton.setBounds (r2.removeFromLeft (compileButton.getWidth()));
     editorButton.changeWidthToFitText (r2.getHeight());
     editorButton.setBounds (r2.removeFromRight (editorButton.getWidth()));
+    memoryLabel.setBounds (r2.reduced (4, 0));
 
     r1.removeFromTop (2);
     if (props.isVisible())
@@ -0,0 +1,179 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "gui/LookAndFeel.h"
+#include "gui/nodes/NetAudioNodeEditor.h"
+
+namespace Element {
+
+NetAudioNodeEditor::NetAudioNodeEditor (const Node& node)
+    : NodeEditorComponent (node)
+{
+    sendNode = getNodeObjectOfType<NetAudioSendNode>();
+    receiveNode = getNodeObjectOfType<NetAudioReceiveNode>();
+    jassert (sendNode != nullptr || receiveNode != nullptr);
+
+    hostNameField.setEditable (true, true, true);
+    portNumberSlider.setRange (1.0, 65535.0, 1.0);
+    portNumberSlider.setSliderStyle (Slider::IncDecButtons);
+    portNumberSlider.setTextBoxStyle (Slider::TextBoxLeft, false, 60, 22);
+
+    if (sendNode != nullptr)
+    {
+        addAndMakeVisible (hostNameLabel);
+        addAndMakeVisible (hostNameField);
+        addAndMakeVisible (packButton);
+        sendNode->addChangeListener (this);
+    }
+    else
+    {
+        receiveNode->addChangeListener (this);
+    }
+
+    addAndMakeVisible (portNumberLabel);
+    addAndMakeVisible (portNumberSlider);
+    addAndMakeVisible (connectButton);
+    addAndMakeVisible (statusLabel);
+
+    connectButton.onClick = std::bind (&NetAudioNodeEditor::connectButtonClicked, this);
+    packButton.onClick = [this]()
+    {
+        if (sendNode != nullptr)
+            sendNode->setPacking (packButton.getToggleState());
+    };
+
+    syncUIFromNodeState();
+    setSize (440, 60);
+    startTimerHz (4);
+}
+
+NetAudioNodeEditor::~NetAudioNodeEditor()
+{
+    stopTimer();
+    connectButton.onClick = nullptr;
+    packButton.onClick = nullptr;
+    if (sendNode != nullptr)
+        sendNode->removeChangeListener (this);
+    if (receiveNode != nullptr)
+        receiveNode->removeChangeListener (this);
+}
+
+bool NetAudioNodeEditor::isConnected() const
+{
+    return sendNode != nullptr ? sendNode->isConnected() : receiveNode->isConnected();
+}
+
+void NetAudioNodeEditor::connectButtonClicked()
+{
+    const int port = roundToInt (portNumberSlider.getValue());
+    bool ok = true;
+
+    if (isConnected())
+    {
+        if (sendNode != nullptr) sendNode->disconnect();
+        else receiveNode->disconnect();
+    }
+    else
+    {
+        ok = sendNode != nullptr ? sendNode->connect (hostNameField.getText(), port)
+                                 : receiveNode->connect (port);
+    }
+
+    if (! ok)
+        AlertWindow::showMessageBoxAsync (AlertWindow::WarningIcon, "Connection error",
+            String ("Could not open port ") + String (port));
+
+    syncUIFromNodeState();
+}
+
+void NetAudioNodeEditor::syncUIFromNodeState()
+{
+    if (sendNode != nullptr)
+    {
+        hostNameField.setText (sendNode->getHostName(), dontSendNotification);
+        portNumberSlider.setValue (sendNode->getPortNumber(), dontSendNotification);
+        packButton.setToggleState (sendNode->isPacking(), dontSendNotification);
+    }
+    else
+    {
+        portNumberSlider.setValue (receiveNode->getPortNumber(), dontSendNotification);
+    }
+
+    connectButton.setButtonText (isConnected() ? "Disconnect" : "Connect");
+    timerCallback();
+}
+
+void NetAudioNodeEditor::timerCallback()
+{
+    String status;
+    if (! isConnected())
+    {
+        status = "Not connected";
+    }
+    else if (sendNode != nullptr)
+    {
+        const auto stats = sendNode->getStats();
+        status << String (stats.numSent) << " packets sent, "
+               << String (stats.numOverruns) << " overruns";
+    }
+    else
+    {
+        const auto stats = receiveNode->getStats();
+        status << String (stats.bufferedMs, 1) << " ms buffered, "
+               << String (stats.jitterMs, 1) << " ms jitter, "
+               << String (stats.numLost) << " lost, "
+               << String (stats.numUnderruns) << " underruns";
+    }
+
+    statusLabel.setText (status, dontSendNotification);
+}
+
+void NetAudioNodeEditor::changeListenerCallback (ChangeBroadcaster*)
+{
+    syncUIFromNodeState();
+}
+
+void NetAudioNodeEditor::paint (Graphics& g)
+{
+    g.fillAll (Element::LookAndFeel::backgroundColor);
+}
+
+void NetAudioNodeEditor::resized()
+{
+    auto r = getLocalBounds().reduced (5);
+    auto row = r.removeFromTop (20);
+
+    if (sendNode != nullptr)
+    {
+        hostNameLabel.setBounds (row.removeFromLeft (40));
+        hostNameField.setBounds (row.removeFromLeft (100));
+        row.removeFromLeft (5);
+    }
+
+    portNumberLabel.setBounds (row.removeFromLeft (40));
+    portNumberSlider.setBounds (row.removeFromLeft (100));
+    connectButton.setBounds (row.removeFromRight (80));
+    if (sendNode != nullptr)
+        packButton.setBounds (row.removeFromRight (60));
+
+    r.removeFromTop (5);
+    statusLabel.setBounds (r.removeFromTop (20));
+}
+
+}
@@ -0,0 +1,60 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "engine/nodes/NetAudioReceiveNode.h"
+#include "engine/nodes/NetAudioSendNode.h"
+#include "gui/nodes/NodeEditorComponent.h"
+
+namespace Element {
+
+/** Editor for both network audio nodes. The host field and packing toggle
+    only show for the send node */
+class NetAudioNodeEditor : public NodeEditorComponent,
+                           public ChangeListener,
+                           private Timer
+{
+public:
+    NetAudioNodeEditor (const Node&);
+    virtual ~NetAudioNodeEditor();
+
+    void paint (Graphics&) override;
+    void resized() override;
+    void changeListenerCallback (ChangeBroadcaster*) override;
+
+private:
+    ReferenceCountedObjectPtr<NetAudioSendNode> sendNode;
+    ReferenceCountedObjectPtr<NetAudioReceiveNode> receiveNode;
+
+    Label hostNameLabel     { {}, "Host" };
+    Label hostNameField     { {}, "127.0.0.1" };
+    Label portNumberLabel   { {}, "Port" };
+    Slider portNumberSlider;
+    ToggleButton packButton { "Pack" };
+    TextButton connectButton { "Connect" };
+    Label statusLabel;
+
+    bool isConnected() const;
+    void connectButtonClicked();
+    void syncUIFromNodeState();
+    void timerCallback() override;
+};
+
+}
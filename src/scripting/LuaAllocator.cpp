@@ -0,0 +1,341 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "scripting/LuaAllocator.h"
+
+namespace Element {
+
+static inline int highestBit (size_t x) noexcept
+{
+    jassert (x != 0);
+   #if JUCE_GCC || JUCE_CLANG
+    return (int) (sizeof (unsigned long long) * 8 - 1) - __builtin_clzll ((unsigned long long) x);
+   #else
+    int bit = 0;
+    while (x >>= 1)
+        ++bit;
+    return bit;
+   #endif
+}
+
+static inline int lowestBit (uint32 x) noexcept
+{
+    jassert (x != 0);
+   #if JUCE_GCC || JUCE_CLANG
+    return __builtin_ctz (x);
+   #else
+    int bit = 0;
+    while ((x & 1u) == 0)
+        x >>= 1, ++bit;
+    return bit;
+   #endif
+}
+
+//=============================================================================
+LuaAllocator::LuaAllocator (size_t size)
+{
+    size = jlimit ((size_t) 64 * 1024, (size_t) 1 << flMaxLog2, size);
+    size &= ~(size_t) (alignment - 1);
+
+    // touch every page now so the audio thread never faults one in
+    memory.malloc (size + alignment);
+    memset (memory.get(), 0, size + alignment);
+
+    arena = reinterpret_cast<uint8*> ((reinterpret_cast<pointer_sized_uint> (memory.get()) + alignment - 1)
+                                      & ~(pointer_sized_uint) (alignment - 1));
+    arenaSize = size;
+
+    flBitmap = 0;
+    for (int fl = 0; fl < flCount; ++fl)
+    {
+        slBitmap[fl] = 0;
+        for (int sl = 0; sl < slCount; ++sl)
+            heads[fl][sl] = nullptr;
+    }
+
+    // one free block spanning the arena, then a zero sized used block
+    // so the last real block always has a neighbour
+    auto* first = reinterpret_cast<Block*> (arena);
+    first->size = arenaSize - 2 * headerSize;
+    first->prevPhys = nullptr;
+
+    auto* sentinel = nextOf (first);
+    sentinel->size = 0;
+    sentinel->prevPhys = first;
+
+    first->size |= 1;
+    insert (first);
+}
+
+LuaAllocator::~LuaAllocator() { }
+
+//=============================================================================
+void LuaAllocator::mapping (size_t size, int& fl, int& sl) noexcept
+{
+    if (size < (size_t) smallBlockSize)
+    {
+        fl = 0;
+        sl = (int) size / (smallBlockSize / slCount);
+    }
+    else
+    {
+        fl = highestBit (size);
+        sl = (int) (size >> (fl - slLog2)) ^ slCount;
+        fl -= flShift - 1;
+    }
+}
+
+void LuaAllocator::insert (Block* block) noexcept
+{
+    int fl, sl;
+    mapping (sizeOf (block), fl, sl);
+    jassert (fl < flCount);
+
+    block->prevFree = nullptr;
+    block->nextFree = heads[fl][sl];
+    if (block->nextFree != nullptr)
+        block->nextFree->prevFree = block;
+    heads[fl][sl] = block;
+    flBitmap |= 1u << fl;
+    slBitmap[fl] |= 1u << sl;
+}
+
+void LuaAllocator::remove (Block* block) noexcept
+{
+    int fl, sl;
+    mapping (sizeOf (block), fl, sl);
+
+    if (block->prevFree != nullptr)
+        block->prevFree->nextFree = block->nextFree;
+    else
+        heads[fl][sl] = block->nextFree;
+    if (block->nextFree != nullptr)
+        block->nextFree->prevFree = block->prevFree;
+
+    if (heads[fl][sl] == nullptr)
+    {
+        slBitmap[fl] &= ~(1u << sl);
+        if (slBitmap[fl] == 0)
+            flBitmap &= ~(1u << fl);
+    }
+}
+
+LuaAllocator::Block* LuaAllocator::findFree (size_t size) noexcept
+{
+    // round up to the next list so any block found is big enough
+    const size_t rounded = size < (size_t) smallBlockSize ? size
+        : size + ((size_t) 1 << (highestBit (size) - slLog2)) - 1;
+
+    int fl, sl;
+    mapping (rounded, fl, sl);
+    if (fl < flCount)
+    {
+        uint32 slMap = slBitmap[fl] & (~0u << sl);
+        if (slMap == 0)
+        {
+            const uint32 flMap = fl + 1 < flCount ? flBitmap & (~0u << (fl + 1)) : 0u;
+            if (flMap != 0)
+            {
+                fl = lowestBit (flMap);
+                slMap = slBitmap[fl];
+            }
+        }
+
+        if (slMap != 0)
+            return heads[fl][lowestBit (slMap)];
+    }
+
+    // nothing bigger, but the first block in the size's own list may fit
+    mapping (size, fl, sl);
+    auto* block = fl < flCount ? heads[fl][sl] : nullptr;
+    return block != nullptr && sizeOf (block) >= size ? block : nullptr;
+}
+
+void LuaAllocator::trim (Block* block, size_t size) noexcept
+{
+    const size_t blockSize = sizeOf (block);
+    if (blockSize < size + headerSize + minBlockSize)
+        return;
+
+    auto* rest = reinterpret_cast<Block*> (payloadOf (block) + size);
+    rest->size = blockSize - size - headerSize;
+    rest->prevPhys = block;
+    block->size = size | (block->size & 1);
+
+    auto* next = nextOf (rest);
+    if (isFree (next))
+    {
+        remove (next);
+        rest->size += headerSize + sizeOf (next);
+        next = nextOf (rest);
+    }
+
+    next->prevPhys = rest;
+    rest->size |= 1;
+    insert (rest);
+}
+
+void LuaAllocator::addUsed (size_t bytes) noexcept
+{
+    const size_t total = used.load (std::memory_order_relaxed) + bytes;
+    used.store (total, std::memory_order_relaxed);
+    if (total > peak.load (std::memory_order_relaxed))
+        peak.store (total, std::memory_order_relaxed);
+    allocatedSinceTake += bytes;
+}
+
+void LuaAllocator::removeUsed (size_t bytes) noexcept
+{
+    used.store (used.load (std::memory_order_relaxed) - bytes, std::memory_order_relaxed);
+}
+
+//=============================================================================
+void* LuaAllocator::allocate (size_t size) noexcept
+{
+    if (size == 0 || size > arenaSize)
+    {
+        numFailed.fetch_add (1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    size = jmax (minBlockSize, (size + alignment - 1) & ~(size_t) (alignment - 1));
+    auto* block = findFree (size);
+    if (block == nullptr)
+    {
+        numFailed.fetch_add (1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    remove (block);
+    block->size &= ~(size_t) 1;
+    trim (block, size);
+    addUsed (headerSize + sizeOf (block));
+    return payloadOf (block);
+}
+
+void LuaAllocator::deallocate (void* ptr) noexcept
+{
+    if (ptr == nullptr)
+        return;
+
+    jassert (owns (ptr));
+    auto* block = blockOf (ptr);
+    jassert (! isFree (block));
+    removeUsed (headerSize + sizeOf (block));
+
+    auto* prev = block->prevPhys;
+    if (prev != nullptr && isFree (prev))
+    {
+        remove (prev);
+        prev->size = sizeOf (prev) + headerSize + sizeOf (block);
+        block = prev;
+    }
+
+    auto* next = nextOf (block);
+    if (isFree (next))
+    {
+        remove (next);
+        block->size = sizeOf (block) + headerSize + sizeOf (next);
+        next = nextOf (block);
+    }
+
+    next->prevPhys = block;
+    block->size |= 1;
+    insert (block);
+}
+
+void* LuaAllocator::reallocate (void* ptr, size_t size) noexcept
+{
+    if (ptr == nullptr)
+        return allocate (size);
+
+    if (size == 0)
+    {
+        deallocate (ptr);
+        return nullptr;
+    }
+
+    auto* block = blockOf (ptr);
+    const size_t current = sizeOf (block);
+    const size_t wanted = jmax (minBlockSize, (size + alignment - 1) & ~(size_t) (alignment - 1));
+
+    if (wanted <= current)
+    {
+        trim (block, wanted);
+        removeUsed (current - sizeOf (block));
+        return ptr;
+    }
+
+    // grow into a free neighbour when it's big enough
+    auto* next = nextOf (block);
+    if (isFree (next) && current + headerSize + sizeOf (next) >= wanted)
+    {
+        remove (next);
+        block->size = current + headerSize + sizeOf (next);
+        nextOf (block)->prevPhys = block;
+        trim (block, wanted);
+        addUsed (sizeOf (block) - current);
+        return ptr;
+    }
+
+    void* const newPtr = allocate (size);
+    if (newPtr == nullptr)
+        return nullptr;
+
+    memcpy (newPtr, ptr, current);
+    deallocate (ptr);
+    return newPtr;
+}
+
+bool LuaAllocator::owns (const void* ptr) const noexcept
+{
+    auto* p = static_cast<const uint8*> (ptr);
+    return p >= arena && p < arena + arenaSize;
+}
+
+size_t LuaAllocator::takeBytesAllocated() noexcept
+{
+    const size_t bytes = allocatedSinceTake;
+    allocatedSinceTake = 0;
+    return bytes;
+}
+
+LuaAllocator::Stats LuaAllocator::getStats() const noexcept
+{
+    Stats stats;
+    stats.arenaSize = arenaSize;
+    stats.used      = getBytesUsed();
+    stats.peak      = getPeakBytesUsed();
+    stats.numFailed = numFailed.load (std::memory_order_relaxed);
+    return stats;
+}
+
+void* LuaAllocator::alloc (void* ud, void* ptr, size_t, size_t nsize)
+{
+    auto* const allocator = static_cast<LuaAllocator*> (ud);
+    if (nsize == 0)
+    {
+        allocator->deallocate (ptr);
+        return nullptr;
+    }
+
+    return allocator->reallocate (ptr, nsize);
+}
+
+}
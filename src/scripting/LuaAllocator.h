@@ -0,0 +1,141 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+namespace Element {
+
+/** A realtime safe memory allocator for a lua_State.
+
+    All memory comes from one arena that is allocated and touched up front.
+    It is managed as a two level segregated fit heap, so allocating, resizing
+    and freeing take bounded time and never reach the system allocator. When
+    the arena is full an allocation fails, and Lua raises a memory error in
+    the script instead of growing.
+
+    The heap has no locks, so its owner must never let two threads into the
+    Lua state at once. Usage statistics can be read from any thread.
+ */
+class LuaAllocator
+{
+public:
+    enum { defaultArenaSize = 4 * 1024 * 1024 };
+
+    struct Stats
+    {
+        size_t arenaSize = 0;
+        size_t used = 0;
+        size_t peak = 0;
+        int64 numFailed = 0;
+    };
+
+    /** Create an allocator. The arena is clamped between 64 KB and 1 GB */
+    explicit LuaAllocator (size_t arenaSize = defaultArenaSize);
+    ~LuaAllocator();
+
+    /** Allocate a block. Returns nullptr if the arena can't fit it */
+    void* allocate (size_t size) noexcept;
+
+    /** Resize a block, in place when possible. Shrinking never fails. If
+        growing fails nullptr is returned and the block is left untouched
+     */
+    void* reallocate (void* ptr, size_t size) noexcept;
+
+    /** Free a block. Does nothing if ptr is nullptr */
+    void deallocate (void* ptr) noexcept;
+
+    /** Returns true if the pointer is inside this allocator's arena */
+    bool owns (const void* ptr) const noexcept;
+
+    /** Returns the usable arena size in bytes */
+    size_t getArenaSize() const noexcept        { return arenaSize; }
+
+    /** Returns the bytes in use, including block headers */
+    size_t getBytesUsed() const noexcept        { return used.load (std::memory_order_relaxed); }
+
+    /** Returns the most bytes ever in use */
+    size_t getPeakBytesUsed() const noexcept    { return peak.load (std::memory_order_relaxed); }
+
+    /** Returns the bytes allocated since the last call, for pacing a collector.
+        Call this from the thread using the allocator.
+     */
+    size_t takeBytesAllocated() noexcept;
+
+    /** Returns usage statistics */
+    Stats getStats() const noexcept;
+
+    /** A lua_Alloc function. Pass the allocator as its user data */
+    static void* alloc (void* ud, void* ptr, size_t osize, size_t nsize);
+
+private:
+    enum
+    {
+        alignLog2       = 4,
+        alignment       = 1 << alignLog2,
+        slLog2          = 4,
+        slCount         = 1 << slLog2,
+        flShift         = slLog2 + alignLog2,
+        smallBlockSize  = 1 << flShift,
+        flMaxLog2       = 30,
+        flCount         = flMaxLog2 - flShift + 1
+    };
+
+    struct Block
+    {
+        size_t size;        // payload bytes, the lowest bit is set when free
+        Block* prevPhys;
+        Block* nextFree;    // free blocks only, these overlap the payload
+        Block* prevFree;
+    };
+
+    static constexpr size_t headerSize = alignment;
+    static constexpr size_t minBlockSize = alignment;
+    static_assert (sizeof (size_t) + sizeof (Block*) <= headerSize, "block header too big");
+
+    HeapBlock<uint8> memory;
+    uint8* arena = nullptr;
+    size_t arenaSize = 0;
+    uint32 flBitmap = 0;
+    uint32 slBitmap [flCount];
+    Block* heads [flCount][slCount];
+
+    std::atomic<size_t> used { 0 }, peak { 0 };
+    std::atomic<int64> numFailed { 0 };
+    size_t allocatedSinceTake = 0;
+
+    static size_t sizeOf (const Block* b) noexcept      { return b->size & ~(size_t) (alignment - 1); }
+    static bool isFree (const Block* b) noexcept        { return (b->size & 1) != 0; }
+    static uint8* payloadOf (Block* b) noexcept         { return reinterpret_cast<uint8*> (b) + headerSize; }
+    static Block* blockOf (void* p) noexcept            { return reinterpret_cast<Block*> (static_cast<uint8*> (p) - headerSize); }
+    static Block* nextOf (Block* b) noexcept            { return reinterpret_cast<Block*> (payloadOf (b) + sizeOf (b)); }
+
+    static void mapping (size_t size, int& fl, int& sl) noexcept;
+    void insert (Block*) noexcept;
+    void remove (Block*) noexcept;
+    Block* findFree (size_t size) noexcept;
+    void trim (Block*, size_t size) noexcept;
+    void addUsed (size_t bytes) noexcept;
+    void removeUsed (size_t bytes) noexcept;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LuaAllocator)
+};
+
+}
@@ -21,7 +21,9 @@
 #include "controllers/GuiController.h"
 
 #include "engine/AudioEngine.h"
+#include "engine/GraphProcessor.h"
 #include "engine/MidiPipe.h"
+#include "engine/SignalProbe.h"
 
 #include "session/CommandManager.h"
 #include "session/MediaManager.h"
@@ -33,10 +35,13 @@
 #include "Globals.h"
 #include "Settings.h"
 
+#include "scripting/LuaDSP.h"
 #include "scripting/LuaIterators.h"
+#include "scripting/LuaMidiView.h"
 
 #include "sol/sol.hpp"
 #include "lua-kv.h"
+#include "modules/dsp/audio.h"
 
 //=============================================================================
 namespace sol {
@@ -59,6 +64,29 @@ using namespace sol;
 namespace Element {
 namespace Lua {
 
+/** A probe attached by a script. It is detached when the script lets go
+    of it, so probes don't stay on the graph after collection */
+struct ScriptProbe
+{
+    ScriptProbe (GraphNode* n, SignalProbe::Ptr p)
+        : node (n), probe (p), type (p->getType()) { }
+    ~ScriptProbe() { detach(); }
+
+    void detach()
+    {
+        if (probe != nullptr)
+            if (auto* graph = node->getParentGraph())
+                graph->detachProbe (probe.get());
+        probe = nullptr;
+    }
+
+    GraphNodePtr node;
+    SignalProbe::Ptr probe;
+    const PortType type;
+
+    JUCE_DECLARE_NON_COPYABLE (ScriptProbe)
+};
+
 static auto NS (state& lua, const char* name) { return lua[name].get_or_create<table>(); }
 
 template<typename T>
@@ -239,6 +267,24 @@ static void openModel (sol::state& lua)
             Node::sanitizeRuntimeProperties (copy, true);
             return copy.toXmlString().toStdString();
         },
+        "probe", [](Node* self, int port, sol::optional<int> decimation) -> std::unique_ptr<ScriptProbe>
+        {
+            auto* const node = self->getGraphNode();
+            auto* const graph = node != nullptr ? node->getParentGraph() : nullptr;
+            if (graph == nullptr || ! isPositiveAndBelow (port, (int) node->getNumPorts()))
+                return nullptr;
+
+            SignalProbe::Ptr probe = new SignalProbe (node->getPortType ((uint32) port),
+                                                      8192, decimation.value_or (1));
+            if (! graph->attachProbe (node->nodeId, (uint32) port, probe.get()))
+                return nullptr;
+            return std::unique_ptr<ScriptProbe> (new ScriptProbe (node, probe));
+        },
+        "unprobe", [](Node*, ScriptProbe* probe)
+        {
+            if (probe != nullptr)
+                probe->detach();
+        },
         "resetports",           &Node::resetPorts,
         "savestate",            &Node::savePluginState,
         "restoretate",          &Node::restorePluginState,
@@ -260,6 +306,58 @@ static void openModel (sol::state& lua)
        #endif
     );
 
+    // SignalProbe
+    e.new_usertype<ScriptProbe> ("SignalProbe", no_constructor,
+        "type",                 readonly_property ([](ScriptProbe* self) {
+            return self->type == PortType::Midi ? "midi" : "audio";
+        }),
+        "decimation",           readonly_property ([](ScriptProbe* self) {
+            return self->probe != nullptr ? self->probe->getDecimation() : 1;
+        }),
+        "available",            readonly_property ([](ScriptProbe* self) {
+            return self->probe != nullptr ? self->probe->getNumReady() : 0;
+        }),
+        "dropped",              readonly_property ([](ScriptProbe* self) {
+            return self->probe != nullptr ? self->probe->getNumDropped() : (int64) 0;
+        }),
+        "attached",             readonly_property ([](ScriptProbe* self) { return self->probe != nullptr; }),
+        "detach",               &ScriptProbe::detach,
+        "peak", [](ScriptProbe* self) {
+            return self->probe != nullptr ? self->probe->readPeak() : 0.f;
+        },
+        "clear", [](ScriptProbe* self) {
+            if (self->probe != nullptr)
+                self->probe->clear();
+        },
+        "read", [](ScriptProbe* self, sol::optional<int> maxSamples, sol::this_state ts)
+        {
+            sol::state_view view (ts);
+            auto samples = view.create_table();
+            if (self->probe == nullptr)
+                return samples;
+            const int numToRead = jlimit (1, 65536, maxSamples.value_or (self->probe->getNumReady()));
+            HeapBlock<float> block ((size_t) numToRead);
+            const int numRead = self->probe->readAudio (block, numToRead);
+            for (int i = 0; i < numRead; ++i)
+                samples[i + 1] = block[i];
+            return samples;
+        },
+        "readmidi", [](ScriptProbe* self, sol::this_state ts)
+        {
+            sol::state_view view (ts);
+            auto messages = view.create_table();
+            MidiMessage msg;
+            int index = 0;
+            while (self->probe != nullptr && self->probe->readMidi (msg))
+            {
+                messages[++index] = view.create_table_with (
+                    "time", msg.getTimeStamp(),
+                    "data", std::string ((const char*) msg.getRawData(), (size_t) msg.getRawDataSize()));
+            }
+            return messages;
+        }
+    );
+
     e.set_function ("newgraph", [](sol::variadic_args args) {
         String name;
         bool defaultGraph = false;
@@ -354,7 +452,13 @@ static void openWorld (state& lua)
 
 void openDSP (sol::state& lua)
 {
-    kv_openlibs (lua.lua_state(), 0);
+    auto* L = lua.lua_state();
+    kv_openlibs (L, 0);
+
+    luaL_requiref (L, "el.audio", luaopen_el_audio, 0);
+    luaL_requiref (L, "el.midi", openMidiViews, 0);
+    luaL_requiref (L, "el.dsp", openDSPVectors, 0);
+    lua_pop (L, 3);
 }
 
 void openLibs (sol::state& lua)
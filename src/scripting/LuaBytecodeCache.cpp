@@ -0,0 +1,225 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "sol/sol.hpp"
+
+#include "scripting/LuaBytecodeCache.h"
+#include "DataPath.h"
+
+namespace Element {
+
+/** Replaces the default directory when set */
+static File defaultDirectoryOverride;
+
+/** Chunks kept in memory before the oldest are dropped */
+static const int maxChunksInMemory = 256;
+
+/** Identifies the cache file layout */
+static const char fileMagic[] = { 'E', 'L', 'B', 'C' };
+static const uint32 fileVersion = 1;
+
+static int writeChunk (lua_State*, const void* data, size_t size, void* block)
+{
+    static_cast<MemoryBlock*> (block)->append (data, size);
+    return 0;
+}
+
+static MemoryBlock makeKey (const String& source, const char* chunkName)
+{
+    // the bytecode format depends on the Lua release and number sizes
+    MemoryOutputStream key;
+    key << LUA_RELEASE;
+    key.writeByte ((char) sizeof (lua_Integer));
+    key.writeByte ((char) sizeof (lua_Number));
+    key.writeByte ((char) sizeof (void*));
+    if (chunkName != nullptr)
+        key.write (chunkName, strlen (chunkName));
+    key.writeByte (0);
+    key << source;
+    return SHA256 (key.getData(), key.getDataSize()).getRawData();
+}
+
+//=============================================================================
+LuaBytecodeCache::LuaBytecodeCache()
+    : directory (getDefaultDirectory()) { }
+
+LuaBytecodeCache::LuaBytecodeCache (const File& dir)
+    : directory (dir) { }
+
+LuaBytecodeCache::~LuaBytecodeCache() { }
+
+File LuaBytecodeCache::getDefaultDirectory()
+{
+    if (defaultDirectoryOverride != File())
+        return defaultDirectoryOverride;
+    return DataPath::applicationDataDir().getChildFile ("Cache/Lua");
+}
+
+void LuaBytecodeCache::setDefaultDirectory (const File& newDirectory)
+{
+    defaultDirectoryOverride = newDirectory;
+}
+
+int LuaBytecodeCache::load (lua_State* L, const String& source, const char* chunkName)
+{
+    const char* const name = chunkName != nullptr ? chunkName : source.toRawUTF8();
+    const MemoryBlock key = makeKey (source, chunkName);
+    const String keyString = String::toHexString (key.getData(), (int) key.getSize(), 0);
+
+    {
+        ScopedLock sl (lock);
+        if (chunks.contains (keyString))
+        {
+            const auto& bytecode = chunks.getReference (keyString);
+            if (luaL_loadbufferx (L, (const char*) bytecode.getData(), bytecode.getSize(), name, "b") == LUA_OK)
+            {
+                ++memoryHits;
+                return LUA_OK;
+            }
+
+            DBG("[EL] Lua bytecode rejected: " << lua_tostring (L, -1));
+            lua_pop (L, 1);
+            chunks.remove (keyString);
+            ++rejected;
+        }
+    }
+
+    const File file = directory == File() ? File() : directory.getChildFile (keyString + ".luac");
+    MemoryBlock bytecode;
+
+    if (file.existsAsFile())
+    {
+        if (readFile (file, key, bytecode))
+        {
+            if (luaL_loadbufferx (L, (const char*) bytecode.getData(), bytecode.getSize(), name, "b") == LUA_OK)
+            {
+                ++diskHits;
+                ScopedLock sl (lock);
+                if (chunks.size() >= maxChunksInMemory)
+                    chunks.clear();
+                chunks.set (keyString, bytecode);
+                return LUA_OK;
+            }
+
+            DBG("[EL] Lua bytecode rejected: " << lua_tostring (L, -1));
+            lua_pop (L, 1);
+        }
+        else
+        {
+            DBG("[EL] Lua bytecode file is invalid: " << file.getFileName());
+        }
+
+        file.deleteFile();
+        ++rejected;
+    }
+
+    const auto utf8 = source.toUTF8();
+    const int status = luaL_loadbufferx (L, utf8.getAddress(), utf8.sizeInBytes() - 1, name, "t");
+    if (status != LUA_OK)
+        return status;
+
+    ++compiles;
+    bytecode.reset();
+    if (lua_dump (L, writeChunk, &bytecode, 0) != 0 || bytecode.getSize() == 0)
+        return LUA_OK; // the function is loaded, it just isn't cached
+
+    {
+        ScopedLock sl (lock);
+        if (chunks.size() >= maxChunksInMemory)
+            chunks.clear();
+        chunks.set (keyString, bytecode);
+    }
+
+    if (file != File())
+        writeFile (file, key, bytecode);
+
+    return LUA_OK;
+}
+
+void LuaBytecodeCache::clear()
+{
+    ScopedLock sl (lock);
+    chunks.clear();
+}
+
+LuaBytecodeCache::Stats LuaBytecodeCache::getStats() const
+{
+    Stats stats;
+    stats.memoryHits = memoryHits.load();
+    stats.diskHits   = diskHits.load();
+    stats.compiles   = compiles.load();
+    stats.rejected   = rejected.load();
+    return stats;
+}
+
+//=============================================================================
+bool LuaBytecodeCache::readFile (const File& file, const MemoryBlock& key, MemoryBlock& bytecode)
+{
+    MemoryBlock data;
+    if (! file.loadFileAsData (data))
+        return false;
+
+    MemoryInputStream in (data, false);
+    char magic[4] = { 0 };
+    MemoryBlock fileKey, checksum;
+
+    if (in.read (magic, 4) != 4 || memcmp (magic, fileMagic, 4) != 0)
+        return false;
+    if ((uint32) in.readInt() != fileVersion)
+        return false;
+    if (in.readIntoMemoryBlock (fileKey, (ssize_t) key.getSize()) != key.getSize() || fileKey != key)
+        return false;
+
+    const auto size = (int64) (uint32) in.readInt();
+    if (in.readIntoMemoryBlock (checksum, 32) != (size_t) 32 || size != in.getNumBytesRemaining())
+        return false;
+
+    bytecode.reset();
+    in.readIntoMemoryBlock (bytecode, (ssize_t) size);
+    return SHA256 (bytecode).getRawData() == checksum;
+}
+
+void LuaBytecodeCache::writeFile (const File& file, const MemoryBlock& key, const MemoryBlock& bytecode)
+{
+    if (! directory.isDirectory() && ! directory.createDirectory())
+        return;
+
+    // write to a temporary file and move it in place, so a reader never
+    // sees a partly written chunk
+    TemporaryFile temp (file);
+    {
+        FileOutputStream out (temp.getFile());
+        if (! out.openedOk())
+            return;
+        out.write (fileMagic, 4);
+        out.writeInt ((int) fileVersion);
+        out.write (key.getData(), key.getSize());
+        out.writeInt ((int) bytecode.getSize());
+        const auto checksum = SHA256 (bytecode).getRawData();
+        out.write (checksum.getData(), checksum.getSize());
+        out.write (bytecode.getData(), bytecode.getSize());
+        out.flush();
+        if (out.getStatus().failed())
+            return;
+    }
+
+    temp.overwriteTargetFileWithTemporary();
+}
+
+}
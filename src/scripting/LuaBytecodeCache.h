@@ -0,0 +1,90 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+struct lua_State;
+
+namespace Element {
+
+/** Caches compiled Lua chunks so the same script is only compiled once.
+
+    Chunks are keyed by a SHA-256 of the source, the chunk name and the Lua
+    version and number formats, so a changed script or Lua build never gets
+    old bytecode. Compiled chunks are kept in memory and written to a
+    directory. Files that don't match their key or checksum are deleted and
+    the source is compiled again.
+ */
+class LuaBytecodeCache
+{
+public:
+    struct Stats
+    {
+        int64 memoryHits = 0;
+        int64 diskHits = 0;
+        int64 compiles = 0;
+        int64 rejected = 0;
+    };
+
+    /** Creates a cache that writes to the default directory */
+    LuaBytecodeCache();
+
+    /** Creates a cache that writes to a directory, or only keeps chunks in
+        memory if the directory is File() */
+    explicit LuaBytecodeCache (const File& directory);
+    ~LuaBytecodeCache();
+
+    /** Returns the default directory, under the user data path */
+    static File getDefaultDirectory();
+
+    /** Replaces the default directory for caches created after this, e.g. so
+        tests don't write to the user data path. File() restores it */
+    static void setDefaultDirectory (const File& directory);
+
+    /** Loads a chunk like luaL_loadbuffer. Pushes the function, or an error
+        message if the source didn't compile, and returns the Lua status.
+
+        @param L            The state to load into
+        @param source       The script source
+        @param chunkName    Name used in error messages. If nullptr the
+                            source is used, like luaL_loadstring
+     */
+    int load (lua_State* L, const String& source, const char* chunkName = nullptr);
+
+    /** Drops chunks kept in memory */
+    void clear();
+
+    /** Returns the number of loads served from each level */
+    Stats getStats() const;
+
+private:
+    const File directory;
+    CriticalSection lock;
+    HashMap<String, MemoryBlock> chunks;
+    std::atomic<int64> memoryHits { 0 }, diskHits { 0 }, compiles { 0 }, rejected { 0 };
+
+    bool readFile (const File& file, const MemoryBlock& key, MemoryBlock& bytecode);
+    void writeFile (const File& file, const MemoryBlock& key, const MemoryBlock& bytecode);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LuaBytecodeCache)
+};
+
+}
@@ -0,0 +1,469 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "sol/sol.hpp"
+#include "modules/dsp/audio.h"
+
+#include "JuceHeader.h"
+#include "scripting/LuaDSP.h"
+
+#define EL_DSP_BIQUAD_MT    "el.dsp.Biquad"
+#define EL_DSP_ONEPOLE_MT   "el.dsp.OnePole"
+
+namespace Element {
+namespace Lua {
+
+/** Filters keep state for this many channels */
+enum { maxFilterChannels = 16 };
+
+//=============================================================================
+static int checkChannel (lua_State* L, el_audio_buffer_t* buf, int idx)
+{
+    const auto c = luaL_checkinteger (L, idx);
+    luaL_argcheck (L, c >= 1 && c <= el_audio_buffer_channels (buf), idx, "channel out of range");
+    return (int) c - 1;
+}
+
+/** Calls fn (channelIndex) for the channel at idx, or every channel if it is nil */
+template<typename Fn>
+static void forChannels (lua_State* L, el_audio_buffer_t* buf, int idx, Fn&& fn)
+{
+    if (! lua_isnoneornil (L, idx))
+    {
+        fn (checkChannel (L, buf, idx));
+        return;
+    }
+
+    for (int c = 0; c < el_audio_buffer_channels (buf); ++c)
+        fn (c);
+}
+
+/** Calls fn (dst, src, numSamples) for the channel pair at idx and idx + 1.
+    Without channels every pair up to the smaller buffer is used */
+template<typename Fn>
+static void forChannelPairs (lua_State* L, el_audio_buffer_t* dst, el_audio_buffer_t* src, int idx, Fn&& fn)
+{
+    const int n = jmin (el_audio_buffer_length (dst), el_audio_buffer_length (src));
+
+    if (! lua_isnoneornil (L, idx))
+    {
+        const int dc = checkChannel (L, dst, idx);
+        const int sc = lua_isnoneornil (L, idx + 1) ? dc : checkChannel (L, src, idx + 1);
+        luaL_argcheck (L, sc < el_audio_buffer_channels (src), idx, "channel out of range");
+        fn (el_audio_buffer_channel (dst, dc), el_audio_buffer_channel (src, sc), n);
+        return;
+    }
+
+    for (int c = 0; c < jmin (el_audio_buffer_channels (dst), el_audio_buffer_channels (src)); ++c)
+        fn (el_audio_buffer_channel (dst, c), el_audio_buffer_channel (src, c), n);
+}
+
+//=============================================================================
+/** gain (buffer, gain [, channel]) */
+static int dsp_gain (lua_State* L)
+{
+    auto* buf = el_audio_buffer_check (L, 1);
+    const auto gain = (float) luaL_checknumber (L, 2);
+    const int n = el_audio_buffer_length (buf);
+    forChannels (L, buf, 3, [=] (int c) {
+        FloatVectorOperations::multiply (el_audio_buffer_channel (buf, c), gain, n);
+    });
+    return 0;
+}
+
+/** ramp (buffer, start, end [, channel]) */
+static int dsp_ramp (lua_State* L)
+{
+    auto* buf = el_audio_buffer_check (L, 1);
+    const auto g0 = (float) luaL_checknumber (L, 2);
+    const auto g1 = (float) luaL_checknumber (L, 3);
+    const int n = el_audio_buffer_length (buf);
+    const float inc = n > 0 ? (g1 - g0) / (float) n : 0.f;
+
+    forChannels (L, buf, 4, [=] (int c) {
+        float* const d = el_audio_buffer_channel (buf, c);
+        if (inc == 0.f)
+            FloatVectorOperations::multiply (d, g0, n);
+        else
+            for (int i = 0; i < n; ++i)
+                d[i] *= g0 + inc * (float) i;
+    });
+    return 0;
+}
+
+/** add (dest, source [, gain [, destChannel [, sourceChannel]]]) */
+static int dsp_add (lua_State* L)
+{
+    auto* dst = el_audio_buffer_check (L, 1);
+    auto* src = el_audio_buffer_check (L, 2);
+    const auto gain = (float) luaL_optnumber (L, 3, 1.0);
+    forChannelPairs (L, dst, src, 4, [=] (float* d, const float* s, int n) {
+        if (gain == 1.f)
+            FloatVectorOperations::add (d, s, n);
+        else
+            FloatVectorOperations::addWithMultiply (d, s, gain, n);
+    });
+    return 0;
+}
+
+/** mix (dest, source, amount [, destChannel [, sourceChannel]])
+    dest becomes dest * (1 - amount) + source * amount */
+static int dsp_mix (lua_State* L)
+{
+    auto* dst = el_audio_buffer_check (L, 1);
+    auto* src = el_audio_buffer_check (L, 2);
+    const auto amount = (float) luaL_checknumber (L, 3);
+    forChannelPairs (L, dst, src, 4, [=] (float* d, const float* s, int n) {
+        FloatVectorOperations::multiply (d, 1.f - amount, n);
+        FloatVectorOperations::addWithMultiply (d, s, amount, n);
+    });
+    return 0;
+}
+
+/** multiply (dest, source [, destChannel [, sourceChannel]]) */
+static int dsp_multiply (lua_State* L)
+{
+    auto* dst = el_audio_buffer_check (L, 1);
+    auto* src = el_audio_buffer_check (L, 2);
+    forChannelPairs (L, dst, src, 3, [] (float* d, const float* s, int n) {
+        FloatVectorOperations::multiply (d, s, n);
+    });
+    return 0;
+}
+
+/** clip (buffer, low, high [, channel]) */
+static int dsp_clip (lua_State* L)
+{
+    auto* buf = el_audio_buffer_check (L, 1);
+    const auto low  = (float) luaL_checknumber (L, 2);
+    const auto high = (float) luaL_checknumber (L, 3);
+    luaL_argcheck (L, low <= high, 3, "high is below low");
+    const int n = el_audio_buffer_length (buf);
+    forChannels (L, buf, 4, [=] (int c) {
+        float* const d = el_audio_buffer_channel (buf, c);
+        FloatVectorOperations::clip (d, d, low, high, n);
+    });
+    return 0;
+}
+
+/** peak (buffer [, channel]) returns the largest absolute sample */
+static int dsp_peak (lua_State* L)
+{
+    auto* buf = el_audio_buffer_check (L, 1);
+    const int n = el_audio_buffer_length (buf);
+    float peak = 0.f;
+    forChannels (L, buf, 2, [&] (int c) {
+        const auto range = FloatVectorOperations::findMinAndMax (el_audio_buffer_channel (buf, c), n);
+        peak = jmax (peak, std::abs (range.getStart()), std::abs (range.getEnd()));
+    });
+    lua_pushnumber (L, peak);
+    return 1;
+}
+
+/** rms (buffer [, channel]) */
+static int dsp_rms (lua_State* L)
+{
+    auto* buf = el_audio_buffer_check (L, 1);
+    const int n = el_audio_buffer_length (buf);
+    double sum = 0.0;
+    int count = 0;
+
+    forChannels (L, buf, 2, [&] (int c) {
+        // independent partial sums so the loop vectorizes
+        const float* const d = el_audio_buffer_channel (buf, c);
+        float s[4] = { 0.f, 0.f, 0.f, 0.f };
+        int i = 0;
+        for (; i + 4 <= n; i += 4)
+            for (int j = 0; j < 4; ++j)
+                s[j] += d[i + j] * d[i + j];
+        for (; i < n; ++i)
+            s[0] += d[i] * d[i];
+        sum += (double) (s[0] + s[1] + s[2] + s[3]);
+        count += n;
+    });
+
+    lua_pushnumber (L, count > 0 ? std::sqrt (sum / count) : 0.0);
+    return 1;
+}
+
+/** interleave (dest, source) writes every source channel interleaved to
+    the first dest channel */
+static int dsp_interleave (lua_State* L)
+{
+    auto* dst = el_audio_buffer_check (L, 1);
+    auto* src = el_audio_buffer_check (L, 2);
+    const int nchans = el_audio_buffer_channels (src);
+    const int n = el_audio_buffer_length (src);
+    luaL_argcheck (L, el_audio_buffer_channels (dst) >= 1 && el_audio_buffer_length (dst) >= nchans * n,
+                   1, "dest is too short");
+
+    float* const d = el_audio_buffer_channel (dst, 0);
+    for (int c = 0; c < nchans; ++c)
+    {
+        const float* const s = el_audio_buffer_channel (src, c);
+        for (int i = 0; i < n; ++i)
+            d[i * nchans + c] = s[i];
+    }
+    return 0;
+}
+
+/** deinterleave (dest, source) splits the first source channel into every
+    dest channel */
+static int dsp_deinterleave (lua_State* L)
+{
+    auto* dst = el_audio_buffer_check (L, 1);
+    auto* src = el_audio_buffer_check (L, 2);
+    const int nchans = el_audio_buffer_channels (dst);
+    const int n = el_audio_buffer_length (dst);
+    luaL_argcheck (L, el_audio_buffer_channels (src) >= 1 && el_audio_buffer_length (src) >= nchans * n,
+                   2, "source is too short");
+
+    const float* const s = el_audio_buffer_channel (src, 0);
+    for (int c = 0; c < nchans; ++c)
+    {
+        float* const d = el_audio_buffer_channel (dst, c);
+        for (int i = 0; i < n; ++i)
+            d[i] = s[i * nchans + c];
+    }
+    return 0;
+}
+
+//=============================================================================
+struct Biquad
+{
+    float c[5];
+    float state[maxFilterChannels][2];
+};
+
+static Biquad* checkBiquad (lua_State* L, int idx)
+{
+    return (Biquad*) luaL_checkudata (L, idx, EL_DSP_BIQUAD_MT);
+}
+
+static void setCoefficients (Biquad* bq, const IIRCoefficients& coeffs)
+{
+    for (int i = 0; i < 5; ++i)
+        bq->c[i] = coeffs.coefficients[i];
+}
+
+static double checkFrequency (lua_State* L, int idx, double rate)
+{
+    const auto freq = luaL_checknumber (L, idx);
+    luaL_argcheck (L, freq > 0.0 && freq < rate * 0.5, idx, "frequency out of range");
+    return freq;
+}
+
+template<IIRCoefficients (*make) (double, double, double)>
+static int biquad_set (lua_State* L)
+{
+    auto* bq = checkBiquad (L, 1);
+    const auto rate = luaL_checknumber (L, 2);
+    luaL_argcheck (L, rate > 0.0, 2, "invalid sample rate");
+    const auto freq = checkFrequency (L, 3, rate);
+    setCoefficients (bq, make (rate, freq, luaL_optnumber (L, 4, std::sqrt (0.5))));
+    lua_settop (L, 1);
+    return 1;
+}
+
+/** lowshelf, highshelf and peak take a linear gain after Q */
+template<IIRCoefficients (*make) (double, double, double, float)>
+static int biquad_set_gain (lua_State* L)
+{
+    auto* bq = checkBiquad (L, 1);
+    const auto rate = luaL_checknumber (L, 2);
+    luaL_argcheck (L, rate > 0.0, 2, "invalid sample rate");
+    const auto freq = checkFrequency (L, 3, rate);
+    const auto q    = luaL_checknumber (L, 4);
+    const auto gain = luaL_checknumber (L, 5);
+    luaL_argcheck (L, gain > 0.0, 5, "gain must be above zero");
+    setCoefficients (bq, make (rate, freq, q, (float) gain));
+    lua_settop (L, 1);
+    return 1;
+}
+
+static int biquad_reset (lua_State* L)
+{
+    auto* bq = checkBiquad (L, 1);
+    zeromem (bq->state, sizeof (bq->state));
+    return 0;
+}
+
+/** process (buffer [, channel]) */
+static int biquad_process (lua_State* L)
+{
+    auto* bq = checkBiquad (L, 1);
+    auto* buf = el_audio_buffer_check (L, 2);
+    const int n = el_audio_buffer_length (buf);
+    const float c0 = bq->c[0], c1 = bq->c[1], c2 = bq->c[2], c3 = bq->c[3], c4 = bq->c[4];
+
+    forChannels (L, buf, 3, [&] (int c) {
+        luaL_argcheck (L, c < maxFilterChannels, 3, "too many channels for the filter");
+        float* const d = el_audio_buffer_channel (buf, c);
+        float v1 = bq->state[c][0], v2 = bq->state[c][1];
+
+        for (int i = 0; i < n; ++i)
+        {
+            const float in = d[i];
+            const float out = c0 * in + v1;
+            d[i] = out;
+            v1 = c1 * in - c3 * out + v2;
+            v2 = c2 * in - c4 * out;
+        }
+
+        JUCE_SNAP_TO_ZERO (v1);  JUCE_SNAP_TO_ZERO (v2);
+        bq->state[c][0] = v1;
+        bq->state[c][1] = v2;
+    });
+    return 0;
+}
+
+static const luaL_Reg biquadMethods[] = {
+    { "lowpass",    biquad_set<IIRCoefficients::makeLowPass> },
+    { "highpass",   biquad_set<IIRCoefficients::makeHighPass> },
+    { "bandpass",   biquad_set<IIRCoefficients::makeBandPass> },
+    { "notch",      biquad_set<IIRCoefficients::makeNotchFilter> },
+    { "allpass",    biquad_set<IIRCoefficients::makeAllPass> },
+    { "lowshelf",   biquad_set_gain<IIRCoefficients::makeLowShelf> },
+    { "highshelf",  biquad_set_gain<IIRCoefficients::makeHighShelf> },
+    { "peak",       biquad_set_gain<IIRCoefficients::makePeakFilter> },
+    { "reset",      biquad_reset },
+    { "process",    biquad_process },
+    { nullptr, nullptr }
+};
+
+//=============================================================================
+struct OnePole
+{
+    float coeff;
+    bool highpass;
+    float state[maxFilterChannels];
+};
+
+static OnePole* checkOnePole (lua_State* L, int idx)
+{
+    return (OnePole*) luaL_checkudata (L, idx, EL_DSP_ONEPOLE_MT);
+}
+
+template<bool highpass>
+static int onepole_set (lua_State* L)
+{
+    auto* op = checkOnePole (L, 1);
+    const auto rate = luaL_checknumber (L, 2);
+    luaL_argcheck (L, rate > 0.0, 2, "invalid sample rate");
+    const auto freq = checkFrequency (L, 3, rate);
+    op->coeff = (float) (1.0 - std::exp (-2.0 * double_Pi * freq / rate));
+    op->highpass = highpass;
+    lua_settop (L, 1);
+    return 1;
+}
+
+static int onepole_reset (lua_State* L)
+{
+    auto* op = checkOnePole (L, 1);
+    zeromem (op->state, sizeof (op->state));
+    return 0;
+}
+
+/** process (buffer [, channel]) */
+static int onepole_process (lua_State* L)
+{
+    auto* op = checkOnePole (L, 1);
+    auto* buf = el_audio_buffer_check (L, 2);
+    const int n = el_audio_buffer_length (buf);
+    const float a = op->coeff;
+    const bool highpass = op->highpass;
+
+    forChannels (L, buf, 3, [&] (int c) {
+        luaL_argcheck (L, c < maxFilterChannels, 3, "too many channels for the filter");
+        float* const d = el_audio_buffer_channel (buf, c);
+        float z = op->state[c];
+
+        for (int i = 0; i < n; ++i)
+        {
+            z += a * (d[i] - z);
+            d[i] = highpass ? d[i] - z : z;
+        }
+
+        JUCE_SNAP_TO_ZERO (z);
+        op->state[c] = z;
+    });
+    return 0;
+}
+
+static const luaL_Reg onePoleMethods[] = {
+    { "lowpass",    onepole_set<false> },
+    { "highpass",   onepole_set<true> },
+    { "reset",      onepole_reset },
+    { "process",    onepole_process },
+    { nullptr, nullptr }
+};
+
+//=============================================================================
+static void setMetatable (lua_State* L, const char* name, const luaL_Reg* methods)
+{
+    if (luaL_newmetatable (L, name))
+    {
+        luaL_setfuncs (L, methods, 0);
+        lua_pushvalue (L, -1);
+        lua_setfield (L, -2, "__index");
+    }
+    lua_setmetatable (L, -2);
+}
+
+static int dsp_biquad (lua_State* L)
+{
+    auto* bq = (Biquad*) lua_newuserdata (L, sizeof (Biquad));
+    zeromem (bq, sizeof (Biquad));
+    bq->c[0] = 1.f; // passes audio through until set
+    setMetatable (L, EL_DSP_BIQUAD_MT, biquadMethods);
+    return 1;
+}
+
+static int dsp_onepole (lua_State* L)
+{
+    auto* op = (OnePole*) lua_newuserdata (L, sizeof (OnePole));
+    zeromem (op, sizeof (OnePole));
+    op->coeff = 1.f;
+    setMetatable (L, EL_DSP_ONEPOLE_MT, onePoleMethods);
+    return 1;
+}
+
+static const luaL_Reg dspFunctions[] = {
+    { "gain",           dsp_gain },
+    { "ramp",           dsp_ramp },
+    { "add",            dsp_add },
+    { "mix",            dsp_mix },
+    { "multiply",       dsp_multiply },
+    { "clip",           dsp_clip },
+    { "peak",           dsp_peak },
+    { "rms",            dsp_rms },
+    { "interleave",     dsp_interleave },
+    { "deinterleave",   dsp_deinterleave },
+    { "Biquad",         dsp_biquad },
+    { "OnePole",        dsp_onepole },
+    { nullptr, nullptr }
+};
+
+int openDSPVectors (lua_State* L)
+{
+    luaL_newlib (L, dspFunctions);
+    return 1;
+}
+
+}}
@@ -63,6 +63,8 @@
 #include "../../libs/lua/src/ltm.c"
 #include "../../libs/lua/src/ldo.c"
 
+#include "../../libs/lua/modules/dsp/audio.c"
+
 // #include "../../libs/lua-rt/src/audio.c"
 // #include "../../libs/lua-rt/src/midi.c"
 
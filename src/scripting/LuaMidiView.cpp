@@ -0,0 +1,279 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "sol/sol.hpp"
+
+#include "engine/MidiPipe.h"
+#include "scripting/LuaMidiView.h"
+
+#define EL_MIDI_PIPE_MT     "el.midi.Pipe"
+#define EL_MIDI_BUFFER_MT   "el.midi.Buffer"
+
+namespace Element {
+namespace Lua {
+
+struct MidiBufferView
+{
+    MidiBuffer* buffer;
+    int numFrames;
+    bool iterating;
+    alignas (MidiBuffer::Iterator) char iterData [sizeof (MidiBuffer::Iterator)];
+
+    MidiBuffer::Iterator& iterator() noexcept { return *reinterpret_cast<MidiBuffer::Iterator*> (iterData); }
+
+    void stopIterating() noexcept
+    {
+        if (iterating)
+            iterator().~Iterator();
+        iterating = false;
+    }
+};
+
+struct MidiPipeView
+{
+    int capacity;
+    int numBuffers;
+    MidiBufferView** buffers;
+};
+
+//=============================================================================
+static MidiBufferView* checkBuffer (lua_State* L, int idx)
+{
+    auto* view = (MidiBufferView*) luaL_checkudata (L, idx, EL_MIDI_BUFFER_MT);
+    if (view->buffer == nullptr)
+        luaL_error (L, "midi view used after the call it was passed to");
+    return view;
+}
+
+static int buffer_count (lua_State* L)
+{
+    lua_pushinteger (L, checkBuffer (L, 1)->buffer->getNumEvents());
+    return 1;
+}
+
+static int buffer_clear (lua_State* L)
+{
+    auto* view = checkBuffer (L, 1);
+    view->stopIterating();
+    view->buffer->clear();
+    return 0;
+}
+
+/** insert (frame, status [, data1 [, data2]]) frames start at zero */
+static int buffer_insert (lua_State* L)
+{
+    auto* view = checkBuffer (L, 1);
+    const auto frame  = luaL_checkinteger (L, 2);
+    const auto status = luaL_checkinteger (L, 3);
+    luaL_argcheck (L, frame >= 0 && frame < view->numFrames, 2, "frame out of range");
+    luaL_argcheck (L, status >= 0x80 && status <= 0xff && status != 0xf0 && status != 0xf7,
+                   3, "invalid status byte");
+
+    const uint8 data[3] = { (uint8) status,
+                            (uint8) (luaL_optinteger (L, 4, 0) & 0x7f),
+                            (uint8) (luaL_optinteger (L, 5, 0) & 0x7f) };
+    view->stopIterating();
+    view->buffer->addEvent (data, MidiMessage::getMessageLengthFromFirstByte (data[0]), (int) frame);
+    return 0;
+}
+
+static int buffer_next (lua_State* L)
+{
+    auto* view = checkBuffer (L, 1);
+    if (! view->iterating)
+        return luaL_error (L, "midi buffer changed while iterating");
+
+    const uint8* data = nullptr;
+    int size = 0, frame = 0;
+    if (! view->iterator().getNextEvent (data, size, frame))
+    {
+        view->stopIterating();
+        return 0;
+    }
+
+    lua_pushinteger (L, luaL_checkinteger (L, 2) + 1);
+    lua_pushinteger (L, frame);
+    for (int i = 0; i < 3; ++i)
+        lua_pushinteger (L, i < size ? data[i] : 0);
+    return 5;
+}
+
+/** for i, frame, status, d1, d2 in b:events() do ... end */
+static int buffer_events (lua_State* L)
+{
+    auto* view = checkBuffer (L, 1);
+    view->stopIterating();
+    new (view->iterData) MidiBuffer::Iterator (*view->buffer);
+    view->iterating = true;
+
+    lua_pushcfunction (L, buffer_next);
+    lua_pushvalue (L, 1);
+    lua_pushinteger (L, 0);
+    return 3;
+}
+
+static int buffer_gc (lua_State* L)
+{
+    ((MidiBufferView*) lua_touserdata (L, 1))->stopIterating();
+    return 0;
+}
+
+static const luaL_Reg bufferMethods[] = {
+    { "count",  buffer_count },
+    { "clear",  buffer_clear },
+    { "insert", buffer_insert },
+    { "events", buffer_events },
+    { "__len",  buffer_count },
+    { "__gc",   buffer_gc },
+    { nullptr, nullptr }
+};
+
+//=============================================================================
+static MidiPipeView* checkPipe (lua_State* L, int idx)
+{
+    return (MidiPipeView*) luaL_checkudata (L, idx, EL_MIDI_PIPE_MT);
+}
+
+static int pipe_size (lua_State* L)
+{
+    lua_pushinteger (L, checkPipe (L, 1)->numBuffers);
+    return 1;
+}
+
+/** get (index) indexes start at one */
+static int pipe_get (lua_State* L)
+{
+    auto* pipe = checkPipe (L, 1);
+    const auto index = luaL_checkinteger (L, 2);
+    luaL_argcheck (L, index >= 1 && index <= pipe->numBuffers, 2, "buffer index out of range");
+    lua_getuservalue (L, 1);
+    lua_rawgeti (L, -1, index);
+    return 1;
+}
+
+static int pipe_clear (lua_State* L)
+{
+    auto* pipe = checkPipe (L, 1);
+    for (int i = 0; i < pipe->numBuffers; ++i)
+    {
+        pipe->buffers[i]->stopIterating();
+        pipe->buffers[i]->buffer->clear();
+    }
+    return 0;
+}
+
+static const luaL_Reg pipeMethods[] = {
+    { "size",   pipe_size },
+    { "get",    pipe_get },
+    { "clear",  pipe_clear },
+    { "__len",  pipe_size },
+    { nullptr, nullptr }
+};
+
+static void setMetatable (lua_State* L, const char* name, const luaL_Reg* methods)
+{
+    if (luaL_newmetatable (L, name))
+    {
+        luaL_setfuncs (L, methods, 0);
+        lua_pushvalue (L, -1);
+        lua_setfield (L, -2, "__index");
+    }
+    lua_setmetatable (L, -2);
+}
+
+//=============================================================================
+MidiPipeView* newMidiPipeView (lua_State* L, int capacity)
+{
+    capacity = jmax (0, capacity);
+    auto* pipe = (MidiPipeView*) lua_newuserdata (L,
+        sizeof (MidiPipeView) + sizeof (MidiBufferView*) * (size_t) capacity);
+    pipe->capacity   = capacity;
+    pipe->numBuffers = 0;
+    pipe->buffers    = reinterpret_cast<MidiBufferView**> (pipe + 1);
+    setMetatable (L, EL_MIDI_PIPE_MT, pipeMethods);
+
+    // the buffer views live in the pipe's user value so get() doesn't allocate
+    lua_createtable (L, capacity, 0);
+    for (int i = 0; i < capacity; ++i)
+    {
+        auto* view = (MidiBufferView*) lua_newuserdata (L, sizeof (MidiBufferView));
+        view->buffer    = nullptr;
+        view->numFrames = 0;
+        view->iterating = false;
+        setMetatable (L, EL_MIDI_BUFFER_MT, bufferMethods);
+        pipe->buffers[i] = view;
+        lua_rawseti (L, -2, i + 1);
+    }
+    lua_setuservalue (L, -2);
+
+    return pipe;
+}
+
+void referTo (MidiPipeView* pipe, MidiPipe& midi, int numFrames) noexcept
+{
+    pipe->numBuffers = jmin (pipe->capacity, midi.getNumBuffers());
+    for (int i = 0; i < pipe->numBuffers; ++i)
+    {
+        pipe->buffers[i]->buffer    = midi.getWriteBuffer (i);
+        pipe->buffers[i]->numFrames = numFrames;
+    }
+}
+
+void detach (MidiPipeView* pipe) noexcept
+{
+    for (int i = 0; i < pipe->numBuffers; ++i)
+    {
+        pipe->buffers[i]->stopIterating();
+        pipe->buffers[i]->buffer    = nullptr;
+        pipe->buffers[i]->numFrames = 0;
+    }
+    pipe->numBuffers = 0;
+}
+
+//=============================================================================
+static int midi_status (lua_State* L, int type)
+{
+    const auto channel = luaL_checkinteger (L, 1);
+    luaL_argcheck (L, channel >= 1 && channel <= 16, 1, "channel out of range");
+    lua_pushinteger (L, type | (int) (channel - 1));
+    return 1;
+}
+
+static int midi_noteon (lua_State* L)          { return midi_status (L, 0x90); }
+static int midi_noteoff (lua_State* L)         { return midi_status (L, 0x80); }
+static int midi_controller (lua_State* L)      { return midi_status (L, 0xb0); }
+static int midi_program (lua_State* L)         { return midi_status (L, 0xc0); }
+static int midi_pitchbend (lua_State* L)       { return midi_status (L, 0xe0); }
+
+static const luaL_Reg midiFunctions[] = {
+    { "noteon",     midi_noteon },
+    { "noteoff",    midi_noteoff },
+    { "controller", midi_controller },
+    { "program",    midi_program },
+    { "pitchbend",  midi_pitchbend },
+    { nullptr, nullptr }
+};
+
+int openMidiViews (lua_State* L)
+{
+    luaL_newlib (L, midiFunctions);
+    return 1;
+}
+
+}}
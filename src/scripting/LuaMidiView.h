@@ -0,0 +1,54 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+struct lua_State;
+
+namespace Element {
+
+class MidiPipe;
+
+namespace Lua {
+
+/** A view of a MidiPipe for Lua render callbacks.
+
+    The view and one buffer view per slot are created up front, so pointing
+    them at the engine's MIDI buffers each block doesn't allocate. Scripts
+    read and insert events in the engine's buffers directly. After detach()
+    the buffer views raise an error if a script kept one and uses it later.
+ */
+struct MidiPipeView;
+
+/** Push a new pipe view with room for up to capacity buffers */
+MidiPipeView* newMidiPipeView (lua_State* L, int capacity);
+
+/** Point the view at the buffers of a pipe. Buffers past the capacity are
+    not visible to the script. Doesn't allocate */
+void referTo (MidiPipeView* view, MidiPipe& pipe, int numFrames) noexcept;
+
+/** Detach the view and its buffer views from the pipe */
+void detach (MidiPipeView* view) noexcept;
+
+/** Opens the el.midi module */
+int openMidiViews (lua_State* L);
+
+}}
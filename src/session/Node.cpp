@@ -773,7 +773,7 @@ void Node::savePluginState()
                 objectData.setProperty (Tags::programState, state.toBase64Encoding(), 0);
             }
 
-            setProperty (Tags::bypass, proc->isSuspended());
+            setProperty (Tags::bypass, obj->isSuspended());
             setProperty (Tags::program, proc->getCurrentProgram());
         }
         else
@@ -805,6 +805,15 @@ void Node::setMuted (bool shouldBeMuted)
         obj->setMuted (isMuted());
 }
 
+void Node::setBypassed (bool shouldBeBypassed)
+{
+    if (shouldBeBypassed != isBypassed())
+        setProperty (Tags::bypass, shouldBeBypassed);
+    if (auto* obj = getGraphNode())
+        if (obj->isSuspended() != isBypassed())
+            obj->suspendProcessing (isBypassed());
+}
+
 void Node::setMuteInput (bool shouldMuteInputs)
 {
     if (shouldMuteInputs != isMutingInputs())
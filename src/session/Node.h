@@ -229,6 +229,9 @@ public:
     /** Returns the Value object for the bypass property */
     Value getBypassedValue()                { return getPropertyAsValue (Tags::bypass); }
 
+    /** Change the bypass status of this Node */
+    void setBypassed (bool);
+
     //=========================================================================    
     /** Returns true if this Node is muted */
     bool isMuted() const                    { return (bool) getProperty (Tags::mute, false); }
@@ -26,6 +26,8 @@
 #include "engine/nodes/MidiMonitorNode.h"
 #include "engine/nodes/MidiProgramMapNode.h"
 #include "engine/nodes/MidiRouterNode.h"
+#include "engine/nodes/NetAudioReceiveNode.h"
+#include "engine/nodes/NetAudioSendNode.h"
 #include "engine/nodes/OSCReceiverNode.h"
 #include "engine/nodes/OSCSenderNode.h"
 #include "DataPath.h"
@@ -769,6 +771,14 @@ GraphNode* PluginManager::createGraphNode (const PluginDescription& desc, String
     {
         return new MidiRouterNode (4, 4);
     }
+    else if (desc.fileOrIdentifier == EL_INTERNAL_ID_NET_AUDIO_SEND)
+    {
+        return new NetAudioSendNode();
+    }
+    else if (desc.fileOrIdentifier == EL_INTERNAL_ID_NET_AUDIO_RECEIVE)
+    {
+        return new NetAudioReceiveNode();
+    }
     else if (desc.fileOrIdentifier == EL_INTERNAL_ID_LUA)
     {
         return new LuaNode();
@@ -0,0 +1,207 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "engine/nodes/LuaNode.h"
+#include "engine/MidiPipe.h"
+#include "scripting/LuaAllocator.h"
+#include "sol/sol.hpp"
+
+namespace Element {
+
+static const String allocatingScript = R"(
+function node_io_ports()
+    return { audio_ins = 2, audio_outs = 2, midi_ins = 0, midi_outs = 0 }
+end
+
+function node_render (a, m)
+    local t = {}
+    for i = 1, 64 do t[i] = { i, tostring (i) } end
+end
+)";
+
+static const String greedyScript = R"(
+function node_io_ports()
+    return { audio_ins = 2, audio_outs = 2, midi_ins = 0, midi_outs = 0 }
+end
+
+hoard = {}
+rendered = 0
+function node_render (a, m)
+    rendered = rendered + 1
+    if rendered > 8 then
+        for i = 1, 1000 do hoard[#hoard + 1] = string.rep ('x', 1000) .. #hoard end
+    end
+end
+)";
+
+class LuaAllocatorTest : public UnitTestBase
+{
+public:
+    LuaAllocatorTest() : UnitTestBase ("Lua Allocator", "Lua", "allocator") { }
+    virtual ~LuaAllocatorTest() { }
+
+    void runTest() override
+    {
+        testHeap();
+        testState();
+        testNode();
+    }
+
+private:
+    enum { blockSize = 512 };
+
+    void testHeap()
+    {
+        beginTest ("heap");
+        LuaAllocator allocator (1 << 20);
+        Random random (4321);
+
+        struct Entry { uint8* data; int size; uint8 value; };
+        Array<Entry> live;
+        bool intact = true;
+
+        for (int i = 0; i < 200000 && intact; ++i)
+        {
+            const int op = random.nextInt (3);
+            if (op == 0 || live.isEmpty())
+            {
+                const int size = 1 + (random.nextInt (4) > 0 ? random.nextInt (200) : random.nextInt (20000));
+                if (auto* data = static_cast<uint8*> (allocator.allocate ((size_t) size)))
+                {
+                    intact = intact && (reinterpret_cast<pointer_sized_uint> (data) & 15) == 0;
+                    const auto value = (uint8) random.nextInt (256);
+                    memset (data, value, (size_t) size);
+                    live.add ({ data, size, value });
+                }
+                continue;
+            }
+
+            const int index = random.nextInt (live.size());
+            auto& entry = live.getReference (index);
+            for (int b = 0; b < entry.size; ++b)
+                intact = intact && entry.data[b] == entry.value;
+
+            if (op == 1)
+            {
+                allocator.deallocate (entry.data);
+                live.remove (index);
+                continue;
+            }
+
+            const int size = 1 + random.nextInt (1000);
+            if (auto* data = static_cast<uint8*> (allocator.reallocate (entry.data, (size_t) size)))
+            {
+                for (int b = 0; b < jmin (size, entry.size); ++b)
+                    intact = intact && data[b] == entry.value;
+                memset (data, entry.value, (size_t) size);
+                entry.data = data;
+                entry.size = size;
+            }
+        }
+
+        expect (intact);
+        expect (allocator.getPeakBytesUsed() > allocator.getBytesUsed());
+        for (const auto& entry : live)
+            allocator.deallocate (entry.data);
+        expect (allocator.getBytesUsed() == 0);
+
+        // freed blocks coalesce back into one
+        auto* whole = allocator.allocate (allocator.getArenaSize() - 64);
+        expect (whole != nullptr && allocator.owns (whole));
+        expect (allocator.allocate (1024) == nullptr);
+        expect (allocator.getStats().numFailed > 0);
+        allocator.deallocate (whole);
+    }
+
+    void testState()
+    {
+        beginTest ("lua state");
+        LuaAllocator allocator (1 << 20);
+        {
+            sol::state lua (sol::default_at_panic, LuaAllocator::alloc, &allocator);
+            lua.open_libraries (sol::lib::base, sol::lib::string);
+            expect (allocator.getBytesUsed() > 0);
+
+            auto result = lua.safe_script (R"(
+                local t = {}
+                for i = 1, 1e7 do t[i] = tostring (i) end
+            )", sol::script_pass_on_error);
+            expect (! result.valid());
+            expect (allocator.getStats().numFailed > 0);
+
+            lua.collect_garbage();
+            result = lua.safe_script ("return 1 + 1", sol::script_pass_on_error);
+            expect (result.valid());
+        }
+        expect (allocator.getBytesUsed() == 0);
+    }
+
+    void testNode()
+    {
+        beginTest ("bounded collection");
+        AudioSampleBuffer audio (2, blockSize);
+        OwnedArray<MidiBuffer> buffers;
+        Array<int> channels;
+        MidiPipe midi (buffers, channels);
+
+        {
+            auto node = std::make_unique<LuaNode>();
+            expect (node->loadScript (allocatingScript).wasOk());
+            node->prepareToRender (44100.0, blockSize);
+            const auto start = node->getMemoryStats();
+
+            for (int i = 0; i < 4000; ++i)
+                node->render (audio, midi);
+
+            const auto stats = node->getMemoryStats();
+            logMessage (String ("used ") + String ((int64) stats.used) + " of "
+                + String ((int64) stats.arenaSize) + ", peak " + String ((int64) stats.peak));
+            expect (stats.peak >= stats.used);
+            expect (stats.used < start.used + 512 * 1024);
+            expect (stats.numFailed == 0);
+            expect (node->getNumRenderErrors() == 0);
+            node->releaseResources();
+        }
+
+        beginTest ("arena exhausted");
+        {
+            auto node = std::make_unique<LuaNode>();
+            expect (node->loadScript (greedyScript).wasOk());
+            node->prepareToRender (44100.0, blockSize);
+
+            for (int i = 0; i < 200; ++i)
+            {
+                for (int c = 0; c < 2; ++c)
+                    FloatVectorOperations::fill (audio.getWritePointer (c), 0.5f, blockSize);
+                node->render (audio, midi);
+            }
+
+            const auto stats = node->getMemoryStats();
+            expect (stats.numFailed > 0);
+            expect (node->getNumRenderErrors() > 0);
+            expect (stats.used <= stats.arenaSize);
+            expect (audio.getMagnitude (0, blockSize) == 0.f);
+            node->releaseResources();
+        }
+    }
+};
+
+static LuaAllocatorTest sLuaAllocatorTest;
+
+}
@@ -0,0 +1,168 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "Tests.h"
+#include "scripting/LuaBytecodeCache.h"
+#include "sol/sol.hpp"
+
+namespace Element {
+
+class LuaBytecodeCacheTest : public UnitTestBase
+{
+public:
+    LuaBytecodeCacheTest() : UnitTestBase ("Lua Bytecode Cache", "Lua", "bytecode") { }
+    virtual ~LuaBytecodeCacheTest() { }
+
+    void initialise() override
+    {
+        directory = File::getSpecialLocation (File::tempDirectory)
+            .getNonexistentChildFile ("LuaBytecodeCacheTest", "");
+        directory.createDirectory();
+    }
+
+    void shutdown() override
+    {
+        directory.deleteRecursively();
+    }
+
+    void runTest() override
+    {
+        testLevels();
+        testInvalidation();
+        testTiming();
+    }
+
+private:
+    File directory;
+
+    /** A script with enough code that compiling it takes a while */
+    static String makeScript (int value)
+    {
+        String script;
+        for (int i = 0; i < 200; ++i)
+            script << "local function f" << i << " (a, b)\n"
+                   << "    local t = { a, b, a * b }\n"
+                   << "    for i = 1, #t do t[i] = t[i] + " << i << " end\n"
+                   << "    return t[1] + t[2] + t[3]\n"
+                   << "end\n";
+        script << "return " << value << "\n";
+        return script;
+    }
+
+    /** Loads and runs a script, returning its result or -1 */
+    int run (LuaBytecodeCache& cache, const String& source)
+    {
+        sol::state lua;
+        lua_State* L = lua.lua_state();
+        if (cache.load (L, source) != LUA_OK || lua_pcall (L, 0, 1, 0) != LUA_OK)
+            return -1;
+        return (int) lua_tointeger (L, -1);
+    }
+
+    void testLevels()
+    {
+        beginTest ("memory and disk");
+        const auto script = makeScript (42);
+        {
+            LuaBytecodeCache cache (directory);
+            expectEquals (run (cache, script), 42);
+            expectEquals (run (cache, script), 42);
+            const auto stats = cache.getStats();
+            expect (stats.compiles == 1 && stats.memoryHits == 1);
+        }
+
+        expectEquals (directory.getNumberOfChildFiles (File::findFiles), 1);
+
+        {
+            LuaBytecodeCache cache (directory);
+            expectEquals (run (cache, script), 42);
+            expect (cache.getStats().diskHits == 1 && cache.getStats().compiles == 0);
+        }
+
+        beginTest ("syntax errors");
+        LuaBytecodeCache cache (directory);
+        sol::state lua;
+        expect (cache.load (lua.lua_state(), "return (") == LUA_ERRSYNTAX);
+        expect (lua_isstring (lua.lua_state(), -1));
+        expectEquals (directory.getNumberOfChildFiles (File::findFiles), 1);
+    }
+
+    void testInvalidation()
+    {
+        beginTest ("changed source");
+        LuaBytecodeCache cache (directory);
+        expectEquals (run (cache, makeScript (1)), 1);
+        expectEquals (run (cache, makeScript (2)), 2);
+        expect (cache.getStats().compiles == 2);
+
+        beginTest ("corrupt file");
+        Array<File> files;
+        directory.findChildFiles (files, File::findFiles, false, "*.luac");
+        expect (files.size() > 0);
+        for (const auto& file : files)
+        {
+            MemoryBlock data;
+            file.loadFileAsData (data);
+            static_cast<char*> (data.getData())[data.getSize() - 10] ^= 0x5a;
+            file.replaceWithData (data.getData(), data.getSize());
+        }
+
+        LuaBytecodeCache fresh (directory);
+        expectEquals (run (fresh, makeScript (1)), 1);
+        expectEquals (run (fresh, makeScript (2)), 2);
+        const auto stats = fresh.getStats();
+        expect (stats.rejected == 2 && stats.compiles == 2 && stats.diskHits == 0);
+    }
+
+    void testTiming()
+    {
+        beginTest ("load time");
+        const auto script = makeScript (7);
+        const int numLoads = 50;
+        LuaBytecodeCache cache (directory);
+        sol::state lua;
+        lua_State* L = lua.lua_state();
+
+        double start = Time::getMillisecondCounterHiRes();
+        for (int i = 0; i < numLoads; ++i)
+        {
+            luaL_loadstring (L, script.toRawUTF8());
+            lua_pop (L, 1);
+        }
+        const double compileMs = (Time::getMillisecondCounterHiRes() - start) / numLoads;
+
+        cache.load (L, script);
+        lua_pop (L, 1);
+        start = Time::getMillisecondCounterHiRes();
+        for (int i = 0; i < numLoads; ++i)
+        {
+            cache.load (L, script);
+            lua_pop (L, 1);
+        }
+        const double cachedMs = (Time::getMillisecondCounterHiRes() - start) / numLoads;
+
+        logMessage (String ("compile ") + String (compileMs, 3) + " ms, cached "
+            + String (cachedMs, 3) + " ms per load");
+        expect (cachedMs < compileMs);
+    }
+};
+
+static LuaBytecodeCacheTest sLuaBytecodeCacheTest;
+
+}
@@ -0,0 +1,187 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "Tests.h"
+#include "scripting/LuaBindings.h"
+#include "sol/sol.hpp"
+
+namespace Element {
+
+class LuaDSPTest : public UnitTestBase
+{
+public:
+    LuaDSPTest() : UnitTestBase ("Lua DSP", "Lua", "dsp") { }
+    virtual ~LuaDSPTest() { }
+
+    void initialise() override
+    {
+        state = std::make_unique<sol::state>();
+        state->open_libraries (sol::lib::base, sol::lib::math);
+        Lua::openDSP (*state);
+    }
+
+    void shutdown() override
+    {
+        state.reset();
+    }
+
+    void runTest() override
+    {
+        testVectors();
+        testFilters();
+        testBenchmark();
+    }
+
+private:
+    std::unique_ptr<sol::state> state;
+    enum { blockSize = 512 };
+
+    void testVectors()
+    {
+        beginTest ("vectors");
+        auto& lua = *state;
+        auto result = lua.safe_script (R"(
+            local audio = require ('el.audio')
+            local dsp = require ('el.dsp')
+            local a = audio.Buffer (2, 8)
+            local b = audio.Buffer (2, 8)
+            for c = 1, 2 do
+                for f = 1, 8 do a:set (c, f, 0.5); b:set (c, f, 0.25) end
+            end
+
+            dsp.add (a, b)
+            assert (a:get (1, 1) == 0.75)
+            dsp.mix (a, b, 1.0)
+            assert (a:get (2, 8) == 0.25)
+            dsp.gain (a, 4, 1)
+            assert (a:get (1, 3) == 1.0 and a:get (2, 3) == 0.25)
+            dsp.multiply (a, b)
+            assert (a:get (1, 1) == 0.25)
+            dsp.gain (a, 4)
+            dsp.clip (a, -0.5, 0.5)
+            assert (a:get (1, 3) == 0.5)
+            assert (dsp.peak (a) == 0.5 and math.abs (dsp.rms (a, 2) - 0.25) < 1e-6)
+
+            local i = audio.Buffer (1, 16)
+            dsp.interleave (i, a)
+            assert (i:get (1, 1) == 0.5 and i:get (1, 2) == 0.25)
+            local d = audio.Buffer (2, 8)
+            dsp.deinterleave (d, i)
+            assert (d:get (1, 8) == 0.5 and d:get (2, 8) == 0.25)
+
+            dsp.ramp (b, 0.0, 1.0)
+            assert (b:get (1, 1) == 0.0 and b:get (2, 5) == 0.125)
+
+            assert (not pcall (dsp.add, a, b, 1, 3))
+            assert (not pcall (dsp.interleave, a, a))
+            assert (not pcall (dsp.clip, a, 1, -1))
+        )", sol::script_pass_on_error);
+        expect (result.valid());
+    }
+
+    void testFilters()
+    {
+        beginTest ("biquad");
+        auto& lua = *state;
+        lua.script (R"(
+            local audio = require ('el.audio')
+            local dsp = require ('el.dsp')
+            filtered = audio.Buffer (1, 1024)
+            lowpass = dsp.Biquad():lowpass (48000, 1000, 0.7)
+            filtered:set (1, 1, 1.0)
+            lowpass:process (filtered)
+
+            function filteredSample (f)
+                return filtered:get (1, f)
+            end
+        )");
+
+        float impulse[1024] = { 1.f };
+        IIRFilter filter;
+        filter.setCoefficients (IIRCoefficients::makeLowPass (48000.0, 1000.0, 0.7));
+        filter.processSamples (impulse, 1024);
+
+        bool same = true;
+        sol::function filteredSample = lua["filteredSample"];
+        for (int i = 0; i < 1024; ++i)
+        {
+            const double value = filteredSample (i + 1);
+            same = same && std::abs (value - impulse[i]) < 1.0e-6;
+        }
+        expect (same);
+
+        beginTest ("one pole");
+        auto result = lua.safe_script (R"(
+            local audio = require ('el.audio')
+            local dsp = require ('el.dsp')
+            local x = audio.Buffer (2, 4096)
+            for f = 1, 4096 do x:set (1, f, 1.0); x:set (2, f, 1.0) end
+            dsp.OnePole():lowpass (48000, 100):process (x, 1)
+            dsp.OnePole():highpass (48000, 100):process (x, 2)
+            assert (x:get (1, 1) < 0.1 and x:get (1, 4096) > 0.99)
+            assert (x:get (2, 1) > 0.9 and x:get (2, 4096) < 0.01)
+        )", sol::script_pass_on_error);
+        expect (result.valid());
+    }
+
+    /** Returns the mean time in microseconds to call fn on a stereo block */
+    double timeBlocks (const char* fn, int numBlocks)
+    {
+        sol::function render = (*state)[fn];
+        sol::object buffer = (*state)["benchBuffer"];
+        const double start = Time::getMillisecondCounterHiRes();
+        for (int i = 0; i < numBlocks; ++i)
+            render (buffer, 0.999);
+        return 1000.0 * (Time::getMillisecondCounterHiRes() - start) / numBlocks;
+    }
+
+    void testBenchmark()
+    {
+        beginTest ("benchmark");
+        auto& lua = *state;
+        lua["benchFrames"] = (int) blockSize;
+        lua.script (R"(
+            local audio = require ('el.audio')
+            local dsp = require ('el.dsp')
+            benchBuffer = audio.Buffer (2, benchFrames)
+
+            function perSampleGain (a, g)
+                for c = 1, a:channels() do
+                    for f = 1, a:length() do
+                        a:set (c, f, a:get (c, f) * g)
+                    end
+                end
+            end
+
+            function vectorGain (a, g)
+                dsp.gain (a, g)
+            end
+        )");
+
+        const double perSample = timeBlocks ("perSampleGain", 500);
+        const double vector    = timeBlocks ("vectorGain", 500);
+        logMessage (String ("stereo ") + String (blockSize) + " frame gain: per sample "
+            + String (perSample, 2) + " us, vectorized " + String (vector, 2) + " us");
+        expect (vector < perSample);
+    }
+};
+
+static LuaDSPTest sLuaDSPTest;
+
+}
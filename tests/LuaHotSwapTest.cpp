@@ -0,0 +1,263 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "Tests.h"
+#include "engine/nodes/LuaNode.h"
+#include "engine/EngineCommandQueue.h"
+#include "engine/GraphProcessor.h"
+#include "engine/MidiPipe.h"
+
+namespace Element {
+
+/** Returns a script that fills its output with a level */
+static String levelScript (const String& level, const String& extra = String())
+{
+    return String (R"(
+node_views = true
+
+function node_io_ports()
+    return { audio_ins = 2, audio_outs = 2, midi_ins = 0, midi_outs = 0 }
+end
+
+level = )") + level + R"(
+
+function fill (a, value)
+    for c = 1, a:channels() do
+        for f = 1, a:length() do a:set (c, f, value) end
+    end
+end
+
+function node_render (a, m)
+    fill (a, level)
+end
+)" + extra;
+}
+
+static const String countingExtra = R"(
+node_state = { count = 0 }
+
+function node_render (a, m)
+    node_state.count = node_state.count + 1
+    fill (a, 0.0)
+end
+)";
+
+static const String migratingExtra = R"(
+function node_migrate (old_state)
+    level = old_state.count
+end
+)";
+
+static const String savingExtra = R"(
+function node_render (a, m)
+    -- allocates while the message thread saves and restores
+    local values = {}
+    for i = 1, 16 do values[i] = level end
+    fill (a, values[16])
+end
+
+function node_save()
+    io.write (tostring (level))
+end
+
+function node_restore()
+    level = tonumber (io.read ("*a")) or level
+end
+)";
+
+class LuaHotSwapTest : public UnitTestBase
+{
+public:
+    LuaHotSwapTest() : UnitTestBase ("Lua Hot Swap", "Lua", "hotswap") { }
+    virtual ~LuaHotSwapTest() { }
+
+    void runTest() override
+    {
+        testCrossfade();
+        testMigrate();
+        testMigrateThroughQueue();
+        testStateWhileRendering();
+    }
+
+private:
+    enum { blockSize = 256 };
+
+    void testCrossfade()
+    {
+        beginTest ("crossfade");
+        AudioSampleBuffer audio (2, blockSize);
+        OwnedArray<MidiBuffer> buffers;
+        Array<int> channels;
+        MidiPipe midi (buffers, channels);
+
+        LuaNode::Ptr node = new LuaNode();
+        expect (node->loadScript (levelScript ("1.0")).wasOk());
+        node->prepareToRender (44100.0, blockSize);
+        node->render (audio, midi);
+        expectEquals (audio.getSample (1, blockSize - 1), 1.f);
+
+        expect (node->loadScript (levelScript ("0.0")).wasOk());
+
+        // 20 ms is 882 frames, so the fade is over after four blocks
+        float last = 1.f, maxStep = 0.f;
+        for (int b = 0; b < 5; ++b)
+        {
+            node->render (audio, midi);
+            for (int f = 0; f < blockSize; ++f)
+            {
+                const float value = audio.getSample (0, f);
+                maxStep = jmax (maxStep, std::abs (value - last));
+                last = value;
+            }
+        }
+
+        expect (maxStep < 0.01f, String (maxStep));
+        expectEquals (audio.getMagnitude (0, blockSize), 0.f);
+        expect (node->getNumRenderErrors() == 0);
+        node->releaseResources();
+    }
+
+    /** Renders blocks like an audio device until stopped */
+    struct RenderThread : public Thread
+    {
+        RenderThread (LuaNode& n) : Thread ("render"), node (n) { }
+        ~RenderThread() { stopThread (1000); }
+
+        void run() override
+        {
+            AudioSampleBuffer audio (2, blockSize);
+            OwnedArray<MidiBuffer> buffers;
+            Array<int> channels;
+            MidiPipe midi (buffers, channels);
+
+            while (! threadShouldExit())
+            {
+                node.render (audio, midi);
+                level.store (audio.getSample (0, blockSize - 1));
+                ++numBlocks;
+                Thread::sleep (1);
+            }
+        }
+
+        LuaNode& node;
+        std::atomic<float> level { -1.f };
+        std::atomic<int> numBlocks { 0 };
+    };
+
+    void testMigrate()
+    {
+        beginTest ("migrate state");
+        LuaNode::Ptr node = new LuaNode();
+        expect (node->loadScript (levelScript ("0.0", countingExtra)).wasOk());
+        node->prepareToRender (44100.0, blockSize);
+
+        RenderThread thread (*node);
+        thread.startThread();
+        while (thread.numBlocks.load() < 20)
+            Thread::sleep (1);
+
+        const int countBefore = thread.numBlocks.load();
+        expect (node->loadScript (levelScript ("-1.0", migratingExtra)).wasOk());
+        while (thread.numBlocks.load() < countBefore + 40)
+            Thread::sleep (1);
+        thread.stopThread (1000);
+
+        // the new script starts from the count the old one reached
+        logMessage (String ("count carried over: ") + String (thread.level.load()));
+        expect (thread.level.load() >= (float) countBefore);
+        expect (node->getNumRenderErrors() == 0);
+        node->releaseResources();
+    }
+
+    void testMigrateThroughQueue()
+    {
+        beginTest ("migrate through the command queue");
+        EngineCommandQueue queue;
+        GraphProcessor graph;
+        graph.setCommandQueue (&queue);
+        queue.setActive (true);
+
+        LuaNode::Ptr node = dynamic_cast<LuaNode*> (graph.addNode (new LuaNode()));
+        expect (node != nullptr);
+        expect (node->loadScript (levelScript ("0.0", countingExtra)).wasOk());
+        node->prepareToRender (44100.0, blockSize);
+
+        AudioSampleBuffer audio (2, blockSize);
+        OwnedArray<MidiBuffer> buffers;
+        Array<int> channels;
+        MidiPipe midi (buffers, channels);
+        auto renderBlock = [&]() {
+            queue.performPending();
+            node->render (audio, midi);
+        };
+
+        for (int i = 0; i < 10; ++i)
+            renderBlock();
+
+        // returns without waiting, the old script keeps rendering until
+        // the copy of its state comes back
+        expect (node->loadScript (levelScript ("-1.0", migratingExtra)).wasOk());
+        expectEquals (queue.getNumPending(), 1);
+        renderBlock();
+        expectEquals (audio.getSample (0, blockSize - 1), 0.f);
+
+        // the count was copied at the start of the eleventh block
+        expectEquals (queue.dispatchCompleted(), 1);
+        for (int i = 0; i < 6; ++i)
+            renderBlock();
+        expectEquals (audio.getSample (0, blockSize - 1), 10.f);
+        expect (node->getNumRenderErrors() == 0);
+
+        node->releaseResources();
+        queue.setActive (false);
+        graph.clear();
+        graph.setCommandQueue (nullptr);
+    }
+
+    void testStateWhileRendering()
+    {
+        beginTest ("state while rendering");
+        LuaNode::Ptr node = new LuaNode();
+        expect (node->loadScript (levelScript ("0.5", savingExtra)).wasOk());
+        node->prepareToRender (44100.0, blockSize);
+
+        RenderThread thread (*node);
+        thread.startThread();
+        for (int i = 0; i < 200; ++i)
+        {
+            MemoryBlock state;
+            node->getState (state);
+            node->setState (state.getData(), (int) state.getSize());
+        }
+
+        const int count = thread.numBlocks.load();
+        while (thread.numBlocks.load() < count + 2)
+            Thread::sleep (1);
+        thread.stopThread (1000);
+
+        expectEquals (thread.level.load(), 0.5f);
+        expect (node->getNumRenderErrors() == 0);
+        expect (node->getMemoryStats().numFailed == 0);
+        node->releaseResources();
+    }
+};
+
+static LuaHotSwapTest sLuaHotSwapTest;
+
+}
@@ -0,0 +1,176 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "Tests.h"
+#include "engine/nodes/LuaNode.h"
+#include "engine/MidiPipe.h"
+#include "scripting/LuaBindings.h"
+#include "sol/sol.hpp"
+
+namespace Element {
+
+static const String gainScript = R"(
+node_views = true
+
+function node_io_ports()
+    return { audio_ins = 2, audio_outs = 2, midi_ins = 1, midi_outs = 1 }
+end
+
+local midi = require ('el.midi')
+
+function node_render (a, m)
+    a:gain (0.5)
+    local b = m:get (1)
+    local notes = 0
+    for i, frame, status, d1, d2 in b:events() do
+        if status & 0xf0 == 0x90 then notes = notes + 1 end
+    end
+    for i = 1, notes do
+        b:insert (a:length() - 1, midi.noteoff (1), 60 + i, 0)
+    end
+end
+)";
+
+static const String staleScript = R"(
+node_views = true
+
+function node_io_ports()
+    return { audio_ins = 2, audio_outs = 2, midi_ins = 0, midi_outs = 0 }
+end
+
+rendered = 0
+function node_render (a, m)
+    rendered = rendered + 1
+    if rendered > 4 then kept:set (1, 1, 1.0) end
+    kept = a
+end
+)";
+
+static const String boundsScript = R"(
+node_views = true
+
+function node_io_ports()
+    return { audio_ins = 2, audio_outs = 2, midi_ins = 0, midi_outs = 0 }
+end
+
+function node_render (a, m)
+    a:set (3, 1, 1.0)
+end
+)";
+
+class LuaViewTest : public UnitTestBase
+{
+public:
+    LuaViewTest() : UnitTestBase ("Lua Views", "Lua", "views") { }
+    virtual ~LuaViewTest() { }
+
+    void runTest() override
+    {
+        testBuffer();
+        testNode();
+        testStale();
+    }
+
+private:
+    enum { blockSize = 512 };
+
+    void testBuffer()
+    {
+        beginTest ("owned buffer");
+        sol::state lua;
+        lua.open_libraries (sol::lib::base);
+        Lua::openDSP (lua);
+
+        auto result = lua.safe_script (R"(
+            local audio = require ('el.audio')
+            local b = audio.Buffer (2, 8)
+            assert (b:channels() == 2 and #b == 8 and not b:isview())
+            b:set (2, 8, 0.5)
+            b:fade (1.0, 0.0)
+            assert (b:get (2, 8) < 0.5 and b:get (1, 1) == 0.0)
+            b:clear (2, 8, 1)
+            assert (b:get (2, 8) == 0.0)
+            assert (not pcall (b.get, b, 3, 1))
+            assert (not pcall (b.get, b, 1, 9))
+            assert (not pcall (b.clear, b, 1, 4, 6))
+        )", sol::script_pass_on_error);
+        expect (result.valid());
+    }
+
+    void testNode()
+    {
+        beginTest ("zero copy render");
+        AudioSampleBuffer audio (2, blockSize);
+        OwnedArray<MidiBuffer> buffers;
+        Array<int> channels;
+        buffers.add (new MidiBuffer());
+        channels.add (0);
+        MidiPipe midi (buffers, channels);
+
+        auto node = std::make_unique<LuaNode>();
+        expect (node->loadScript (gainScript).wasOk());
+        node->prepareToRender (44100.0, blockSize);
+
+        const float* const before = audio.getReadPointer (0);
+        for (int c = 0; c < 2; ++c)
+            FloatVectorOperations::fill (audio.getWritePointer (c), 0.8f, blockSize);
+        buffers[0]->addEvent (MidiMessage::noteOn (1, 60, (uint8) 100), 0);
+        buffers[0]->addEvent (MidiMessage::noteOn (1, 64, (uint8) 100), 10);
+        node->render (audio, midi);
+
+        expect (audio.getReadPointer (0) == before);
+        expectWithinAbsoluteError (audio.getSample (0, 0), 0.4f, 1.0e-6f);
+        expectWithinAbsoluteError (audio.getSample (1, blockSize - 1), 0.4f, 1.0e-6f);
+        expectEquals (buffers[0]->getNumEvents(), 4);
+        expectEquals (buffers[0]->getLastEventTime(), blockSize - 1);
+        expect (node->getNumRenderErrors() == 0);
+
+        beginTest ("out of range");
+        expect (node->loadScript (boundsScript).failed());
+        node->releaseResources();
+    }
+
+    void testStale()
+    {
+        beginTest ("stale view");
+        AudioSampleBuffer audio (2, blockSize);
+        OwnedArray<MidiBuffer> buffers;
+        Array<int> channels;
+        MidiPipe midi (buffers, channels);
+
+        auto node = std::make_unique<LuaNode>();
+        expect (node->loadScript (staleScript).wasOk());
+        node->prepareToRender (44100.0, blockSize);
+
+        for (int i = 0; i < 8; ++i)
+        {
+            audio.clear();
+            node->render (audio, midi);
+        }
+
+        // the kept view has no channels once its call returned
+        expect (node->getNumRenderErrors() == 4);
+        expect (audio.getMagnitude (0, blockSize) == 0.f);
+        node->releaseResources();
+    }
+};
+
+static LuaViewTest sLuaViewTest;
+
+}
@@ -0,0 +1,140 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "Tests.h"
+#include "engine/nodes/LuaNode.h"
+#include "engine/MidiPipe.h"
+
+namespace Element {
+
+// validation renders silence, the loop starts once the test feeds audio
+static const String hangingScript = R"(
+node_views = true
+function node_io_ports()
+    return { audio_ins = 2, audio_outs = 2, midi_ins = 0, midi_outs = 0 }
+end
+
+function node_render (a, m)
+    if a:get (1, 1) > 0 then
+        while true do end
+    end
+end
+)";
+
+static const String catchingScript = R"(
+node_views = true
+function node_io_ports()
+    return { audio_ins = 2, audio_outs = 2, midi_ins = 0, midi_outs = 0 }
+end
+
+function node_render (a, m)
+    if a:get (1, 1) > 0 then
+        while true do
+            pcall (function() while true do end end)
+        end
+    end
+end
+)";
+
+static const String stuckScript = R"(
+node_views = true
+function node_io_ports()
+    return { audio_ins = 2, audio_outs = 2, midi_ins = 0, midi_outs = 0 }
+end
+
+function node_render (a, m)
+    while true do end
+end
+)";
+
+class LuaWatchdogTest : public UnitTestBase
+{
+public:
+    LuaWatchdogTest() : UnitTestBase ("Lua Watchdog", "Lua", "watchdog") { }
+    virtual ~LuaWatchdogTest() { }
+
+    void runTest() override
+    {
+        testDeadline (hangingScript, "infinite loop");
+        testDeadline (catchingScript, "caught deadline");
+        testValidation();
+    }
+
+private:
+    enum { blockSize = 512, numBlocks = 8 };
+    const double sampleRate = 48000.0;
+
+    void testDeadline (const String& script, const String& name)
+    {
+        beginTest (name);
+        AudioSampleBuffer audio (2, blockSize);
+        OwnedArray<MidiBuffer> buffers;
+        Array<int> channels;
+        MidiPipe midi (buffers, channels);
+
+        auto node = std::make_unique<LuaNode>();
+        expect (node->loadScript (script).wasOk());
+        node->setRenderBudget (0.25);
+        node->prepareToRender (sampleRate, blockSize);
+
+        const double budgetMs = 1000.0 * 0.25 * blockSize / sampleRate;
+        double maxMs = 0.0;
+        for (int i = 0; i < numBlocks; ++i)
+        {
+            for (int c = 0; c < 2; ++c)
+                FloatVectorOperations::fill (audio.getWritePointer (c), 0.5f, blockSize);
+            const double start = Time::getMillisecondCounterHiRes();
+            node->render (audio, midi);
+            maxMs = jmax (maxMs, Time::getMillisecondCounterHiRes() - start);
+
+            if (i == 0)
+                expect (node->getRenderStats().overruns == 1, "the first block didn't overrun");
+        }
+
+        logMessage (String ("budget ") + String (budgetMs, 2) + " ms, longest block "
+            + String (maxMs, 2) + " ms");
+        expect (maxMs < budgetMs + 1.0);
+        expect (audio.getMagnitude (0, blockSize) == 0.f);
+
+        const auto stats = node->getRenderStats();
+        expect (stats.overruns >= 3 && stats.overruns < numBlocks);
+        expect (stats.faulted);
+        expect (stats.peakLoad >= 0.25f);
+
+        // a new script clears the fault
+        expect (node->loadScript (node->getScript()).wasOk());
+        expect (! node->getRenderStats().faulted);
+        node->releaseResources();
+    }
+
+    void testValidation()
+    {
+        beginTest ("validation");
+        auto node = std::make_unique<LuaNode>();
+        const double start = Time::getMillisecondCounterHiRes();
+        auto result = node->loadScript (stuckScript);
+        expect (result.failed());
+        expect (result.getErrorMessage().contains ("deadline"));
+        expect (Time::getMillisecondCounterHiRes() - start < 5000.0);
+    }
+};
+
+static LuaWatchdogTest sLuaWatchdogTest;
+
+}
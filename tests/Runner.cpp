@@ -17,6 +17,7 @@
 */
 
 #include "Tests.h"
+#include "scripting/LuaBytecodeCache.h"
 
 static bool copyData()
 {
@@ -78,6 +79,11 @@ public:
         UnitTestRunner runner;
         runner.setAssertOnFailure (true);
 
+        // compiled Lua chunks stay out of the user's data directory
+        const auto luaCache = File::getSpecialLocation (File::tempDirectory)
+            .getNonexistentChildFile ("ElementTestsLuaCache", "");
+        Element::LuaBytecodeCache::setDefaultDirectory (luaCache);
+
         DBG("command line: " << commandLine);
 
     #if JUCE_LINUX
@@ -131,6 +137,9 @@ public:
         Logger::writeToLog ("Test Results");
         String message = "pass: "; message << totalPass << " fail: " << totalFails << newLine;
         Logger::writeToLog (message);
+
+        luaCache.deleteRecursively();
+        Element::LuaBytecodeCache::setDefaultDirectory (File());
         setApplicationReturnValue (totalFails);
         systemRequestedQuit();
     }
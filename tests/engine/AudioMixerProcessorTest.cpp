@@ -0,0 +1,175 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "Tests.h"
+#include "engine/nodes/AudioMixerProcessor.h"
+
+namespace Element {
+
+class AudioMixerProcessorTest : public UnitTestBase
+{
+public:
+    AudioMixerProcessorTest() : UnitTestBase ("Audio Mixer Processor", "engine", "audioMixer") { }
+    virtual ~AudioMixerProcessorTest() { }
+
+    void runTest() override
+    {
+        testMix();
+        testState();
+        testScaling();
+    }
+
+private:
+    enum { blockSize = 256 };
+    const double sampleRate = 48000.0;
+
+    /** Renders a block with every input sample at level */
+    static void renderBlock (AudioMixerProcessor& mixer, AudioSampleBuffer& audio, float level)
+    {
+        for (int c = 0; c < audio.getNumChannels(); ++c)
+            FloatVectorOperations::fill (audio.getWritePointer (c), level, audio.getNumSamples());
+        MidiBuffer midi;
+        mixer.processBlock (audio, midi);
+    }
+
+    static float getLevel (AudioMixerProcessor& mixer, int track, int channel = 0)
+    {
+        return mixer.getMonitor (track)->getLevel (channel);
+    }
+
+    void testMix()
+    {
+        beginTest ("mix");
+        AudioMixerProcessor mixer (4, sampleRate, blockSize);
+        mixer.prepareToPlay (sampleRate, blockSize);
+        AudioSampleBuffer audio (mixer.getTotalNumInputChannels(), blockSize);
+
+        // the master fades in on the first block
+        renderBlock (mixer, audio, 0.5f);
+        expectWithinAbsoluteError (audio.getSample (0, 0), 0.f, 1.0e-5f);
+        renderBlock (mixer, audio, 0.5f);
+        expectWithinAbsoluteError (audio.getSample (0, 0), 2.f, 1.0e-5f);
+        expectWithinAbsoluteError (audio.getSample (1, blockSize - 1), 2.f, 1.0e-5f);
+        expectWithinAbsoluteError (getLevel (mixer, 2), 0.5f, 1.0e-5f);
+        expectWithinAbsoluteError (getLevel (mixer, -1, 1), 2.f, 1.0e-4f);
+
+        beginTest ("gain ramp");
+        mixer.setTrackGain (0, 0.f);
+        expectEquals (mixer.getTrackGain (0), 0.f);
+        renderBlock (mixer, audio, 0.5f);
+        expectWithinAbsoluteError (audio.getSample (0, 0), 2.f, 1.0e-5f);
+        expectWithinAbsoluteError (audio.getSample (0, blockSize / 2), 1.75f, 1.0e-2f);
+        expect (audio.getSample (0, blockSize - 1) < 1.51f);
+        renderBlock (mixer, audio, 0.5f);
+        expectWithinAbsoluteError (audio.getSample (0, 0), 1.5f, 1.0e-5f);
+        expectWithinAbsoluteError (getLevel (mixer, 0), 0.f, 1.0e-6f);
+
+        beginTest ("mute");
+        mixer.setTrackMuted (1, true);
+        expect (mixer.isTrackMuted (1));
+        renderBlock (mixer, audio, 0.5f);
+        renderBlock (mixer, audio, 0.5f);
+        expectWithinAbsoluteError (audio.getSample (0, 0), 1.f, 1.0e-5f);
+        expectWithinAbsoluteError (getLevel (mixer, 1), 0.f, 1.0e-6f);
+        expect (mixer.getMonitor (1)->isMuted());
+
+        mixer.setTrackMuted (1, false);
+        renderBlock (mixer, audio, 0.5f);
+        renderBlock (mixer, audio, 0.5f);
+        expectWithinAbsoluteError (audio.getSample (0, 0), 1.5f, 1.0e-5f);
+    }
+
+    void testState()
+    {
+        beginTest ("state");
+        AudioMixerProcessor mixer (3, sampleRate, blockSize);
+        mixer.setTrackGain (0, 0.25f);
+        mixer.setTrackMuted (2, true);
+        MemoryBlock block;
+        mixer.getStateInformation (block);
+
+        AudioMixerProcessor other (3, sampleRate, blockSize);
+        other.setStateInformation (block.getData(), (int) block.getSize());
+        expectEquals (other.getNumTracks(), 3);
+        expectEquals (other.getTrackGain (0), 0.25f);
+        expect (other.isTrackMuted (2));
+        expect (! other.isTrackMuted (0));
+
+        other.prepareToPlay (sampleRate, blockSize);
+        AudioSampleBuffer audio (other.getTotalNumInputChannels(), blockSize);
+        renderBlock (other, audio, 1.f);
+        renderBlock (other, audio, 1.f);
+        expectWithinAbsoluteError (audio.getSample (0, 0), 1.25f, 1.0e-5f);
+    }
+
+    /** Returns the best time in microseconds to mix a block */
+    double timeBlock (int numTracks)
+    {
+        AudioMixerProcessor mixer (numTracks, sampleRate, blockSize);
+        mixer.prepareToPlay (sampleRate, blockSize);
+        AudioSampleBuffer audio (mixer.getTotalNumInputChannels(), blockSize);
+        Random random (numTracks);
+        MidiBuffer midi;
+        double best = std::numeric_limits<double>::max();
+
+        for (int run = 0; run < 5; ++run)
+        {
+            enum { numBlocks = 200 };
+            double elapsed = 0.0;
+            for (int i = 0; i < numBlocks; ++i)
+            {
+                for (int c = 0; c < audio.getNumChannels(); ++c)
+                    for (int f = 0; f < blockSize; ++f)
+                        audio.setSample (c, f, random.nextFloat() * 2.f - 1.f);
+
+                const double start = Time::getMillisecondCounterHiRes();
+                mixer.processBlock (audio, midi);
+                elapsed += Time::getMillisecondCounterHiRes() - start;
+            }
+
+            best = jmin (best, 1000.0 * elapsed / numBlocks);
+        }
+
+        return best;
+    }
+
+    void testScaling()
+    {
+        beginTest ("scaling");
+        expectEquals (AudioMixerProcessor (1000).getNumTracks(), (int) AudioMixerProcessor::maxTracks);
+
+        double perTrack8 = 0.0;
+        for (const int numTracks : { 8, 16, 32, 64, 128 })
+        {
+            const double us = timeBlock (numTracks);
+            const double perTrack = us / numTracks;
+            logMessage (String (numTracks) + " tracks: " + String (us, 2) + " us per block, "
+                + String (perTrack, 3) + " us per track");
+
+            if (numTracks == 8)
+                perTrack8 = perTrack;
+            else if (numTracks == 64)
+                expect (perTrack < 2.0 * perTrack8, "mixing does not scale linearly");
+        }
+    }
+};
+
+static AudioMixerProcessorTest sAudioMixerProcessorTest;
+
+}
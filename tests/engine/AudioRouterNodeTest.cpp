@@ -0,0 +1,182 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "Tests.h"
+#include "engine/nodes/AudioRouterNode.h"
+
+namespace Element {
+
+class AudioRouterNodeTest : public UnitTestBase
+{
+public:
+    AudioRouterNodeTest() : UnitTestBase ("Audio Router Node", "engine", "audioRouter") { }
+    virtual ~AudioRouterNodeTest() { }
+
+    void runTest() override
+    {
+        testRouting();
+        testProgramChange();
+        testCost (16);
+        testCost (32);
+    }
+
+private:
+    enum { blockSize = 256, fadeFrames = 48 };
+    const double sampleRate = 48000.0;
+
+    /** Renders a block with each input channel at its channel number + 1 */
+    static void renderBlock (AudioRouterNode& node, AudioSampleBuffer& audio, const MidiBuffer& events = MidiBuffer())
+    {
+        for (int c = 0; c < audio.getNumChannels(); ++c)
+            FloatVectorOperations::fill (audio.getWritePointer (c), (float) (c + 1), audio.getNumSamples());
+
+        OwnedArray<MidiBuffer> buffers;
+        Array<int> channels;
+        buffers.add (new MidiBuffer (events));
+        channels.add (0);
+        MidiPipe midi (buffers, channels);
+        node.render (audio, midi);
+    }
+
+    static AudioRouterNode* createNode (int size, double sampleRate)
+    {
+        auto* node = new AudioRouterNode (size, size);
+        node->setFadeLength (fadeFrames / sampleRate);
+        node->prepareToRender (sampleRate, blockSize);
+        return node;
+    }
+
+    void testRouting()
+    {
+        beginTest ("routing");
+        GraphNodePtr ptr = createNode (4, sampleRate);
+        auto& node = *dynamic_cast<AudioRouterNode*> (ptr.get());
+        AudioSampleBuffer audio (4, blockSize);
+
+        // patches fade in from silence
+        renderBlock (node, audio);
+        expectEquals (audio.getSample (0, 0), 0.f);
+        expectWithinAbsoluteError (audio.getSample (1, fadeFrames), 2.f, 1.0e-5f);
+        expectEquals (audio.getSample (3, blockSize - 1), 4.f);
+
+        MatrixState matrix (4, 4);
+        matrix.set (0, 1, true);
+        matrix.set (2, 1, true);
+        node.setMatrixState (matrix);
+        renderBlock (node, audio);
+        renderBlock (node, audio);
+        expectEquals (audio.getSample (0, 10), 0.f);
+        expectEquals (audio.getSample (1, 10), 4.f);
+        expectEquals (audio.getSample (2, 10), 0.f);
+        expectEquals (audio.getSample (3, 10), 0.f);
+
+        // single patches go through the same path and fade too
+        node.setWithoutLocking (3, 0, true);
+        expect (node.getMatrixState().connected (3, 0));
+        renderBlock (node, audio);
+        expectEquals (audio.getSample (0, 0), 0.f);
+        renderBlock (node, audio);
+        expectEquals (audio.getSample (0, 10), 4.f);
+        expectEquals (audio.getSample (1, 10), 4.f);
+    }
+
+    void testProgramChange()
+    {
+        beginTest ("program change");
+        GraphNodePtr ptr = createNode (4, sampleRate);
+        auto& node = *dynamic_cast<AudioRouterNode*> (ptr.get());
+        AudioSampleBuffer audio (4, blockSize);
+        renderBlock (node, audio);
+
+        MatrixState swapped (4, 4);
+        swapped.set (0, 1, true);
+        swapped.set (1, 0, true);
+        node.addProgram ("Swapped", swapped, 100);
+
+        // "Inverse Stereo" is program 2, so MIDI program 1
+        const int frame = 100;
+        MidiBuffer events;
+        events.addEvent (MidiMessage::programChange (1, 1), frame);
+        renderBlock (node, audio, events);
+        expectEquals (audio.getSample (0, frame - 1), 1.f);
+        expectEquals (audio.getSample (0, frame), 1.f);
+        expect (audio.getSample (0, frame + 1) > 1.f);
+        expectWithinAbsoluteError (audio.getSample (0, frame + fadeFrames), 2.f, 1.0e-5f);
+        expectEquals (audio.getSample (2, blockSize - 1), 4.f);
+
+        events.clear();
+        events.addEvent (MidiMessage::programChange (1, 100), 0);
+        renderBlock (node, audio, events);
+        renderBlock (node, audio);
+        expectEquals (audio.getSample (0, 0), 2.f);
+        expectEquals (audio.getSample (1, 0), 1.f);
+        expectEquals (audio.getSample (2, 0), 0.f);
+    }
+
+    void testCost (const int size)
+    {
+        beginTest (String (size) + "x" + String (size) + " cost");
+        GraphNodePtr ptr = createNode (size, sampleRate);
+        auto& node = *dynamic_cast<AudioRouterNode*> (ptr.get());
+
+        // each output mixes four inputs
+        MatrixState matrix (size, size);
+        for (int o = 0; o < size; ++o)
+            for (int i = 0; i < 4; ++i)
+                matrix.set ((o + i * 3) % size, o, true);
+        node.setMatrixState (matrix);
+
+        AudioSampleBuffer audio (size, blockSize), temp (size, blockSize);
+        OwnedArray<MidiBuffer> buffers;
+        Array<int> channels;
+        buffers.add (new MidiBuffer());
+        channels.add (0);
+        MidiPipe midi (buffers, channels);
+        node.render (audio, midi);
+
+        const int numBlocks = 2000;
+        double start = Time::getMillisecondCounterHiRes();
+        for (int b = 0; b < numBlocks; ++b)
+            node.render (audio, midi);
+        const double routerUs = 1000.0 * (Time::getMillisecondCounterHiRes() - start) / numBlocks;
+
+        // the same mix written out by hand
+        start = Time::getMillisecondCounterHiRes();
+        for (int b = 0; b < numBlocks; ++b)
+        {
+            for (int o = 0; o < size; ++o)
+            {
+                temp.copyFrom (o, 0, audio, o, 0, blockSize);
+                for (int i = 1; i < 4; ++i)
+                    temp.addFrom (o, 0, audio, (o + i * 3) % size, 0, blockSize);
+            }
+            for (int c = 0; c < size; ++c)
+                audio.copyFrom (c, 0, temp, c, 0, blockSize);
+        }
+        const double plainUs = 1000.0 * (Time::getMillisecondCounterHiRes() - start) / numBlocks;
+
+        logMessage (String ("router ") + String (routerUs, 2) + " us, plain mix "
+            + String (plainUs, 2) + " us per block");
+        expect (routerUs < plainUs * 2.0 + 2.0);
+    }
+};
+
+static AudioRouterNodeTest sAudioRouterNodeTest;
+
+}
@@ -0,0 +1,273 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "Tests.h"
+#include "engine/nodes/CompressorProcessor.h"
+
+namespace Element {
+
+/** The compressor as it was rendered sample by sample, to null against */
+class ReferenceCompressor
+{
+public:
+    ReferenceCompressor() { makeupGain.reset (200); }
+
+    void prepare (double sampleRate)
+    {
+        detector.reset ((float) sampleRate);
+        sideDetector.reset ((float) sampleRate);
+        gainComputer.reset();
+    }
+
+    /** Renders with the parameters of a compressor */
+    void process (AudioSampleBuffer& buffer, CompressorProcessor& comp)
+    {
+        float values[7];
+        for (int i = 0; i < 7; ++i)
+            values[i] = dynamic_cast<AudioParameterFloat*> (comp.getParameters()[i])->get();
+        process (buffer, values[0], values[1], values[2], values[3], values[4], values[5], values[6]);
+    }
+
+    void process (AudioSampleBuffer& buffer, float threshDB, float ratio, float kneeDB,
+                  float attackMs, float releaseMs, float makeupDB, float sideChain)
+    {
+        for (auto* d : { &detector, &sideDetector })
+        {
+            d->setAttackMs (attackMs);
+            d->setReleaseMs (releaseMs);
+        }
+        gainComputer.setThreshold (threshDB);
+        gainComputer.setRatio (ratio);
+        gainComputer.setKnee (kneeDB);
+        makeupGain.setTargetValue (Decibels::decibelsToGain (makeupDB));
+
+        for (int n = 0; n < buffer.getNumSamples(); ++n)
+        {
+            const float mainInput = (0.0f + buffer.getSample (0, n) + buffer.getSample (1, n)) / 2.0f;
+            const float sideInput = (0.0f + buffer.getSample (2, n) + buffer.getSample (3, n)) / 2.0f;
+            const float level = detector.process (mainInput) * (1.0f - sideChain)
+                              + sideDetector.process (sideInput) * sideChain;
+            const float gain = gainComputer.process (level) * makeupGain.getNextValue();
+            buffer.setSample (0, n, buffer.getSample (0, n) * gain);
+            buffer.setSample (1, n, buffer.getSample (1, n) * gain);
+        }
+    }
+
+private:
+    LevelDetector detector, sideDetector;
+    GainComputer gainComputer;
+    SmoothedValue<float, ValueSmoothingTypes::Multiplicative> makeupGain = 1.0f;
+};
+
+class CompressorProcessorTest : public UnitTestBase
+{
+public:
+    CompressorProcessorTest() : UnitTestBase ("Compressor Processor", "engine", "compressor") { }
+    virtual ~CompressorProcessorTest() { }
+
+    void runTest() override
+    {
+        testNull();
+        testSideChainAutomation();
+        testStereoLink();
+        testBenchmark (64);
+        testBenchmark (1024);
+    }
+
+private:
+    const double sampleRate = 48000.0;
+    enum { threshParam, ratioParam, kneeParam, attackParam, releaseParam, makeupParam, sideChainParam, linkParam };
+
+    static void setParameter (CompressorProcessor& comp, int index, float value)
+    {
+        auto* param = comp.getParameters()[index];
+        if (auto* f = dynamic_cast<AudioParameterFloat*> (param))
+            *f = value;
+        else if (auto* c = dynamic_cast<AudioParameterChoice*> (param))
+            *c = roundToInt (value);
+    }
+
+    static void setup (CompressorProcessor& comp)
+    {
+        setParameter (comp, threshParam, -20.f);
+        setParameter (comp, ratioParam, 4.f);
+        setParameter (comp, kneeParam, 6.f);
+        setParameter (comp, makeupParam, 3.f);
+        setParameter (comp, sideChainParam, 0.25f);
+    }
+
+    /** Fills the main and sidechain with noise bursts that cross the threshold */
+    static void fillInput (Random& random, AudioSampleBuffer& buffer, int block)
+    {
+        const float level = block % 8 < 4 ? 0.05f : 0.9f;
+        for (int c = 0; c < buffer.getNumChannels(); ++c)
+            for (int n = 0; n < buffer.getNumSamples(); ++n)
+                buffer.setSample (c, n, level * (random.nextFloat() * 2.f - 1.f));
+    }
+
+    void testNull()
+    {
+        beginTest ("null");
+        CompressorProcessor comp;
+        setup (comp);
+        comp.prepareToPlay (sampleRate, 512);
+        ReferenceCompressor reference;
+        reference.prepare (sampleRate);
+
+        Random random (1);
+        AudioSampleBuffer audio (4, 512), expected (4, 512);
+        MidiBuffer midi;
+        float error = 0.f;
+        float reduction = 0.f;
+
+        for (int b = 0; b < 64; ++b)
+        {
+            // uneven sizes cross the chunk boundaries
+            const int numSamples = b % 3 == 0 ? 512 : 100 + b;
+            audio.setSize (4, numSamples, false, false, true);
+            expected.setSize (4, numSamples, false, false, true);
+            fillInput (random, audio, b);
+            expected.makeCopyOf (audio);
+
+            comp.processBlock (audio, midi);
+            reference.process (expected, comp);
+            reduction = jmax (reduction, comp.getGainReductionDB());
+
+            for (int c = 0; c < 2; ++c)
+                for (int n = 0; n < numSamples; ++n)
+                    error = jmax (error, std::abs (audio.getSample (c, n) - expected.getSample (c, n)));
+        }
+
+        expect (error < 1.0e-5f, String ("differs from the per sample compressor by ") + String (error));
+
+        beginTest ("telemetry");
+        expect (reduction > 3.f);
+        expect (comp.getInputLevelDB() > -30.f && comp.getInputLevelDB() < 0.f);
+    }
+
+    void testSideChainAutomation()
+    {
+        beginTest ("sidechain automation");
+        CompressorProcessor comp;
+        setup (comp);
+        setParameter (comp, sideChainParam, 0.f);
+        comp.prepareToPlay (sampleRate, 512);
+        ReferenceCompressor reference;
+        reference.prepare (sampleRate);
+
+        Random random (3);
+        AudioSampleBuffer audio (4, 512), expected (4, 512);
+        MidiBuffer midi;
+        float error = 0.f;
+
+        for (int b = 0; b < 32; ++b)
+        {
+            // brought in halfway through a loud burst on the sidechain
+            if (b == 13)
+                setParameter (comp, sideChainParam, 0.5f);
+
+            fillInput (random, audio, b);
+            FloatVectorOperations::multiply (audio.getWritePointer (0), 0.1f, 512);
+            FloatVectorOperations::multiply (audio.getWritePointer (1), 0.1f, 512);
+            expected.makeCopyOf (audio);
+
+            comp.processBlock (audio, midi);
+            reference.process (expected, comp);
+
+            for (int c = 0; c < 2; ++c)
+                for (int n = 0; n < 512; ++n)
+                    error = jmax (error, std::abs (audio.getSample (c, n) - expected.getSample (c, n)));
+        }
+
+        expect (error < 1.0e-5f, String ("differs from the per sample compressor by ") + String (error));
+    }
+
+    void testStereoLink()
+    {
+        beginTest ("stereo link");
+        CompressorProcessor summed, linked;
+        for (auto* comp : { &summed, &linked })
+        {
+            setup (*comp);
+            setParameter (*comp, sideChainParam, 0.f);
+            comp->prepareToPlay (sampleRate, 512);
+        }
+        setParameter (linked, linkParam, 1.f);
+
+        // the channels cancel when summed, so only the linked detector sees them
+        AudioSampleBuffer a (4, 512), b (4, 512);
+        MidiBuffer midi;
+        for (int block = 0; block < 32; ++block)
+        {
+            for (auto* buffer : { &a, &b })
+            {
+                buffer->clear();
+                for (int n = 0; n < 512; ++n)
+                {
+                    const float x = 0.8f * (float) std::sin (n * 0.05);
+                    buffer->setSample (0, n, x);
+                    buffer->setSample (1, n, -x);
+                }
+            }
+
+            summed.processBlock (a, midi);
+            linked.processBlock (b, midi);
+        }
+
+        expectWithinAbsoluteError (summed.getGainReductionDB(), 0.f, 1.0e-4f);
+        expect (linked.getGainReductionDB() > 6.f);
+        expectEquals (b.getSample (0, 100), -b.getSample (1, 100));
+    }
+
+    void testBenchmark (int blockSize)
+    {
+        beginTest (String ("benchmark ") + String (blockSize));
+        CompressorProcessor comp;
+        setup (comp);
+        comp.prepareToPlay (sampleRate, blockSize);
+        ReferenceCompressor reference;
+        reference.prepare (sampleRate);
+
+        Random random (2);
+        AudioSampleBuffer audio (4, blockSize);
+        MidiBuffer midi;
+        const int numBlocks = (int) (sampleRate * 2.0) / blockSize;
+        double oldMs = 0.0, newMs = 0.0;
+
+        for (int b = 0; b < numBlocks; ++b)
+        {
+            fillInput (random, audio, b);
+            double start = Time::getMillisecondCounterHiRes();
+            reference.process (audio, comp);
+            oldMs += Time::getMillisecondCounterHiRes() - start;
+
+            fillInput (random, audio, b);
+            start = Time::getMillisecondCounterHiRes();
+            comp.processBlock (audio, midi);
+            newMs += Time::getMillisecondCounterHiRes() - start;
+        }
+
+        logMessage (String (blockSize) + " frames: per sample " + String (1000.0 * oldMs / numBlocks, 2)
+            + " us per block, block wise " + String (1000.0 * newMs / numBlocks, 2) + " us per block");
+    }
+};
+
+static CompressorProcessorTest sCompressorProcessorTest;
+
+}
@@ -0,0 +1,136 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "engine/ControllerMapTable.h"
+
+namespace Element {
+
+class ControllerMapTableTest : public UnitTestBase
+{
+public:
+    ControllerMapTableTest() : UnitTestBase ("Controller Map Table", "engine", "controllerMapTable") { }
+    virtual ~ControllerMapTableTest() { }
+
+    void runTest() override
+    {
+        testLookup();
+        testStress();
+    }
+
+private:
+    struct CountingHandler : public ControllerMapHandler
+    {
+        CountingHandler (MessageType t, int ch, int n)
+            : ControllerMapHandler (t, n), channel (ch) { }
+
+        bool wants (const MidiMessage& message) const override
+        {
+            if (channel != 0 && message.getChannel() != channel)
+                return false;
+            return messageType == Controller
+                ? message.isController() && message.getControllerNumber() == number
+                : message.isNoteOnOrOff() && message.getNoteNumber() == number;
+        }
+
+        void perform (const MidiMessage&) override { ++count; }
+        int getChannel() const override { return channel; }
+
+        const int channel;
+        int count = 0;
+    };
+
+    void testLookup()
+    {
+        beginTest ("lookup");
+        OwnedArray<CountingHandler> handlers;
+        auto* cc7  = handlers.add (new CountingHandler (ControllerMapHandler::Controller, 1, 7));
+        auto* omni = handlers.add (new CountingHandler (ControllerMapHandler::Controller, 0, 7));
+        auto* note = handlers.add (new CountingHandler (ControllerMapHandler::Note, 10, 36));
+
+        Array<ControllerMapHandler*> toIndex;
+        for (auto* h : handlers)
+            toIndex.add (h);
+        ControllerMapTable table (toIndex);
+        expectEquals (table.getNumEntries(), 1 + 16 + 1);
+
+        expectEquals (table.dispatch (MidiMessage::controllerEvent (1, 7, 100)), 2);
+        expectEquals (table.dispatch (MidiMessage::controllerEvent (2, 7, 100)), 1);
+        expectEquals (table.dispatch (MidiMessage::controllerEvent (1, 8, 100)), 0);
+        expectEquals (table.dispatch (MidiMessage::noteOn (10, 36, 1.f)), 1);
+        expectEquals (table.dispatch (MidiMessage::noteOff (10, 36)), 1);
+        expectEquals (table.dispatch (MidiMessage::noteOn (9, 36, 1.f)), 0);
+        expectEquals (table.dispatch (MidiMessage::pitchWheel (1, 100)), 0);
+
+        expectEquals (cc7->count, 1);
+        expectEquals (omni->count, 2);
+        expectEquals (note->count, 2);
+    }
+
+    void testStress()
+    {
+        beginTest ("10,000 mappings");
+        Random random (1234);
+        OwnedArray<CountingHandler> handlers;
+        Array<ControllerMapHandler*> toIndex;
+        for (int i = 0; i < 10000; ++i)
+        {
+            const auto type = random.nextBool() ? ControllerMapHandler::Controller : ControllerMapHandler::Note;
+            const int channel = random.nextInt (100) < 5 ? 0 : 1 + random.nextInt (16);
+            toIndex.add (handlers.add (new CountingHandler (type, channel, random.nextInt (128))));
+        }
+
+        const double buildStart = Time::getMillisecondCounterHiRes();
+        ControllerMapTable table (toIndex);
+        const double buildMs = Time::getMillisecondCounterHiRes() - buildStart;
+
+        Array<MidiMessage> messages;
+        for (int i = 0; i < 4096; ++i)
+        {
+            const int channel = 1 + random.nextInt (16);
+            messages.add (random.nextBool()
+                ? MidiMessage::controllerEvent (channel, random.nextInt (128), random.nextInt (128))
+                : MidiMessage::noteOn (channel, random.nextInt (128), 1.f));
+        }
+
+        // results must match a linear walk of every handler
+        int expectedTotal = 0, actualTotal = 0;
+        for (const auto& message : messages)
+        {
+            for (auto* h : handlers)
+                if (h->wants (message))
+                    ++expectedTotal;
+            actualTotal += table.dispatch (message);
+        }
+        expectEquals (actualTotal, expectedTotal);
+
+        const int numMessages = 1000000;
+        const double start = Time::getMillisecondCounterHiRes();
+        for (int i = 0; i < numMessages; ++i)
+            table.dispatch (messages.getReference (i % messages.size()));
+        const double elapsedMs = jmax (0.001, Time::getMillisecondCounterHiRes() - start);
+
+        logMessage (String ("table built in ") + String (buildMs, 2) + " ms, "
+            + String (numMessages / elapsedMs * 1000.0, 0) + " messages per second");
+        expect (elapsedMs < 10000.0);
+    }
+};
+
+static ControllerMapTableTest sControllerMapTableTest;
+
+}
@@ -0,0 +1,213 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "Tests.h"
+#include "engine/nodes/EQFilterProcessor.h"
+#include "engine/nodes/FreqSplitterProcessor.h"
+
+namespace Element {
+
+class EQFilterTest : public UnitTestBase
+{
+public:
+    EQFilterTest() : UnitTestBase ("EQ Filter", "engine", "eqFilter") { }
+    virtual ~EQFilterTest() { }
+
+    void runTest() override
+    {
+        testNull();
+        testStereo();
+        testSplitter();
+    }
+
+private:
+    enum { blockSize = 256, numBlocks = 200 };
+    const double sampleRate = 48000.0;
+
+    static void setup (EQFilter& filter, EQFilter::Shape shape, float freq, float q, float gain, double sampleRate)
+    {
+        filter.setFrequency (freq);
+        filter.setQ (q);
+        filter.setGain (gain);
+        filter.setShape (shape);
+        filter.reset (sampleRate);
+    }
+
+    static void fillNoise (Random& random, float* data, int numSamples)
+    {
+        for (int i = 0; i < numSamples; ++i)
+            data[i] = random.nextFloat() * 2.f - 1.f;
+    }
+
+    /** Returns the largest difference to a filter calculating coefficients on
+        every sample, as the filter always did before interpolating */
+    float renderAgainstReference (EQFilter::Shape shape, bool sweep)
+    {
+        EQFilter reference, filter;
+        reference.setCoefficientInterval (1);
+        setup (reference, shape, 1000.f, 0.707f, 2.f, sampleRate);
+        setup (filter, shape, 1000.f, 0.707f, 2.f, sampleRate);
+
+        Random random (1);
+        AudioSampleBuffer expected (1, blockSize), actual (1, blockSize);
+        float error = 0.f;
+
+        for (int b = 0; b < numBlocks; ++b)
+        {
+            if (sweep && b % 20 == 5)
+            {
+                const float freq = 200.f + (float) (b * 37 % 50) * 300.f;
+                const float q = 0.5f + (float) (b % 5) * 0.5f;
+                const float gain = 0.5f + (float) (b % 7) * 0.3f;
+                for (auto* f : { &reference, &filter })
+                {
+                    f->setFrequency (freq);
+                    f->setQ (q);
+                    f->setGain (gain);
+                }
+            }
+
+            fillNoise (random, expected.getWritePointer (0), blockSize);
+            actual.copyFrom (0, 0, expected, 0, 0, blockSize);
+            reference.processBlock (expected.getWritePointer (0), blockSize);
+            filter.processBlock (actual.getWritePointer (0), blockSize);
+
+            for (int i = 0; i < blockSize; ++i)
+                error = jmax (error, std::abs (expected.getSample (0, i) - actual.getSample (0, i)));
+        }
+
+        return error;
+    }
+
+    void testNull()
+    {
+        beginTest ("null");
+        for (int shape = EQFilter::Bell; shape <= EQFilter::LowPass; ++shape)
+        {
+            expectEquals (renderAgainstReference ((EQFilter::Shape) shape, false), 0.f);
+            const float error = renderAgainstReference ((EQFilter::Shape) shape, true);
+            logMessage (String ("shape ") + String (shape) + " smoothing error: "
+                + String (Decibels::gainToDecibels (error), 1) + " dB");
+            expect (error < 0.05f);
+        }
+    }
+
+    void testStereo()
+    {
+        beginTest ("stereo");
+        EQFilter left, right, stereo;
+        for (auto* f : { &left, &right, &stereo })
+            setup (*f, EQFilter::HighShelf, 3000.f, 1.f, 0.5f, sampleRate);
+
+        Random random (2);
+        AudioSampleBuffer mono (2, blockSize), pair (2, blockSize);
+        bool same = true;
+
+        for (int b = 0; b < numBlocks; ++b)
+        {
+            if (b == 10)
+                for (auto* f : { &left, &right, &stereo })
+                    f->setFrequency (500.f);
+
+            fillNoise (random, mono.getWritePointer (0), blockSize);
+            fillNoise (random, mono.getWritePointer (1), blockSize);
+            pair.makeCopyOf (mono);
+            left.processBlock (mono.getWritePointer (0), blockSize);
+            right.processBlock (mono.getWritePointer (1), blockSize);
+            stereo.processBlock (pair.getWritePointer (0), pair.getWritePointer (1), blockSize);
+
+            for (int c = 0; c < 2; ++c)
+                for (int i = 0; i < blockSize; ++i)
+                    same &= mono.getSample (c, i) == pair.getSample (c, i);
+        }
+
+        expect (same, "channels filtered together differ from filtering them one by one");
+    }
+
+    void testSplitter()
+    {
+        beginTest ("splitter");
+        FreqSplitterProcessor splitter (2);
+        splitter.prepareToPlay (sampleRate, blockSize);
+        auto* lowFreq = dynamic_cast<AudioParameterFloat*> (splitter.getParameters()[0]);
+        auto* highFreq = dynamic_cast<AudioParameterFloat*> (splitter.getParameters()[1]);
+        expect (lowFreq != nullptr && highFreq != nullptr);
+        if (lowFreq == nullptr || highFreq == nullptr)
+            return;
+
+        // the bands as they were rendered before, one filter after another
+        EQFilter lowLPF[2], lowHPF[2], highLPF[2], highHPF[2];
+        for (int c = 0; c < 2; ++c)
+        {
+            for (auto* f : { &lowLPF[c], &lowHPF[c], &highLPF[c], &highHPF[c] })
+                f->setCoefficientInterval (1);
+            setup (lowLPF[c],  EQFilter::LowPass,  *lowFreq,  0.7071f, 1.f, sampleRate);
+            setup (lowHPF[c],  EQFilter::HighPass, *lowFreq,  0.7071f, 1.f, sampleRate);
+            setup (highLPF[c], EQFilter::LowPass,  *highFreq, 0.7071f, 1.f, sampleRate);
+            setup (highHPF[c], EQFilter::HighPass, *highFreq, 0.7071f, 1.f, sampleRate);
+        }
+
+        Random random (3);
+        AudioSampleBuffer audio (6, blockSize), expected (6, blockSize);
+        float staticError = 0.f, sweepError = 0.f;
+
+        for (int b = 0; b < numBlocks; ++b)
+        {
+            const bool sweeping = b >= numBlocks / 2;
+            if (b == numBlocks / 2)
+                *lowFreq = 800.f;
+
+            audio.clear();
+            fillNoise (random, audio.getWritePointer (0), blockSize);
+            fillNoise (random, audio.getWritePointer (1), blockSize);
+
+            for (int c = 0; c < 2; ++c)
+            {
+                for (int band = 0; band < 3; ++band)
+                    expected.copyFrom (band * 2 + c, 0, audio, c, 0, blockSize);
+                lowLPF[c].setFrequency (*lowFreq);
+                lowHPF[c].setFrequency (*lowFreq);
+                lowLPF[c].processBlock (expected.getWritePointer (c), blockSize);
+                lowHPF[c].processBlock (expected.getWritePointer (2 + c), blockSize);
+                highLPF[c].processBlock (expected.getWritePointer (2 + c), blockSize);
+                highHPF[c].processBlock (expected.getWritePointer (4 + c), blockSize);
+            }
+
+            MidiBuffer midi;
+            splitter.processBlock (audio, midi);
+
+            for (int c = 0; c < 6; ++c)
+            {
+                for (int i = 0; i < blockSize; ++i)
+                {
+                    auto& error = sweeping ? sweepError : staticError;
+                    error = jmax (error, std::abs (audio.getSample (c, i) - expected.getSample (c, i)));
+                }
+            }
+        }
+
+        expectEquals (staticError, 0.f);
+        logMessage (String ("splitter smoothing error: ") + String (Decibels::gainToDecibels (sweepError), 1) + " dB");
+        expect (sweepError < 0.05f);
+    }
+};
+
+static EQFilterTest sEQFilterTest;
+
+}
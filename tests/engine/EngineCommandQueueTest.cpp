@@ -0,0 +1,158 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "engine/EngineCommandQueue.h"
+
+namespace Element {
+
+class EngineCommandQueueTest : public UnitTestBase
+{
+public:
+    EngineCommandQueueTest() : UnitTestBase ("Engine Command Queue", "engine", "commandQueue") { }
+    virtual ~EngineCommandQueueTest() { }
+
+    void runTest() override
+    {
+        testInactive();
+        testActive();
+        testOverflow();
+        testPostFromCompleted();
+    }
+
+private:
+    struct Counter
+    {
+        int performed = 0;
+        int completed = 0;
+        int lastValue = -1;
+        int alive = 0;
+    };
+
+    struct CountCommand : public EngineCommand
+    {
+        CountCommand (Counter& c, int v) : counter (c), value (v) { ++counter.alive; }
+        ~CountCommand()             { --counter.alive; }
+        void perform() override     { ++counter.performed; counter.lastValue = value; }
+        void completed() override   { ++counter.completed; }
+        Counter& counter;
+        const int value;
+    };
+
+    void testInactive()
+    {
+        beginTest ("inactive queue performs immediately");
+        Counter counter;
+        EngineCommandQueue queue (8);
+        expect (! queue.isActive());
+        expect (queue.post (new CountCommand (counter, 1)));
+        expect (counter.performed == 1 && counter.completed == 1);
+        expect (queue.getNumPending() == 0);
+
+        beginTest ("null queue performs immediately");
+        expect (EngineCommandQueue::post (nullptr, new CountCommand (counter, 2)));
+        expect (counter.performed == 2 && counter.completed == 2);
+        expect (counter.lastValue == 2);
+    }
+
+    void testActive()
+    {
+        beginTest ("active queue defers to performPending");
+        Counter counter;
+        EngineCommandQueue queue (8);
+        queue.setActive (true);
+
+        for (int i = 0; i < 5; ++i)
+            expect (queue.post (new CountCommand (counter, i)));
+        expect (counter.performed == 0);
+        expect (queue.getNumPending() == 5);
+
+        expectEquals (queue.performPending(), 5);
+        expect (counter.performed == 5 && counter.completed == 0);
+        expect (counter.lastValue == 4); // performed in order
+
+        expectEquals (queue.dispatchCompleted(), 5);
+        expect (counter.completed == 5);
+
+        beginTest ("deactivating flushes pending commands");
+        queue.post (new CountCommand (counter, 10));
+        queue.setActive (false);
+        expect (counter.performed == 6);
+        queue.dispatchCompleted();
+        expect (counter.completed == 6);
+    }
+
+    void testOverflow()
+    {
+        beginTest ("overflow");
+        Counter counter;
+
+        {
+            EngineCommandQueue queue (4);
+            queue.setActive (true);
+            int numPosted = 0;
+            bool overflowed = false;
+            for (int i = 0; i < 100 && ! overflowed; ++i)
+            {
+                if (queue.post (new CountCommand (counter, i)))
+                    ++numPosted;
+                else
+                    overflowed = true;
+            }
+
+            expect (overflowed);
+            expect (numPosted >= 4);
+            expectEquals (queue.getNumPending(), numPosted);
+            expectEquals (counter.alive, numPosted); // the rejected command was freed
+            expect (counter.performed == 0);
+
+            expectEquals (queue.performPending(), numPosted);
+            queue.dispatchCompleted();
+            expectEquals (counter.completed, numPosted);
+            expectEquals (counter.alive, 0);
+
+            expect (queue.post (new CountCommand (counter, 100)));
+        }
+
+        expectEquals (counter.alive, 0); // pending commands are freed with the queue
+    }
+
+    struct PostAgainCommand : public EngineCommand
+    {
+        PostAgainCommand (EngineCommandQueue& q, Counter& c) : queue (q), counter (c) { }
+        void perform() override     { ++counter.performed; }
+        void completed() override   { queue.post (new CountCommand (counter, 1)); }
+        EngineCommandQueue& queue;
+        Counter& counter;
+    };
+
+    void testPostFromCompleted()
+    {
+        beginTest ("post from completed");
+        Counter counter;
+        EngineCommandQueue queue (8);
+        expect (queue.post (new PostAgainCommand (queue, counter)));
+        expectEquals (counter.performed, 2);
+        expectEquals (counter.completed, 1);
+        expectEquals (counter.alive, 0);
+    }
+};
+
+static EngineCommandQueueTest sEngineCommandQueueTest;
+
+}
@@ -0,0 +1,184 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "controllers/EngineOSCListener.h"
+
+namespace Element {
+
+class EngineOSCListenerTest : public UnitTestBase
+{
+public:
+    EngineOSCListenerTest() : UnitTestBase ("Engine OSC Listener", "engine", "engineOscListener") { }
+    virtual ~EngineOSCListenerTest() { }
+
+    void initialise() override
+    {
+        initializeWorld();
+    }
+
+    void shutdown() override
+    {
+        shutdownWorld();
+    }
+
+    void runTest() override
+    {
+        GraphProcessor graph;
+        nodes.add (graph.addNode (new GraphProcessor::AudioGraphIOProcessor (
+            GraphProcessor::AudioGraphIOProcessor::audioInputNode)));
+        nodes.add (graph.addNode (new GraphProcessor::AudioGraphIOProcessor (
+            GraphProcessor::AudioGraphIOProcessor::audioOutputNode)));
+        buildRoutes();
+
+        Updater updater;
+        EngineOSCFeedback feedback;
+        EngineOSCListener listener (getAppController(), getWorld().getAudioEngine(), updater, feedback);
+        listener.setRoutes (routes);
+
+        testValues (listener);
+        testModelState (listener);
+        testFeedbackHosts (listener, feedback);
+        testUnknownAddress (listener, updater);
+
+        feedback.stop();
+        listener.setRoutes (nullptr);
+        routes = nullptr;
+        nodes.clear();
+    }
+
+private:
+    struct Updater : public AsyncUpdater
+    {
+        void handleAsyncUpdate() override { ++numUpdates; }
+        int numUpdates = 0;
+    };
+
+    ReferenceCountedArray<GraphNode> nodes;
+    Node graphModel;
+    Array<Node> models;
+    EngineOSCRoutes::Ptr routes;
+
+    static String getNodePath (const GraphNode* node)
+    {
+        return String ("/el/graph/0/node/") + String (node->nodeId);
+    }
+
+    void buildRoutes()
+    {
+        routes = new EngineOSCRoutes();
+        graphModel = Node (Tags::graph);
+        auto modelNodes = graphModel.getValueTree().getOrCreateChildWithName (Tags::nodes, nullptr);
+        routes->graphs.add (graphModel);
+
+        auto addRoute = [this] (const String& address, OSCRoute::Kind kind, GraphNode* node)
+        {
+            OSCRoute route;
+            route.kind  = kind;
+            route.graph = 0;
+            route.node  = node;
+            routes->table.add (address, route);
+        };
+
+        addRoute ("/el/feedback", OSCRoute::feedback, nullptr);
+        for (auto* node : nodes)
+        {
+            Node model (Tags::node);
+            model.setProperty (Tags::id, (int64) node->nodeId);
+            modelNodes.appendChild (model.getValueTree(), nullptr);
+            models.add (model);
+
+            addRoute (getNodePath (node) + "/gain",   OSCRoute::gain, node);
+            addRoute (getNodePath (node) + "/mute",   OSCRoute::mute, node);
+            addRoute (getNodePath (node) + "/bypass", OSCRoute::bypass, node);
+        }
+    }
+
+    void testValues (EngineOSCListener& listener)
+    {
+        beginTest ("values apply on the receiver thread");
+        listener.oscMessageReceived (OSCMessage (getNodePath (nodes[0]) + "/gain", 0.5f));
+        expectEquals (nodes[0]->getGain(), 0.5f);
+        expectEquals (nodes[1]->getGain(), 1.f);
+
+        beginTest ("patterns fan out to matching nodes");
+        listener.oscMessageReceived (OSCMessage ("/el/graph/0/node/*/gain", 0.25f));
+        for (auto* node : nodes)
+            expectEquals (node->getGain(), 0.25f);
+    }
+
+    void testModelState (EngineOSCListener& listener)
+    {
+        beginTest ("mute and bypass go through the model");
+        listener.oscMessageReceived (OSCMessage (getNodePath (nodes[0]) + "/mute", 1.f));
+        listener.oscMessageReceived (OSCMessage (getNodePath (nodes[1]) + "/bypass", 1));
+
+        // nothing changes until the message thread applies it to the model
+        expect (! nodes[0]->isMuted());
+        expect (! models[0].isMuted());
+        expect (! models[1].isBypassed());
+
+        runDispatchLoop();
+        expect (models[0].isMuted());
+        expect (! models[0].isBypassed());
+        expect (models[1].isBypassed());
+        expect (! models[1].isMuted());
+
+        listener.oscMessageReceived (OSCMessage (getNodePath (nodes[0]) + "/mute", 0.f));
+        runDispatchLoop();
+        expect (! models[0].isMuted());
+    }
+
+    void testFeedbackHosts (EngineOSCListener& listener, EngineOSCFeedback& feedback)
+    {
+        beginTest ("feedback only goes to allowed hosts");
+        expect (listener.isFeedbackHostAllowed ("127.0.0.1"));
+        expect (! listener.isFeedbackHostAllowed ("10.9.8.7"));
+
+        listener.oscMessageReceived (OSCMessage ("/el/feedback", String ("10.9.8.7"), 9999));
+        expect (! feedback.isSending());
+
+        listener.oscMessageReceived (OSCMessage ("/el/feedback", String ("127.0.0.1"), 9999));
+        expect (feedback.isSending());
+        feedback.stop();
+
+        listener.setFeedbackHosts (StringArray ("10.9.8.7"));
+        expect (! listener.isFeedbackHostAllowed ("127.0.0.1"));
+        listener.oscMessageReceived (OSCMessage ("/el/feedback", String ("127.0.0.1"), 9999));
+        expect (! feedback.isSending());
+        listener.setFeedbackHosts (StringArray ("127.0.0.1", "localhost", "::1"));
+    }
+
+    void testUnknownAddress (EngineOSCListener& listener, Updater& updater)
+    {
+        beginTest ("unknown addresses ask for new routes");
+        listener.oscMessageReceived (OSCMessage ("/el/graph/0/node/9999/gain", 0.5f));
+        listener.oscMessageReceived (OSCMessage ("/el/graph/0/node/9998/gain", 0.5f));
+        runDispatchLoop();
+        expectEquals (updater.numUpdates, 1);
+
+        // other namespaces are ignored
+        listener.oscMessageReceived (OSCMessage ("/element/command", String ("quit")));
+        runDispatchLoop();
+        expectEquals (updater.numUpdates, 1);
+    }
+};
+
+static EngineOSCListenerTest sEngineOSCListenerTest;
+
+}
@@ -0,0 +1,113 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "engine/MidiClock.h"
+
+namespace Element {
+
+class MidiClockMasterTest : public UnitTestBase
+{
+public:
+    MidiClockMasterTest() : UnitTestBase ("MIDI Clock Master", "engine", "midiClockMaster") { }
+    virtual ~MidiClockMasterTest() { }
+
+    void runTest() override
+    {
+        testNoDrift (48000.0, 127.0);
+        testNoDrift (44100.0, 93.7);
+        testNoDrift (96000.0, 172.3);
+        testTempoChangeMidBlock();
+    }
+
+private:
+    void testNoDrift (double sampleRate, double tempo)
+    {
+        beginTest (String ("no drift over an hour at ") + String (tempo, 1)
+            + " bpm, " + String (roundToInt (sampleRate)) + " Hz");
+
+        MidiClockMaster clock;
+        clock.setSampleRate (sampleRate);
+        clock.setTempo (tempo);
+        clock.reset();
+
+        const double samplesPerClock = (60.0 * sampleRate) / (24.0 * tempo);
+        const int64 totalSamples = static_cast<int64> (sampleRate * 3600.0);
+        Random random (static_cast<int64> (tempo * 10.0));
+        MidiBuffer midi;
+        int64 pos = 0, numTicks = 0, numWrong = 0;
+
+        while (pos < totalSamples)
+        {
+            // awkward block sizes, as from a host or a split block
+            const int numSamples = 1 + random.nextInt (1024);
+            midi.clear();
+            clock.render (midi, numSamples);
+
+            MidiBuffer::Iterator iter (midi);
+            MidiMessage message; int frame = 0;
+            while (iter.getNextEvent (message, frame))
+            {
+                const auto expected = static_cast<int64> (std::floor (numTicks * samplesPerClock + 0.5));
+                if (pos + frame != expected)
+                    ++numWrong;
+                ++numTicks;
+            }
+
+            pos += numSamples;
+        }
+
+        expectEquals ((int) numWrong, 0);
+        expectEquals ((int) numTicks, (int) std::ceil ((pos - 0.5) / samplesPerClock));
+    }
+
+    void testTempoChangeMidBlock()
+    {
+        beginTest ("tempo change mid block");
+        const double sampleRate = 48000.0;
+        MidiClockMaster clock;
+        clock.setSampleRate (sampleRate);
+        clock.setTempo (120.0);
+        clock.reset();
+
+        // 120 bpm is 1000 samples per clock, 150 bpm is 800
+        MidiBuffer midi;
+        clock.render (midi, 0, 2500);
+        clock.setTempo (150.0);
+        clock.render (midi, 2500, 1500);
+
+        Array<int> frames;
+        MidiBuffer::Iterator iter (midi);
+        MidiMessage message; int frame = 0;
+        while (iter.getNextEvent (message, frame))
+            frames.add (frame);
+
+        // half a clock had passed at the change, leaving 400 samples at the new tempo
+        expectEquals (frames.size(), 5);
+        expectEquals (frames[0], 0);
+        expectEquals (frames[1], 1000);
+        expectEquals (frames[2], 2000);
+        expectEquals (frames[3], 2900);
+        expectEquals (frames[4], 3700);
+        expectWithinAbsoluteError (clock.getSamplesPerClock(), 800.0, 1.0e-9);
+    }
+};
+
+static MidiClockMasterTest sMidiClockMasterTest;
+
+}
@@ -0,0 +1,236 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "engine/MidiEventArena.h"
+#include "engine/MidiPipe.h"
+
+namespace Element {
+
+class MidiEventArenaTest : public UnitTestBase
+{
+public:
+    MidiEventArenaTest() : UnitTestBase ("MIDI Event Arena", "engine", "midiEventArena") { }
+    virtual ~MidiEventArenaTest() { }
+
+    void runTest() override
+    {
+        testArena();
+        testMerge();
+        testCopyOnWrite();
+        testWriteTo();
+        testWidePipe();
+        testFanOut();
+    }
+
+private:
+    static Array<int> getFrames (const MidiBuffer& buffer)
+    {
+        Array<int> frames;
+        MidiBuffer::Iterator iter (buffer);
+        MidiMessage msg; int frame = 0;
+        while (iter.getNextEvent (msg, frame))
+            frames.add (frame);
+        return frames;
+    }
+
+    void testArena()
+    {
+        beginTest ("arena");
+        MidiEventArena arena (2, 5);
+        const uint8 noteOn[] = { 0x90, 60, 100 };
+        const uint8 pgc[] = { 0xc0, 1 };
+
+        expectEquals (arena.add (noteOn, 3, 10), 0);
+        expectEquals (arena.add (pgc, 2, 20), 1);
+        expectEquals (arena.add (pgc, 2, 30), -1);
+        expectEquals (arena.getFrame (1), 20);
+        expectEquals (arena.getSize (0), 3);
+        expect (arena.getData (0)[1] == 60);
+
+        arena.clear();
+        expectEquals (arena.getNumEvents(), 0);
+        expectEquals (arena.add (pgc, 2, 0), 0);
+    }
+
+    void testMerge()
+    {
+        beginTest ("merge");
+        MidiEventArena arena;
+        MidiEventView a, b;
+        const uint8 cc[] = { 0xb0, 1, 0 };
+
+        for (const int frame : { 0, 10, 20, 30 })
+            a.add (arena.add (cc, 3, frame));
+        for (const int frame : { 5, 10, 25 })
+            b.add (arena.add (cc, 3, frame));
+
+        a.merge (arena, b);
+        expectEquals (a.size(), 7);
+        Array<int> frames;
+        for (int i = 0; i < a.size(); ++i)
+            frames.add (arena.getFrame (a[i]));
+        expect (frames == Array<int> ({ 0, 5, 10, 10, 20, 25, 30 }));
+
+        // events on the same frame keep the existing one first
+        expectEquals (a[2], 1);
+        expectEquals (a[3], 5);
+
+        MidiEventView c;
+        c.merge (arena, b);
+        expectEquals (c.size(), 3);
+    }
+
+    void testCopyOnWrite()
+    {
+        beginTest ("copy on write");
+        MidiEventArena arena;
+        MidiEventView a, b;
+        const uint8 pgc[] = { 0xc0, 1 };
+        const int index = arena.add (pgc, 2, 7);
+        a.add (index);
+        b.add (index);
+
+        const uint8 mapped[] = { 0xc0, 9 };
+        expect (a.replace (arena, 0, mapped, 2));
+        expect (a[0] != index);
+        expect (arena.getData (a[0])[1] == 9);
+        expectEquals (arena.getFrame (a[0]), 7);
+        expect (arena.getData (b[0])[1] == 1);
+    }
+
+    void testWriteTo()
+    {
+        beginTest ("write to buffer");
+        MidiBuffer input;
+        input.addEvent (MidiMessage::noteOn (1, 60, (uint8) 100), 0);
+        input.addEvent (MidiMessage::controllerEvent (2, 7, 64), 16);
+        input.addEvent (MidiMessage::noteOff (1, 60), 200);
+        input.addEvent (MidiMessage::noteOff (1, 61), 300);
+
+        MidiEventArena arena;
+        MidiEventView view;
+        expectEquals (view.addFromBuffer (arena, input, 256), 3);
+
+        MidiBuffer output;
+        output.addEvent (MidiMessage::allNotesOff (1), 5);
+        view.writeTo (arena, output);
+        expectEquals (output.getNumEvents(), 3);
+        expect (getFrames (output) == Array<int> ({ 0, 16, 200 }));
+
+        MidiBuffer::Iterator iter (output);
+        MidiMessage msg; int frame = 0;
+        iter.getNextEvent (msg, frame);
+        expect (msg.isNoteOn() && msg.getNoteNumber() == 60 && msg.getVelocity() == 100);
+        iter.getNextEvent (msg, frame);
+        expect (msg.isController() && msg.getChannel() == 2 && msg.getControllerValue() == 64);
+
+        // a buffer written from a view can be added to like any other
+        output.addEvent (MidiMessage::noteOn (1, 62, (uint8) 1), 8);
+        expect (getFrames (output) == Array<int> ({ 0, 8, 16, 200 }));
+    }
+
+    void testWidePipe()
+    {
+        beginTest ("wide pipe");
+        OwnedArray<MidiBuffer> buffers;
+        Array<int> channels;
+        for (int i = 0; i < 48; ++i)
+        {
+            buffers.add (new MidiBuffer())->addEvent (MidiMessage::noteOn (1, i, 1.f), 0);
+            channels.add (47 - i);
+        }
+
+        MidiPipe pipe (buffers, channels);
+        expectEquals (pipe.getNumBuffers(), 48);
+        expect (pipe.getReadBuffer (40) == buffers[7]);
+        pipe.clear();
+        expect (buffers[0]->isEmpty() && buffers[47]->isEmpty());
+    }
+
+    /** Dense controllers from 8 sources, each sent to all of 16 destinations */
+    void testFanOut()
+    {
+        beginTest ("fan out");
+        enum { numSources = 8, numDestinations = 16, numEvents = 256, blockSize = 512, numBlocks = 200 };
+
+        OwnedArray<MidiBuffer> sources, viewOuts, addOuts;
+        for (int s = 0; s < numSources; ++s)
+        {
+            auto* buffer = sources.add (new MidiBuffer());
+            for (int i = 0; i < numEvents; ++i)
+                buffer->addEvent (MidiMessage::controllerEvent (s + 1, i % 128, i % 128), (i * 2 + s) % blockSize);
+        }
+
+        for (int d = 0; d < numDestinations; ++d)
+        {
+            viewOuts.add (new MidiBuffer())->ensureSize (64 * 1024);
+            addOuts.add (new MidiBuffer())->ensureSize (64 * 1024);
+        }
+
+        MidiEventArena arena;
+        OwnedArray<MidiEventView> sourceViews, destViews;
+        for (int s = 0; s < numSources; ++s)
+            sourceViews.add (new MidiEventView (4096));
+        for (int d = 0; d < numDestinations; ++d)
+            destViews.add (new MidiEventView (4096));
+
+        double viewMs = 0.0, addMs = 0.0;
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            double start = Time::getMillisecondCounterHiRes();
+            arena.clear();
+            for (int s = 0; s < numSources; ++s)
+            {
+                sourceViews[s]->clear();
+                sourceViews[s]->addFromBuffer (arena, *sources[s], blockSize);
+            }
+            for (int d = 0; d < numDestinations; ++d)
+            {
+                destViews[d]->clear();
+                for (int s = 0; s < numSources; ++s)
+                    destViews[d]->merge (arena, *sourceViews[s]);
+                destViews[d]->writeTo (arena, *viewOuts[d]);
+            }
+            viewMs += Time::getMillisecondCounterHiRes() - start;
+
+            // the old way, adding every source to every destination
+            start = Time::getMillisecondCounterHiRes();
+            for (int d = 0; d < numDestinations; ++d)
+            {
+                addOuts[d]->clear();
+                for (int s = 0; s < numSources; ++s)
+                    addOuts[d]->addEvents (*sources[s], 0, blockSize, 0);
+            }
+            addMs += Time::getMillisecondCounterHiRes() - start;
+        }
+
+        for (int d = 0; d < numDestinations; ++d)
+        {
+            expectEquals (viewOuts[d]->getNumEvents(), numSources * numEvents);
+            expect (getFrames (*viewOuts[d]) == getFrames (*addOuts[d]));
+        }
+
+        logMessage (String ("views: ") + String (viewMs / numBlocks, 3) + " ms per block, addEvents: "
+            + String (addMs / numBlocks, 3) + " ms per block");
+    }
+};
+
+static MidiEventArenaTest sMidiEventArenaTest;
+
+}
@@ -0,0 +1,236 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "engine/MidiInputCollector.h"
+
+namespace Element {
+
+class MidiInputCollectorTest : public UnitTestBase
+{
+public:
+    MidiInputCollectorTest() : UnitTestBase ("MIDI Input Collector", "engine", "midiInputCollector") { }
+    virtual ~MidiInputCollectorTest() { }
+
+    void runTest() override
+    {
+        testSampleOffsets();
+        testLatency();
+        testThreads();
+        testScheduled();
+    }
+
+private:
+    enum { blockSize = 256 };
+    const double sampleRate = 48000.0;
+
+    static MidiMessage noteAt (double timeMs, int note = 60)
+    {
+        auto message = MidiMessage::noteOn (1, note, (uint8) 100);
+        message.setTimeStamp (timeMs * 0.001);
+        return message;
+    }
+
+    static Array<int> getFrames (const MidiBuffer& buffer)
+    {
+        Array<int> frames;
+        MidiBuffer::Iterator iter (buffer);
+        MidiMessage message; int frame = 0;
+        while (iter.getNextEvent (message, frame))
+            frames.add (frame);
+        return frames;
+    }
+
+    void testSampleOffsets()
+    {
+        beginTest ("sample offsets");
+        MidiInputCollector collector;
+        collector.reset (sampleRate);
+        const double blockMs = 1000.0 * blockSize / sampleRate;
+        const double start = Time::getMillisecondCounterHiRes();
+
+        MidiBuffer buffer;
+        collector.removeNextBlockOfMessages (buffer, blockSize, start);
+        expect (buffer.isEmpty());
+
+        collector.addMessageToQueue (noteAt (start + 1.0));
+        collector.addMessageToQueue (noteAt (start + 3.0));
+        collector.addMessageToQueue (noteAt (start + blockMs + 1.0));
+
+        // messages from the last block keep their spacing, later ones wait
+        collector.removeNextBlockOfMessages (buffer, blockSize, start + blockMs);
+        auto frames = getFrames (buffer);
+        expectEquals (frames.size(), 2);
+        expectEquals (frames[0], 48);
+        expectEquals (frames[1], 144);
+
+        buffer.clear();
+        collector.removeNextBlockOfMessages (buffer, blockSize, start + 2.0 * blockMs);
+        frames = getFrames (buffer);
+        expectEquals (frames.size(), 1);
+        expectEquals (frames[0], 48);
+
+        // a message without a timestamp arrives now
+        buffer.clear();
+        collector.addMessageToQueue (MidiMessage::noteOff (1, 60));
+        collector.removeNextBlockOfMessages (buffer, blockSize, Time::getMillisecondCounterHiRes() + 1000.0);
+        expectEquals (getFrames (buffer).size(), 1);
+    }
+
+    static Array<int> getNotes (const MidiBuffer& buffer)
+    {
+        Array<int> notes;
+        MidiBuffer::Iterator iter (buffer);
+        MidiMessage message; int frame = 0;
+        while (iter.getNextEvent (message, frame))
+            notes.add (message.getNoteNumber());
+        return notes;
+    }
+
+    void testLatency()
+    {
+        beginTest ("jitter absorption latency");
+        MidiInputCollector collector;
+        collector.reset (sampleRate);
+        collector.setLatency (2.0);
+        const double blockMs = 1000.0 * blockSize / sampleRate;
+        const double start = Time::getMillisecondCounterHiRes();
+
+        MidiBuffer buffer;
+        collector.removeNextBlockOfMessages (buffer, blockSize, start);
+        collector.addMessageToQueue (noteAt (start + 4.0));
+
+        collector.removeNextBlockOfMessages (buffer, blockSize, start + blockMs);
+        expect (buffer.isEmpty());
+
+        collector.removeNextBlockOfMessages (buffer, blockSize, start + 2.0 * blockMs);
+        const auto frames = getFrames (buffer);
+        expectEquals (frames.size(), 1);
+        expectEquals (frames[0], 32);
+    }
+
+    struct Producer : public Thread
+    {
+        Producer (MidiInputCollector& c, int n)
+            : Thread ("Producer"), collector (c), numMessages (n) { }
+
+        void run() override
+        {
+            for (int i = 0; i < numMessages; ++i)
+                collector.addMessageToQueue (noteAt (Time::getMillisecondCounterHiRes(), i % 128));
+        }
+
+        MidiInputCollector& collector;
+        const int numMessages;
+    };
+
+    void testThreads()
+    {
+        beginTest ("one queue per thread");
+        enum { numThreads = 4, numMessages = 120 };
+        MidiInputCollector collector (numThreads);
+        collector.reset (sampleRate);
+
+        OwnedArray<Producer> producers;
+        for (int i = 0; i < numThreads; ++i)
+            producers.add (new Producer (collector, numMessages))->startThread();
+        for (auto* producer : producers)
+            producer->waitForThreadToExit (-1);
+
+        MidiBuffer buffer;
+        collector.removeNextBlockOfMessages (buffer, blockSize, Time::getMillisecondCounterHiRes() + 1000.0);
+        expectEquals (buffer.getNumEvents(), numThreads * numMessages);
+        expectEquals (collector.getNumDropped(), 0);
+
+        // this thread takes the only queue, so others share the locked one
+        beginTest ("more threads than queues");
+        MidiInputCollector single (1);
+        single.reset (sampleRate);
+        single.addMessageToQueue (noteAt (Time::getMillisecondCounterHiRes()));
+        producers.clear();
+        for (int i = 0; i < numThreads; ++i)
+            producers.add (new Producer (single, numMessages))->startThread();
+        for (auto* producer : producers)
+            producer->waitForThreadToExit (-1);
+
+        buffer.clear();
+        single.removeNextBlockOfMessages (buffer, blockSize, Time::getMillisecondCounterHiRes() + 1000.0);
+        expectEquals (single.getNumDropped(), 0);
+        expectEquals (buffer.getNumEvents(), 1 + numThreads * numMessages);
+    }
+
+    void testScheduled()
+    {
+        beginTest ("scheduled messages alongside immediate ones");
+        MidiInputCollector collector;
+        collector.reset (sampleRate);
+        const double blockMs = 1000.0 * blockSize / sampleRate;
+        const double start = Time::getMillisecondCounterHiRes();
+
+        MidiBuffer buffer;
+        collector.removeNextBlockOfMessages (buffer, blockSize, start);
+
+        // out of order and further ahead than immediate messages may be
+        expect (collector.addScheduledMessage (noteAt (start + 4.0 * blockMs + 1.0, 64)));
+        expect (collector.addScheduledMessage (noteAt (start + 2000.0, 65)));
+        expect (collector.addScheduledMessage (noteAt (start + 2.0 * blockMs + 3.0, 63)));
+        collector.addMessageToQueue (noteAt (start + 1.0, 60));
+
+        collector.removeNextBlockOfMessages (buffer, blockSize, start + blockMs);
+        expectEquals (getNotes (buffer).size(), 1);
+        expectEquals (getNotes (buffer)[0], 60);
+        expectEquals (getFrames (buffer)[0], 48);
+        expectEquals (collector.getNumScheduled(), 3);
+
+        // immediate messages don't wait behind future ones
+        buffer.clear();
+        collector.addMessageToQueue (noteAt (start + blockMs + 1.0, 61));
+        collector.removeNextBlockOfMessages (buffer, blockSize, start + 2.0 * blockMs);
+        expectEquals (getNotes (buffer).size(), 1);
+        expectEquals (getNotes (buffer)[0], 61);
+
+        buffer.clear();
+        collector.removeNextBlockOfMessages (buffer, blockSize, start + 3.0 * blockMs);
+        expectEquals (getNotes (buffer).size(), 1);
+        expectEquals (getNotes (buffer)[0], 63);
+        expectEquals (getFrames (buffer)[0], 144);
+
+        buffer.clear();
+        collector.removeNextBlockOfMessages (buffer, blockSize, start + 4.0 * blockMs);
+        expect (buffer.isEmpty());
+
+        collector.removeNextBlockOfMessages (buffer, blockSize, start + 5.0 * blockMs);
+        expectEquals (getNotes (buffer).size(), 1);
+        expectEquals (getNotes (buffer)[0], 64);
+        expectEquals (getFrames (buffer)[0], 48);
+
+        // two seconds ahead keeps its time instead of playing now
+        expectEquals (collector.getNumScheduled(), 1);
+        buffer.clear();
+        collector.removeNextBlockOfMessages (buffer, blockSize, start + 2000.0 + blockMs);
+        expectEquals (getNotes (buffer).size(), 1);
+        expectEquals (getNotes (buffer)[0], 65);
+        expectEquals (getFrames (buffer)[0], 0);
+        expectEquals (collector.getNumScheduled(), 0);
+        expectEquals (collector.getNumDropped(), 0);
+    }
+};
+
+static MidiInputCollectorTest sMidiInputCollectorTest;
+
+}
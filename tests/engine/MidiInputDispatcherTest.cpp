@@ -0,0 +1,207 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "engine/MidiInputDispatcher.h"
+
+namespace Element {
+
+class MidiInputDispatcherTest : public UnitTestBase
+{
+public:
+    MidiInputDispatcherTest() : UnitTestBase ("MIDI Input Dispatcher", "engine", "midiInputDispatcher") { }
+    virtual ~MidiInputDispatcherTest() { }
+
+    void runTest() override
+    {
+        testDispatch();
+        testReplaceWhileBusy();
+        testReplaceFromCallback();
+        testThroughput();
+    }
+
+private:
+    enum { numInputs = 16, numCallbacks = 4 };
+
+    struct Counter : public MidiInputCallback
+    {
+        void handleIncomingMidiMessage (MidiInput*, const MidiMessage&) override { ++count; }
+        std::atomic<int> count { 0 };
+    };
+
+    /** Pumps messages into a dispatcher as fast as it can, like a busy device */
+    struct BusyInput : public Thread
+    {
+        BusyInput (std::function<void(const MidiMessage&)> f, int n)
+            : Thread ("BusyInput"), send (f), numMessages (n) { }
+
+        void run() override
+        {
+            const auto message = MidiMessage::controllerEvent (1, 7, 100);
+            for (int i = 0; i < numMessages && ! threadShouldExit(); ++i)
+                send (message);
+        }
+
+        std::function<void(const MidiMessage&)> send;
+        const int numMessages;
+    };
+
+    void testDispatch()
+    {
+        beginTest ("dispatch");
+        Counter a, b;
+        MidiInputDispatcher dispatcher (3);
+        expectEquals (dispatcher.getId(), 3);
+
+        const auto message = MidiMessage::noteOn (1, 60, 1.f);
+        expectEquals (dispatcher.dispatch (nullptr, message, true), 0);
+
+        dispatcher.setCallbacks ({ { &a, false }, { &b, true } });
+        expectEquals (dispatcher.dispatch (nullptr, message, true), 2);
+        expectEquals (dispatcher.dispatch (nullptr, message, false), 1);
+        expectEquals (a.count.load(), 1);
+        expectEquals (b.count.load(), 2);
+
+        dispatcher.setCallbacks ({ { &b, true } });
+        expectEquals (dispatcher.dispatch (nullptr, message, true), 1);
+        expectEquals (a.count.load(), 1);
+    }
+
+    void testReplaceWhileBusy()
+    {
+        beginTest ("replace while busy");
+        Counter a, b;
+        MidiInputDispatcher dispatcher (1);
+        dispatcher.setCallbacks ({ { &a, false } });
+
+        BusyInput input ([&dispatcher] (const MidiMessage& m) { dispatcher.dispatch (nullptr, m, true); }, 200000);
+        input.startThread();
+
+        for (int i = 0; i < 200; ++i)
+            dispatcher.setCallbacks (i % 2 == 0 ? Array<MidiInputDispatcher::Entry> ({ { &a, false }, { &b, false } })
+                                                : Array<MidiInputDispatcher::Entry> ({ { &a, false } }));
+
+        // once removed and synchronised, a callback must not be called again
+        dispatcher.setCallbacks ({ { &a, false } });
+        dispatcher.synchronise();
+        const int countAfterRemove = b.count.load();
+        input.stopThread (10000);
+        expectEquals (b.count.load(), countAfterRemove);
+        expect (a.count.load() > 0);
+    }
+
+    struct Remover : public MidiInputCallback
+    {
+        Remover (MidiInputDispatcher& d) : dispatcher (d) { }
+        void handleIncomingMidiMessage (MidiInput*, const MidiMessage&) override
+        {
+            ++count;
+            inside = MidiInputDispatcher::isDispatching();
+            dispatcher.setCallbacks ({});
+            dispatcher.synchronise(); // must not wait for its own dispatch
+        }
+        MidiInputDispatcher& dispatcher;
+        int count = 0;
+        bool inside = false;
+    };
+
+    void testReplaceFromCallback()
+    {
+        beginTest ("replace from a callback");
+        MidiInputDispatcher dispatcher (1);
+        Remover remover (dispatcher);
+        Counter after;
+        dispatcher.setCallbacks ({ { &remover, false }, { &after, false } });
+
+        const auto message = MidiMessage::noteOn (1, 60, 1.f);
+        expectEquals (dispatcher.dispatch (nullptr, message, true), 2);
+        expect (remover.inside);
+        expect (! MidiInputDispatcher::isDispatching());
+        expectEquals (after.count.load(), 1); // the running dispatch finishes its array
+
+        dispatcher.synchronise();
+        expectEquals (dispatcher.dispatch (nullptr, message, true), 0);
+        expectEquals (remover.count, 1);
+    }
+
+    void testThroughput()
+    {
+        beginTest ("16 busy inputs");
+        const int messagesPerInput = 100000;
+
+        OwnedArray<Counter> counters;
+        Array<MidiInputDispatcher::Entry> entries;
+        for (int i = 0; i < numCallbacks; ++i)
+            entries.add ({ counters.add (new Counter()), false });
+
+        OwnedArray<MidiInputDispatcher> dispatchers;
+        OwnedArray<BusyInput> inputs;
+        for (int i = 0; i < numInputs; ++i)
+        {
+            auto* dispatcher = dispatchers.add (new MidiInputDispatcher (i + 1));
+            dispatcher->setCallbacks (entries);
+            inputs.add (new BusyInput ([dispatcher] (const MidiMessage& m) {
+                dispatcher->dispatch (nullptr, m, true);
+            }, messagesPerInput));
+        }
+
+        const double lockFreeMs = runInputs (inputs);
+        int total = 0;
+        for (auto* c : counters)
+            total += c->count.exchange (0);
+        expectEquals (total, numInputs * messagesPerInput * numCallbacks);
+
+        // the same load through one shared lock, matching callbacks by device name
+        CriticalSection lock;
+        StringArray callbackDevices;
+        for (int i = 0; i < numCallbacks; ++i)
+            callbackDevices.add (String());
+
+        inputs.clear();
+        for (int i = 0; i < numInputs; ++i)
+        {
+            const String name = "MIDI Device " + String (i + 1);
+            inputs.add (new BusyInput ([&lock, &counters, &callbackDevices, name] (const MidiMessage& m) {
+                const ScopedLock sl (lock);
+                const String deviceName (name);
+                for (int j = 0; j < numCallbacks; ++j)
+                    if (callbackDevices [j].isEmpty() || callbackDevices [j] == deviceName)
+                        counters.getUnchecked (j)->handleIncomingMidiMessage (nullptr, m);
+            }, messagesPerInput));
+        }
+
+        const double lockedMs = runInputs (inputs);
+        const double numMessages = (double) numInputs * messagesPerInput;
+        logMessage (String ("lock-free: ") + String (numMessages / lockFreeMs * 1000.0, 0) + " messages per second, "
+            + "shared lock: " + String (numMessages / lockedMs * 1000.0, 0) + " messages per second");
+    }
+
+    static double runInputs (OwnedArray<BusyInput>& inputs)
+    {
+        const double start = Time::getMillisecondCounterHiRes();
+        for (auto* input : inputs)
+            input->startThread();
+        for (auto* input : inputs)
+            input->waitForThreadToExit (-1);
+        return jmax (0.001, Time::getMillisecondCounterHiRes() - start);
+    }
+};
+
+static MidiInputDispatcherTest sMidiInputDispatcherTest;
+
+}
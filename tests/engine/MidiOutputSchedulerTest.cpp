@@ -0,0 +1,234 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "engine/MidiOutputScheduler.h"
+
+namespace Element {
+
+class MidiOutputSchedulerTest : public UnitTestBase
+{
+public:
+    MidiOutputSchedulerTest() : UnitTestBase ("MIDI Output Scheduler", "engine", "midiOutputScheduler") { }
+    virtual ~MidiOutputSchedulerTest() { }
+
+    void runTest() override
+    {
+        testBlockClock();
+        testTiming();
+       #if JUCE_LINUX
+        testAlsaLoopback();
+       #endif
+    }
+
+private:
+    enum { blockSize = 256, eventSpacing = 64, numBlocks = 40 };
+    const double sampleRate = 48000.0;
+
+    /** Records when each message was due and when it arrived, on a clock
+        the test moves forward */
+    struct RecordingScheduler : public MidiOutputScheduler
+    {
+        RecordingScheduler() : MidiOutputScheduler (nullptr) { }
+        ~RecordingScheduler() { stop(); }
+
+        void deliver (const MidiMessage& message) override
+        {
+            const ScopedLock sl (lock);
+            due.add (message.getTimeStamp());
+            arrived.add (getCurrentTime());
+        }
+
+        double getCurrentTime() const override { return now.load(); }
+
+        std::atomic<double> now { 1000.0 };
+        CriticalSection lock;
+        Array<double> due, arrived;
+    };
+
+    /** Fills a block with a note every eventSpacing samples */
+    static void fillBlock (MidiBuffer& buffer)
+    {
+        buffer.clear();
+        for (int frame = 0; frame < blockSize; frame += eventSpacing)
+            buffer.addEvent (MidiMessage::noteOn (1, 60, (uint8) 100), frame);
+    }
+
+    /** Sends blocks in real time like an audio callback */
+    void runBlocks (MidiOutputScheduler& scheduler)
+    {
+        MidiBuffer buffer;
+        const double blockMs = 1000.0 * blockSize / sampleRate;
+        const double start = Time::getMillisecondCounterHiRes();
+
+        for (int i = 0; i < numBlocks; ++i)
+        {
+            while (Time::getMillisecondCounterHiRes() < start + i * blockMs)
+                Thread::yield();
+            fillBlock (buffer);
+            scheduler.send (buffer, blockSize, sampleRate, Time::getMillisecondCounterHiRes());
+        }
+
+        Thread::sleep (roundToInt (scheduler.getLatency() + blockMs * 2.0) + 20);
+    }
+
+    void testBlockClock()
+    {
+        beginTest ("block clock");
+        RecordingScheduler scheduler;
+        MidiBuffer empty;
+        const double blockMs = 1000.0 * blockSize / sampleRate;
+
+        // jittery callback times still give evenly spaced blocks
+        Random random (99);
+        double lastBlockTime = 0.0;
+        for (int i = 0; i < 1000; ++i)
+        {
+            const double callbackTime = 1000.0 + i * blockMs + random.nextDouble() * 0.5;
+            scheduler.send (empty, blockSize, sampleRate, callbackTime);
+            if (i > 100)
+                expectWithinAbsoluteError (scheduler.getBlockTime() - lastBlockTime, blockMs, 0.05);
+            lastBlockTime = scheduler.getBlockTime();
+        }
+
+        // a stalled callback resets the clock
+        scheduler.send (empty, blockSize, sampleRate, lastBlockTime + 100.0);
+        expectEquals (scheduler.getBlockTime(), lastBlockTime + 100.0);
+    }
+
+    void testTiming()
+    {
+        beginTest ("timing");
+        RecordingScheduler scheduler;
+        scheduler.setLatency (3.0);
+
+        // callbacks wake up late by up to half a millisecond, the clock is
+        // stepped in 10 us ticks and due messages delivered at each tick
+        const double blockMs = 1000.0 * blockSize / sampleRate;
+        const double tickMs = 0.01;
+        Random random (7);
+        MidiBuffer buffer;
+
+        for (int i = 0; i < numBlocks; ++i)
+        {
+            const double blockStart = 1000.0 + i * blockMs;
+            scheduler.now.store (blockStart + random.nextDouble() * 0.5);
+            fillBlock (buffer);
+            scheduler.send (buffer, blockSize, sampleRate, scheduler.now.load());
+
+            while (scheduler.now.load() < blockStart + blockMs)
+            {
+                scheduler.sendDue (scheduler.now.load());
+                scheduler.now.store (scheduler.now.load() + tickMs);
+            }
+        }
+
+        for (int i = 0; i < roundToInt ((scheduler.getLatency() + blockMs) / tickMs); ++i)
+        {
+            scheduler.sendDue (scheduler.now.load());
+            scheduler.now.store (scheduler.now.load() + tickMs);
+        }
+
+        const int numEvents = numBlocks * (blockSize / eventSpacing);
+        const auto stats = scheduler.getStats();
+        expectEquals ((int) stats.numSent, numEvents);
+        expectEquals ((int) stats.numDropped, 0);
+        expectEquals ((int) stats.numLate, 0);
+        expectEquals (scheduler.due.size(), numEvents);
+
+        // due times are spaced by their sample offsets, whatever the wake-up jitter
+        const double spacingMs = 1000.0 * eventSpacing / sampleRate;
+        for (int i = 1; i < scheduler.due.size(); ++i)
+            expectWithinAbsoluteError (scheduler.due[i] - scheduler.due[i - 1], spacingMs, 0.1);
+
+        // and each is delivered within one tick of being due
+        expect (stats.maxJitterMs <= tickMs + 1.0e-9, "max jitter " + String (stats.maxJitterMs, 4));
+    }
+
+   #if JUCE_LINUX
+    struct Receiver : public MidiInputCallback
+    {
+        void handleIncomingMidiMessage (MidiInput*, const MidiMessage&) override
+        {
+            const ScopedLock sl (lock);
+            arrived.add (Time::getMillisecondCounterHiRes());
+        }
+
+        CriticalSection lock;
+        Array<double> arrived;
+    };
+
+    void testAlsaLoopback()
+    {
+        beginTest ("ALSA loopback");
+        const String portName ("Element Scheduler Loopback");
+        Receiver receiver;
+        std::unique_ptr<MidiInput> input (MidiInput::createNewDevice (portName, &receiver));
+        if (input == nullptr)
+        {
+            logMessage ("ALSA sequencer not available, skipping");
+            return;
+        }
+
+        input->start();
+        const int index = MidiOutput::getDevices().indexOf (portName);
+        std::unique_ptr<MidiOutput> output (index >= 0 ? MidiOutput::openDevice (index) : nullptr);
+        if (output == nullptr)
+        {
+            logMessage ("loopback port not found, skipping");
+            return;
+        }
+
+        MidiOutputScheduler scheduler (output.get());
+        scheduler.setLatency (3.0);
+        scheduler.start();
+        runBlocks (scheduler);
+        scheduler.stop();
+        input->stop();
+
+        const int numEvents = numBlocks * (blockSize / eventSpacing);
+        expectEquals (receiver.arrived.size(), numEvents);
+
+        // arrival spacing should follow sample offsets
+        const double spacingMs = 1000.0 * eventSpacing / sampleRate;
+        double totalError = 0.0;
+        for (int i = 1; i < receiver.arrived.size(); ++i)
+            totalError += std::abs (receiver.arrived[i] - receiver.arrived[i - 1] - spacingMs);
+        const double meanError = receiver.arrived.size() > 1 ? totalError / (receiver.arrived.size() - 1) : 0.0;
+
+        const auto stats = scheduler.getStats();
+        logMessage (String ("loopback spacing error ") + String (meanError, 3) + " ms, send jitter "
+            + String (stats.meanJitterMs, 3) + " ms");
+        expectEquals ((int) stats.numDropped, 0);
+
+        // sent unscheduled, the four notes of a block would arrive together
+        // and miss their spacing by about 1.3 ms on average. The tolerances
+        // leave room for a loaded machine, not for that
+        expect (meanError < 0.5, "mean spacing error " + String (meanError, 3) + " ms");
+        if (receiver.arrived.size() > 1)
+        {
+            const double span = receiver.arrived.getLast() - receiver.arrived.getFirst();
+            expectWithinAbsoluteError (span, spacingMs * (receiver.arrived.size() - 1), 10.0);
+        }
+    }
+   #endif
+};
+
+static MidiOutputSchedulerTest sMidiOutputSchedulerTest;
+
+}
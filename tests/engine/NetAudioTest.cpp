@@ -0,0 +1,378 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "engine/GraphProcessor.h"
+#include "engine/NetAudioReceiver.h"
+#include "engine/NetAudioSender.h"
+#include "engine/nodes/NetAudioReceiveNode.h"
+#include "engine/nodes/NetAudioSendNode.h"
+
+namespace Element {
+
+class NetAudioTest : public UnitTestBase
+{
+public:
+    NetAudioTest() : UnitTestBase ("Net Audio", "engine", "netAudio") { }
+    virtual ~NetAudioTest() { }
+
+    void runTest() override
+    {
+        testPacket();
+        testLocalhost();
+        testImpaired();
+        testRateMismatch();
+        testSocket();
+        testNodes();
+    }
+
+private:
+    enum { blockSize = 256, numChannels = 2 };
+    static constexpr double sampleRate = 48000.0;
+
+    void testPacket()
+    {
+        beginTest ("packet round trip");
+        Random random (1234);
+        AudioSampleBuffer audio (numChannels, NetAudioPacket::maxFrames);
+        for (int c = 0; c < numChannels; ++c)
+            for (int i = 0; i < audio.getNumSamples(); ++i)
+                audio.setSample (c, i, random.nextFloat() * 2.f - 1.f);
+
+        HeapBlock<uint8> data (NetAudioPacket::maxSize, true);
+        AudioSampleBuffer decoded (numChannels, audio.getNumSamples());
+
+        for (const bool pack : { false, true })
+        {
+            const int size = NetAudioPacket::write (data, NetAudioPacket::maxSize, 7, 48000,
+                audio.getArrayOfReadPointers(), numChannels, audio.getNumSamples(), pack);
+            expect (size > 0);
+
+            NetAudioPacket header;
+            expect (NetAudioPacket::readHeader (data, size, header));
+            expect (header.sequence == 7 && header.sampleRate == 48000);
+            expect (header.numChannels == numChannels && header.numFrames == audio.getNumSamples());
+
+            decoded.clear();
+            expect (NetAudioPacket::readSamples (data, size, header, decoded.getArrayOfWritePointers(), numChannels));
+            for (int c = 0; c < numChannels; ++c)
+                expect (memcmp (audio.getReadPointer (c), decoded.getReadPointer (c),
+                                sizeof (float) * (size_t) audio.getNumSamples()) == 0);
+        }
+
+        beginTest ("packed silence");
+        audio.clear();
+        audio.setSample (0, 10, 1.0e-20f);
+        const int rawSize = NetAudioPacket::headerSize + 4 * numChannels * audio.getNumSamples();
+        const int size = NetAudioPacket::write (data, NetAudioPacket::maxSize, 0, 48000,
+            audio.getArrayOfReadPointers(), numChannels, audio.getNumSamples(), true);
+        expect (size < rawSize / 4);
+
+        NetAudioPacket header;
+        expect (NetAudioPacket::readHeader (data, size, header) && header.packed);
+        expect (NetAudioPacket::readSamples (data, size, header, decoded.getArrayOfWritePointers(), numChannels));
+        expect (decoded.getSample (0, 10) == 1.0e-20f);
+        expect (decoded.getMagnitude (1, 0, decoded.getNumSamples()) == 0.f);
+
+        expect (! NetAudioPacket::readHeader (data, NetAudioPacket::headerSize - 1, header));
+        expect (! NetAudioPacket::readSamples (data, size - 8, header, decoded.getArrayOfWritePointers(), numChannels));
+        data[0] = 0;
+        expect (! NetAudioPacket::readHeader (data, size, header));
+    }
+
+    /** Hands packets straight to a receiver, on a clock the test advances */
+    struct LoopbackSender : public NetAudioSender
+    {
+        LoopbackSender (NetAudioReceiver& r) : NetAudioSender (numChannels), receiver (r) { }
+        ~LoopbackSender() { disconnect(); }
+
+        bool deliver (const uint8* data, int size) override
+        {
+            receiver.receive (data, size, now);
+            return true;
+        }
+
+        double getCurrentTime() const override { return now; }
+
+        NetAudioReceiver& receiver;
+        double now = 1000.0;
+    };
+
+    /** Streams a sine for a number of blocks on the sender's clock and
+        returns the largest step between received samples once audio has started */
+    float stream (LoopbackSender& sender, NetAudioReceiver& receiver, int numBlocks, int& numAudible)
+    {
+        AudioSampleBuffer in (numChannels, blockSize), out (numChannels, blockSize);
+        const double delta = MathConstants<double>::twoPi * 200.0 / sampleRate;
+        const double blockMs = 1000.0 * blockSize / sampleRate;
+        double phase = 0.0;
+        float last = 0.f, maxStep = 0.f;
+        bool started = false;
+        numAudible = 0;
+
+        for (int b = 0; b < numBlocks; ++b)
+        {
+            for (int i = 0; i < blockSize; ++i, phase += delta)
+                for (int c = 0; c < numChannels; ++c)
+                    in.setSample (c, i, 0.5f * (float) std::sin (phase));
+
+            sender.write (in, blockSize);
+            sender.now += blockMs;
+            sender.sendPending (sender.now);
+            receiver.read (out, blockSize);
+
+            const float* samples = out.getReadPointer (0);
+            if (out.getMagnitude (0, 0, blockSize) > 0.f)
+                ++numAudible;
+            for (int i = 0; i < blockSize; ++i)
+            {
+                if (started)
+                    maxStep = jmax (maxStep, std::abs (samples[i] - last));
+                started = started || samples[i] != 0.f;
+                last = samples[i];
+            }
+        }
+
+        return maxStep;
+    }
+
+    void connect (LoopbackSender& sender, NetAudioReceiver& receiver)
+    {
+        sender.prepare (sampleRate, blockSize);
+        receiver.prepare (sampleRate, blockSize);
+        sender.connect ("127.0.0.1", 0, false);
+    }
+
+    void testLocalhost()
+    {
+        beginTest ("loopback");
+        NetAudioReceiver receiver (numChannels);
+        LoopbackSender sender (receiver);
+        sender.setPacking (true);
+        connect (sender, receiver);
+
+        int numAudible = 0;
+        const float maxStep = stream (sender, receiver, 400, numAudible);
+        const auto stats = receiver.getStats();
+        logMessage (String (stats.numReceived) + " packets, " + String (stats.targetMs, 1)
+            + " ms target, " + String (stats.jitterMs, 2) + " ms jitter, ratio " + String (stats.ratio, 5));
+
+        expect (sender.getStats().numSent == 400 * blockSize / 128);
+        expect (stats.numReceived == sender.getStats().numSent);
+        expect (stats.numLost == 0 && stats.numLate == 0);
+        expect (stats.numUnderruns == 0, String (stats.numUnderruns));
+        expect (numAudible > 390);
+
+        // a 200 Hz sine at half scale never steps more than about 0.013
+        expect (maxStep < 0.03f, String (maxStep));
+        expectWithinAbsoluteError (stats.ratio, 1.0, 0.006);
+
+        sender.disconnect();
+    }
+
+    void testImpaired()
+    {
+        beginTest ("loss and jitter");
+        NetAudioReceiver receiver (numChannels);
+        LoopbackSender sender (receiver);
+        sender.setImpairment (0.05f, 15.0);
+        connect (sender, receiver);
+
+        int numAudible = 0;
+        stream (sender, receiver, 600, numAudible);
+        const auto stats = receiver.getStats();
+        logMessage (String (stats.numLost) + " lost, " + String (stats.numLate) + " late, "
+            + String (stats.numUnderruns) + " underruns, " + String (stats.targetMs, 1) + " ms target, "
+            + String (stats.jitterMs, 2) + " ms jitter");
+
+        expect (stats.numLost > 0);
+        expect (stats.jitterMs > 1.0);
+        expect (stats.targetMs > 15.0);
+        expect (stats.targetMs <= 250.0);
+        expect (stats.numUnderruns < 10);
+        expect (numAudible > 400);
+
+        sender.disconnect();
+    }
+
+    void testRateMismatch()
+    {
+        beginTest ("sender and receiver rates differ");
+        const double senderRate = 48048.0;
+        NetAudioReceiver receiver (numChannels);
+        LoopbackSender sender (receiver);
+        sender.prepare (senderRate, blockSize);
+        receiver.prepare (sampleRate, blockSize);
+        sender.connect ("127.0.0.1", 0, false);
+
+        // the sender's clock makes a little more than a block each block
+        enum { numBlocks = 3000, numSettled = 500 };
+        AudioSampleBuffer in (numChannels, blockSize + 1), out (numChannels, blockSize);
+        const double framesPerBlock = blockSize * senderRate / sampleRate;
+        const double delta = MathConstants<double>::twoPi * 200.0 / senderRate;
+        const double blockMs = 1000.0 * blockSize / sampleRate;
+        double phase = 0.0, owed = 0.0;
+        double minRatio = 2.0, maxRatio = 0.0;
+
+        for (int b = 0; b < numBlocks; ++b)
+        {
+            owed += framesPerBlock;
+            const int numFrames = (int) owed;
+            owed -= numFrames;
+            for (int i = 0; i < numFrames; ++i, phase += delta)
+                for (int c = 0; c < numChannels; ++c)
+                    in.setSample (c, i, 0.5f * (float) std::sin (phase));
+
+            sender.write (in, numFrames);
+            sender.now += blockMs;
+            sender.sendPending (sender.now);
+            receiver.read (out, blockSize);
+
+            if (b >= numBlocks - numSettled)
+            {
+                const double ratio = receiver.getStats().ratio;
+                minRatio = jmin (minRatio, ratio);
+                maxRatio = jmax (maxRatio, ratio);
+            }
+        }
+
+        const auto stats = receiver.getStats();
+        logMessage ("ratio " + String (minRatio, 6) + " to " + String (maxRatio, 6) + ", "
+            + String (stats.bufferedMs, 1) + " ms buffered, " + String (stats.targetMs, 1) + " ms target");
+
+        // settles on the rate difference and stays there
+        const double expected = senderRate / sampleRate;
+        expectWithinAbsoluteError (minRatio, expected, 0.0005);
+        expectWithinAbsoluteError (maxRatio, expected, 0.0005);
+        expectEquals ((int) stats.numUnderruns, 0);
+        expectEquals ((int) stats.numLost, 0);
+
+        sender.disconnect();
+    }
+
+    void testSocket()
+    {
+        beginTest ("impaired stream over a localhost socket");
+        NetAudioReceiver receiver (numChannels);
+        if (! receiver.connect (0))
+        {
+            logMessage ("could not open a localhost port, skipping");
+            return;
+        }
+
+        NetAudioSender sender (numChannels);
+        sender.setImpairment (0.05f, 5.0);
+        sender.prepare (sampleRate, blockSize);
+        receiver.prepare (sampleRate, blockSize);
+        expect (sender.connect ("127.0.0.1", receiver.getPort()));
+
+        // real time pacing, the threads and the socket do the rest
+        enum { numBlocks = 400 };
+        AudioSampleBuffer in (numChannels, blockSize), out (numChannels, blockSize);
+        const double delta = MathConstants<double>::twoPi * 200.0 / sampleRate;
+        const double blockMs = 1000.0 * blockSize / sampleRate;
+        double phase = 0.0;
+        int numAudible = 0;
+        double nextMs = Time::getMillisecondCounterHiRes();
+
+        for (int b = 0; b < numBlocks; ++b)
+        {
+            for (int i = 0; i < blockSize; ++i, phase += delta)
+                for (int c = 0; c < numChannels; ++c)
+                    in.setSample (c, i, 0.5f * (float) std::sin (phase));
+
+            sender.write (in, blockSize);
+            receiver.read (out, blockSize);
+            if (out.getMagnitude (0, 0, blockSize) > 0.f)
+                ++numAudible;
+
+            nextMs += blockMs;
+            const double waitMs = nextMs - Time::getMillisecondCounterHiRes();
+            if (waitMs > 1.0)
+                Thread::sleep ((int) waitMs);
+        }
+
+        sender.disconnect();
+        Thread::sleep (50);
+        const auto sent = sender.getStats();
+        const auto stats = receiver.getStats();
+        receiver.disconnect();
+        logMessage (String (sent.numSent) + " sent, " + String (stats.numReceived) + " received, "
+            + String (stats.numLost) + " lost, " + String (stats.numUnderruns) + " underruns, "
+            + String (stats.jitterMs, 2) + " ms jitter, " + String (stats.targetMs, 1) + " ms target");
+
+        // about one in twenty is dropped before it reaches the socket
+        expect (sent.numSent > 0);
+        expect (sent.numSent < numBlocks * blockSize / 128);
+        expect (stats.numReceived > 0 && stats.numReceived <= sent.numSent);
+        expect (stats.numReceived >= sent.numSent * 9 / 10);
+        expect (stats.numLost > 0);
+        expect (stats.jitterMs > 0.0);
+        expect (stats.targetMs >= 5.0);
+        expect (numAudible > numBlocks / 2, String (numAudible));
+    }
+
+    void testNodes()
+    {
+        beginTest ("nodes");
+        GraphProcessor graph;
+        graph.setPlayConfigDetails (2, 2, sampleRate, blockSize);
+        graph.prepareToPlay (sampleRate, blockSize);
+        GraphNodePtr sendPtr = graph.addNode (new NetAudioSendNode());
+        GraphNodePtr receivePtr = graph.addNode (new NetAudioReceiveNode());
+        MessageManager::getInstance()->runDispatchLoopUntil (10);
+        auto& send = *dynamic_cast<NetAudioSendNode*> (sendPtr.get());
+        auto& receive = *dynamic_cast<NetAudioReceiveNode*> (receivePtr.get());
+        expect (send.getNumAudioInputs() == numChannels && send.getNumAudioOutputs() == 0);
+        expect (receive.getNumAudioInputs() == 0 && receive.getNumAudioOutputs() == numChannels);
+
+        PluginDescription desc;
+        send.getPluginDescription (desc);
+        expect (desc.fileOrIdentifier == EL_INTERNAL_ID_NET_AUDIO_SEND);
+        receive.getPluginDescription (desc);
+        expect (desc.fileOrIdentifier == EL_INTERNAL_ID_NET_AUDIO_RECEIVE);
+
+        const int port = 20000 + Random::getSystemRandom().nextInt (20000);
+        if (! receive.connect (port) || ! send.connect ("127.0.0.1", port))
+        {
+            logMessage ("could not open a localhost port, skipping");
+            return;
+        }
+
+        send.setPacking (true);
+        MemoryBlock state;
+        send.getState (state);
+        send.disconnect();
+        expect (! send.isConnected());
+        send.setState (state.getData(), (int) state.getSize());
+        expect (send.isConnected() && send.isPacking() && send.getPortNumber() == port);
+
+        receive.getState (state);
+        receive.disconnect();
+        receive.setState (state.getData(), (int) state.getSize());
+        expect (receive.isConnected() && receive.getPortNumber() == port);
+
+        send.disconnect();
+        receive.disconnect();
+        graph.clear();
+    }
+};
+
+static NetAudioTest sNetAudioTest;
+
+}
@@ -0,0 +1,192 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "engine/OSCMidiMatcher.h"
+#include "engine/nodes/OSCReceiverNode.h"
+
+namespace Element {
+
+class OSCMidiMatcherTest : public UnitTestBase
+{
+public:
+    OSCMidiMatcherTest() : UnitTestBase ("OSC MIDI Matcher", "engine", "oscMidiMatcher") { }
+    virtual ~OSCMidiMatcherTest() { }
+
+    void runTest() override
+    {
+        testMatch();
+        testWildcards();
+        testToMidi();
+        testLocalhost();
+    }
+
+private:
+    enum { blockSize = 256 };
+
+    void testMatch()
+    {
+        beginTest ("match");
+        expect (OSCMidiMatcher::match ("/midi/noteOn") == OSCMidiMatcher::noteOn);
+        expect (OSCMidiMatcher::match ("/midi/device/controlChange") == OSCMidiMatcher::controlChange);
+        expect (OSCMidiMatcher::match ("/midi/continue") == OSCMidiMatcher::continuePlaying);
+        expect (OSCMidiMatcher::match ("/midi/songPositionPointer/") == OSCMidiMatcher::songPositionPointer);
+        expect (OSCMidiMatcher::match ("/midi/noteon") == OSCMidiMatcher::unknown);
+        expect (OSCMidiMatcher::match ("/midi") == OSCMidiMatcher::unknown);
+        expect (OSCMidiMatcher::match ("/other/noteOn") == OSCMidiMatcher::unknown);
+        expect (OSCMidiMatcher::match ("/midi/a/b/noteOn") == OSCMidiMatcher::unknown);
+        expect (OSCMidiMatcher::match ("midi/noteOn") == OSCMidiMatcher::unknown);
+
+        for (int c = 1; c < OSCMidiMatcher::numCommands; ++c)
+        {
+            const auto command = (OSCMidiMatcher::Command) c;
+            const String address = String ("/midi/") + OSCMidiMatcher::getCommandName (command);
+            expect (OSCMidiMatcher::match (address.toRawUTF8()) == command, address);
+        }
+    }
+
+    void testWildcards()
+    {
+        beginTest ("wildcards");
+        expect (OSCMidiMatcher::match ("/midi/note?n") == OSCMidiMatcher::noteOn);
+        expect (OSCMidiMatcher::match ("/midi/*/controlCh*") == OSCMidiMatcher::controlChange);
+        expect (OSCMidiMatcher::match ("/m?di/{start,stop}") == OSCMidiMatcher::start);
+        expect (OSCMidiMatcher::match ("/midi/[a-c]lock") == OSCMidiMatcher::clock);
+        expect (OSCMidiMatcher::match ("/midi/[!c]lock") == OSCMidiMatcher::unknown);
+        expect (OSCMidiMatcher::match ("/midi/x*") == OSCMidiMatcher::unknown);
+    }
+
+    void testToMidi()
+    {
+        beginTest ("to midi");
+        MidiMessage midi;
+
+        expect (OSCMidiMatcher::toMidi (OSCMessage ("/midi/noteOn", 2, 60, 100), midi));
+        expect (midi.isNoteOn() && midi.getChannel() == 2 && midi.getNoteNumber() == 60 && midi.getVelocity() == 100);
+
+        expect (OSCMidiMatcher::toMidi (OSCMessage ("/midi/noteOn", 1, 60, 0.5f), midi));
+        expect (midi.isNoteOn() && midi.getVelocity() == 64);
+
+        expect (OSCMidiMatcher::toMidi (OSCMessage ("/midi/programChange", 3, 10), midi));
+        expect (midi.isProgramChange() && midi.getProgramChangeNumber() == 10);
+
+        expect (OSCMidiMatcher::toMidi (OSCMessage ("/midi/channelPressure", 1, 90), midi));
+        expect (midi.isChannelPressure() && midi.getChannelPressureValue() == 90);
+
+        expect (OSCMidiMatcher::toMidi (OSCMessage ("/midi/dev/controlChange", 1, 7, 99.f), midi));
+        expect (midi.isController() && midi.getControllerNumber() == 7 && midi.getControllerValue() == 99);
+
+        const uint8 bytes[] = { 0x90, 64, 127 };
+        OSCMessage rawMessage ("/midi/raw");
+        rawMessage.addBlob (MemoryBlock (bytes, sizeof (bytes)));
+        expect (OSCMidiMatcher::toMidi (rawMessage, midi));
+        expect (midi.isNoteOn() && midi.getNoteNumber() == 64);
+
+        expect (! OSCMidiMatcher::toMidi (OSCMessage ("/midi/noteOn", 1, 60), midi));
+        expect (! OSCMidiMatcher::toMidi (OSCMessage ("/midi/activeSense"), midi));
+        expect (! OSCMidiMatcher::toMidi (OSCMessage ("/element/command"), midi));
+    }
+
+    /** Renders a block from the node and returns the number of MIDI events */
+    static int renderBlock (OSCReceiverNode& node)
+    {
+        OwnedArray<MidiBuffer> buffers;
+        Array<int> channels;
+        buffers.add (new MidiBuffer());
+        channels.add (0);
+        MidiPipe pipe (buffers, channels);
+        AudioSampleBuffer audio (1, blockSize);
+        node.render (audio, pipe);
+        return pipe.getReadBuffer (0)->getNumEvents();
+    }
+
+    void testLocalhost()
+    {
+        beginTest ("localhost load");
+        GraphNodePtr ptr = new OSCReceiverNode();
+        auto& node = *dynamic_cast<OSCReceiverNode*> (ptr.get());
+        node.prepareToRender (48000.0, blockSize);
+
+        const int port = 20000 + Random::getSystemRandom().nextInt (20000);
+        OSCSender sender;
+        if (! node.connect (port) || ! sender.connect ("127.0.0.1", port))
+        {
+            logMessage ("could not open a localhost port, skipping");
+            return;
+        }
+
+        enum { numMessages = 20000, burstSize = 50 };
+        int received = 0;
+        const double start = Time::getMillisecondCounterHiRes();
+        for (int i = 0; i < numMessages; ++i)
+        {
+            if (i % 4 == 3)
+            {
+                OSCBundle bundle;
+                bundle.addElement (OSCMessage ("/midi/controlChange", 1, 7, i % 128));
+                sender.send (bundle);
+            }
+            else
+            {
+                sender.send (OSCMessage ("/midi/controlChange", 1, 7, i % 128));
+            }
+
+            if (i % burstSize == burstSize - 1)
+            {
+                Thread::sleep (1);
+                received += renderBlock (node);
+            }
+        }
+
+        for (int i = 0; i < 100 && received < numMessages; ++i)
+        {
+            Thread::sleep (5);
+            received += renderBlock (node);
+        }
+
+        const double elapsedMs = Time::getMillisecondCounterHiRes() - start;
+        logMessage (String (received) + " of " + String (numMessages) + " received, "
+            + String (received / elapsedMs * 1000.0, 0) + " messages per second");
+        expect (received >= numMessages * 9 / 10);
+
+        beginTest ("bundle time tag");
+        while (renderBlock (node) > 0) {}
+        OSCBundle bundle (OSCTimeTag (Time::getCurrentTime() + RelativeTime::milliseconds (100)));
+        bundle.addElement (OSCMessage ("/midi/noteOn", 1, 60, 100));
+        const double sent = Time::getMillisecondCounterHiRes();
+        sender.send (bundle);
+
+        double arrived = 0.0;
+        while (arrived == 0.0 && Time::getMillisecondCounterHiRes() - sent < 1000.0)
+        {
+            Thread::sleep (5);
+            if (renderBlock (node) > 0)
+                arrived = Time::getMillisecondCounterHiRes();
+        }
+
+        logMessage (String ("scheduled 100 ms ahead, rendered after ") + String (arrived - sent, 1) + " ms");
+        expect (arrived - sent >= 90.0);
+        expect (arrived - sent < 300.0);
+
+        node.disconnect();
+    }
+};
+
+static OSCMidiMatcherTest sOSCMidiMatcherTest;
+
+}
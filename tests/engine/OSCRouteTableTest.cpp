@@ -0,0 +1,139 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "engine/OSCRouteTable.h"
+
+namespace Element {
+
+class OSCRouteTableTest : public UnitTestBase
+{
+public:
+    OSCRouteTableTest() : UnitTestBase ("OSC Route Table", "engine", "oscRouteTable") { }
+    virtual ~OSCRouteTableTest() { }
+
+    void runTest() override
+    {
+        testLookup();
+        testManyRoutes();
+        testWildcards();
+    }
+
+private:
+    enum { numNodes = 20, numParams = 500 };
+
+    static String getParamAddress (int node, int param)
+    {
+        return String ("/el/graph/0/node/") + String (node) + "/param/" + String (param);
+    }
+
+    static OSCRoute makeRoute (OSCRoute::Kind kind, int index = -1)
+    {
+        OSCRoute route;
+        route.kind = kind;
+        route.index = index;
+        return route;
+    }
+
+    void testLookup()
+    {
+        beginTest ("lookup");
+        OSCRouteTable table;
+        expect (table.find ("/el/transport/play") == nullptr);
+
+        table.add ("/el/transport/play", makeRoute (OSCRoute::play));
+        table.add ("/el/transport/stop", makeRoute (OSCRoute::stop));
+        expectEquals (table.size(), 2);
+
+        auto* route = table.find ("/el/transport/play");
+        expect (route != nullptr && route->kind == OSCRoute::play);
+        expect (table.find (String ("/el/transport/stop"))->kind == OSCRoute::stop);
+        expect (table.find ("/el/transport/pla") == nullptr);
+        expect (table.find ("/el/transport/play/") == nullptr);
+        expect (table.find ("") == nullptr);
+
+        // same address replaces
+        table.add ("/el/transport/play", makeRoute (OSCRoute::record));
+        expectEquals (table.size(), 2);
+        expect (table.find ("/el/transport/play")->kind == OSCRoute::record);
+    }
+
+    void testManyRoutes()
+    {
+        beginTest ("many routes");
+        OSCRouteTable table;
+        for (int n = 0; n < numNodes; ++n)
+            for (int p = 0; p < numParams; ++p)
+                table.add (getParamAddress (n, p), makeRoute (OSCRoute::parameter, p));
+        expectEquals (table.size(), numNodes * numParams);
+
+        int numFound = 0;
+        for (int n = 0; n < numNodes; ++n)
+        {
+            for (int p = 0; p < numParams; ++p)
+            {
+                auto* route = table.find (getParamAddress (n, p));
+                if (route != nullptr && route->index == p)
+                    ++numFound;
+            }
+        }
+
+        expectEquals (numFound, numNodes * numParams);
+        expect (table.find (getParamAddress (numNodes, 0)) == nullptr);
+        expect (table.find (getParamAddress (0, numParams)) == nullptr);
+
+        // a desk sending hundreds of parameters at 50 Hz is a few thousand lookups per second
+        StringArray addresses;
+        for (int i = 0; i < 1000; ++i)
+            addresses.add (getParamAddress (i % numNodes, (i * 7) % numParams));
+
+        const double start = Time::getMillisecondCounterHiRes();
+        int numHits = 0;
+        for (int i = 0; i < 200; ++i)
+            for (const auto& address : addresses)
+                if (table.find (address) != nullptr)
+                    ++numHits;
+        const double elapsedMs = Time::getMillisecondCounterHiRes() - start;
+
+        expectEquals (numHits, 200 * addresses.size());
+        logMessage (String (numHits / jmax (0.001, elapsedMs) * 1000.0, 0) + " lookups per second");
+    }
+
+    void testWildcards()
+    {
+        beginTest ("wildcards");
+        OSCRouteTable table;
+        for (int n = 0; n < 4; ++n)
+        {
+            const String path = String ("/el/graph/0/node/") + String (n);
+            table.add (path + "/mute", makeRoute (OSCRoute::mute));
+            table.add (path + "/bypass", makeRoute (OSCRoute::bypass));
+        }
+
+        int numMuted = 0;
+        expectEquals (table.findMatches (OSCAddressPattern ("/el/graph/0/node/*/mute"),
+            [&numMuted] (const OSCRoute& route) { if (route.kind == OSCRoute::mute) ++numMuted; }), 4);
+        expectEquals (numMuted, 4);
+        expectEquals (table.findMatches (OSCAddressPattern ("/el/graph/0/node/[12]/*"), nullptr), 4);
+        expectEquals (table.findMatches (OSCAddressPattern ("/el/graph/1/node/*/mute"), nullptr), 0);
+    }
+};
+
+static OSCRouteTableTest sOSCRouteTableTest;
+
+}
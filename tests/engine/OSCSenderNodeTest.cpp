@@ -0,0 +1,222 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "engine/nodes/OSCSenderNode.h"
+#include "Utils.h"
+
+namespace Element {
+
+class OSCSenderNodeTest : public UnitTestBase,
+                          private OSCReceiver::Listener<OSCReceiver::RealtimeCallback>
+{
+public:
+    OSCSenderNodeTest() : UnitTestBase ("OSC Sender Node", "engine", "oscSenderNode") { }
+    virtual ~OSCSenderNodeTest() { }
+
+    void runTest() override
+    {
+        testTimeTags();
+
+        const int port = 20000 + Random::getSystemRandom().nextInt (20000);
+        if (! receiver.connect (port))
+        {
+            logMessage ("could not open a localhost port, skipping");
+            return;
+        }
+
+        receiver.addListener (this);
+        testUnbatched (port);
+        testBatched (port, false);
+        testBatched (port, true);
+        testCoalescedOrder (port);
+        receiver.removeListener (this);
+        receiver.disconnect();
+    }
+
+private:
+    enum { blockSize = 256, numBlocks = 1000, eventsPerBlock = 32 };
+
+    OSCReceiver receiver;
+    std::atomic<int> numMessages { 0 }, numBundles { 0 }, numTimeTagged { 0 };
+
+    CriticalSection addressLock;
+    StringArray addresses;
+
+    void oscMessageReceived (const OSCMessage& message) override
+    {
+        numMessages.fetch_add (1);
+        const ScopedLock sl (addressLock);
+        addresses.add (message.getAddressPattern().toString());
+    }
+    void oscBundleReceived (const OSCBundle& bundle) override
+    {
+        numBundles.fetch_add (1);
+        if (! bundle.getTimeTag().isImmediately())
+            numTimeTagged.fetch_add (1);
+        countMessages (bundle);
+    }
+
+    void countMessages (const OSCBundle& bundle)
+    {
+        for (const auto& element : bundle)
+        {
+            if (element.isMessage())
+            {
+                numMessages.fetch_add (1);
+                const ScopedLock sl (addressLock);
+                addresses.add (element.getMessage().getAddressPattern().toString());
+            }
+            else if (element.isBundle())
+                countMessages (element.getBundle());
+        }
+    }
+
+    void resetCounts()
+    {
+        numMessages.store (0);
+        numBundles.store (0);
+        numTimeTagged.store (0);
+        const ScopedLock sl (addressLock);
+        addresses.clearQuick();
+    }
+
+    /** Waits for the receiver to settle, then logs throughput and CPU use */
+    int report (const String& name, double startMs, std::clock_t startCpu)
+    {
+        for (int last = -1; last != numMessages.load();)
+        {
+            last = numMessages.load();
+            Thread::sleep (50);
+        }
+
+        const double elapsedMs = Time::getMillisecondCounterHiRes() - startMs;
+        const double cpuMs = 1000.0 * (double) (std::clock() - startCpu) / CLOCKS_PER_SEC;
+        const int received = numMessages.load();
+        logMessage (name + ": " + String (received) + " messages in " + String (numBundles.load())
+            + " bundles, " + String (received / elapsedMs * 1000.0, 0) + " messages per second, "
+            + String (cpuMs, 1) + " ms cpu");
+        return received;
+    }
+
+    void testTimeTags()
+    {
+        beginTest ("time tags");
+        const double nowMs = Time::getMillisecondCounterHiRes();
+        for (const double offset : { 0.0, 12.5, 250.0 })
+        {
+            const auto tag = Util::millisecondCounterToOscTimeTag (nowMs + offset);
+            expectWithinAbsoluteError (Util::oscTimeTagToMillisecondCounter (tag), nowMs + offset, 2.0);
+        }
+    }
+
+    /** The old behavior, one datagram per message */
+    void testUnbatched (int port)
+    {
+        beginTest ("unbatched baseline");
+        OSCSender sender;
+        expect (sender.connect ("127.0.0.1", port));
+        resetCounts();
+
+        const double startMs = Time::getMillisecondCounterHiRes();
+        const auto startCpu = std::clock();
+        for (int b = 0; b < numBlocks; ++b)
+        {
+            for (int i = 0; i < eventsPerBlock; ++i)
+                sender.send (Util::processMidiToOscMessage (MidiMessage::controllerEvent (1, i, b % 128)));
+            Thread::sleep (1);
+        }
+
+        report ("unbatched", startMs, startCpu);
+    }
+
+    void testBatched (int port, bool coalesce)
+    {
+        beginTest (coalesce ? "batched and coalesced" : "batched");
+        GraphNodePtr ptr = new OSCSenderNode();
+        auto& node = *dynamic_cast<OSCSenderNode*> (ptr.get());
+        node.setCoalescing (coalesce);
+        node.prepareToRender (48000.0, blockSize);
+        expect (node.connect ("127.0.0.1", port));
+        resetCounts();
+
+        OwnedArray<MidiBuffer> buffers;
+        Array<int> channels;
+        buffers.add (new MidiBuffer());
+        channels.add (0);
+        MidiPipe pipe (buffers, channels);
+        AudioSampleBuffer audio (1, blockSize);
+
+        const double startMs = Time::getMillisecondCounterHiRes();
+        const auto startCpu = std::clock();
+        for (int b = 0; b < numBlocks; ++b)
+        {
+            // each controller is sent twice a block, once at the start and once later
+            auto& midi = *pipe.getWriteBuffer (0);
+            for (int i = 0; i < eventsPerBlock; ++i)
+                midi.addEvent (MidiMessage::controllerEvent (1, i % (eventsPerBlock / 2), b % 128),
+                               i < eventsPerBlock / 2 ? 0 : i * (blockSize / eventsPerBlock));
+            node.render (audio, pipe);
+            Thread::sleep (1);
+        }
+
+        const int received = report (coalesce ? "coalesced" : "batched", startMs, startCpu);
+        const int expected = numBlocks * (coalesce ? eventsPerBlock / 2 : eventsPerBlock);
+        expect (received >= expected * 9 / 10 && received <= expected);
+        expect (numBundles.load() > 0 && numTimeTagged.load() == numBundles.load());
+        expectEquals (node.getNumDropped(), 0);
+        expect (node.getOscMessages().size() <= 100);
+        node.disconnect();
+    }
+
+    void testCoalescedOrder (int port)
+    {
+        beginTest ("coalesced controllers keep their order");
+        GraphNodePtr ptr = new OSCSenderNode();
+        auto& node = *dynamic_cast<OSCSenderNode*> (ptr.get());
+        node.setCoalescing (true);
+        node.prepareToRender (48000.0, blockSize);
+        expect (node.connect ("127.0.0.1", port));
+        resetCounts();
+
+        OwnedArray<MidiBuffer> buffers;
+        Array<int> channels;
+        buffers.add (new MidiBuffer());
+        channels.add (0);
+        MidiPipe pipe (buffers, channels);
+        AudioSampleBuffer audio (1, blockSize);
+
+        // the sustain release must still follow the note off
+        auto& midi = *pipe.getWriteBuffer (0);
+        midi.addEvent (MidiMessage::controllerEvent (1, 64, 127), 0);
+        midi.addEvent (MidiMessage::noteOff (1, 60), 10);
+        midi.addEvent (MidiMessage::controllerEvent (1, 64, 0), 20);
+        node.render (audio, pipe);
+        report ("ordered", Time::getMillisecondCounterHiRes(), std::clock());
+
+        const ScopedLock sl (addressLock);
+        expectEquals (addresses.size(), 2);
+        expect (addresses[0].endsWith ("noteOff"));
+        expect (! addresses[1].endsWith ("noteOff"));
+        node.disconnect();
+    }
+};
+
+static OSCSenderNodeTest sOSCSenderNodeTest;
+
+}
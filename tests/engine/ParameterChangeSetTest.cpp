@@ -0,0 +1,124 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "engine/ParameterChangeSet.h"
+
+namespace Element {
+
+class ParameterChangeSetTest : public UnitTestBase
+{
+public:
+    ParameterChangeSetTest() : UnitTestBase ("Parameter Change Set", "engine", "parameterChanges") { }
+    virtual ~ParameterChangeSetTest() { }
+
+    void runTest() override
+    {
+        testCoalesce();
+        testGrow();
+        testThreads();
+    }
+
+private:
+    void testCoalesce()
+    {
+        beginTest ("changes are coalesced");
+        ParameterChangeSet set;
+        set.setNumParameters (100);
+        expect (! set.isDirty());
+
+        for (int i = 0; i < 1000; ++i)
+            set.mark (i % 10 == 0 ? 99 : 3);
+        set.mark (64);
+        set.mark (100); // out of range
+        set.mark (-1);
+        expect (set.isDirty());
+
+        int numCalls = 0;
+        Array<int> received;
+        set.onChanged = [&] (const Array<int>& indexes) { ++numCalls; received = indexes; };
+        set.dispatch();
+        expectEquals (numCalls, 1);
+        expectEquals (received.size(), 3);
+        expectEquals (received[0], 3);
+        expectEquals (received[1], 64);
+        expectEquals (received[2], 99);
+
+        beginTest ("nothing to dispatch after collecting");
+        expect (! set.isDirty());
+        set.dispatch();
+        expectEquals (numCalls, 1);
+    }
+
+    void testGrow()
+    {
+        beginTest ("growing keeps marks");
+        ParameterChangeSet set;
+        set.setNumParameters (8);
+        set.mark (5);
+        set.setNumParameters (500);
+        set.mark (499);
+        Array<int> indexes;
+        expectEquals (set.collect (indexes), 2);
+        expectEquals (indexes[0], 5);
+        expectEquals (indexes[1], 499);
+    }
+
+    void testThreads()
+    {
+        beginTest ("marking from many threads");
+        ParameterChangeSet set;
+        set.setNumParameters (512);
+
+        struct Marker : public Thread
+        {
+            Marker (ParameterChangeSet& s, int o) : Thread ("marker"), set (s), offset (o) { }
+            void run() override
+            {
+                for (int i = 0; i < 100000; ++i)
+                    set.mark (offset + (i % 128));
+            }
+            ParameterChangeSet& set;
+            const int offset;
+        };
+
+        OwnedArray<Marker> markers;
+        for (int i = 0; i < 4; ++i)
+            markers.add (new Marker (set, i * 128))->startThread();
+
+        BigInteger seen;
+        Array<int> indexes;
+        auto collect = [&]()
+        {
+            set.collect (indexes);
+            for (const auto index : indexes)
+                seen.setBit (index);
+        };
+
+        for (auto* marker : markers)
+            while (marker->isThreadRunning())
+                collect();
+        collect();
+
+        expectEquals (seen.countNumberOfSetBits(), 512);
+    }
+};
+
+static ParameterChangeSetTest sParameterChangeSetTest;
+
+}
@@ -0,0 +1,115 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "engine/ParameterEventQueue.h"
+
+namespace Element {
+
+class ParameterEventQueueTest : public UnitTestBase
+{
+public:
+    ParameterEventQueueTest() : UnitTestBase ("Parameter Event Queue", "engine", "parameterEvents") { }
+    virtual ~ParameterEventQueueTest() { }
+
+    void runTest() override
+    {
+        testOffsets();
+        testGranularity();
+        testPending();
+        testOverflow();
+    }
+
+private:
+    // one sample per millisecond keeps the math readable
+    enum { sampleRate = 1000, blockSize = 100 };
+
+    void testOffsets()
+    {
+        beginTest ("events are placed where they happened");
+        ParameterEventQueue queue (16);
+        queue.prepare (sampleRate);
+        const double now = Time::getMillisecondCounterHiRes();
+        expect (queue.post (1, 0.25f, now - 20.0));
+        expect (queue.post (0, 0.5f,  now - 80.0));
+        expect (queue.post (2, 0.75f, now - 5000.0));
+
+        expectEquals (queue.collect (blockSize, 1), 3);
+        expectEquals (queue.getEvent(0).parameter, 2);
+        expectEquals (queue.getEvent(0).frame, 0);  // older than the block
+        expectEquals (queue.getEvent(1).parameter, 0);
+        expect (queue.getEvent(1).frame > 0 && queue.getEvent(1).frame <= 20);
+        expectEquals (queue.getEvent(2).parameter, 1);
+        expect (queue.getEvent(2).frame > 60 && queue.getEvent(2).frame <= 80);
+        expectEquals (queue.getEvent(2).value, 0.25f);
+
+        beginTest ("the block is cleared on the next collect");
+        expectEquals (queue.collect (blockSize, 1), 0);
+        expectEquals (queue.getNumEvents(), 0);
+    }
+
+    void testGranularity()
+    {
+        beginTest ("granularity");
+        ParameterEventQueue queue (16);
+        queue.prepare (sampleRate);
+        const double now = Time::getMillisecondCounterHiRes();
+        queue.post (0, 0.1f, now - 70.0);
+        queue.post (0, 0.2f, now - 30.0);
+        expectEquals (queue.collect (blockSize, 16), 2);
+        for (int i = 0; i < queue.getNumEvents(); ++i)
+            expectEquals (queue.getEvent(i).frame % 16, 0);
+
+        beginTest ("granularity of zero places events at the start");
+        queue.post (0, 0.1f, now - 70.0);
+        queue.post (0, 0.2f, now - 30.0);
+        expectEquals (queue.collect (blockSize, 0), 2);
+        expectEquals (queue.getEvent(0).frame, 0);
+        expectEquals (queue.getEvent(1).frame, 0);
+        expectEquals (queue.getEvent(1).value, 0.2f); // posted order is kept
+    }
+
+    void testPending()
+    {
+        beginTest ("events posted after the block started wait");
+        ParameterEventQueue queue (16);
+        queue.prepare (sampleRate);
+        queue.post (0, 1.f, Time::getMillisecondCounterHiRes() + 60000.0);
+        expectEquals (queue.collect (blockSize, 1), 0);
+        expectEquals (queue.getNumPending(), 1);
+    }
+
+    void testOverflow()
+    {
+        beginTest ("overflow");
+        ParameterEventQueue queue (4);
+        queue.prepare (sampleRate);
+        const double now = Time::getMillisecondCounterHiRes();
+        int numPosted = 0;
+        for (int i = 0; i < 8; ++i)
+            if (queue.post (i, 0.f, now - 10.0))
+                ++numPosted;
+        expect (numPosted < 8);
+        expectEquals (queue.collect (blockSize, 1), numPosted);
+        expect (queue.post (0, 0.f, now - 10.0));
+    }
+};
+
+static ParameterEventQueueTest sParameterEventQueueTest;
+
+}
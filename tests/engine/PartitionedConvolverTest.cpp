@@ -0,0 +1,340 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "engine/PartitionedConvolver.h"
+#include "engine/nodes/ConvolutionProcessor.h"
+
+namespace Element {
+
+class PartitionedConvolverTest : public UnitTestBase
+{
+public:
+    PartitionedConvolverTest() : UnitTestBase ("Partitioned Convolver", "engine", "partitionedConvolver") { }
+    virtual ~PartitionedConvolverTest() { }
+
+    void runTest() override
+    {
+        testHeadIsExact();
+        testPartitions();
+        testTrueStereo();
+        testSwap();
+        testOverruns();
+        testBenchmark();
+    }
+
+private:
+    Random random { 0x5eed };
+
+    void fillNoise (float* data, int numSamples, float decay = 0.0f)
+    {
+        for (int i = 0; i < numSamples; ++i)
+            data[i] = (random.nextFloat() * 2.0f - 1.0f) * std::exp (-decay * (float) i / (float) numSamples);
+    }
+
+    /** Direct convolution, summed in tap order like the convolver's head */
+    static void convolve (const float* h, int length, const float* x, float* y, int numSamples)
+    {
+        for (int n = 0; n < numSamples; ++n)
+        {
+            float sum = 0.0f;
+            for (int k = 0; k < length && k <= n; ++k)
+                sum += h[k] * x[n - k];
+            y[n] = sum;
+        }
+    }
+
+    /** Processes in blocks of random size up to maxBlockSize, optionally
+        sleeping between them so a worker keeps up */
+    void process (PartitionedConvolver& convolver, const float* x, float* y, int numSamples,
+                  int maxBlockSize, int sleepMs = 0)
+    {
+        for (int start = 0; start < numSamples;)
+        {
+            const int num = jmin (numSamples - start, 1 + random.nextInt (maxBlockSize));
+            convolver.process (x + start, y + start, num);
+            start += num;
+            if (sleepMs > 0)
+                Thread::sleep (sleepMs);
+        }
+    }
+
+    void testHeadIsExact()
+    {
+        beginTest ("short impulse is exact");
+        const int numSamples = 4000;
+        HeapBlock<float> x (numSamples), y (numSamples), expected (numSamples);
+        fillNoise (x, numSamples);
+
+        for (const int length : { 1, 7, 33, (int) PartitionedConvolver::defaultHeadSize })
+        {
+            HeapBlock<float> h (length);
+            fillNoise (h, length);
+            PartitionedConvolver convolver (h, length, 300);
+            expect (convolver.getNumStages() == 0);
+
+            process (convolver, x, y, numSamples, 300);
+            convolve (h, length, x, expected, numSamples);
+
+            int numDifferent = 0;
+            for (int i = 0; i < numSamples; ++i)
+                if (y[i] != expected[i])
+                    ++numDifferent;
+            expect (numDifferent == 0, String (length) + " taps, " + String (numDifferent) + " samples differ");
+        }
+    }
+
+    void testPartitions()
+    {
+        beginTest ("partitions");
+        const int numSamples = 48000, maxBlockSize = 256;
+        HeapBlock<float> x (numSamples), y (numSamples), threaded (numSamples);
+        fillNoise (x, numSamples);
+
+        for (const int length : { 65, 1000, 5000, 20000 })
+        {
+            HeapBlock<float> h (length);
+            fillNoise (h, length, 3.0f);
+
+            // a small largest partition gives every kind of stage with these lengths
+            PartitionedConvolver convolver (h, length, maxBlockSize, 64, 1024);
+            PartitionedConvolver background (h, length, maxBlockSize, 64, 1024);
+            ConvolutionWorker worker;
+            worker.add (&background);
+            worker.start();
+            process (convolver, x, y, numSamples, maxBlockSize);
+            process (background, x, threaded, numSamples, maxBlockSize, 1);
+            worker.stop();
+            worker.remove (&background);
+
+            double maxError = 0.0, peak = 0.0;
+            bool sameWithWorker = true;
+            for (int n = 0; n < numSamples; ++n)
+            {
+                double sum = 0.0;
+                for (int k = 0; k < length && k <= n; ++k)
+                    sum += (double) h[k] * (double) x[n - k];
+                peak = jmax (peak, std::abs (sum));
+                maxError = jmax (maxError, std::abs (sum - (double) y[n]));
+                sameWithWorker = sameWithWorker && y[n] == threaded[n];
+            }
+
+            const String name (String (length) + " taps, " + String (convolver.getNumStages()) + " stages");
+            expect (maxError < 1.0e-5 * peak, name + ", error " + String (maxError / peak));
+            expect (sameWithWorker, name + " differs with a worker");
+            expectEquals (background.getNumOverruns(), 0);
+
+            // the output doesn't depend on how the input is split into blocks
+            convolver.reset();
+            process (convolver, x, threaded, numSamples, maxBlockSize);
+            int numDifferent = 0;
+            for (int n = 0; n < numSamples; ++n)
+                if (y[n] != threaded[n])
+                    ++numDifferent;
+            expect (numDifferent == 0, name + " differs after reset");
+        }
+    }
+
+    void testTrueStereo()
+    {
+        beginTest ("true stereo");
+        const int numSamples = 2048, length = 40;
+        AudioBuffer<float> ir (4, length);
+        for (int ch = 0; ch < 4; ++ch)
+            fillNoise (ir.getWritePointer (ch), length);
+
+        ConvolutionProcessor processor;
+        processor.setImpulseResponse (ir, 48000.0);
+        processor.prepareToPlay (48000.0, 512);
+
+        AudioBuffer<float> input (2, numSamples), buffer (2, numSamples);
+        fillNoise (input.getWritePointer (0), numSamples);
+        fillNoise (input.getWritePointer (1), numSamples);
+        buffer.makeCopyOf (input);
+
+        MidiBuffer midi;
+        for (int start = 0; start < numSamples; start += 512)
+        {
+            AudioBuffer<float> block (buffer.getArrayOfWritePointers(), 2, start, 512);
+            processor.processBlock (block, midi);
+        }
+
+        HeapBlock<float> a (numSamples), b (numSamples);
+        for (int out = 0; out < 2; ++out)
+        {
+            // left to left, left to right, right to left, right to right
+            convolve (ir.getReadPointer (out), length, input.getReadPointer (0), a, numSamples);
+            convolve (ir.getReadPointer (2 + out), length, input.getReadPointer (1), b, numSamples);
+
+            int numDifferent = 0;
+            for (int i = 0; i < numSamples; ++i)
+                if (buffer.getSample (out, i) != a[i] + b[i])
+                    ++numDifferent;
+            expect (numDifferent == 0, String (numDifferent) + " samples differ on output " + String (out));
+        }
+
+        processor.releaseResources();
+    }
+
+    void testSwap()
+    {
+        beginTest ("swap");
+        const int blockSize = 256;
+        AudioBuffer<float> first (1, 32), second (1, 48);
+        for (int i = 0; i < first.getNumSamples(); ++i)
+            first.setSample (0, i, 1.0f / 32.0f);
+        for (int i = 0; i < second.getNumSamples(); ++i)
+            second.setSample (0, i, -1.0f / 48.0f);
+
+        ConvolutionProcessor processor;
+        processor.setImpulseResponse (first, 44100.0);
+        processor.prepareToPlay (44100.0, blockSize);
+
+        AudioBuffer<float> buffer (2, blockSize);
+        MidiBuffer midi;
+        float last = 0.0f, maxStep = 0.0f;
+        for (int block = 0; block < 64; ++block)
+        {
+            if (block == 16)
+                processor.setImpulseResponse (second, 44100.0);
+
+            for (int ch = 0; ch < 2; ++ch)
+                FloatVectorOperations::fill (buffer.getWritePointer (ch), 1.0f, blockSize);
+            processor.processBlock (buffer, midi);
+
+            for (int i = 0; i < blockSize; ++i)
+            {
+                const float sample = buffer.getSample (0, i);
+                if (block >= 1)
+                    maxStep = jmax (maxStep, std::abs (sample - last));
+                last = sample;
+            }
+
+            if (block == 15)
+                expectWithinAbsoluteError (last, 1.0f, 1.0e-5f);
+        }
+
+        expectWithinAbsoluteError (last, -1.0f, 1.0e-5f);
+        expect (maxStep < 0.01f, "largest step " + String (maxStep));
+        processor.releaseResources();
+    }
+
+    void testOverruns()
+    {
+        beginTest ("overruns");
+        const int numSamples = 48000, maxBlockSize = 256, length = 20000;
+        HeapBlock<float> x (numSamples), y (numSamples), expected (numSamples);
+        HeapBlock<float> h (length);
+        fillNoise (x, numSamples);
+        fillNoise (h, length, 3.0f);
+
+        PartitionedConvolver convolver (h, length, maxBlockSize, 64, 1024);
+        process (convolver, x, expected, numSamples, maxBlockSize);
+
+        // blocks faster than real time leave the worker behind, which
+        // silences a stage for a partition instead of waiting for it
+        PartitionedConvolver background (h, length, maxBlockSize, 64, 1024);
+        ConvolutionWorker worker;
+        worker.add (&background);
+        worker.start();
+        process (background, x, y, numSamples, maxBlockSize);
+
+        bool finite = true;
+        for (int n = 0; n < numSamples; ++n)
+            finite = finite && std::isfinite (y[n]);
+        expect (finite);
+        logMessage (String (background.getNumOverruns()) + " overruns");
+
+        // a reset with a job in flight doesn't wait for it, and the result
+        // is dropped when it is collected
+        background.reset();
+        worker.stop();
+        process (background, x, y, numSamples, maxBlockSize);
+        worker.remove (&background);
+
+        int numDifferent = 0;
+        for (int n = 0; n < numSamples; ++n)
+            if (y[n] != expected[n])
+                ++numDifferent;
+        expect (numDifferent == 0, String (numDifferent) + " samples differ after reset");
+    }
+
+    void testBenchmark()
+    {
+        beginTest ("benchmark");
+        const double sampleRate = 48000.0;
+        const int blockSize = 256, numBlocks = (int) (2.0 * sampleRate) / blockSize;
+        HeapBlock<float> x (blockSize), y (blockSize);
+        fillNoise (x, blockSize);
+
+        for (const int seconds : { 1, 2, 4, 8 })
+        {
+            const int length = (int) sampleRate * seconds;
+            HeapBlock<float> h (length);
+            fillNoise (h, length, 6.0f);
+
+            double total = 0.0, audioThread = 0.0;
+            for (const bool withWorker : { false, true })
+            {
+                PartitionedConvolver convolver (h, length, blockSize);
+                ConvolutionWorker worker;
+                if (withWorker)
+                {
+                    worker.add (&convolver);
+                    worker.start();
+                }
+
+                // with a worker blocks arrive in real time, so it has the
+                // partition period to compute its jobs like it would live
+                const double blockMs = 1000.0 * blockSize / sampleRate;
+                const double start = Time::getMillisecondCounterHiRes();
+                double elapsed = 0.0;
+                for (int i = 0; i < numBlocks; ++i)
+                {
+                    if (withWorker)
+                    {
+                        const double due = start + i * blockMs;
+                        const double now = Time::getMillisecondCounterHiRes();
+                        if (due > now)
+                            Thread::sleep ((int) (due - now));
+                        while (Time::getMillisecondCounterHiRes() < due)
+                            Thread::yield();
+                    }
+
+                    const double blockStart = Time::getMillisecondCounterHiRes();
+                    convolver.process (x, y, blockSize);
+                    elapsed += Time::getMillisecondCounterHiRes() - blockStart;
+                }
+                (withWorker ? audioThread : total) = elapsed;
+
+                worker.stop();
+                worker.remove (&convolver);
+            }
+
+            // percent of one core per second of audio, divided by the response length
+            const double audioMs = 1000.0 * numBlocks * blockSize / sampleRate;
+            logMessage (String (seconds) + " s impulse: "
+                + String (100.0 * total / audioMs / seconds, 3) + "% per IR second in total, "
+                + String (100.0 * audioThread / audioMs / seconds, 3) + "% on the audio thread with a worker");
+        }
+    }
+};
+
+static PartitionedConvolverTest sPartitionedConvolverTest;
+
+}
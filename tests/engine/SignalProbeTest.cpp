@@ -0,0 +1,190 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "Tests.h"
+#include "engine/GraphProcessor.h"
+#include "engine/SignalProbe.h"
+
+namespace Element {
+
+class SignalProbeTest : public UnitTestBase
+{
+public:
+    SignalProbeTest() : UnitTestBase ("Signal Probe", "engine", "signalProbe") { }
+    virtual ~SignalProbeTest() { }
+
+    void runTest() override
+    {
+        testAudio();
+        testDecimation();
+        testMidi();
+        testGraph();
+    }
+
+private:
+    enum { blockSize = 256 };
+
+    void testAudio()
+    {
+        beginTest ("audio ring");
+        SignalProbe probe (PortType::Audio, 1000);
+        float block [blockSize];
+        for (int i = 0; i < blockSize; ++i)
+            block[i] = (float) i / (float) blockSize;
+
+        for (int i = 0; i < 4; ++i)
+            probe.writeAudio (block, blockSize);
+        expect (probe.getNumReady() == 1000);
+        expect (probe.getNumDropped() == 4 * blockSize - 1000);
+        expectWithinAbsoluteError (probe.readPeak(), (float) (blockSize - 1) / (float) blockSize, 0.0001f);
+        expect (probe.readPeak() == 0.f);
+
+        float read [blockSize];
+        expect (probe.readAudio (read, blockSize) == blockSize);
+        for (int i = 0; i < blockSize; ++i)
+            expect (read[i] == block[i]);
+
+        probe.clear();
+        expect (probe.getNumReady() == 0);
+    }
+
+    void testDecimation()
+    {
+        beginTest ("decimation");
+        SignalProbe probe (PortType::Audio, 1000, 3);
+        float block [100];
+        for (int b = 0; b < 3; ++b)
+        {
+            for (int i = 0; i < 100; ++i)
+                block[i] = (float) (b * 100 + i);
+            probe.writeAudio (block, 100);
+        }
+
+        // every third sample across block boundaries
+        expect (probe.getNumReady() == 100);
+        float read [100];
+        expect (probe.readAudio (read, 100) == 100);
+        for (int i = 0; i < 100; ++i)
+            expect (read[i] == (float) (i * 3));
+    }
+
+    void testMidi()
+    {
+        beginTest ("midi ring");
+        SignalProbe probe (PortType::Midi, 4);
+        MidiBuffer buffer;
+        for (int i = 0; i < 6; ++i)
+            buffer.addEvent (MidiMessage::noteOn (1, 60 + i, (uint8) 100), i * 10);
+
+        const double before = Time::getMillisecondCounterHiRes();
+        probe.writeMidi (buffer, blockSize, 48000.0);
+        expect (probe.getNumReady() == 4);
+        expect (probe.getNumDropped() == 2);
+
+        MidiMessage msg;
+        for (int i = 0; i < 4; ++i)
+        {
+            expect (probe.readMidi (msg));
+            expect (msg.isNoteOn() && msg.getNoteNumber() == 60 + i);
+            expect (msg.getTimeStamp() >= before);
+        }
+        expect (! probe.readMidi (msg));
+    }
+
+    void testGraph()
+    {
+        beginTest ("attach to a connection");
+        GraphProcessor graph;
+        graph.setPlayConfigDetails (2, 2, 44100.0, blockSize);
+        graph.prepareToPlay (44100.0, blockSize);
+
+        GraphNodePtr input = graph.addNode (new GraphProcessor::AudioGraphIOProcessor (
+            GraphProcessor::AudioGraphIOProcessor::audioInputNode));
+        GraphNodePtr output = graph.addNode (new GraphProcessor::AudioGraphIOProcessor (
+            GraphProcessor::AudioGraphIOProcessor::audioOutputNode));
+        GraphNodePtr midiInput = graph.addNode (new GraphProcessor::AudioGraphIOProcessor (
+            GraphProcessor::AudioGraphIOProcessor::midiInputNode));
+        GraphNodePtr midiOutput = graph.addNode (new GraphProcessor::AudioGraphIOProcessor (
+            GraphProcessor::AudioGraphIOProcessor::midiOutputNode));
+        expect (graph.connectChannels (PortType::Audio, input->nodeId, 1, output->nodeId, 1));
+        expect (graph.connectChannels (PortType::Midi, midiInput->nodeId, 0, midiOutput->nodeId, 0));
+        MessageManager::getInstance()->runDispatchLoopUntil (10);
+
+        const auto* audioConnection = graph.getConnectionBetween (input->nodeId,
+            input->getPortForChannel (PortType::Audio, 1, false),
+            output->nodeId, output->getPortForChannel (PortType::Audio, 1, true));
+        expect (audioConnection != nullptr);
+        if (audioConnection == nullptr)
+            return;
+
+        SignalProbe::Ptr audioProbe = new SignalProbe (PortType::Audio, 4096);
+        SignalProbe::Ptr midiProbe = new SignalProbe (PortType::Midi, 64);
+        expect (graph.attachProbe (*audioConnection, audioProbe.get()));
+        expect (graph.attachProbe (midiInput->nodeId,
+            midiInput->getPortForChannel (PortType::Midi, 0, false), midiProbe.get()));
+        expect (! graph.attachProbe (input->nodeId,
+            input->getPortForChannel (PortType::Audio, 0, false), midiProbe.get()));
+        expect (graph.getNumProbes() == 2);
+
+        AudioSampleBuffer audio (2, blockSize);
+        MidiBuffer midi;
+        fill (audio);
+        midi.addEvent (MidiMessage::noteOn (1, 64, (uint8) 100), 16);
+        graph.processBlock (audio, midi);
+
+        float read [blockSize];
+        expect (audioProbe->readAudio (read, blockSize) == blockSize);
+        for (int i = 0; i < blockSize; ++i)
+            expect (read[i] == -0.5f + (float) i / (float) blockSize);
+        
+        MidiMessage msg;
+        expect (midiProbe->readMidi (msg) && msg.getNoteNumber() == 64);
+
+        beginTest ("detach");
+        graph.detachProbe (audioProbe.get());
+        graph.detachProbe (midiProbe.get());
+        expect (graph.getNumProbes() == 0);
+        fill (audio);
+        graph.processBlock (audio, midi);
+        expect (audioProbe->getNumReady() == 0);
+        expect (midiProbe->getNumReady() == 0);
+
+        beginTest ("removing the node detaches");
+        expect (graph.attachProbe (*audioConnection, audioProbe.get()));
+        graph.removeNode (input->nodeId);
+        expect (graph.getNumProbes() == 0);
+
+        input = output = midiInput = midiOutput = nullptr;
+        graph.releaseResources();
+        graph.clear();
+    }
+
+    static void fill (AudioSampleBuffer& audio)
+    {
+        for (int i = 0; i < audio.getNumSamples(); ++i)
+        {
+            audio.setSample (0, i, 0.25f);
+            audio.setSample (1, i, -0.5f + (float) i / (float) audio.getNumSamples());
+        }
+    }
+};
+
+static SignalProbeTest sSignalProbeTest;
+
+}
@@ -15,8 +15,12 @@
 #include <strings.h>
 
 #include "scripting/LuaBindings.h"
+#include "scripting/LuaBytecodeCache.h"
 #include "sol/sol.hpp"
 
+/* compiled scripts are cached between runs */
+static Element::LuaBytecodeCache* bytecodeCache = nullptr;
+
 #if !defined(LUA_PROMPT)
  #define LUA_PROMPT "> "
  #define LUA_PROMPT2 ">> "
@@ -449,13 +453,35 @@ static int pushargs(lua_State *L)
     return n;
 }
 
+/* precompiled chunks are loaded as they are, the cache only compiles source */
+static bool is_precompiled (const juce::File& file)
+{
+    juce::FileInputStream in (file);
+    return in.openedOk() && in.readByte() == LUA_SIGNATURE[0];
+}
+
 static int handle_script (lua_State *L, char **argv)
 {
     int status;
     const char *fname = argv[0];
     if (strcmp(fname, "-") == 0 && strcmp(argv[-1], "--") != 0)
         fname = NULL; /* stdin */
-    status = luaL_loadfile(L, fname);
+    const juce::File file = fname != NULL ? juce::File::getCurrentWorkingDirectory().getChildFile (fname)
+                                          : juce::File();
+    if (bytecodeCache != nullptr && file.existsAsFile() && ! is_precompiled (file))
+    {
+        juce::String source = file.loadFileAsString();
+        if (source.startsWithChar ('#'))
+            source = "--" + source; /* keep the line numbers of a skipped shebang */
+        juce::String chunkName ("@");
+        chunkName << fname;
+        status = bytecodeCache->load (L, source, chunkName.toRawUTF8());
+    }
+    else
+    {
+        status = luaL_loadfile(L, fname);
+    }
+
     if (status == LUA_OK)
     {
         int n = pushargs(L); /* push arguments to script */
@@ -638,6 +664,8 @@ int main(int argc, char **argv)
 {
     int status, result;
     sol::state L;
+    Element::LuaBytecodeCache cache;
+    bytecodeCache = &cache;
     L.open_libraries();
     Element::Lua::registerEngine (L);
 